@@ -14,7 +14,7 @@ bool DepthRenderPass::Create(Scene* sc)
 {
 	__super::Create(sc);
 
-	depthShader = LoadShader("../../resources/shaders/glsl330/kn-lit-depth.vs", "../../resources/shaders/glsl330/shadow_depth.fs");
+	depthShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/kn-lit-depth.vs", "../../resources/shaders/glsl330/shadow_depth.fs");
 	alphaTestLoc = GetShaderLocation(depthShader, "alphaTest");
 
 	Hints.pOverrideShader = &depthShader;
@@ -41,7 +41,7 @@ bool DepthRenderPass::Create(Scene* sc)
 void DepthRenderPass::Release()
 {
 	UnloadShadowmapRenderTexture(shadowMap);
-	UnloadShader(depthShader);
+	ResourceRegistry::Instance().ReleaseShader(depthShader);
 }
 
 void DepthRenderPass::BeginScene(SceneCamera* pOverrideCamera)
@@ -54,8 +54,7 @@ void DepthRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 		pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//Override shader 
 	BeginShaderMode(depthShader);
@@ -67,7 +66,7 @@ void DepthRenderPass::Render()
 	vector<RenderContext>::iterator bk = pScene->_RenderQueue.Background.begin();
 	while (bk != pScene->_RenderQueue.Background.end())
 	{
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -76,7 +75,7 @@ void DepthRenderPass::Render()
 	while (opaque != pScene->_RenderQueue.Geometry.end())
 	{
 		BeginBlendMode(opaque->pComponent->blendingMode);
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		EndBlendMode();
 		++opaque;
 	}
@@ -88,7 +87,7 @@ void DepthRenderPass::Render()
 	while (alpha != pScene->_RenderQueue.AlphaBlending.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		++alpha;
 	}
@@ -100,7 +99,7 @@ void DepthRenderPass::Render()
 	while (overlay != pScene->_RenderQueue.Overlay.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		EndBlendMode();
 		++overlay;
 	}
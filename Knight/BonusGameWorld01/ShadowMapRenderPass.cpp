@@ -15,7 +15,7 @@ bool ShadowMapRenderPass::Create(Scene *sc)
 {
 	__super::Create(sc);
 
-	shadowShader = LoadShader("../../resources/shaders/glsl330/shadowmap.vs", "../../resources/shaders/glsl330/kn-lit-sm-pcf.fs");
+	shadowShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/shadowmap.vs", "../../resources/shaders/glsl330/kn-lit-sm-pcf.fs");
 	lightDirLoc = GetShaderLocation(shadowShader, "lightDir");
 	lightColLoc = GetShaderLocation(shadowShader, "lightColor");
 	shadowShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(shadowShader, "viewPos");
@@ -39,7 +39,7 @@ bool ShadowMapRenderPass::Create(Scene *sc)
 
 void ShadowMapRenderPass::Release()
 {
-	UnloadShader(shadowShader);
+	ResourceRegistry::Instance().ReleaseShader(shadowShader);
 }
 
 bool ShadowMapRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
@@ -54,21 +54,7 @@ bool ShadowMapRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 			dist2 = Vector3DistanceSqr(pos, pActiveCamera->GetPosition());
 	}
 
-	switch (pSC->renderQueue)
-	{
-		case Component::eRenderQueueType::Background:
-			pScene->_RenderQueue.Background.push_back(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Geometry:
-			pScene->_RenderQueue.Geometry.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::AlphaBlend:
-			pScene->_RenderQueue.AlphaBlending.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Overlay:
-			pScene->_RenderQueue.Overlay.push_back(RenderContext{ pSC, dist2 });
-			break;
-	}
+	AddToRenderQueue(pSC, dist2);
 
 	return true;
 }
@@ -90,8 +76,7 @@ void ShadowMapRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 	pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//update lighting changes (if any)
 	Vector4 lightColorNormalized = ColorNormalize(pLight->lightColor);
@@ -114,7 +99,7 @@ void ShadowMapRenderPass::Render()
 	while (bk != pScene->_RenderQueue.Background.end()) {
 		int receiveShadow = bk->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -123,7 +108,7 @@ void ShadowMapRenderPass::Render()
 	while (opaque != pScene->_RenderQueue.Geometry.end()) {
 		int receiveShadow = opaque->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 	
@@ -135,7 +120,7 @@ void ShadowMapRenderPass::Render()
 		BeginBlendMode(alpha->pComponent->blendingMode);
 		int receiveShadow = alpha->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		rlEnableDepthMask();
 		rlEnableBackfaceCulling();
@@ -147,7 +132,7 @@ void ShadowMapRenderPass::Render()
 	while (overlay != pScene->_RenderQueue.Overlay.end()) {
 		int receiveShadow = overlay->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		++overlay;
 	}	
 }
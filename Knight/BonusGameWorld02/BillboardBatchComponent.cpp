@@ -0,0 +1,349 @@
+#include "BillboardBatchComponent.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+BillboardBatchComponent::BillboardBatchComponent()
+{
+	renderQueue = Component::eRenderQueueType::AlphaBlend;
+	blendingMode = BLEND_ALPHA;
+	EnableAlphaTest = true;
+	castShadow = Component::eShadowCastingType::Shadow;
+}
+
+BillboardBatchComponent::~BillboardBatchComponent()
+{
+}
+
+int BillboardBatchComponent::AddTexture(Texture2D texture)
+{
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].id == texture.id)
+			return (int)i;
+	}
+	textures.push_back(texture);
+	return (int)textures.size() - 1;
+}
+
+int BillboardBatchComponent::AddInstance(int textureIndex, Vector3 position, Vector2 size, Rectangle source, Color tint, bool alphaTest, bool castShadow)
+{
+	if (textureIndex < 0 || textureIndex >= (int)textures.size())
+	{
+		TraceLog(LOG_WARNING, "<BillboardBatchComponent.AddInstance> Invalid texture index %d", textureIndex);
+		return -1;
+	}
+
+	positions.push_back(position);
+	sizes.push_back(size);
+	sources.push_back(source);
+	tints.push_back(tint);
+	textureIndices.push_back((unsigned short)textureIndex);
+	flags.push_back((unsigned char)((alphaTest ? InstanceAlphaTest : 0) | (castShadow ? InstanceCastShadow : 0)));
+	cellsDirty = true;
+	return (int)positions.size() - 1;
+}
+
+void BillboardBatchComponent::SetInstancePosition(int index, Vector3 position)
+{
+	positions[index] = position;
+	cellsDirty = true;
+}
+
+void BillboardBatchComponent::Clear()
+{
+	positions.clear();
+	sizes.clear();
+	sources.clear();
+	tints.clear();
+	textureIndices.clear();
+	flags.clear();
+	cells.clear();
+	cellInstances.clear();
+	LocalBoundingBox = { 0 };
+	cellsDirty = true;
+}
+
+/// <summary>
+/// Update - Rebuild the cells after instances were added or moved, before the actor takes the
+/// component's bounding box.
+/// </summary>
+/// <param name="ElapsedSeconds">Seconds since last called</param>
+/// <param name="pRH">Not used</param>
+void BillboardBatchComponent::Update(float ElapsedSeconds, RenderHints* pRH)
+{
+	if (cellsDirty)
+		BuildCells();
+}
+
+/// <summary>
+/// BuildCells - Bucket the instances into BILLBOARD_BATCH_CELL_SIZE cells with a counting sort and
+/// compute the bounds of every cell, a billboard can turn so it reaches half its largest side around
+/// its position. The component's bounding box is the union of the cells.
+/// </summary>
+void BillboardBatchComponent::BuildCells()
+{
+	cellsDirty = false;
+	cells.clear();
+	cellInstances.clear();
+	if (positions.empty())
+		return;
+
+	int count = (int)positions.size();
+	vector<int> cellOf(count);
+	int minX = INT_MAX, minZ = INT_MAX, maxX = INT_MIN, maxZ = INT_MIN;
+	for (int i = 0; i < count; i++)
+	{
+		int cx = (int)floorf(positions[i].x / BILLBOARD_BATCH_CELL_SIZE);
+		int cz = (int)floorf(positions[i].z / BILLBOARD_BATCH_CELL_SIZE);
+		minX = std::min(minX, cx);
+		maxX = std::max(maxX, cx);
+		minZ = std::min(minZ, cz);
+		maxZ = std::max(maxZ, cz);
+	}
+
+	int gridWidth = maxX - minX + 1;
+	int gridDepth = maxZ - minZ + 1;
+	vector<int> cellStart((size_t)gridWidth * gridDepth + 1, 0);
+	for (int i = 0; i < count; i++)
+	{
+		int cx = (int)floorf(positions[i].x / BILLBOARD_BATCH_CELL_SIZE) - minX;
+		int cz = (int)floorf(positions[i].z / BILLBOARD_BATCH_CELL_SIZE) - minZ;
+		cellOf[i] = cz * gridWidth + cx;
+		cellStart[cellOf[i] + 1]++;
+	}
+	for (size_t c = 1; c < cellStart.size(); c++)
+		cellStart[c] += cellStart[c - 1];
+
+	cellInstances.resize(count);
+	vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < count; i++)
+		cellInstances[fill[cellOf[i]]++] = i;
+
+	for (size_t c = 0; c + 1 < cellStart.size(); c++)
+	{
+		BillboardCell cell;
+		cell.first = cellStart[c];
+		cell.count = cellStart[c + 1] - cellStart[c];
+		if (cell.count == 0)
+			continue;
+
+		cell.bounds.min = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		cell.bounds.max = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int k = cell.first; k < cell.first + cell.count; k++)
+		{
+			int i = cellInstances[k];
+			float extent = std::max(sizes[i].x, sizes[i].y) * 0.5f;
+			Vector3 reach = { extent, extent, extent };
+			cell.bounds.min = Vector3Min(cell.bounds.min, Vector3Subtract(positions[i], reach));
+			cell.bounds.max = Vector3Max(cell.bounds.max, Vector3Add(positions[i], reach));
+		}
+		cells.push_back(cell);
+	}
+
+	LocalBoundingBox = cells[0].bounds;
+	for (const BillboardCell& cell : cells)
+	{
+		LocalBoundingBox.min = Vector3Min(LocalBoundingBox.min, cell.bounds.min);
+		LocalBoundingBox.max = Vector3Max(LocalBoundingBox.max, cell.bounds.max);
+	}
+}
+
+/// <summary>
+/// Draw - Cull the cells against the frustum of the drawing camera and bucket the visible instances by
+/// texture and alpha test. Without blending every bucket is one streamed draw call. With blending all the
+/// visible instances are sorted far to near together, so billboards of different textures overlap in the
+/// right order, and a new draw call starts wherever the texture or alpha test changes along the sorted list.
+/// A pass drawing from another camera than the main one (shadow depth) only gets the instances casting shadows.
+/// </summary>
+/// <param name="pRH">The RenderHints, use to override default rendering settings</param>
+void BillboardBatchComponent::Draw(RenderHints* pRH)
+{
+	NumVisible = 0;
+	NumCellsVisible = 0;
+	NumDrawCalls = 0;
+
+	if (positions.empty())
+		return;
+	if (cellsDirty)
+		BuildCells();
+
+	SceneCamera* pMainCamera = _SceneActor->GetMainCamera();
+	if (pMainCamera == nullptr)
+		return;
+	SceneCamera* pCamera = pMainCamera;
+	if (pRH != nullptr && pRH->pOverrideCamera != nullptr)
+		pCamera = pRH->pOverrideCamera;
+	bool shadowPass = pCamera != pMainCamera;
+	const Shader* pShader = pRH != nullptr ? pRH->pOverrideShader : nullptr;
+	Camera3D camera = *pCamera->GetCamera3D();
+
+	FrustumPlane frustumPlanes[6];
+	pCamera->ExtractFrustumPlanes(frustumPlanes);
+
+	buckets.resize(textures.size() * 2);
+	for (auto& bucket : buckets)
+		bucket.clear();
+
+	for (const BillboardCell& cell : cells)
+	{
+		if (!pCamera->IsBoundingBoxInFrustum(cell.bounds, frustumPlanes))
+			continue;
+		NumCellsVisible++;
+
+		for (int k = cell.first; k < cell.first + cell.count; k++)
+		{
+			int i = cellInstances[k];
+			if (shadowPass && (flags[i] & InstanceCastShadow) == 0)
+				continue;
+			buckets[textureIndices[i] * 2 + ((flags[i] & InstanceAlphaTest) ? 1 : 0)].push_back(i);
+		}
+	}
+
+	//the buckets one after the other keep the instances of a texture together
+	visible.clear();
+	for (const auto& bucket : buckets)
+		visible.insert(visible.end(), bucket.begin(), bucket.end());
+	NumVisible = (int)visible.size();
+	if (visible.empty())
+		return;
+
+	//blending needs the far billboards first whatever their texture, the depth pass doesn't blend
+	if (DepthSort && !shadowPass && (blendingMode == BLEND_ALPHA || blendingMode == BLEND_ALPHA_PREMULTIPLY))
+	{
+		depths.resize(positions.size());
+		for (int i : visible)
+			depths[i] = Vector3DistanceSqr(positions[i], camera.position);
+		std::sort(visible.begin(), visible.end(), [this](int x, int y) { return depths[x] > depths[y]; });
+	}
+
+	Vector3 up = { 0.0f, 1.0f, 0.0f };
+	if (AlignType == SCREEN_ALIGNED)
+	{
+		Matrix matView = MatrixLookAt(camera.position, camera.target, camera.up);
+		up = { matView.m1, matView.m5, matView.m9 };
+	}
+
+	//the vertex buffers need the GL context, which the first Draw is sure to have
+	if (!quadsCreated)
+	{
+		quadsCreated = true;
+		if (!quads.Create())
+			TraceLog(LOG_WARNING, "<BillboardBatchComponent.Draw> Streaming quads not available, drawing single billboards");
+	}
+
+	int alphaTestLoc = pShader != nullptr ? GetShaderLocation(*pShader, "alphaTest") : -1;
+
+	BeginBlendMode(blendingMode);
+	int lastAlphaTest = -1;
+	size_t first = 0;
+	while (first < visible.size())
+	{
+		//the run of instances sharing the texture and alpha test of the first one
+		int textureIndex = textureIndices[visible[first]];
+		int alphaTest = (flags[visible[first]] & InstanceAlphaTest) ? 1 : 0;
+		size_t last = first + 1;
+		while (last < visible.size() && textureIndices[visible[last]] == textureIndex
+			&& ((flags[visible[last]] & InstanceAlphaTest) ? 1 : 0) == alphaTest)
+			last++;
+
+		if (alphaTestLoc >= 0 && alphaTest != lastAlphaTest)
+		{
+			rlDrawRenderBatchActive();	//what raylib batched so far was meant for the previous value
+			SetShaderValue(*pShader, alphaTestLoc, &alphaTest, SHADER_UNIFORM_INT);
+			lastAlphaTest = alphaTest;
+		}
+
+		const int* pInstances = visible.data() + first;
+		int count = (int)(last - first);
+		Texture2D texture = textures[textureIndex];
+		if (quads.IsReady())
+			DrawRun(pInstances, count, texture, camera, up, pShader);
+		else
+			DrawBillboards(pInstances, count, texture, camera, up, pShader);
+		first = last;
+	}
+	EndBlendMode();
+
+	//leave the uniform as a pass enabling the alpha test per component would
+	if (alphaTestLoc >= 0)
+	{
+		rlDrawRenderBatchActive();
+		int alphaTest = EnableAlphaTest ? 1 : 0;
+		SetShaderValue(*pShader, alphaTestLoc, &alphaTest, SHADER_UNIFORM_INT);
+	}
+}
+
+/// <summary>
+/// DrawRun - Build the camera facing quads of the instances and draw them through the streaming
+/// quad buffer, in as many calls as the buffer needs.
+/// </summary>
+void BillboardBatchComponent::DrawRun(const int* pInstances, int count, Texture2D texture, const Camera3D& camera, Vector3 up, const Shader* pShader)
+{
+	Matrix matView = MatrixLookAt(camera.position, camera.target, camera.up);
+	Vector3 right = { matView.m0, matView.m4, matView.m8 };
+	float invWidth = 1.0f / texture.width;
+	float invHeight = 1.0f / texture.height;
+
+	int k = 0;
+	while (k < count)
+	{
+		int room = quads.GetMaxQuads() - quads.GetNumQuads();
+		if (room == 0)
+		{
+			if (quads.Draw(texture, pShader))
+				NumDrawCalls++;
+			continue;
+		}
+
+		int numQuads = std::min(room, count - k);
+		QuadVertex* pVertex = quads.AddQuads(numQuads);
+		for (int end = k + numQuads; k < end; k++)
+		{
+			int i = pInstances[k];
+			const Rectangle& src = sources[i];
+			Rectangle uv = { src.x * invWidth, src.y * invHeight, src.width * invWidth, src.height * invHeight };
+			WriteQuad(pVertex, positions[i], Vector3Scale(right, sizes[i].x * 0.5f), Vector3Scale(up, sizes[i].y * 0.5f), uv, tints[i]);
+			pVertex += 4;
+		}
+	}
+
+	if (quads.Draw(texture, pShader))
+		NumDrawCalls++;
+}
+
+void BillboardBatchComponent::WriteQuad(QuadVertex* pVertex, Vector3 p, Vector3 rx, Vector3 uy, Rectangle uv, Color c)
+{
+	float u0 = uv.x;
+	float u1 = uv.x + uv.width;
+	float v0 = uv.y;
+	float v1 = uv.y + uv.height;
+
+	// counter clockwise from the bottom left
+	pVertex[0] = QuadVertex{ Vector3Subtract(Vector3Subtract(p, rx), uy), Vector2{ u0, v1 }, c };
+	pVertex[1] = QuadVertex{ Vector3Subtract(Vector3Add(p, rx), uy), Vector2{ u1, v1 }, c };
+	pVertex[2] = QuadVertex{ Vector3Add(Vector3Add(p, rx), uy), Vector2{ u1, v0 }, c };
+	pVertex[3] = QuadVertex{ Vector3Add(Vector3Subtract(p, rx), uy), Vector2{ u0, v0 }, c };
+}
+
+/// <summary>
+/// DrawBillboards - Fallback without vertex array objects, one raylib billboard per instance.
+/// </summary>
+void BillboardBatchComponent::DrawBillboards(const int* pInstances, int count, Texture2D texture, const Camera3D& camera, Vector3 up, const Shader* pShader)
+{
+	if (pShader != nullptr)
+		BeginShaderMode(*pShader);
+	for (int k = 0; k < count; k++)
+	{
+		int i = pInstances[k];
+		DrawBillboardPro(camera, texture, sources[i], positions[i], up, sizes[i], Vector2Scale(sizes[i], 0.5f), 0, tints[i]);
+	}
+	if (pShader != nullptr)
+		EndShaderMode();
+	NumDrawCalls++;
+}
+
+//end of BillboardBatchComponent.cpp
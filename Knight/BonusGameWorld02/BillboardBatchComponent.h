@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include "Knight.h"
+#include "BillboardComponent.h"
+
+#define BILLBOARD_BATCH_CELL_SIZE	32.0f	//world units per side of a culling cell
+
+// Thousands of billboards in one Component: props and vegetation scattered over a level without a
+// SceneActor each. Instances live in flat arrays and are bucketed into square cells on the XZ plane;
+// Draw tests the cells against the frustum and draws the visible instances sharing a texture and the
+// alpha test setting with one streamed draw call; when blending, the instances of all textures are sorted
+// far to near together and split into runs of the same texture. Instance positions are in world space, keep the
+// owning SceneActor at the origin without rotation or scale.
+class BillboardBatchComponent : public Component
+{
+public:
+	BillboardBatchComponent();
+	~BillboardBatchComponent();
+
+	void Update(float ElapsedSeconds, RenderHints* pRH = nullptr) override;
+	void Draw(RenderHints* pRH = nullptr) override;
+
+	// The textures are not owned, they have to outlive the component. Returns the texture index.
+	int AddTexture(Texture2D texture);
+
+	// Returns the instance index. source is the rectangle of the texture (atlas) in pixels, the billboard
+	// is centered on position.
+	int AddInstance(int textureIndex, Vector3 position, Vector2 size, Rectangle source, Color tint = WHITE, bool alphaTest = true, bool castShadow = true);
+	void SetInstancePosition(int index, Vector3 position);
+	void SetInstanceTint(int index, Color tint) { tints[index] = tint; }
+	void Clear();
+
+	int GetNumInstances() const { return (int)positions.size(); }
+
+	// The 4 vertices of a billboard centered on position, uv is the normalized texture rectangle
+	static void WriteQuad(QuadVertex* pVertex, Vector3 position, Vector3 halfRight, Vector3 halfUp, Rectangle uv, Color color);
+
+	BillboardAlignType AlignType = UPWARD_ALIGNED;
+
+	// Sort the visible instances far to near when the blend mode needs it
+	bool DepthSort = true;
+
+	// Counters of the last Draw
+	int NumVisible = 0;
+	int NumCellsVisible = 0;
+	int NumDrawCalls = 0;
+
+protected:
+	// Instance streams
+	vector<Vector3> positions;
+	vector<Vector2> sizes;
+	vector<Rectangle> sources;
+	vector<Color> tints;
+	vector<unsigned short> textureIndices;
+	vector<unsigned char> flags;
+
+	enum eInstanceFlag : unsigned char
+	{
+		InstanceAlphaTest = 1,
+		InstanceCastShadow = 2
+	};
+
+	struct BillboardCell
+	{
+		BoundingBox bounds;
+		int first;	// into cellInstances
+		int count;
+	};
+
+	vector<Texture2D> textures;
+	vector<BillboardCell> cells;
+	vector<int> cellInstances;	// instance indices grouped by cell
+	bool cellsDirty = true;
+
+	// Per draw scratch: the visible instances of each texture and alpha test pair, then all of them
+	// in drawing order
+	vector<vector<int>> buckets;
+	vector<int> visible;
+	vector<float> depths;
+
+	StreamingQuadBuffer quads;
+	bool quadsCreated = false;
+
+	void BuildCells();
+	void DrawRun(const int* pInstances, int count, Texture2D texture, const Camera3D& camera, Vector3 up, const Shader* pShader);
+	void DrawBillboards(const int* pInstances, int count, Texture2D texture, const Camera3D& camera, Vector3 up, const Shader* pShader);
+
+	friend SceneActor;
+};
+
+//end of BillboardBatchComponent.h
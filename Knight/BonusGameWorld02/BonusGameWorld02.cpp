@@ -19,11 +19,18 @@
 
 #include "BonusGameWorld02.h"
 
+#include <cstring>
+
 int main(int argc, char* argv[])
 {
 	BonusGameWorld02* KnightBonusGameWorld02 = new BonusGameWorld02();
 
 	KnightBonusGameWorld02->Start();
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-benchmark") == 0)
+			KnightBonusGameWorld02->RunBenchmarks();
+	}
 	KnightBonusGameWorld02->GameLoop();
 
 	delete KnightBonusGameWorld02;
@@ -83,6 +90,18 @@ void BonusGameWorld02::Start()
 	sceneLight = _Scene->CreateSceneObject<ShadowSceneLight>("Light");
 	sceneLight->SetLight(Vector3{ -50.0f, -30.0f, 50.0f }, WHITE);
 
+#if USE_CASCADED_SHADOWS
+	//Create a depth render pass and shadow map render pass with 3 shadow cascades. The near cascade gives
+	//sharp shadows around the player, the far ones cover the view up to ShadowDistance at a lower resolution.
+	pDepthRenderer = new CascadedDepthRenderPass(sceneLight, 3);
+	pDepthRenderer->Create(_Scene);
+
+	pShadowMapRenderer = new CascadedShadowMapRenderPass(sceneLight, pDepthRenderer->shadowMap.depth.id);
+	pShadowMapRenderer->Create(_Scene);
+
+	//Torches for the night variant, the cascaded pass adds any number of point lights through a froxel grid.
+	CreateNightLights();
+#else
 	//Create a depth render pass and shadow map render pass.
 	float depthShadowCutOff = 20.0f * 20.0f;
 	pDepthRenderer = new LoDDepthRenderPass(depthShadowCutOff, sceneLight);
@@ -91,6 +110,16 @@ void BonusGameWorld02::Start()
 	float shadowCutOff = 20.0f * 20.0f;
 	pShadowMapRenderer = new LoDShadowMapRenderPass(shadowCutOff, sceneLight, pDepthRenderer->shadowMap.depth.id);
 	pShadowMapRenderer->Create(_Scene);
+#endif
+
+	//All particle emitters are drawn in batches through one streaming vertex buffer.
+	if (!ParticleRenderBatcher::Instance().Create())
+	{
+		TraceLog(LOG_WARNING, "<BonusGameWorld02.Start> Particle batching not available, emitters draw single billboards");
+	}
+
+	//The village props share their models, textures and shaders, show what was actually loaded.
+	ResourceRegistry::Instance().LogStats();
 
 	SetTargetFPS(60); // Set the target frame rate for the game loop
 }
@@ -98,9 +127,26 @@ void BonusGameWorld02::Start()
 void BonusGameWorld02::EndGame()
 {
 	_Entities.clear();
+	ParticleRenderBatcher::Instance().Release();
 	__super::EndGame();
 }
 
+/// <summary>
+/// RunBenchmarks - Measure the hot paths of the demo once and log the results. They stall the game for a
+/// moment, so they only run when the demo is started with -benchmark.
+/// </summary>
+void BonusGameWorld02::RunBenchmarks()
+{
+	//update cost at 100k particles
+	ParticleComponent::RunSimulationBenchmark();
+
+	//decode cost of the compact heights against floats, the tiled terrain has no in-memory heightmap to compare
+	_TerrainEntity->_Terrain->RunSamplingBenchmark();
+
+	//edits beyond the quantized range of the compact heights must not be flattened
+	_TerrainEntity->_Terrain->RunCompactEditCheck();
+}
+
 void BonusGameWorld02::Update(float ElapsedSeconds)
 {
 	double t = GetTime();
@@ -112,7 +158,7 @@ void BonusGameWorld02::Update(float ElapsedSeconds)
 	{
 		_Entities[i]->Update(ElapsedSeconds);
 	}
-	
+
 	Vector3 cameraPos = _Scene->GetMainCameraActor()->GetPosition();
 	SetShaderValue(pShadowMapRenderer->shadowShader, pShadowMapRenderer->shadowShader.locs[SHADER_LOC_VECTOR_VIEW], &cameraPos, SHADER_UNIFORM_VEC3);
 
@@ -153,6 +199,24 @@ void BonusGameWorld02::Update(float ElapsedSeconds)
 		sceneLight->lightDir.y -= cameraSpeed * 60.0f * ElapsedSeconds;
 	} 
 
+	//Terrain editing: dig a crater where the player stands.
+	if (IsKeyPressed(KEY_F6))
+	{
+		_TerrainEntity->_Terrain->StampBrush(_PlayerEntity->_Actor->Position, 6.0f, -2.0f);
+	}
+
+#if USE_CASCADED_SHADOWS
+	//Night variant: dim the sun and light the world with the torches instead.
+	if (IsKeyPressed(KEY_N))
+	{
+		nightMode = !nightMode;
+		if (nightMode)
+			_Scene->PointLights = nightLights;
+		else
+			_Scene->PointLights.clear();
+	}
+#endif
+
 	//after all the SceneObjects are updated, it's time to make adjustments to the 
 	// player position and camera.
 	//This is usually done in other game engines during the "Late Update" phase.
@@ -201,8 +265,24 @@ void BonusGameWorld02::Update(float ElapsedSeconds)
 	pMainCamera->SetLookAtPosition(_PlayerEntity->_Actor->Position);
 	pMainCamera->Update(0.001f);   //late update to adjust the camera position and look-at direction
 
+#if USE_CASCADED_SHADOWS
+	//the terrain is cached as a static caster, render its shadow again after an edit or a tile was paged in or out
+	unsigned int terrainChange = _TerrainEntity->_Terrain->GetHeightChangeSerial();
+	if (terrainChange != lastTerrainChange) {
+		lastTerrainChange = terrainChange;
+		pDepthRenderer->InvalidateStaticCasters();
+	}
+#endif
+
+	//the particle components only queued themselves during the scene update
+	ParticleSystemManager::Instance().Update(pMainCamera);
+
 	//change of sky light
 	sceneLight->lightColor = pMainCamera->GetComponent<SkyboxComponent>()->_SkyColor;
+#if USE_CASCADED_SHADOWS
+	if (nightMode)
+		sceneLight->lightColor = ColorBrightness(sceneLight->lightColor, -0.85f);
+#endif
 
 	_FrameUpdateTime = float(GetTime() - t);
 }
@@ -210,12 +290,17 @@ void BonusGameWorld02::Update(float ElapsedSeconds)
 void BonusGameWorld02::DrawOffscreen()
 {
 	double t = GetTime();
+#if USE_CASCADED_SHADOWS
+	//Render every shadow cascade into its tile of the shadow map.
+	pDepthRenderer->RenderCascades();
+#else
 	//Render the scene to the shadow map texture. See Chapter 7 for details.
 	pDepthRenderer->BeginShadowMap(_Scene);
 	pDepthRenderer->BeginScene();
 	pDepthRenderer->Render();
 	pDepthRenderer->EndScene();
 	pDepthRenderer->EndShadowMap();
+#endif
 	_OffscreenRenderTime = float(GetTime() - t);
 }
 
@@ -240,6 +325,41 @@ void BonusGameWorld02::DrawGUI()
 	QuadTreeTerrainComponent* pTerrainCmpt = _TerrainEntity->_Terrain;
 	//DrawText(TextFormat("Terrain triangle count = %d %d %d %3.1f %3.1f %3.1f", pTerrainCmpt->NumTriangles, pDepthRenderer->NumComponentsSkipped, pShadowMapRenderer->NumComponentsSkipped, _FrameUpdateTime * 1000, _OffscreenRenderTime * 1000, _FrameRenderTime * 1000), 10, 160, 50, WHITE);
 	//DrawText(TextFormat("LOD Factor: %.1f", pTerrainCmpt->LevelOfDetailDistance), 10, 220, 50, WHITE);
+	const BillboardBatchComponent* pImposters = _TerrainEntity->GetImposterBatch();
+	if (pImposters != nullptr)
+		DrawText(TextFormat("Imposters: %d visible, %d draw calls", pImposters->NumVisible, pImposters->NumDrawCalls), 10, 200, 30, WHITE);
+	const ParticleBatcherStats& particleStats = ParticleRenderBatcher::Instance().GetStats();
+	DrawText(TextFormat("Particles: %d in %d batches, %d draw calls", particleStats.particlesDrawn, particleStats.batchesIssued, particleStats.drawCalls), 10, 60, 30, WHITE);
+	const ParticleSystemStats& simStats = ParticleSystemManager::Instance().GetStats();
+	DrawText(TextFormat("Emitters: %d/%d simulated, %d jobs, %d sorted, %.2f ms", simStats.emittersSimulated, simStats.emittersQueued, simStats.chunks, simStats.particlesSorted, simStats.updateMs), 10, 95, 30, WHITE);
+#if USE_CASCADED_SHADOWS
+	DrawText(TextFormat("Shadow casters: %d / %d / %d / %d, static cache refreshed %d times", pDepthRenderer->NumCasters[0], pDepthRenderer->NumCasters[1], pDepthRenderer->NumCasters[2], pDepthRenderer->NumCasters[3], pDepthRenderer->NumStaticRefreshes), 10, 130, 30, WHITE);
+	const ClusteredLighting& clusters = pShadowMapRenderer->Clusters;
+	if (nightMode)
+		DrawText(TextFormat("Point lights: %d / %d visible, %d lit clusters, %d light indices", clusters.NumVisibleLights, clusters.NumLights, clusters.NumLitClusters, clusters.NumIndices), 10, 165, 30, WHITE);
+	else
+		DrawText(TextFormat("N: night with %d torches", (int)nightLights.size()), 10, 165, 30, WHITE);
+#endif
+}
+
+/// <summary>
+/// CreateNightLights - Scatter NUM_NIGHT_LIGHTS torches over the terrain for the night variant. They reach
+/// a few meters each, so a view only touches a part of them and every froxel only a handful.
+/// </summary>
+void BonusGameWorld02::CreateNightLights()
+{
+	QuadTreeTerrainComponent* pTerrain = _TerrainEntity->_Terrain;
+	nightLights.resize(NUM_NIGHT_LIGHTS);
+	for (PointLightData& light : nightLights)
+	{
+		light.position.x = (float)GetRandomValue(-240, 240);
+		light.position.z = (float)GetRandomValue(-240, 240);
+		light.position.y = pTerrain->GetTerrainY(light.position.x, light.position.z) + 1.5f;
+		light.radius = (float)GetRandomValue(6, 14);
+		//warm flame colors from red to yellow
+		light.color = Color{ 255, (unsigned char)GetRandomValue(80, 200), (unsigned char)GetRandomValue(20, 60), 255 };
+		light.intensity = 1.5f;
+	}
 }
 
 void BonusGameWorld02::OnCreateDefaultResources()
@@ -5,7 +5,11 @@
 #include "QuadTreeTerrainComponent.h"
 #include "SkyboxComponent.h"
 #include "BillboardComponent.h"
+#include "BillboardBatchComponent.h"
+#include "FoliageScatterComponent.h"
 #include "ParticleComponent.h"
+#include "ParticleRenderBatcher.h"
+#include "ParticleSystemManager.h"
 #include "FollowUpCamera.h"
 
 #include "ShadowSceneLight.h"
@@ -13,6 +17,8 @@
 #include "LoDShadowMapRenderPass.h"
 #include "DepthRenderPass.h"
 #include "LoDDepthRenderPass.h"
+#include "CascadedDepthRenderPass.h"
+#include "CascadedShadowMapRenderPass.h"
 
 #include "PlayerFSM.h"
 
@@ -20,11 +26,16 @@
 
 #include "Entities.h" // Custom entities for the bonus game world demo
 
+#define USE_CASCADED_SHADOWS 1 //fit shadow cascades to the view instead of a fixed light camera with a cutoff
+#define NUM_NIGHT_LIGHTS 1000 //torches of the night variant (N key), shaded by the clustered lighting of the cascaded pass
+
 class BonusGameWorld02 : public Knight
 {
 public:
 	void Start() override;
 	void EndGame() override;
+	// Opt-in measurements logged once after Start, the -benchmark command line switch runs them
+	void RunBenchmarks();
 
 	BonusGameWorld02();
 
@@ -47,12 +58,21 @@ public:
 
 
 	ShadowSceneLight* sceneLight = nullptr;
+#if USE_CASCADED_SHADOWS
+	CascadedShadowMapRenderPass* pShadowMapRenderer = nullptr;
+	CascadedDepthRenderPass* pDepthRenderer = nullptr;
+	unsigned int lastTerrainChange = 0; //serial of the last terrain height change the static shadow cache saw
+	bool nightMode = false;
+	vector<PointLightData> nightLights; //copied into the Scene's PointLights at night
+#else
 	LoDShadowMapRenderPass* pShadowMapRenderer = nullptr;
 	LoDDepthRenderPass* pDepthRenderer = nullptr;
+#endif
 
 protected:
 
 	void OnCreateDefaultResources() override;
+	void CreateNightLights();
 
 	void Update(float ElapsedSeconds) override;
 	void DrawOffscreen() override;
@@ -0,0 +1,403 @@
+#include "Knight.h"
+
+#include "rlgl.h"
+
+#include "CascadedDepthRenderPass.h"
+
+#define SHADOW_DEPTH_BUFFER_BIT 0x00000100 //GL_DEPTH_BUFFER_BIT, for copying the cached depth
+
+CascadedDepthRenderPass::CascadedDepthRenderPass(ShadowSceneLight* l, int numCascades) : DepthRenderPass(l)
+{
+	NumCascades = numCascades;
+}
+
+/// <summary>
+/// Create - Create the shadow map atlas and the depth shader of the cascades
+/// </summary>
+/// <param name="sc">The Scene to render shadow</param>
+/// <returns>True if initialization is successful.</returns>
+bool CascadedDepthRenderPass::Create(Scene* sc)
+{
+	if (!__super::Create(sc))
+		return false;
+
+	if (NumCascades < 1 || NumCascades > MAX_SHADOW_CASCADES)
+	{
+		TraceLog(LOG_WARNING, "<CascadedDepthRenderPass.Create> %d cascades are not supported, clamped to 1 ~ %d", NumCascades, MAX_SHADOW_CASCADES);
+		NumCascades = NumCascades < 1 ? 1 : MAX_SHADOW_CASCADES;
+	}
+	cascadeResolution = shadowMapResolution / SHADOW_CASCADE_COLUMNS;
+
+	if (CacheStaticCasters)
+	{
+		staticShadowMap = LoadShadowmapRenderTexture(shadowMapResolution, shadowMapResolution);
+		if (staticShadowMap.id == 0)
+		{
+			TraceLog(LOG_WARNING, "<CascadedDepthRenderPass.Create> Failed to create the static shadow map, static casters are drawn every frame");
+			CacheStaticCasters = false;
+		}
+	}
+	staticCacheValid = false;
+
+	return shadowMap.id > 0;
+}
+
+/// <summary>
+/// Release - Release the shadow maps and the depth shader
+/// </summary>
+void CascadedDepthRenderPass::Release()
+{
+	UnloadShadowmapRenderTexture(staticShadowMap);
+	staticShadowMap = { 0 };
+	__super::Release();
+}
+
+/// <summary>
+/// OnAddToRender - Skip the casters which don't cast shadow, which belong to the other layer (static or
+/// moving) than the one being drawn, which would cover only a few texels of the cascade or whose shadow can't
+/// fall into its slice
+/// </summary>
+/// <param name="pSC">The Component candidate</param>
+/// <param name="pSO">The SceneObject the Component is attached to.</param>
+/// <returns>True if we should include this Component.</returns>
+bool CascadedDepthRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
+{
+	if (casterFilter == StaticCasters && !pSC->isStatic)
+		return false;
+	if (casterFilter == DynamicCasters && pSC->isStatic)
+		return false;
+
+	SceneActor* pActor = dynamic_cast<SceneActor*>(pSO);
+	if (currentCascade >= 0 && pActor != nullptr && IsBoundingBoxValid(pActor->WorldBoundingBox))
+	{
+		float size = Vector3Distance(pActor->WorldBoundingBox.min, pActor->WorldBoundingBox.max);
+		if (size < MinCasterTexels * pLight->cascadeTexelSize[currentCascade])
+			return false;
+
+		//The cached static casters have to cover every view the cascade is kept for, only the casters
+		//drawn each frame can be culled against the current slice
+		if (casterFilter != StaticCasters && !IsShadowInSlice(pActor->WorldBoundingBox, currentCascade))
+			return false;
+	}
+	return __super::OnAddToRender(pSC, pSO);
+}
+
+/// <summary>
+/// IsShadowInSlice - Test if the box or its shadow can reach the view frustum slice of a cascade, by sweeping
+/// the box along the light direction. A plane the box is outside of rejects the swept box as well, unless
+/// the light direction leads back inside the plane.
+/// </summary>
+/// <param name="box">World bounding box of the caster</param>
+/// <param name="cascade">Index of the cascade</param>
+/// <returns>False if the caster can't shadow anything in the slice</returns>
+bool CascadedDepthRenderPass::IsShadowInSlice(const BoundingBox& box, int cascade) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const FrustumPlane& plane = slicePlanes[cascade][i];
+		if (Vector3DotProduct(plane.normal, pLight->lightDir) > 0.0f)
+			continue;
+
+		//the corner of the box farthest inside the plane
+		Vector3 corner;
+		corner.x = plane.normal.x >= 0.0f ? box.max.x : box.min.x;
+		corner.y = plane.normal.y >= 0.0f ? box.max.y : box.min.y;
+		corner.z = plane.normal.z >= 0.0f ? box.max.z : box.min.z;
+		if (Vector3DotProduct(plane.normal, corner) + plane.d < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// RenderCascades - Split the view frustum, fit a light camera to every slice and render the slices into
+/// their tiles of the shadow map. The light matrices are left in the ShadowSceneLight for the receivers.
+/// </summary>
+/// <param name="pViewCamera">The camera the shadows are seen from, nullptr for the main camera</param>
+void CascadedDepthRenderPass::RenderCascades(SceneCamera* pViewCamera)
+{
+	if (pViewCamera == nullptr)
+		pViewCamera = pScene->GetMainCameraActor();
+	if (pViewCamera == nullptr || shadowMap.id == 0)
+		return;
+
+	const Camera3D view = *pViewCamera->GetCamera3D();
+	float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
+
+	//Practical split scheme: a blend of the logarithmic split, which keeps the texel density even over the
+	//distance, and the uniform split, which keeps the near cascades from becoming too small.
+	float nearDistance = (float)rlGetCullDistanceNear();
+	float farDistance = ShadowDistance;
+	float sliceStart = nearDistance;
+	for (int i = 0; i < NumCascades; i++)
+	{
+		float t = float(i + 1) / float(NumCascades);
+		float logSplit = nearDistance * powf(farDistance / nearDistance, t);
+		float uniformSplit = nearDistance + (farDistance - nearDistance) * t;
+		float sliceEnd = SplitLambda * logSplit + (1.0f - SplitLambda) * uniformSplit;
+		FitCascade(i, view, aspect, sliceStart, sliceEnd);
+		pLight->cascadeSplits[i] = sliceEnd;
+		sliceStart = sliceEnd;
+	}
+	for (int i = NumCascades; i < MAX_SHADOW_CASCADES; i++)
+	{
+		pLight->cascadeSplits[i] = 0;
+		NumCasters[i] = 0;
+	}
+	pLight->numCascades = NumCascades;
+
+	if (CacheStaticCasters)
+	{
+		RefreshStaticCasters();
+
+		//start from the cached static depth, the moving casters are drawn on top of it
+		rlDrawRenderBatchActive();
+		rlBindFramebuffer(RL_READ_FRAMEBUFFER, staticShadowMap.id);
+		rlBindFramebuffer(RL_DRAW_FRAMEBUFFER, shadowMap.id);
+		rlBlitFramebuffer(0, 0, shadowMapResolution, shadowMapResolution, 0, 0, shadowMapResolution, shadowMapResolution, SHADOW_DEPTH_BUFFER_BIT);
+		rlDisableFramebuffer();
+
+		BeginTextureMode(shadowMap);
+		for (int i = 0; i < NumCascades; i++)
+			DrawCascade(i, DynamicCasters);
+		EndTextureMode();
+	}
+	else
+	{
+		BeginTextureMode(shadowMap);
+		ClearBackground(WHITE);
+		for (int i = 0; i < NumCascades; i++)
+			DrawCascade(i, AllCasters);
+		EndTextureMode();
+	}
+
+	//the first cascade stands in for the single shadow map of the other passes
+	pLight->lightView = MatrixLookAt(cascades[0].camera.position, cascades[0].camera.target, cascades[0].camera.up);
+	pLight->lightProj = MatrixOrtho(-cascades[0].radius, cascades[0].radius, -cascades[0].radius, cascades[0].radius, 0.0, cascades[0].depth);
+}
+
+/// <summary>
+/// FitCascade - Fit an orthographic light camera around one slice of the view frustum. The slice is
+/// enclosed by a sphere, so the light frustum keeps its size when the view turns, and the light camera is
+/// moved in whole shadow map texels, so the shadow edges don't shimmer when the view moves. With the static
+/// cache the camera moves in steps of StaticCacheStep, the light frustum is widened by a step to still
+/// enclose the slice in between.
+/// </summary>
+/// <param name="cascade">Index of the cascade</param>
+/// <param name="view">The view camera</param>
+/// <param name="aspect">Width / height of the view</param>
+/// <param name="nearDistance">View depth where the slice starts</param>
+/// <param name="farDistance">View depth where the slice ends</param>
+void CascadedDepthRenderPass::FitCascade(int cascade, const Camera3D& view, float aspect, float nearDistance, float farDistance)
+{
+	Vector3 forward = Vector3Normalize(Vector3Subtract(view.target, view.position));
+
+	//The corners of the slice are on two rings around the view axis, at nearDistance * k and farDistance * k
+	//from it. The smallest sphere through both rings has its center on the axis.
+	float tanHalfFovY = tanf(view.fovy * DEG2RAD * 0.5f);
+	float k2 = tanHalfFovY * tanHalfFovY * (1.0f + aspect * aspect);
+	float centerDistance = 0.5f * (nearDistance + farDistance) * (1.0f + k2);
+	float radius;
+	if (centerDistance < farDistance)
+	{
+		float dz = farDistance - centerDistance;
+		radius = sqrtf(dz * dz + farDistance * farDistance * k2);
+	}
+	else
+	{
+		//wide slices: the far ring alone decides
+		centerDistance = farDistance;
+		radius = farDistance * sqrtf(k2);
+	}
+	float step = CacheStaticCasters ? 2.0f * radius * StaticCacheStep : 0.0f;
+	radius += step;
+	//round up, so floating point noise doesn't change the texel size from frame to frame
+	radius = ceilf(radius * 16.0f) / 16.0f;
+	Vector3 center = Vector3Add(view.position, Vector3Scale(forward, centerDistance));
+
+	//The light camera basis, as MatrixLookAt builds it from the up vector
+	Vector3 lightDir = Vector3Normalize(pLight->lightDir);
+	Vector3 up = fabsf(lightDir.y) > 0.99f ? Vector3{ 0.0f, 0.0f, 1.0f } : Vector3{ 0.0f, 1.0f, 0.0f };
+	Vector3 axisZ = Vector3Negate(lightDir);
+	Vector3 axisX = Vector3Normalize(Vector3CrossProduct(up, axisZ));
+	Vector3 axisY = Vector3CrossProduct(axisZ, axisX);
+
+	//Snap the center to the texel grid of the light camera, or to whole steps of the static cache. Along
+	//the light the center is snapped as well, the cached depth values stay valid then.
+	float texelSize = 2.0f * radius / (float)cascadeResolution;
+	step = fmaxf(ceilf(step / texelSize), 1.0f) * texelSize;
+	float x = Vector3DotProduct(center, axisX);
+	float y = Vector3DotProduct(center, axisY);
+	float z = Vector3DotProduct(center, axisZ);
+	center = Vector3Add(center, Vector3Scale(axisX, floorf(x / step) * step - x));
+	center = Vector3Add(center, Vector3Scale(axisY, floorf(y / step) * step - y));
+	center = Vector3Add(center, Vector3Scale(axisZ, floorf(z / step) * step - z));
+
+	ShadowCascade& c = cascades[cascade];
+	c.radius = radius;
+	c.depth = 2.0f * radius + CasterDistance;
+	c.camera.target = center;
+	c.camera.position = Vector3Subtract(center, Vector3Scale(lightDir, radius + CasterDistance));
+	c.camera.up = up;
+	c.camera.fovy = 2.0f * radius;
+	c.camera.projection = CAMERA_ORTHOGRAPHIC;
+
+	Matrix lightView = MatrixLookAt(c.camera.position, c.camera.target, c.camera.up);
+	Matrix lightProj = MatrixOrtho(-radius, radius, -radius, radius, 0.0, c.depth);
+	pLight->cascadeViewProj[cascade] = MatrixMultiply(lightView, lightProj);
+	pLight->cascadeTexelSize[cascade] = texelSize;
+
+	//The planes of the slice, normals pointing inside: |right| <= depth * tanX, |up| <= depth * tanY
+	Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, view.up));
+	Vector3 viewUp = Vector3CrossProduct(right, forward);
+	float tanHalfFovX = tanHalfFovY * aspect;
+	Vector3 normals[6] = {
+		Vector3Add(right, Vector3Scale(forward, tanHalfFovX)),
+		Vector3Add(Vector3Negate(right), Vector3Scale(forward, tanHalfFovX)),
+		Vector3Add(viewUp, Vector3Scale(forward, tanHalfFovY)),
+		Vector3Add(Vector3Negate(viewUp), Vector3Scale(forward, tanHalfFovY)),
+		forward,
+		Vector3Negate(forward)
+	};
+	for (int i = 0; i < 6; i++)
+	{
+		FrustumPlane& plane = slicePlanes[cascade][i];
+		plane.normal = Vector3Normalize(normals[i]);
+		plane.d = -Vector3DotProduct(plane.normal, view.position);
+	}
+	slicePlanes[cascade][4].d -= nearDistance;
+	slicePlanes[cascade][5].d += farDistance;
+}
+
+/// <summary>
+/// DrawCascade - Queue and draw one layer of casters of a cascade into the bound shadow map
+/// </summary>
+/// <param name="cascade">Index of the cascade</param>
+/// <param name="filter">The casters to draw</param>
+void CascadedDepthRenderPass::DrawCascade(int cascade, eCasterFilter filter)
+{
+	//the queue is culled again when the accepted casters change, even if the light camera did not
+	if (filter != casterFilter)
+		RequeueRenderList();
+	casterFilter = filter;
+
+	BeginCascade(cascade);
+	BeginScene();
+	int numQueued = (int)GetNumQueued();
+	if (filter == StaticCasters)
+		NumStaticCasters[cascade] = numQueued;
+	else
+		NumCasters[cascade] = numQueued;
+	Render();
+	EndScene();
+	EndCascade();
+}
+
+/// <summary>
+/// HaveStaticCastersChanged - Test if a static caster was added, removed or moved since the cache was rendered
+/// </summary>
+/// <returns>True if every cascade has to render its static casters again</returns>
+bool CascadedDepthRenderPass::HaveStaticCastersChanged()
+{
+	if (!staticCacheValid || staticListVersion != pScene->GetRenderListVersion())
+		return true;
+
+	//the render list of the pass knows the components of each actor
+	const vector<SceneActor*>& movedActors = pScene->GetMovedActors();
+	for (SceneActor* pActor : movedActors)
+	{
+		unordered_map<SceneActor*, size_t>::iterator it = _ActorEntries.find(pActor);
+		if (it == _ActorEntries.end())
+			continue;
+		for (size_t i = it->second; i < _RenderList.size() && _RenderList[i].pActor == pActor; i++)
+		{
+			if (_RenderList[i].pComponent->isStatic)
+				return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// RefreshStaticCasters - Render the static casters again for the cascades whose light camera moved since
+/// they were cached, or for all of them when the light or static geometry changed
+/// </summary>
+void CascadedDepthRenderPass::RefreshStaticCasters()
+{
+	bool refreshAll = HaveStaticCastersChanged();
+	bool begun = false;
+	for (int i = 0; i < NumCascades; i++)
+	{
+		if (!refreshAll && memcmp(&cascades[i], &staticCascades[i], sizeof(ShadowCascade)) == 0)
+			continue;
+
+		if (!begun)
+		{
+			BeginTextureMode(staticShadowMap);
+			begun = true;
+		}
+
+		//clear the tile of the cascade only
+		rlDrawRenderBatchActive();
+		rlEnableScissorTest();
+		rlScissor((i % SHADOW_CASCADE_COLUMNS) * cascadeResolution, (i / SHADOW_CASCADE_COLUMNS) * cascadeResolution, cascadeResolution, cascadeResolution);
+		ClearBackground(WHITE);
+		rlDisableScissorTest();
+
+		DrawCascade(i, StaticCasters);
+		staticCascades[i] = cascades[i];
+		NumStaticRefreshes++;
+	}
+	if (begun)
+		EndTextureMode();
+
+	//the render list may have been collected again while drawing
+	staticListVersion = pScene->GetRenderListVersion();
+	staticCacheValid = true;
+}
+
+/// <summary>
+/// BeginCascade - Point the light camera and the viewport at one cascade. The render queue is frustum
+/// culled against the light camera in BeginScene, so every cascade only queues its own casters.
+/// </summary>
+/// <param name="cascade">Index of the cascade</param>
+void CascadedDepthRenderPass::BeginCascade(int cascade)
+{
+	const ShadowCascade& c = cascades[cascade];
+	currentCascade = cascade;
+	*pLight->GetCamera3D() = c.camera;
+
+	//far cascades draw coarser meshes
+	LevelOfDetailBias = 1 + cascade;
+
+	rlDrawRenderBatchActive();
+	rlViewport((cascade % SHADOW_CASCADE_COLUMNS) * cascadeResolution, (cascade / SHADOW_CASCADE_COLUMNS) * cascadeResolution, cascadeResolution, cascadeResolution);
+
+	rlMatrixMode(RL_PROJECTION);
+	rlPushMatrix();
+	rlLoadIdentity();
+	rlOrtho(-c.radius, c.radius, -c.radius, c.radius, 0.0, c.depth);
+
+	rlMatrixMode(RL_MODELVIEW);
+	rlLoadIdentity();
+	Matrix lightView = MatrixLookAt(c.camera.position, c.camera.target, c.camera.up);
+	rlMultMatrixf(MatrixToFloat(lightView));
+
+	rlEnableDepthTest();
+}
+
+/// <summary>
+/// EndCascade - Flush the cascade and restore the matrices
+/// </summary>
+void CascadedDepthRenderPass::EndCascade()
+{
+	rlDrawRenderBatchActive();
+	rlMatrixMode(RL_PROJECTION);
+	rlPopMatrix();
+	rlMatrixMode(RL_MODELVIEW);
+	rlLoadIdentity();
+	rlDisableDepthTest();
+	currentCascade = -1;
+}
+
+//End of CascadedDepthRenderPass.cpp
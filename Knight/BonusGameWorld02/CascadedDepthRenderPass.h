@@ -0,0 +1,81 @@
+#pragma once
+
+#include "DepthRenderPass.h"
+
+#define SHADOW_CASCADE_COLUMNS 2 //the cascades are tiles of a 2 x 2 shadow map atlas
+
+// Cascaded shadow maps for the directional light. The view frustum of the main camera up to ShadowDistance
+// is split into NumCascades slices, every slice gets an orthographic light camera fitted around it and is
+// rendered into its own tile of the shadow map. The near slices are small and get sharp shadows, the far ones
+// cover more ground with the same texels and draw coarser casters. Each cascade is culled against its own
+// light frustum, the moving casters also against the volume their shadows can fall into the slice from.
+//
+// With CacheStaticCasters the Components flagged isStatic are kept in a second shadow map. The light cameras
+// then move in coarser steps, a cascade re-renders its static casters only when its light camera moved, the
+// light turned or static geometry changed; every frame the cached depth is copied into the shadow map and
+// only the moving casters are drawn on top. Expects a perspective view camera.
+class CascadedDepthRenderPass : public DepthRenderPass
+{
+public:
+	CascadedDepthRenderPass(ShadowSceneLight* l, int numCascades = 3);
+
+	bool Create(Scene* sc) override;
+	void Release() override;
+	bool OnAddToRender(Component* pSC, SceneObject* pSO) override;
+
+	// Fit the cascades to the view camera (the main camera by default) and render all of them
+	void RenderCascades(SceneCamera* pViewCamera = nullptr);
+	// Render the static casters of every cascade again, after static geometry was edited in place
+	void InvalidateStaticCasters() { staticCacheValid = false; }
+
+	int NumCascades = 3;				// 1 ~ MAX_SHADOW_CASCADES
+	float ShadowDistance = 120.0f;		// shadows end here, faded out by the receivers
+	float SplitLambda = 0.75f;			// 0 splits the distance evenly, 1 logarithmically
+	float CasterDistance = 100.0f;		// how far towards the light casters in front of a slice are still drawn
+	float MinCasterTexels = 1.5f;		// casters smaller than this many texels of their cascade are skipped
+	bool CacheStaticCasters = true;		// set before Create
+	float StaticCacheStep = 0.1f;		// share of the cascade width the light cameras move by when caching
+
+	// Casters drawn into each cascade in the last RenderCascades, the static ones only when refreshed
+	int NumCasters[MAX_SHADOW_CASCADES] = { 0 };
+	int NumStaticCasters[MAX_SHADOW_CASCADES] = { 0 };
+	int NumStaticRefreshes = 0;
+
+protected:
+	struct ShadowCascade
+	{
+		Camera3D camera;	// orthographic light camera looking at the slice
+		float radius;		// half the width of the light frustum
+		float depth;		// near to far plane of the light frustum
+	};
+
+	// Which casters OnAddToRender accepts
+	enum eCasterFilter
+	{
+		AllCasters = 0,
+		StaticCasters,
+		DynamicCasters
+	};
+
+	void FitCascade(int cascade, const Camera3D& view, float aspect, float nearDistance, float farDistance);
+	void BeginCascade(int cascade);
+	void EndCascade();
+	void DrawCascade(int cascade, eCasterFilter filter);
+	void RefreshStaticCasters();
+	bool HaveStaticCastersChanged();
+	bool IsShadowInSlice(const BoundingBox& box, int cascade) const;
+
+	ShadowCascade cascades[MAX_SHADOW_CASCADES] = { 0 };
+	FrustumPlane slicePlanes[MAX_SHADOW_CASCADES][6] = { 0 };	// the view frustum slice of each cascade
+	int cascadeResolution = SHADOWMAP_RESOLUTION / SHADOW_CASCADE_COLUMNS;
+	int currentCascade = -1;
+	eCasterFilter casterFilter = AllCasters;
+
+	// The static casters, rendered for the cascades as they were when cached
+	RenderTexture2D staticShadowMap = { 0 };
+	ShadowCascade staticCascades[MAX_SHADOW_CASCADES] = { 0 };
+	unsigned int staticListVersion = 0;
+	bool staticCacheValid = false;
+};
+
+//end of CascadedDepthRenderPass.h
@@ -0,0 +1,70 @@
+#include "Knight.h"
+
+#include "CascadedShadowMapRenderPass.h"
+
+CascadedShadowMapRenderPass::CascadedShadowMapRenderPass(ShadowSceneLight* l, int id) : ShadowMapRenderPass(l, id)
+{
+	fragmentShaderFileName = "../../resources/shaders/glsl330/kn-lit-csm-pcf.fs";
+}
+
+/// <summary>
+/// Create - Load the cascaded shadow shader and look up the cascade and cluster uniforms
+/// </summary>
+/// <param name="sc">The Scene</param>
+/// <returns>True if initialization is successful.</returns>
+bool CascadedShadowMapRenderPass::Create(Scene* sc)
+{
+	if (!__super::Create(sc))
+		return false;
+
+	for (int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		cascadeVPLocs[i] = GetShaderLocation(shadowShader, TextFormat("cascadeVP[%i]", i));
+	cascadeSplitsLoc = GetShaderLocation(shadowShader, "cascadeSplits");
+	cascadeTexelSizeLoc = GetShaderLocation(shadowShader, "cascadeTexelSize");
+	numCascadesLoc = GetShaderLocation(shadowShader, "numCascades");
+	cascadeColumnsLoc = GetShaderLocation(shadowShader, "cascadeColumns");
+	viewDirLoc = GetShaderLocation(shadowShader, "viewDir");
+	fadeRangeLoc = GetShaderLocation(shadowShader, "fadeRange");
+	normalOffsetLoc = GetShaderLocation(shadowShader, "normalOffset");
+
+	int columns = SHADOW_CASCADE_COLUMNS;
+	SetShaderValue(shadowShader, cascadeColumnsLoc, &columns, SHADER_UNIFORM_INT);
+
+	//the ForwardRenderPass created the clusters for its own shader, this pass draws with the cascaded one
+	if (EnableClusteredLighting)
+		Clusters.InitUniforms(shadowShader);
+
+	return shadowShader.id > 0;
+}
+
+/// <summary>
+/// BeginScene - Hand the cascades fitted by the depth pass and the point light clusters to the shader
+/// </summary>
+/// <param name="pOverrideCamera">Customzied SceneCamera to render shadow, if any.</param>
+void CascadedShadowMapRenderPass::BeginScene(SceneCamera* pOverrideCamera)
+{
+	__super::BeginScene(pOverrideCamera);
+
+	for (int i = 0; i < pLight->numCascades; i++)
+		SetShaderValueMatrix(shadowShader, cascadeVPLocs[i], pLight->cascadeViewProj[i]);
+	SetShaderValue(shadowShader, cascadeSplitsLoc, pLight->cascadeSplits, SHADER_UNIFORM_VEC4);
+	SetShaderValue(shadowShader, cascadeTexelSizeLoc, pLight->cascadeTexelSize, SHADER_UNIFORM_VEC4);
+	SetShaderValue(shadowShader, numCascadesLoc, &pLight->numCascades, SHADER_UNIFORM_INT);
+	SetShaderValue(shadowShader, fadeRangeLoc, &FadeRange, SHADER_UNIFORM_FLOAT);
+	SetShaderValue(shadowShader, normalOffsetLoc, &NormalOffset, SHADER_UNIFORM_FLOAT);
+
+	//the cascades are picked by the depth along the view direction
+	Camera3D* pCamera = pActiveCamera->GetCamera3D();
+	Vector3 viewDir = Vector3Normalize(Vector3Subtract(pCamera->target, pCamera->position));
+	SetShaderValue(shadowShader, viewDirLoc, &viewDir, SHADER_UNIFORM_VEC3);
+	SetShaderValue(shadowShader, shadowShader.locs[SHADER_LOC_VECTOR_VIEW], &pCamera->position, SHADER_UNIFORM_VEC3);
+
+	//froxel light lists of this camera, the shader skips the clustered lights without them
+	if (EnableClusteredLighting)
+	{
+		Clusters.Build(pScene->PointLights, *pCamera);
+		Clusters.Bind(shadowShader);
+	}
+}
+
+//End of CascadedShadowMapRenderPass.cpp
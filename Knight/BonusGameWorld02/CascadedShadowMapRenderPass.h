@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ShadowMapRenderPass.h"
+#include "CascadedDepthRenderPass.h"
+
+// Receives the shadows of a CascadedDepthRenderPass: the shader picks the cascade by the view depth of the
+// fragment and fades the shadows out at the end of the last one, instead of cutting them off.
+// The Scene's PointLights are added on top through the ClusteredLighting of the ForwardRenderPass.
+class CascadedShadowMapRenderPass : public ShadowMapRenderPass
+{
+	public:
+
+		CascadedShadowMapRenderPass(ShadowSceneLight* l, int id);
+
+		bool Create(Scene* sc) override;
+		void BeginScene(SceneCamera* cam = NULL) override;
+
+		float FadeRange = 0.2f;		// share of the last cascade over which the shadows fade out
+		float NormalOffset = 1.5f;	// receivers look up the shadow map this many texels along their normal
+
+	protected:
+		int cascadeVPLocs[MAX_SHADOW_CASCADES] = { -1, -1, -1, -1 };
+		int cascadeSplitsLoc = -1;
+		int cascadeTexelSizeLoc = -1;
+		int numCascadesLoc = -1;
+		int cascadeColumnsLoc = -1;
+		int viewDirLoc = -1;
+		int fadeRangeLoc = -1;
+		int normalOffsetLoc = -1;
+};
+
+//end of CascadedShadowMapRenderPass.h
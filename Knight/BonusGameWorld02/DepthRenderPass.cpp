@@ -18,11 +18,12 @@ bool DepthRenderPass::Create(Scene* sc)
 {
 	__super::Create(sc);
 
-	depthShader = LoadShader("../../resources/shaders/glsl330/kn-lit-depth.vs", "../../resources/shaders/glsl330/shadow_depth.fs");
+	depthShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/kn-lit-depth.vs", "../../resources/shaders/glsl330/shadow_depth.fs");
 	alphaTestLoc = GetShaderLocation(depthShader, "alphaTest");
 
 	Hints.pOverrideShader = &depthShader;
 	Hints.pOverrideCamera = pLight;
+	LevelOfDetailBias = 1;	//shadow casters can use a coarser mesh
 
 	shadowMap = LoadShadowmapRenderTexture(SHADOWMAP_RESOLUTION, SHADOWMAP_RESOLUTION);
 
@@ -50,7 +51,7 @@ bool DepthRenderPass::Create(Scene* sc)
 void DepthRenderPass::Release()
 {
 	UnloadShadowmapRenderTexture(shadowMap);
-	UnloadShader(depthShader);
+	ResourceRegistry::Instance().ReleaseShader(depthShader);
 }
 
 /// <summary>
@@ -67,8 +68,7 @@ void DepthRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 		pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//Override shader 
 	BeginShaderMode(depthShader);
@@ -83,7 +83,7 @@ void DepthRenderPass::Render()
 	vector<RenderContext>::iterator bk = pScene->_RenderQueue.Background.begin();
 	while (bk != pScene->_RenderQueue.Background.end())
 	{
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -92,7 +92,7 @@ void DepthRenderPass::Render()
 	while (opaque != pScene->_RenderQueue.Geometry.end())
 	{
 		BeginBlendMode(opaque->pComponent->blendingMode);
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		EndBlendMode();
 		++opaque;
 	}
@@ -104,7 +104,7 @@ void DepthRenderPass::Render()
 	while (alpha != pScene->_RenderQueue.AlphaBlending.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		++alpha;
 	}
@@ -116,7 +116,7 @@ void DepthRenderPass::Render()
 	while (overlay != pScene->_RenderQueue.Overlay.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		EndBlendMode();
 		++overlay;
 	}
@@ -6,6 +6,8 @@
 #include "QuadTreeTerrainComponent.h"
 #include "PlayerFSM.h"
 #include "SkyboxComponent.h"
+#include "BillboardBatchComponent.h"
+#include "FoliageScatterComponent.h"
 #include "MagicAttackEffect.h"
 
 class Entity
@@ -26,10 +28,17 @@ public:
 
 	QuadTreeTerrainComponent* _Terrain = nullptr;
 
+	// nullptr unless the imposters are batched
+	const BillboardBatchComponent* GetImposterBatch() const { return pImposterBatch; }
+
 protected:
 	Texture2D treeImage = { 0 };
 	Texture2D robotImage = { 0 };
+	Texture2D imposterAtlas = { 0 }; //tree and robot images side by side for the batch
 	vector<SceneActor*> imposters = { 0 };
+	BillboardBatchComponent* pImposterBatch = nullptr;
+	Texture2D foliageImage = { 0 };
+	FoliageScatterComponent* pFoliage = nullptr;
 	SkyboxComponent* pSkybox = nullptr;
 
 	int currentIdx = -1;
@@ -62,4 +71,12 @@ public:
 
 protected:
 	TerrainEntity* pTerrainEntity = nullptr;
+
+	//houses and turrets scattered over the terrain, drawn as impostors in the distance
+	bool CreateVillageProps(Scene* pScene, QuadTreeTerrainComponent* pTerrain, const char* modelPath, const char* texturePath, int count, ImpostorAtlas* pImpostor);
+	ImpostorAtlas houseImpostor;
+	ImpostorAtlas turretImpostor;
+
+	//the props load in the background, each atlas is baked from the first prop of its kind once it is loaded
+	vector<pair<ModelComponent*, ImpostorAtlas*>> pendingImpostors;
 };
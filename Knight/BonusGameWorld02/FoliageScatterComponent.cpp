@@ -0,0 +1,483 @@
+#include "FoliageScatterComponent.h"
+#include "BillboardBatchComponent.h"
+#include "KnightUtils.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+
+// Integer hash (lowbias32), the random numbers of a candidate only depend on its world cell
+static unsigned int HashFoliage(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+static float HashToFloat(unsigned int h)
+{
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// Squared distance from eye to the node on the XZ plane
+static float NodeDistanceSqr(const QuadTreeNode* pNode, Vector3 eye)
+{
+	float dx = std::max(std::max(pNode->bounds.min.x - eye.x, 0.0f), eye.x - pNode->bounds.max.x);
+	float dz = std::max(std::max(pNode->bounds.min.z - eye.z, 0.0f), eye.z - pNode->bounds.max.z);
+	return dx * dx + dz * dz;
+}
+
+// Whether the node overlaps the changed rectangle on the XZ plane
+static bool NodeOverlapsChange(const QuadTreeNode* pNode, const TerrainHeightChange& change)
+{
+	return pNode->bounds.max.x >= change.minX && pNode->bounds.min.x <= change.maxX
+		&& pNode->bounds.max.z >= change.minZ && pNode->bounds.min.z <= change.maxZ;
+}
+
+FoliageScatterComponent::FoliageScatterComponent()
+{
+	renderQueue = Component::eRenderQueueType::Geometry;
+	blendingMode = BLEND_ALPHA;
+	EnableAlphaTest = true;
+	castShadow = Component::eShadowCastingType::ShadowWithAlpha;
+}
+
+FoliageScatterComponent::~FoliageScatterComponent()
+{
+	InvalidateChunks();
+	if (mask.data != nullptr)
+		UnloadImage(mask);
+}
+
+/// <summary>
+/// Create - Scatter over a terrain. The mask is kept on the CPU as RGBA8 so the workers can sample it.
+/// </summary>
+/// <param name="pTerrainComponent">The terrain the plants grow on, created already</param>
+/// <param name="pMaskPath">Density mask over the whole terrain, nullptr for none</param>
+/// <returns>false if the terrain is missing or the mask can't be loaded</returns>
+bool FoliageScatterComponent::Create(QuadTreeTerrainComponent* pTerrainComponent, const char* pMaskPath)
+{
+	InvalidateChunks();
+	pTerrain = pTerrainComponent;
+	if (pTerrain == nullptr || pTerrain->GetRootNode() == nullptr)
+	{
+		TraceLog(LOG_WARNING, "<FoliageScatterComponent.Create> The terrain has to be created first");
+		return false;
+	}
+
+	//the component covers the terrain, the chunks are culled in Draw
+	LocalBoundingBox = pTerrain->GetRootNode()->bounds;
+	terrainExtent = LocalBoundingBox;
+	lastHeightChange = pTerrain->GetHeightChangeSerial();
+
+	if (mask.data != nullptr)
+		UnloadImage(mask);
+	mask = { 0 };
+	if (pMaskPath != nullptr)
+	{
+		mask = LoadImage(pMaskPath);
+		if (mask.data == nullptr)
+		{
+			TraceLog(LOG_WARNING, "<FoliageScatterComponent.Create> Failed to load the mask %s", pMaskPath);
+			return false;
+		}
+		ImageFormat(&mask, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	}
+	return true;
+}
+
+int FoliageScatterComponent::AddLayer(const FoliageLayer& layer)
+{
+	//the workers read the layers
+	InvalidateChunks();
+
+	FoliageLayer added = layer;
+	if (added.source.width == 0 || added.source.height == 0)
+		added.source = { 0.0f, 0.0f, (float)added.texture.width, (float)added.texture.height };
+	layers.push_back(added);
+	return (int)layers.size() - 1;
+}
+
+void FoliageScatterComponent::InvalidateChunks()
+{
+	WaitForPendingChunks();
+	for (auto& chunk : chunks)
+		delete chunk.second;
+	chunks.clear();
+}
+
+void FoliageScatterComponent::WaitForPendingChunks()
+{
+	for (auto& request : pending)
+	{
+		request.second.done.wait();
+		delete request.second.pChunk;
+		delete request.second.pPatch;
+	}
+	pending.clear();
+}
+
+/// <summary>
+/// Update - Drop the chunks over changed terrain heights, take the chunks the workers finished, release the
+/// chunks out of EvictRadius and request the missing ones within GenerateRadius, nearest first.
+/// </summary>
+/// <param name="ElapsedSeconds">Seconds since last called</param>
+/// <param name="pRH">Not used</param>
+void FoliageScatterComponent::Update(float ElapsedSeconds, RenderHints* pRH)
+{
+	if (pTerrain == nullptr || pTerrain->GetRootNode() == nullptr || layers.empty())
+		return;
+	SceneCamera* pCamera = _SceneActor->GetMainCamera();
+	if (pCamera == nullptr)
+		return;
+	Vector3 eye = pCamera->GetPosition();
+	float evict2 = EvictRadius * EvictRadius;
+
+	HandleHeightChanges();
+
+	for (auto it = pending.begin(); it != pending.end(); )
+	{
+		if (it->second.done.wait_for(chrono::seconds(0)) != future_status::ready)
+		{
+			++it;
+			continue;
+		}
+		//stale chunks are requested again below, the camera may also have moved on while it was generated
+		if (!it->second.stale && NodeDistanceSqr(it->first, eye) <= evict2)
+			chunks[it->first] = it->second.pChunk;
+		else
+			delete it->second.pChunk;
+		delete it->second.pPatch;
+		it = pending.erase(it);
+	}
+
+	NumInstances = 0;
+	for (auto it = chunks.begin(); it != chunks.end(); )
+	{
+		if (NodeDistanceSqr(it->first, eye) > evict2)
+		{
+			delete it->second;
+			it = chunks.erase(it);
+			continue;
+		}
+		for (const FoliageInstances& instances : it->second->layers)
+			NumInstances += (int)instances.positions.size();
+		++it;
+	}
+
+	RequestChunks(eye);
+
+	NumChunks = (int)chunks.size();
+	NumPendingChunks = (int)pending.size();
+}
+
+// Release the cached chunks over the terrain height changes since the last Update and mark the pending ones stale
+void FoliageScatterComponent::HandleHeightChanges()
+{
+	for (const TerrainHeightChange& change : pTerrain->GetHeightChanges())
+	{
+		if (change.serial <= lastHeightChange)
+			continue;
+		lastHeightChange = change.serial;
+
+		for (auto it = chunks.begin(); it != chunks.end(); )
+		{
+			if (NodeOverlapsChange(it->first, change))
+			{
+				delete it->second;
+				it = chunks.erase(it);
+				continue;
+			}
+			++it;
+		}
+		for (auto& request : pending)
+		{
+			if (NodeOverlapsChange(request.first, change))
+				request.second.stale = true;
+		}
+	}
+}
+
+void FoliageScatterComponent::RequestChunks(Vector3 eye)
+{
+	if ((int)pending.size() >= MaxPendingChunks)
+		return;
+
+	wantedNodes.clear();
+	GatherChunkNodes(pTerrain->GetRootNode(), eye, wantedNodes);
+	std::sort(wantedNodes.begin(), wantedNodes.end(), [](const pair<float, const QuadTreeNode*>& a, const pair<float, const QuadTreeNode*>& b) {
+		return a.first < b.first;
+	});
+
+	for (const auto& wanted : wantedNodes)
+	{
+		if ((int)pending.size() >= MaxPendingChunks)
+			break;
+
+		//the terrain may be edited or paged while the worker runs, it gets a copy of the heights
+		const QuadTreeNode* pNode = wanted.second;
+		BoundingBox area = pNode->bounds;
+		TerrainPatch* pPatch = new TerrainPatch();
+		pTerrain->CopyPatch(area.min.x, area.min.z, area.max.x, area.max.z, *pPatch);
+		FoliageChunk* pChunk = new FoliageChunk();
+		PendingChunk request;
+		request.pChunk = pChunk;
+		request.pPatch = pPatch;
+		request.done = JobSystem::Instance().Submit([this, area, pPatch, pChunk]() {
+			GenerateChunk(area, *pPatch, pChunk);
+		});
+		pending[pNode] = std::move(request);
+	}
+}
+
+// Nodes at ChunkDepth (or leaves above it) within GenerateRadius that are neither cached nor pending
+void FoliageScatterComponent::GatherChunkNodes(const QuadTreeNode* pNode, Vector3 eye, vector<pair<float, const QuadTreeNode*>>& nodes) const
+{
+	float distance2 = NodeDistanceSqr(pNode, eye);
+	if (distance2 > GenerateRadius * GenerateRadius)
+		return;
+
+	if (pNode->isLeaf || pNode->depth >= ChunkDepth)
+	{
+		if (chunks.find(pNode) == chunks.end() && pending.find(pNode) == pending.end())
+			nodes.push_back(make_pair(distance2, pNode));
+		return;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (pNode->children[i] != nullptr)
+			GatherChunkNodes(pNode->children[i], eye, nodes);
+	}
+}
+
+/// <summary>
+/// GenerateChunk - Runs on a worker. Every layer places one candidate per cell of a world aligned grid
+/// with 1 / density cells, jittered inside the cell; a chunk owns the cells whose corner lies in it. The
+/// candidates failing the mask, height or slope rule are dropped and the rest is ordered by a random rank.
+/// Reads the copied heights, the mask and the layers; Create and AddLayer wait for the pending chunks
+/// before they change the last two.
+/// </summary>
+/// <param name="area">Bounds of the quadtree node the chunk covers</param>
+/// <param name="patch">The terrain under the node, copied when the chunk was requested</param>
+/// <param name="pChunk">Receives the instances</param>
+void FoliageScatterComponent::GenerateChunk(BoundingBox area, const TerrainPatch& patch, FoliageChunk* pChunk) const
+{
+	pChunk->layers.resize(layers.size());
+	pChunk->bounds.min = Vector3{ area.min.x, FLT_MAX, area.min.z };
+	pChunk->bounds.max = Vector3{ area.max.x, -FLT_MAX, area.max.z };
+
+	vector<float> candidateX, candidateZ, groundY, ranks, sizeFactors;
+	vector<int> order;
+
+	for (size_t l = 0; l < layers.size(); l++)
+	{
+		const FoliageLayer& layer = layers[l];
+		if (layer.density <= 0.0f)
+			continue;
+
+		float spacing = 1.0f / sqrtf(layer.density);
+		int gx0 = (int)ceilf(area.min.x / spacing);
+		int gx1 = (int)ceilf(area.max.x / spacing);
+		int gz0 = (int)ceilf(area.min.z / spacing);
+		int gz1 = (int)ceilf(area.max.z / spacing);
+		unsigned int layerSeed = HashFoliage(Seed * 0x9E3779B9u + (unsigned int)l);
+
+		//jittered candidates, the mask drops them before the terrain is queried
+		candidateX.clear();
+		candidateZ.clear();
+		ranks.clear();
+		sizeFactors.clear();
+		for (int gz = gz0; gz < gz1; gz++)
+		{
+			for (int gx = gx0; gx < gx1; gx++)
+			{
+				unsigned int h = HashFoliage(layerSeed ^ HashFoliage((unsigned int)gx * 73856093u ^ (unsigned int)gz * 19349663u));
+				float x = (gx + HashToFloat(h)) * spacing;
+				h = HashFoliage(h);
+				float z = (gz + HashToFloat(h)) * spacing;
+				h = HashFoliage(h);
+				if (layer.maskChannel >= 0 && HashToFloat(h) >= SampleMask(x, z, layer.maskChannel))
+					continue;
+				h = HashFoliage(h);
+				candidateX.push_back(x);
+				candidateZ.push_back(z);
+				ranks.push_back(HashToFloat(h));
+				sizeFactors.push_back(HashToFloat(HashFoliage(h)));
+			}
+		}
+
+		int count = (int)candidateX.size();
+		groundY.resize(count);
+		if (count > 0)
+			patch.GetTerrainYBatch(candidateX.data(), candidateZ.data(), groundY.data(), count);
+
+		float minNormalY = cosf(layer.maxSlope * DEG2RAD);
+		order.clear();
+		for (int i = 0; i < count; i++)
+		{
+			if (groundY[i] < layer.minHeight || groundY[i] > layer.maxHeight)
+				continue;
+			if (patch.GetTerrainNormal(candidateX[i], candidateZ[i]).y < minNormalY)
+				continue;
+			order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&ranks](int a, int b) { return ranks[a] < ranks[b]; });
+
+		FoliageInstances& instances = pChunk->layers[l];
+		instances.positions.resize(order.size());
+		instances.sizes.resize(order.size());
+		for (size_t k = 0; k < order.size(); k++)
+		{
+			int i = order[k];
+			Vector2 size = Vector2Lerp(layer.minSize, layer.maxSize, sizeFactors[i]);
+			Vector3 position = { candidateX[i], groundY[i] + size.y * 0.45f, candidateZ[i] };
+			instances.positions[k] = position;
+			instances.sizes[k] = size;
+
+			float extent = std::max(size.x, size.y) * 0.5f;
+			pChunk->bounds.min = Vector3Min(pChunk->bounds.min, Vector3{ position.x - extent, position.y - extent, position.z - extent });
+			pChunk->bounds.max = Vector3Max(pChunk->bounds.max, Vector3{ position.x + extent, position.y + extent, position.z + extent });
+		}
+	}
+
+	if (pChunk->bounds.min.y > pChunk->bounds.max.y)
+		pChunk->bounds = area;	//nothing grows here
+}
+
+float FoliageScatterComponent::SampleMask(float x, float z, int channel) const
+{
+	if (mask.data == nullptr || channel < 0 || channel > 3)
+		return 1.0f;
+
+	float u = (x - terrainExtent.min.x) / (terrainExtent.max.x - terrainExtent.min.x);
+	float v = (z - terrainExtent.min.z) / (terrainExtent.max.z - terrainExtent.min.z);
+	int px = std::min(std::max((int)(u * mask.width), 0), mask.width - 1);
+	int pz = std::min(std::max((int)(v * mask.height), 0), mask.height - 1);
+	return ((const unsigned char*)mask.data)[((size_t)pz * mask.width + px) * 4 + channel] / 255.0f;
+}
+
+// Share of a chunk's instances drawn at a distance, 1 up to FullDensityDistance down to MinDensity at GenerateRadius
+float FoliageScatterComponent::GetDensityScale(float distance) const
+{
+	if (distance <= FullDensityDistance)
+		return 1.0f;
+	float t = (distance - FullDensityDistance) / std::max(GenerateRadius - FullDensityDistance, 1.0f);
+	return Lerp(1.0f, MinDensity, Clamp(t, 0.0f, 1.0f));
+}
+
+/// <summary>
+/// Draw - Cull the cached chunks against the frustum of the drawing camera and draw each layer with one
+/// streamed draw call: the rank prefix of every visible chunk, thinned by the distance to the main camera
+/// so the shadows thin the same way. Passes drawing from another camera (shadow depth) only get the layers
+/// casting shadows.
+/// </summary>
+/// <param name="pRH">The RenderHints, use to override default rendering settings</param>
+void FoliageScatterComponent::Draw(RenderHints* pRH)
+{
+	NumVisible = 0;
+	NumDrawCalls = 0;
+	if (chunks.empty())
+		return;
+
+	SceneCamera* pMainCamera = _SceneActor->GetMainCamera();
+	if (pMainCamera == nullptr)
+		return;
+	SceneCamera* pCamera = pMainCamera;
+	if (pRH != nullptr && pRH->pOverrideCamera != nullptr)
+		pCamera = pRH->pOverrideCamera;
+	bool shadowPass = pCamera != pMainCamera;
+	const Shader* pShader = pRH != nullptr ? pRH->pOverrideShader : nullptr;
+	Camera3D camera = *pCamera->GetCamera3D();
+	Vector3 eye = pMainCamera->GetPosition();
+
+	FrustumPlane frustumPlanes[6];
+	pCamera->ExtractFrustumPlanes(frustumPlanes);
+
+	visibleChunks.clear();
+	for (auto& chunk : chunks)
+	{
+		FoliageChunk* pChunk = chunk.second;
+		if (!pCamera->IsBoundingBoxInFrustum(pChunk->bounds, frustumPlanes))
+			continue;
+		pChunk->densityScale = GetDensityScale(sqrtf(PointToBoxDistanceSqr(eye, pChunk->bounds)));
+		visibleChunks.push_back(pChunk);
+	}
+	if (visibleChunks.empty())
+		return;
+
+	//the vertex buffers need the GL context, which the first Draw is sure to have
+	if (!quadsCreated)
+	{
+		quadsCreated = true;
+		if (!quads.Create())
+			TraceLog(LOG_WARNING, "<FoliageScatterComponent.Draw> Streaming quads not available, foliage is not drawn");
+	}
+	if (!quads.IsReady())
+		return;
+
+	Matrix matView = MatrixLookAt(camera.position, camera.target, camera.up);
+	Vector3 right = { matView.m0, matView.m4, matView.m8 };
+	Vector3 up = { 0.0f, 1.0f, 0.0f };
+	int alphaTestLoc = pShader != nullptr ? GetShaderLocation(*pShader, "alphaTest") : -1;
+
+	BeginBlendMode(blendingMode);
+	for (size_t l = 0; l < layers.size(); l++)
+	{
+		const FoliageLayer& layer = layers[l];
+		if (layer.texture.id == 0 || (shadowPass && !layer.castShadow))
+			continue;
+
+		if (alphaTestLoc >= 0)
+		{
+			rlDrawRenderBatchActive();
+			int alphaTest = layer.alphaTest ? 1 : 0;
+			SetShaderValue(*pShader, alphaTestLoc, &alphaTest, SHADER_UNIFORM_INT);
+		}
+
+		Rectangle uv = { layer.source.x / layer.texture.width, layer.source.y / layer.texture.height,
+			layer.source.width / layer.texture.width, layer.source.height / layer.texture.height };
+
+		for (FoliageChunk* pChunk : visibleChunks)
+		{
+			const FoliageInstances& instances = pChunk->layers[l];
+			int count = (int)ceilf(instances.positions.size() * pChunk->densityScale);
+			int i = 0;
+			while (i < count)
+			{
+				int room = quads.GetMaxQuads() - quads.GetNumQuads();
+				if (room == 0)
+				{
+					if (quads.Draw(layer.texture, pShader))
+						NumDrawCalls++;
+					continue;
+				}
+				int n = std::min(room, count - i);
+				QuadVertex* pVertex = quads.AddQuads(n);
+				for (int end = i + n; i < end; i++, pVertex += 4)
+				{
+					Vector2 size = instances.sizes[i];
+					BillboardBatchComponent::WriteQuad(pVertex, instances.positions[i], Vector3Scale(right, size.x * 0.5f), Vector3Scale(up, size.y * 0.5f), uv, layer.tint);
+				}
+			}
+			NumVisible += count;
+		}
+
+		if (quads.Draw(layer.texture, pShader))
+			NumDrawCalls++;
+	}
+	EndBlendMode();
+
+	//leave the uniform as a pass enabling the alpha test per component would
+	if (alphaTestLoc >= 0)
+	{
+		rlDrawRenderBatchActive();
+		int alphaTest = EnableAlphaTest ? 1 : 0;
+		SetShaderValue(*pShader, alphaTestLoc, &alphaTest, SHADER_UNIFORM_INT);
+	}
+}
+
+//end of FoliageScatterComponent.cpp
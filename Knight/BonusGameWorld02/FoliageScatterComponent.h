@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <future>
+#include <cfloat>
+
+#include "Knight.h"
+#include "QuadTreeTerrainComponent.h"
+
+// One kind of plant and the rules for where it grows
+struct FoliageLayer
+{
+	Texture2D texture = { 0 };		// not owned, has to outlive the component
+	Rectangle source = { 0 };		// in pixels, an empty rectangle takes the whole texture
+	float density = 0.05f;			// instances per square world unit before the rules thin them
+	Vector2 minSize = { 1.0f, 1.0f };
+	Vector2 maxSize = { 2.0f, 2.0f };
+	float minHeight = -FLT_MAX;		// world height range
+	float maxHeight = FLT_MAX;
+	float maxSlope = 30.0f;			// degrees from flat
+	int maskChannel = -1;			// channel (0 ~ 3) of the mask image scaling the density, -1 ignores the mask
+	Color tint = WHITE;
+	bool alphaTest = true;
+	bool castShadow = false;
+};
+
+// Scatters billboards over a QuadTreeTerrainComponent from density rules instead of placing them by hand.
+// The terrain is split into the quadtree nodes at ChunkDepth; the chunks around the main camera are
+// generated on the JobSystem and cached, the ones left behind are released. Instances come from a jittered
+// grid hashed on their world cell, so a chunk always regenerates the same plants. Every chunk keeps its
+// instances in random rank order and draws only a prefix of them, thinner with the distance.
+// The workers sample a copy of the terrain under their chunk, and the chunks under the height changes the
+// terrain reports are generated again.
+// Keep the owning SceneActor at the origin without rotation or scale.
+class FoliageScatterComponent : public Component
+{
+public:
+	FoliageScatterComponent();
+	~FoliageScatterComponent();
+
+	// pMaskPath is optional, the image is stretched over the whole terrain
+	bool Create(QuadTreeTerrainComponent* pTerrain, const char* pMaskPath = nullptr);
+	// Returns the layer index, the chunks generated so far are dropped
+	int AddLayer(const FoliageLayer& layer);
+	// Regenerate every chunk. The ones over changed terrain heights are regenerated by Update already.
+	void InvalidateChunks();
+
+	void Update(float ElapsedSeconds, RenderHints* pRH = nullptr) override;
+	void Draw(RenderHints* pRH = nullptr) override;
+
+	unsigned int Seed = 1;
+	int ChunkDepth = 4;					// quadtree depth of the chunks, 32 units on a 512 unit terrain
+	float GenerateRadius = 160.0f;		// chunks closer to the camera are generated
+	float EvictRadius = 200.0f;			// cached chunks farther away are released
+	float FullDensityDistance = 40.0f;	// all instances are drawn up to here
+	float MinDensity = 0.1f;			// share of the instances drawn at GenerateRadius
+	int MaxPendingChunks = 8;			// chunks generated on the workers at once
+
+	// Counters of the last Update and Draw
+	int NumChunks = 0;
+	int NumPendingChunks = 0;
+	int NumInstances = 0;
+	int NumVisible = 0;
+	int NumDrawCalls = 0;
+
+protected:
+	// Instances of one layer in a chunk, in ascending rank
+	struct FoliageInstances
+	{
+		vector<Vector3> positions;
+		vector<Vector2> sizes;
+	};
+
+	struct FoliageChunk
+	{
+		BoundingBox bounds;
+		vector<FoliageInstances> layers;
+		float densityScale = 1.0f;	// share drawn this frame
+	};
+
+	struct PendingChunk
+	{
+		future<void> done;
+		FoliageChunk* pChunk;
+		TerrainPatch* pPatch;	// the heights the worker reads
+		bool stale = false;		// the heights changed after they were copied
+	};
+
+	void GenerateChunk(BoundingBox area, const TerrainPatch& patch, FoliageChunk* pChunk) const;
+	void HandleHeightChanges();
+	void RequestChunks(Vector3 eye);
+	void GatherChunkNodes(const QuadTreeNode* pNode, Vector3 eye, vector<pair<float, const QuadTreeNode*>>& nodes) const;
+	void WaitForPendingChunks();
+	float GetDensityScale(float distance) const;
+	float SampleMask(float x, float z, int channel) const;
+
+	QuadTreeTerrainComponent* pTerrain = nullptr;
+	BoundingBox terrainExtent = { 0 };
+	unsigned int lastHeightChange = 0;	// serial of the last terrain height change handled
+	Image mask = { 0 };
+	vector<FoliageLayer> layers;
+
+	unordered_map<const QuadTreeNode*, FoliageChunk*> chunks;
+	unordered_map<const QuadTreeNode*, PendingChunk> pending;
+	vector<FoliageChunk*> visibleChunks;
+	vector<pair<float, const QuadTreeNode*>> wantedNodes;
+
+	StreamingQuadBuffer quads;
+	bool quadsCreated = false;
+
+	friend SceneActor;
+};
+
+//end of FoliageScatterComponent.h
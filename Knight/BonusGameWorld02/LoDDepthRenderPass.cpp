@@ -38,21 +38,9 @@ bool LoDDepthRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 			return false;
 	}
 
-	switch (pSC->renderQueue)
-	{
-		case Component::eRenderQueueType::Background:
-			pScene->_RenderQueue.Background.push_back(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Geometry:
-			pScene->_RenderQueue.Geometry.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::AlphaBlend:
-			pScene->_RenderQueue.AlphaBlending.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Overlay:
-			pScene->_RenderQueue.Overlay.push_back(RenderContext{ pSC, dist2 });
-			break;
-	}
+	AddToRenderQueue(pSC, dist2);
+
+	return true;
 }
 
 //End of LoDDepthRenderPass.cpp
\ No newline at end of file
@@ -1,6 +1,7 @@
 //Render shadow only for objects within certain distance to the view camera
 #include "LodShadowMapRenderPass.h"
 #include "QuadTreeTerrainComponent.h"
+#include "ParticleRenderBatcher.h"
 
 LoDShadowMapRenderPass::LoDShadowMapRenderPass(float cutof, ShadowSceneLight * l, int id)
 	: ShadowMapRenderPass(l, id)
@@ -34,7 +35,7 @@ void LoDShadowMapRenderPass::Render()
 	while (bk != pScene->_RenderQueue.Background.end()) {
 		int receiveShadow = ShouldRenderShadow(*bk);
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -43,7 +44,7 @@ void LoDShadowMapRenderPass::Render()
 	while (opaque != pScene->_RenderQueue.Geometry.end()) {
 		int receiveShadow = ShouldRenderShadow(*opaque);
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 
@@ -55,19 +56,23 @@ void LoDShadowMapRenderPass::Render()
 		BeginBlendMode(alpha->pComponent->blendingMode);
 		int receiveShadow = ShouldRenderShadow(*alpha);
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		rlEnableDepthMask();
 		rlEnableBackfaceCulling();
 		++alpha;
 	}
 
+	//the particle emitters only queued their particles in the alpha loop, draw them in batches now
+	if (pActiveCamera != nullptr)
+		ParticleRenderBatcher::Instance().Flush(*pActiveCamera->GetCamera3D());
+
 	//render overlay first
 	vector<RenderContext>::iterator overlay = pScene->_RenderQueue.Overlay.begin();
 	while (overlay != pScene->_RenderQueue.Overlay.end()) {
 		int receiveShadow = ShouldRenderShadow(*overlay);
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		++overlay;
 	}
 }
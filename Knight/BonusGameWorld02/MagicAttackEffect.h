@@ -12,11 +12,12 @@ public:
 
     MagicAttackEffect();
 
-    void Update(float ElapsedSeconds, RenderHints* pRH = nullptr) override;
     void Draw(RenderHints* pRH = nullptr) override;
 
     void Reset() override;
 
+    bool IsEmitting() const override { return isEnabled; }
+
     void EmitParticles(float deltaTime) override;
 };
 
@@ -0,0 +1,280 @@
+#include "ParticleBuffer.h"
+
+#include <cstring>
+#include <malloc.h>
+#include <emmintrin.h>
+
+#define PARTICLE_FLOAT_STREAMS 8    //posX, posY, posZ, velX, velY, velZ, life, maxLife
+
+ParticleBuffer::~ParticleBuffer()
+{
+    Free();
+}
+
+/// <summary>
+/// Reserve - Allocate the streams for maxParticles in one aligned block.
+/// </summary>
+/// <param name="maxParticles">Number of particles the buffer holds at most</param>
+void ParticleBuffer::Reserve(int maxParticles)
+{
+    Free();
+    if (maxParticles <= 0)
+        return;
+
+    capacity = (maxParticles + 3) & ~3;
+    size_t streamBytes = (size_t)capacity * sizeof(float);
+    pMemory = _aligned_malloc(streamBytes * (PARTICLE_FLOAT_STREAMS + 1), 16);
+    if (pMemory == nullptr) {
+        TraceLog(LOG_WARNING, "<ParticleBuffer.Reserve> Out of memory for %d particles", maxParticles);
+        capacity = 0;
+        return;
+    }
+    memset(pMemory, 0, streamBytes * (PARTICLE_FLOAT_STREAMS + 1));
+
+    float* pStream = (float*)pMemory;
+    posX = pStream; pStream += capacity;
+    posY = pStream; pStream += capacity;
+    posZ = pStream; pStream += capacity;
+    velX = pStream; pStream += capacity;
+    velY = pStream; pStream += capacity;
+    velZ = pStream; pStream += capacity;
+    life = pStream; pStream += capacity;
+    maxLife = pStream; pStream += capacity;
+    color = (Color*)pStream;
+}
+
+int ParticleBuffer::Add(Vector3 position, Vector3 velocity, float lifeSeconds, Color c)
+{
+    if (size >= capacity)
+        return -1;
+
+    orderValid = false;
+    int i = size++;
+    posX[i] = position.x;
+    posY[i] = position.y;
+    posZ[i] = position.z;
+    velX[i] = velocity.x;
+    velY[i] = velocity.y;
+    velZ[i] = velocity.z;
+    life[i] = maxLife[i] = lifeSeconds;
+    color[i] = c;
+    return i;
+}
+
+/// <summary>
+/// Integrate - Move every particle by its velocity, accelerate it and age it, 4 particles at a time.
+/// The lanes past the last particle are padding and are integrated along, nobody reads them.
+/// </summary>
+/// <param name="dt">Seconds since the last update</param>
+/// <param name="acceleration">Gravity or wind, in units per second squared</param>
+/// <param name="begin">First particle, a multiple of 4 so ranges can be integrated on different threads</param>
+/// <param name="end">One past the last particle, -1 for all</param>
+void ParticleBuffer::Integrate(float dt, Vector3 acceleration, int begin, int end)
+{
+    __m128 vdt = _mm_set1_ps(dt);
+    __m128 ax = _mm_set1_ps(acceleration.x * dt);
+    __m128 ay = _mm_set1_ps(acceleration.y * dt);
+    __m128 az = _mm_set1_ps(acceleration.z * dt);
+
+    int count = (GetRangeEnd(end) + 3) & ~3;
+    for (int i = begin; i < count; i += 4) {
+        __m128 vx = _mm_load_ps(velX + i);
+        __m128 vy = _mm_load_ps(velY + i);
+        __m128 vz = _mm_load_ps(velZ + i);
+
+        _mm_store_ps(posX + i, _mm_add_ps(_mm_load_ps(posX + i), _mm_mul_ps(vx, vdt)));
+        _mm_store_ps(posY + i, _mm_add_ps(_mm_load_ps(posY + i), _mm_mul_ps(vy, vdt)));
+        _mm_store_ps(posZ + i, _mm_add_ps(_mm_load_ps(posZ + i), _mm_mul_ps(vz, vdt)));
+
+        _mm_store_ps(velX + i, _mm_add_ps(vx, ax));
+        _mm_store_ps(velY + i, _mm_add_ps(vy, ay));
+        _mm_store_ps(velZ + i, _mm_add_ps(vz, az));
+
+        _mm_store_ps(life + i, _mm_sub_ps(_mm_load_ps(life + i), vdt));
+    }
+}
+
+/// <summary>
+/// FadeColors - Scale the color by the life left, alpha goes from 255 down to 0.
+/// </summary>
+/// <param name="initialColor">The color of a new particle</param>
+/// <param name="begin">First particle, a multiple of 4</param>
+/// <param name="end">One past the last particle, -1 for all</param>
+void ParticleBuffer::FadeColors(Color initialColor, int begin, int end)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 r = _mm_set1_ps((float)initialColor.r);
+    __m128 g = _mm_set1_ps((float)initialColor.g);
+    __m128 b = _mm_set1_ps((float)initialColor.b);
+    __m128 a = _mm_set1_ps(255.0f);
+
+    int count = (GetRangeEnd(end) + 3) & ~3;
+    for (int i = begin; i < count; i += 4) {
+        //padding lanes have a maxLife of 0, the division gives inf or nan which max/min turn into 0 or 1
+        __m128 ratio = _mm_div_ps(_mm_load_ps(life + i), _mm_load_ps(maxLife + i));
+        ratio = _mm_min_ps(_mm_max_ps(ratio, zero), one);
+
+        __m128i packed = _mm_cvttps_epi32(_mm_mul_ps(r, ratio));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(g, ratio)), 8));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(b, ratio)), 16));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(a, ratio)), 24));
+        _mm_store_si128((__m128i*)(color + i), packed);
+    }
+}
+
+/// <summary>
+/// RemoveDead - Replace every dead particle by the last live one. Groups of 4 live particles are
+/// skipped with one compare.
+/// </summary>
+/// <returns>Number of particles removed</returns>
+int ParticleBuffer::RemoveDead()
+{
+    __m128 zero = _mm_setzero_ps();
+    int removed = 0;
+
+    int i = 0;
+    while (i < size) {
+        if ((i & 3) == 0 && i + 4 <= size && _mm_movemask_ps(_mm_cmple_ps(_mm_load_ps(life + i), zero)) == 0) {
+            i += 4;
+            continue;
+        }
+        if (life[i] > 0.0f) {
+            i++;
+            continue;
+        }
+
+        int last = --size;
+        posX[i] = posX[last];
+        posY[i] = posY[last];
+        posZ[i] = posZ[last];
+        velX[i] = velX[last];
+        velY[i] = velY[last];
+        velZ[i] = velZ[last];
+        life[i] = life[last];
+        maxLife[i] = maxLife[last];
+        color[i] = color[last];
+        removed++;
+    }
+    if (removed > 0)
+        orderValid = false;
+    return removed;
+}
+
+/// <summary>
+/// CollideWithGround - Push the particles below the ground back onto it, 4 at a time. Bouncing particles
+/// only bounce while they move down, so a particle resting on a slope doesn't gain speed.
+/// </summary>
+/// <param name="groundY">Ground height under every particle of the range</param>
+/// <param name="response">What happens to a particle on contact</param>
+/// <param name="restitution">Share of the vertical speed kept by a bounce</param>
+/// <param name="friction">Share of the horizontal speed kept by a bounce</param>
+/// <param name="begin">First particle, a multiple of 4</param>
+/// <param name="end">One past the last particle, -1 for all</param>
+/// <returns>Number of particles below the ground</returns>
+int ParticleBuffer::CollideWithGround(const float* groundY, eParticleCollision response, float restitution, float friction, int begin, int end)
+{
+    if (response == PARTICLE_COLLISION_NONE)
+        return 0;
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 bounce = _mm_set1_ps(-restitution);
+    __m128 slide = _mm_set1_ps(friction);
+
+    end = GetRangeEnd(end);
+    int count = (end + 3) & ~3;
+    int hits = 0;
+    for (int i = begin; i < count; i += 4) {
+        __m128 ground = _mm_loadu_ps(groundY + i);
+        __m128 y = _mm_load_ps(posY + i);
+        __m128 below = _mm_cmplt_ps(y, ground);
+        int mask = _mm_movemask_ps(below);
+        if (i + 4 > end)
+            mask &= (1 << (end - i)) - 1;   //not the padding
+        if (mask == 0)
+            continue;
+
+        hits += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        _mm_store_ps(posY + i, _mm_or_ps(_mm_and_ps(below, ground), _mm_andnot_ps(below, y)));
+
+        if (response == PARTICLE_COLLISION_KILL) {
+            __m128 l = _mm_load_ps(life + i);
+            _mm_store_ps(life + i, _mm_andnot_ps(below, l));
+        }
+        else if (response == PARTICLE_COLLISION_STICK) {
+            _mm_store_ps(velX + i, _mm_andnot_ps(below, _mm_load_ps(velX + i)));
+            _mm_store_ps(velY + i, _mm_andnot_ps(below, _mm_load_ps(velY + i)));
+            _mm_store_ps(velZ + i, _mm_andnot_ps(below, _mm_load_ps(velZ + i)));
+        }
+        else {
+            __m128 vy = _mm_load_ps(velY + i);
+            __m128 hit = _mm_and_ps(below, _mm_cmplt_ps(vy, zero));
+            __m128 vx = _mm_load_ps(velX + i);
+            __m128 vz = _mm_load_ps(velZ + i);
+            _mm_store_ps(velY + i, _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(vy, bounce)), _mm_andnot_ps(hit, vy)));
+            _mm_store_ps(velX + i, _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(vx, slide)), _mm_andnot_ps(hit, vx)));
+            _mm_store_ps(velZ + i, _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(vz, slide)), _mm_andnot_ps(hit, vz)));
+        }
+    }
+    return hits;
+}
+
+/// <summary>
+/// SortByDepth - Order the particles far to near for alpha blending. The depths are turned into unsigned
+/// keys that sort like the floats, and sorted in 3 passes of 11 bits; a pass where all keys share
+/// the digit is skipped. The particles themselves don't move, GetDrawOrder lists them.
+/// </summary>
+/// <param name="eye">The camera position</param>
+/// <param name="viewDir">The normalized camera forward direction</param>
+void ParticleBuffer::SortByDepth(Vector3 eye, Vector3 viewDir)
+{
+    order.resize(size);
+    orderScratch.resize(size);
+    keys.resize(size);
+    keysScratch.resize(size);
+
+    for (int i = 0; i < size; i++) {
+        float depth = (posX[i] - eye.x) * viewDir.x + (posY[i] - eye.y) * viewDir.y + (posZ[i] - eye.z) * viewDir.z;
+        unsigned int bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        keys[i] = ~bits;    //ascending keys, descending depth
+        order[i] = i;
+    }
+
+    for (int shift = 0; shift < 32; shift += 11) {
+        unsigned int counts[2048] = { 0 };
+        for (int i = 0; i < size; i++)
+            counts[(keys[i] >> shift) & 2047]++;
+        if (size == 0 || counts[(keys[0] >> shift) & 2047] == (unsigned int)size)
+            continue;
+
+        unsigned int offset = 0;
+        for (int d = 0; d < 2048; d++) {
+            unsigned int n = counts[d];
+            counts[d] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < size; i++) {
+            unsigned int slot = counts[(keys[i] >> shift) & 2047]++;
+            keysScratch[slot] = keys[i];
+            orderScratch[slot] = order[i];
+        }
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+    orderValid = true;
+}
+
+void ParticleBuffer::Free()
+{
+    if (pMemory != nullptr)
+        _aligned_free(pMemory);
+    pMemory = nullptr;
+    posX = posY = posZ = velX = velY = velZ = life = maxLife = nullptr;
+    color = nullptr;
+    size = capacity = 0;
+    orderValid = false;
+}
+
+//End of ParticleBuffer.cpp
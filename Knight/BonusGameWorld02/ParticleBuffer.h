@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+
+using namespace std;
+
+// What a particle does when it falls below the ground
+enum eParticleCollision
+{
+    PARTICLE_COLLISION_NONE = 0,
+    PARTICLE_COLLISION_BOUNCE,  // reflected up, damped by the restitution and slowed by the friction
+    PARTICLE_COLLISION_KILL,    // dies at the next RemoveDead
+    PARTICLE_COLLISION_STICK    // stays on the ground until its life runs out
+};
+
+// Small xorshift generator, one per emitter so emission never goes through the shared rand() state
+// and an emitter replays the same particles from the same seed
+struct ParticleRandom
+{
+    unsigned int state = 2463534242u;
+
+    void Seed(unsigned int seed) { state = seed != 0 ? seed : 2463534242u; }
+
+    unsigned int NextUInt()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform in [0, 1)
+    float NextFloat() { return (NextUInt() >> 8) * (1.0f / 16777216.0f); }
+
+    // Uniform in [minValue, maxValue)
+    float Range(float minValue, float maxValue) { return minValue + (maxValue - minValue) * NextFloat(); }
+};
+
+// Particles stored as a structure of arrays: every stream is 16 byte aligned and the capacity is padded
+// to a multiple of 4, so the SSE loops run over whole groups of 4 particles without a scalar tail.
+// Dead particles are swap-removed, the order of the live ones is not kept.
+class ParticleBuffer
+{
+public:
+    ParticleBuffer() {}
+    ~ParticleBuffer();
+
+    ParticleBuffer(const ParticleBuffer&) = delete;
+    ParticleBuffer& operator=(const ParticleBuffer&) = delete;
+
+    // Allocate room for maxParticles, the live particles are dropped
+    void Reserve(int maxParticles);
+    void Clear() { size = 0; orderValid = false; }
+
+    // Index of the new particle, -1 if the buffer is full
+    int Add(Vector3 position, Vector3 velocity, float life, Color color);
+
+    // position += velocity * dt, velocity += acceleration * dt, life -= dt
+    // for the particles [begin, end), end -1 is the last one; begin has to be a multiple of 4
+    void Integrate(float dt, Vector3 acceleration, int begin = 0, int end = -1);
+    // color = initialColor * life / maxLife, alpha 255 * life / maxLife
+    void FadeColors(Color initialColor, int begin = 0, int end = -1);
+    // Resolve the particles of [begin, end) below groundY, one height per particle. groundY has to cover
+    // the range rounded up to a multiple of 4. Returns how many particles hit the ground.
+    int CollideWithGround(const float* groundY, eParticleCollision response, float restitution, float friction, int begin = 0, int end = -1);
+    // Swap-remove the particles without life left, returns how many were removed
+    int RemoveDead();
+
+    // Back to front order of the particles seen from eye, radix sorted on the depth along viewDir.
+    // GetDrawOrder is nullptr once particles are added or removed, until the next sort.
+    void SortByDepth(Vector3 eye, Vector3 viewDir);
+    const int* GetDrawOrder() const { return orderValid ? order.data() : nullptr; }
+
+    int Size() const { return size; }
+    int Capacity() const { return capacity; }
+    bool IsFull() const { return size >= capacity; }
+
+    Vector3 GetPosition(int i) const { return Vector3{ posX[i], posY[i], posZ[i] }; }
+
+    float* posX = nullptr;
+    float* posY = nullptr;
+    float* posZ = nullptr;
+    float* velX = nullptr;
+    float* velY = nullptr;
+    float* velZ = nullptr;
+    float* life = nullptr;
+    float* maxLife = nullptr;
+    Color* color = nullptr;
+
+protected:
+    void Free();
+    int GetRangeEnd(int end) const { return end < 0 || end > size ? size : end; }
+
+    int size = 0;
+    int capacity = 0;
+    void* pMemory = nullptr;
+
+    // SortByDepth
+    vector<int> order;
+    vector<int> orderScratch;
+    vector<unsigned int> keys;
+    vector<unsigned int> keysScratch;
+    bool orderValid = false;
+};
+
+//End of ParticleBuffer.h
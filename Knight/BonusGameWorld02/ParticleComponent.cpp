@@ -1,29 +1,76 @@
 #include "ParticleComponent.h"
+#include "ParticleRenderBatcher.h"
+#include "ParticleSystemManager.h"
+#include "QuadTreeTerrainComponent.h"
 
 ParticleComponent::ParticleComponent()
 {
     renderQueue = Component::eRenderQueueType::AlphaBlend;
     blendingMode = BLEND_ADDITIVE;
     EnableAlphaTest = false;
+
+    //every emitter gets its own sequence, still the same from run to run
+    static unsigned int numEmitters = 0;
+    emitterIndex = ++numEmitters;
+    random.Seed(0x9E3779B9u * emitterIndex);
+}
+
+ParticleComponent::~ParticleComponent()
+{
+    if (queued)
+        ParticleSystemManager::Instance().Remove(this);
+    ResourceRegistry::Instance().ReleaseTexture(texture);
 }
 
 bool ParticleComponent::CreateFromFile(const char* path, int maxp, Vector3 v, Color ic, Vector3 isp)
 {
     Texture2D particleTexture = { 0 };
 
-    particleTexture = LoadTexture(path);
+    //every effect of the same kind shares the texture
+    particleTexture = ResourceRegistry::Instance().AcquireTexture(path);
     if (particleTexture.width == 0 && particleTexture.height == 0)
         return false;
+    ResourceRegistry::Instance().ReleaseTexture(texture);
     maxParticles = maxp;
     offset = v;
     texture = particleTexture;
     initialColor = ic;
     initialSpeed = isp;
-    particles.reserve(maxParticles);
+    particles.Reserve(maxParticles);
+    groundHeights.assign(particles.Capacity(), 0.0f);
 
 	return true;
 }
 
+void ParticleComponent::SetCollisionTerrain(QuadTreeTerrainComponent* pTerrain)
+{
+    collisionTerrain = pTerrain;
+    groundHeights.assign(particles.Capacity(), 0.0f);
+}
+
+bool ParticleComponent::NeedsDepthSort() const
+{
+    if (!DepthSort)
+        return false;
+
+    // additive and multiplied blending give the same result in any order
+    switch (blendingMode) {
+    case BLEND_ALPHA:
+    case BLEND_ALPHA_PREMULTIPLY:
+    case BLEND_CUSTOM:
+    case BLEND_CUSTOM_SEPARATE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// <summary>
+/// Update - Simulate the live particles and emit the ones due since the last frame. With the
+/// ParticleSystemManager enabled the emitter is only queued, the manager simulates it after the scene update.
+/// </summary>
+/// <param name="ElapsedSeconds">Seconds since the last frame</param>
+/// <param name="pRH"></param>
 void ParticleComponent::Update(float ElapsedSeconds, RenderHints* pRH)
 {
     if (currentDelayTime > 0.0f) {
@@ -31,71 +78,200 @@ void ParticleComponent::Update(float ElapsedSeconds, RenderHints* pRH)
         return; // Wait until delay is over
 	}
 
-    for (auto& particle : particles) {
-        // Update particle position based on velocity
-        particle.position.x += particle.velocity.x * ElapsedSeconds;
-        particle.position.y += particle.velocity.y * ElapsedSeconds;
-        particle.position.z += particle.velocity.z * ElapsedSeconds;
-
-		// Apply small gravity to make it fly up 
-        particle.velocity.y += 0.8f * ElapsedSeconds;
-
-        // Decrease particle life
-        particle.life -= ElapsedSeconds;
-        float lifeRatio = particle.life / particle.maxLife;
-
-        // Fade out as life decreases
-        particle.color.a = static_cast<unsigned char>(255 * lifeRatio);
-		particle.color.r = static_cast<unsigned char>(initialColor.r * lifeRatio);
-        particle.color.g = static_cast<unsigned char>(initialColor.g * lifeRatio);
-        particle.color.b = static_cast<unsigned char>(initialColor.b * lifeRatio);
+    ParticleSystemManager& manager = ParticleSystemManager::Instance();
+    if (manager.Enabled) {
+        manager.Queue(this, ElapsedSeconds);
+        return;
     }
 
-    // Remove dead particles
-    particles.erase(std::remove_if(particles.begin(), particles.end(),
-        [](const Particle& p) { return p.life <= 0; }),
-        particles.end());
+    SimulateParticles(ElapsedSeconds);
 
     // Emit new particles
-    EmitParticles(ElapsedSeconds);
+    if (IsEmitting())
+        EmitParticles(ElapsedSeconds);
 }
 
 void ParticleComponent::Draw(RenderHints* pRH)
+{
+    DrawParticles();
+}
+
+void ParticleComponent::DrawParticles()
 {
     Camera3D *pCam = NULL;
     SceneCamera* pMainCam = _SceneActor->GetMainCamera();
     if (pMainCam != NULL)
         pCam = pMainCam->GetCamera3D();
 
+    //the ParticleSystemManager sorts after the simulation, the serial update leaves it to the first draw
+    const int* pOrder = nullptr;
+    if (NeedsDepthSort()) {
+        if (particles.GetDrawOrder() == nullptr && pCam != NULL)
+            SortParticles(pCam->position, Vector3Normalize(Vector3Subtract(pCam->target, pCam->position)));
+        pOrder = particles.GetDrawOrder();
+    }
+
+    ParticleRenderBatcher& batcher = ParticleRenderBatcher::Instance();
+    if (batcher.IsReady()) {
+        batcher.Submit(texture, blendingMode, particles, particleSize, pOrder);
+        return;
+    }
+
     if (pCam != NULL) {
-        for (const auto& particle : particles) {
-            float size = 1.0f; // Size of each particle
-            DrawBillboard(*pCam, texture, particle.position, size, particle.color);
+        for (int i = 0; i < particles.Size(); i++) {
+            int p = pOrder != nullptr ? pOrder[i] : i;
+            DrawBillboard(*pCam, texture, particles.GetPosition(p), particleSize, particles.color[p]);
         }
     }
 }
 
+void ParticleComponent::SimulateParticles(float deltaTime)
+{
+    particles.Integrate(deltaTime, Acceleration);
+    CollideParticles(0, particles.Size());
+    particles.FadeColors(initialColor);
+    particles.RemoveDead();
+}
+
+/// <summary>
+/// CollideParticles - Look up the terrain height under the particles in one batch, then resolve the
+/// ones below it. Safe on job threads for disjoint ranges of the same emitter.
+/// </summary>
+/// <param name="begin">First particle, a multiple of 4</param>
+/// <param name="end">One past the last particle</param>
+void ParticleComponent::CollideParticles(int begin, int end)
+{
+    if (Collision == PARTICLE_COLLISION_NONE || collisionTerrain == nullptr || begin >= end)
+        return;
+
+    //CollideWithGround reads whole groups of 4, the padding lanes get a height too
+    int count = std::min((end + 3) & ~3, particles.Capacity()) - begin;
+    if ((int)groundHeights.size() < begin + count)
+        return;
+
+    collisionTerrain->GetTerrainYBatch(particles.posX + begin, particles.posZ + begin, groundHeights.data() + begin, count);
+    particles.CollideWithGround(groundHeights.data(), Collision, Restitution, Friction, begin, end);
+}
+
+void ParticleComponent::SortParticles(Vector3 eye, Vector3 viewDir)
+{
+    particles.SortByDepth(eye, viewDir);
+}
+
+/// <summary>
+/// GetNumToEmit - Accumulate the emission time, so the rate doesn't depend on the frame rate.
+/// </summary>
+/// <param name="deltaTime">Seconds since the last frame</param>
+/// <returns>Number of particles to emit this frame</returns>
+int ParticleComponent::GetNumToEmit(float deltaTime)
+{
+    emitAccumulator += deltaTime * EmissionRate;
+    int count = (int)emitAccumulator;
+    emitAccumulator -= (float)count;
+
+    //a full emitter doesn't bank particles for later
+    int room = particles.Capacity() - particles.Size();
+    return count < room ? count : room;
+}
+
+bool ParticleComponent::AddParticle(const Particle& particle)
+{
+    return particles.Add(particle.position, particle.velocity, particle.maxLife, particle.color) >= 0;
+}
+
 void ParticleComponent::EmitParticles(float deltaTime)
 {
-    int particlesToEmit = 5; // Emit rate
+    int particlesToEmit = GetNumToEmit(deltaTime);
 
     Vector3 origin = Vector3Add(_SceneActor->Position, offset);
 
-    for (int i = 0; i < particlesToEmit && particles.size() < maxParticles; i++) {
+    for (int i = 0; i < particlesToEmit; i++) {
         Particle particle;
         particle.position = origin;
 
         // Random velocity with some upward direction
-        particle.velocity.x = (float(rand()) / RAND_MAX - 0.5f) * 2.0f;
-        particle.velocity.y = (float(rand()) / RAND_MAX) * 2.0f + 4.0f; // Upward velocity
-        particle.velocity.z = (float(rand()) / RAND_MAX - 0.5f) * 2.0f;
-        Vector3Add(particle.velocity, initialSpeed);
+        particle.velocity.x = random.Range(-1.0f, 1.0f);
+        particle.velocity.y = random.Range(4.0f, 6.0f); // Upward velocity
+        particle.velocity.z = random.Range(-1.0f, 1.0f);
+        particle.velocity = Vector3Add(particle.velocity, initialSpeed);
 
-        particle.life = particle.maxLife = 2.0f + float(rand()) / RAND_MAX * 2.0f; // Life in seconds
+        particle.life = particle.maxLife = random.Range(2.0f, 4.0f); // Life in seconds
         particle.color = initialColor; // Initial color
 
-        particles.push_back(particle);
+        AddParticle(particle);
     }
 }
 
+/// <summary>
+/// RunSimulationBenchmark - Time one second of simulation at 60 fps for the array of structs update
+/// ParticleComponent used before (erase/remove_if compaction) and for ParticleBuffer. Both start from
+/// the same particles and respawn the dead ones to keep the count. Results go to the log.
+/// </summary>
+/// <param name="numParticles">Number of live particles</param>
+void ParticleComponent::RunSimulationBenchmark(int numParticles)
+{
+    const int numFrames = 60;
+    const float dt = 1.0f / 60.0f;
+    const Vector3 acceleration = { 0, 0.8f, 0 };
+    const Color initial = ORANGE;
+
+    vector<Particle> spawns(numParticles);
+    ParticleRandom rng;
+    rng.Seed(12345u);
+    for (auto& p : spawns) {
+        p.position = Vector3{ rng.Range(-10.0f, 10.0f), 0, rng.Range(-10.0f, 10.0f) };
+        p.velocity = Vector3{ rng.Range(-1.0f, 1.0f), rng.Range(4.0f, 6.0f), rng.Range(-1.0f, 1.0f) };
+        p.life = p.maxLife = rng.Range(0.2f, 2.0f);
+        p.color = initial;
+    }
+
+    vector<Particle> aos;
+    aos.reserve(numParticles);
+    aos.assign(spawns.begin(), spawns.end());
+    double t = GetTime();
+    for (int frame = 0; frame < numFrames; frame++) {
+        for (auto& particle : aos) {
+            particle.position.x += particle.velocity.x * dt;
+            particle.position.y += particle.velocity.y * dt;
+            particle.position.z += particle.velocity.z * dt;
+            particle.velocity.y += acceleration.y * dt;
+            particle.life -= dt;
+            float lifeRatio = particle.life / particle.maxLife;
+            particle.color.a = static_cast<unsigned char>(255 * lifeRatio);
+            particle.color.r = static_cast<unsigned char>(initial.r * lifeRatio);
+            particle.color.g = static_cast<unsigned char>(initial.g * lifeRatio);
+            particle.color.b = static_cast<unsigned char>(initial.b * lifeRatio);
+        }
+        aos.erase(std::remove_if(aos.begin(), aos.end(), [](const Particle& p) { return p.life <= 0; }), aos.end());
+        for (size_t i = aos.size(); i < (size_t)numParticles; i++)
+            aos.push_back(spawns[i]);
+    }
+    double aosTime = GetTime() - t;
+
+    ParticleBuffer soa;
+    soa.Reserve(numParticles);
+    for (const auto& p : spawns)
+        soa.Add(p.position, p.velocity, p.maxLife, p.color);
+    t = GetTime();
+    for (int frame = 0; frame < numFrames; frame++) {
+        soa.Integrate(dt, acceleration);
+        soa.FadeColors(initial);
+        soa.RemoveDead();
+        for (int i = soa.Size(); i < numParticles; i++)
+            soa.Add(spawns[i].position, spawns[i].velocity, spawns[i].maxLife, spawns[i].color);
+    }
+    double soaTime = GetTime() - t;
+
+    float checksum = 0.0f; // printed, so the loops are not optimized away
+    for (const auto& p : aos)
+        checksum += p.position.y;
+    for (int i = 0; i < soa.Size(); i++)
+        checksum += soa.posY[i];
+
+    double updates = (double)numParticles * numFrames;
+    TraceLog(LOG_INFO, "<ParticleComponent.RunSimulationBenchmark> %d particles, %d frames (checksum %.1f)", numParticles, numFrames, checksum);
+    TraceLog(LOG_INFO, "    array of structs: %.2f ms/frame, %.2f ns/particle", aosTime * 1000.0 / numFrames, aosTime * 1e9 / updates);
+    TraceLog(LOG_INFO, "    ParticleBuffer  : %.2f ms/frame, %.2f ns/particle", soaTime * 1000.0 / numFrames, soaTime * 1e9 / updates);
+}
+
 //End of ParticleSystem.cpp
\ No newline at end of file
@@ -3,8 +3,11 @@
 #include <vector>
 
 #include "Knight.h"
+#include "ParticleBuffer.h"
 
-// Struct to represent a particle
+class QuadTreeTerrainComponent;
+
+// Struct to describe a particle when it's emitted, the live ones are kept in a ParticleBuffer
 struct Particle {
     Vector3 position;
     Vector3 velocity;
@@ -17,6 +20,7 @@ class ParticleComponent : public Component
 {
     public:
         ParticleComponent();
+        virtual ~ParticleComponent();
 
         virtual bool CreateFromFile(const char* path, int maxp, Vector3 v, Color ic = WHITE, Vector3 isp = {0,0,0});
         void Update(float ElapsedSeconds, RenderHints* pRH = nullptr) override;
@@ -24,10 +28,39 @@ class ParticleComponent : public Component
 
         virtual void Reset()
         {
-            particles.clear();
+            particles.Clear();
+            pendingSeconds = 0.0f;
+            emitAccumulator = 0.0f;
             currentDelayTime = delayStart;
 		}
 
+        // Particles emitted per second, independent of the frame rate
+        float EmissionRate = 300.0f;
+
+        // Applied to every particle, the default small upward pull makes the sparks fly up
+        Vector3 Acceleration = Vector3{ 0, 0.8f, 0 };
+
+        // Restart the emitter's random sequence, the same seed emits the same particles
+        void SetSeed(unsigned int seed) { random.Seed(seed); }
+
+        int GetNumParticles() const { return particles.Size(); }
+
+        // Ground collision against the heightfield of a terrain, off without a terrain
+        eParticleCollision Collision = PARTICLE_COLLISION_NONE;
+        float Restitution = 0.4f;   // vertical speed kept by a bounce
+        float Friction = 0.7f;      // horizontal speed kept by a bounce
+        void SetCollisionTerrain(QuadTreeTerrainComponent* pTerrain);
+
+        // Draw the particles back to front if the blend mode depends on the order
+        bool DepthSort = true;
+        bool NeedsDepthSort() const;
+
+        // Whether new particles are emitted, the live ones are simulated either way
+        virtual bool IsEmitting() const { return true; }
+
+        // Log the cost of the old array of structs update against ParticleBuffer, see BonusGameWorld02 -benchmark
+        static void RunSimulationBenchmark(int numParticles = 100000);
+
     protected:
         int maxParticles = 500;
         Vector3 offset = Vector3{ 0,0,0 };
@@ -35,11 +68,36 @@ class ParticleComponent : public Component
         Color initialColor = Color{255,255,255,255};
         Vector3 initialSpeed = Vector3{0,0,0};
         Texture2D texture = { 0 };
-        std::vector<Particle> particles;
+        ParticleBuffer particles;
+        ParticleRandom random;
+        float emitAccumulator = 0.0f;
+        float particleSize = 1.0f;
+        QuadTreeTerrainComponent* collisionTerrain = nullptr;
+        vector<float> groundHeights;    // terrain height under every particle, CollideParticles scratch
 
         float currentDelayTime = -1;
 
+        // Simulation handed to the ParticleSystemManager
+        unsigned int emitterIndex = 0;  // spreads the LOD steps of the emitters over the frames
+        float pendingSeconds = 0.0f;    // elapsed time not simulated yet
+        bool queued = false;
+
+        // Integrate, collide, fade and remove the dead particles
+        void SimulateParticles(float deltaTime);
+        // Ground collision of the particles [begin, end), begin a multiple of 4
+        void CollideParticles(int begin, int end);
+        // Back to front order for the camera at eye looking along viewDir
+        void SortParticles(Vector3 eye, Vector3 viewDir);
+        // Number of particles due this frame at EmissionRate
+        int GetNumToEmit(float deltaTime);
+        bool AddParticle(const Particle& particle);
+        // Hand the particles to the ParticleRenderBatcher, or draw them one billboard each without it
+        void DrawParticles();
+
+        // Called on a job thread by the ParticleSystemManager, must not touch raylib state
         virtual void EmitParticles(float deltaTime);
+
+        friend class ParticleSystemManager;
 };
 
 //End of ParticleSyste.h
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "ParticleRenderBatcher.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+
+ParticleRenderBatcher& ParticleRenderBatcher::Instance()
+{
+    static ParticleRenderBatcher batcher;
+    return batcher;
+}
+
+bool ParticleRenderBatcher::Create()
+{
+    return quads.Create();
+}
+
+void ParticleRenderBatcher::Release()
+{
+    submissions.clear();
+    quads.Release();
+}
+
+void ParticleRenderBatcher::Submit(Texture2D texture, BlendMode blendMode, const ParticleBuffer& particles, float size, const int* pOrder)
+{
+    if (particles.Size() == 0 || texture.id == 0)
+        return;
+    submissions.push_back(Submission{ texture, blendMode, &particles, size, pOrder });
+}
+
+// additive and multiplied emitters give the same result in any order among themselves,
+// the other modes have to be drawn back to front as the alpha queue submitted them
+static bool IsOrderIndependent(BlendMode blendMode)
+{
+    switch (blendMode) {
+    case BLEND_ADDITIVE:
+    case BLEND_MULTIPLIED:
+    case BLEND_ADD_COLORS:
+    case BLEND_SUBTRACT_COLORS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// <summary>
+/// Flush - Draw the submitted particles in the order they were queued, merging consecutive submissions
+/// with the same blend mode and texture into one batch. Only a run of emitters sharing an order independent
+/// blend mode is regrouped by texture, so alpha blended emitters keep the back to front order of the queue.
+/// The quads are upright and turned to the camera like raylib's DrawBillboard.
+/// </summary>
+/// <param name="camera">The camera the pass renders with</param>
+void ParticleRenderBatcher::Flush(const Camera3D& camera)
+{
+    stats = ParticleBatcherStats();
+    if (submissions.empty() || !quads.IsReady()) {
+        submissions.clear();
+        return;
+    }
+
+    size_t runStart = 0;
+    while (runStart < submissions.size()) {
+        size_t runEnd = runStart + 1;
+        BlendMode blendMode = submissions[runStart].blendMode;
+        if (IsOrderIndependent(blendMode)) {
+            while (runEnd < submissions.size() && submissions[runEnd].blendMode == blendMode)
+                runEnd++;
+            std::stable_sort(submissions.begin() + runStart, submissions.begin() + runEnd,
+                [](const Submission& a, const Submission& b) { return a.texture.id < b.texture.id; });
+        }
+        runStart = runEnd;
+    }
+
+    // camera vectors once for every particle of the frame
+    Matrix matView = MatrixLookAt(camera.position, camera.target, camera.up);
+    Vector3 right = { matView.m0, matView.m4, matView.m8 };
+    Vector3 up = { 0.0f, 1.0f, 0.0f };
+
+    rlDisableDepthMask();
+    rlDisableBackfaceCulling();
+
+    size_t first = 0;
+    while (first < submissions.size()) {
+        const Submission& group = submissions[first];
+        size_t last = first;
+
+        BeginBlendMode(group.blendMode);
+        while (last < submissions.size() && submissions[last].blendMode == group.blendMode
+            && submissions[last].texture.id == group.texture.id) {
+            BuildQuads(submissions[last], right, up, group.texture);
+            stats.particlesDrawn += submissions[last].pParticles->Size();
+            last++;
+        }
+        if (quads.Draw(group.texture))
+            stats.drawCalls++;
+        EndBlendMode();
+
+        stats.batchesIssued++;
+        first = last;
+    }
+
+    rlEnableDepthMask();
+    rlEnableBackfaceCulling();
+
+    submissions.clear();
+}
+
+void ParticleRenderBatcher::BuildQuads(const Submission& submission, Vector3 right, Vector3 up, Texture2D texture)
+{
+    const ParticleBuffer& particles = *submission.pParticles;
+    const int* pOrder = submission.pOrder;
+
+    float halfWidth = submission.size * fabsf((float)texture.width / texture.height) * 0.5f;
+    float halfHeight = submission.size * 0.5f;
+    Vector3 rx = Vector3Scale(right, halfWidth);
+    Vector3 uy = Vector3Scale(up, halfHeight);
+
+    // corner offsets from the particle position, counter clockwise from the bottom left
+    Vector3 corners[4] = {
+        Vector3Subtract(Vector3Negate(rx), uy),
+        Vector3Subtract(rx, uy),
+        Vector3Add(rx, uy),
+        Vector3Subtract(uy, rx)
+    };
+    const Vector2 texcoords[4] = { { 0, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 } };
+
+    int i = 0;
+    while (i < particles.Size()) {
+        int room = quads.GetMaxQuads() - quads.GetNumQuads();
+        if (room == 0) {
+            // the group doesn't fit one buffer, it takes another draw call
+            if (quads.Draw(texture))
+                stats.drawCalls++;
+            continue;
+        }
+
+        int count = std::min(room, particles.Size() - i);
+        QuadVertex* pVertex = quads.AddQuads(count);
+        for (int end = i + count; i < end; i++) {
+            int p = pOrder != nullptr ? pOrder[i] : i;
+            float x = particles.posX[p];
+            float y = particles.posY[p];
+            float z = particles.posZ[p];
+            Color c = particles.color[p];
+            for (int k = 0; k < 4; k++, pVertex++) {
+                pVertex->position = Vector3{ x + corners[k].x, y + corners[k].y, z + corners[k].z };
+                pVertex->texcoord = texcoords[k];
+                pVertex->color = c;
+            }
+        }
+    }
+}
+
+//End of ParticleRenderBatcher.cpp
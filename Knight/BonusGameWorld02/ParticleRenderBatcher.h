@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "Knight.h"
+#include "ParticleBuffer.h"
+
+struct ParticleBatcherStats
+{
+    int particlesDrawn = 0;
+    int batchesIssued = 0;     // runs of the same texture and blend mode
+    int drawCalls = 0;         // more than the batches if a group overflows the quad buffer
+};
+
+// Draws the particles of every emitter in the pass with few draw calls: emitters queue their live particles,
+// Flush builds the camera-facing quads with the camera vectors computed once and draws consecutive emitters
+// sharing a texture and blend mode as one batch through a StreamingQuadBuffer. The queue order is kept except
+// among neighbouring emitters with the same additive or multiplied blend mode, which are grouped by texture.
+class ParticleRenderBatcher
+{
+public:
+    static ParticleRenderBatcher& Instance();
+
+    bool Create();
+    void Release();
+    // false before Create or without vertex array objects, emitters draw their own billboards then
+    bool IsReady() const { return Enabled && quads.IsReady(); }
+
+    // Queue the live particles of an emitter, the buffer has to stay untouched until Flush.
+    // pOrder lists the particles in the order to draw them, nullptr keeps the buffer order.
+    void Submit(Texture2D texture, BlendMode blendMode, const ParticleBuffer& particles, float size, const int* pOrder = nullptr);
+
+    // Draw everything submitted, inside BeginMode3D of the camera. Depth writes are off while drawing.
+    void Flush(const Camera3D& camera);
+
+    // Counters of the last Flush
+    const ParticleBatcherStats& GetStats() const { return stats; }
+
+    bool Enabled = true;
+
+protected:
+    struct Submission
+    {
+        Texture2D texture;
+        BlendMode blendMode;
+        const ParticleBuffer* pParticles;
+        float size;
+        const int* pOrder;
+    };
+
+    void BuildQuads(const Submission& submission, Vector3 right, Vector3 up, Texture2D texture);
+
+    vector<Submission> submissions;
+    StreamingQuadBuffer quads;
+    ParticleBatcherStats stats;
+};
+
+//End of ParticleRenderBatcher.h
@@ -0,0 +1,139 @@
+#include "ParticleSystemManager.h"
+#include "ParticleComponent.h"
+
+#include <algorithm>
+
+ParticleSystemManager& ParticleSystemManager::Instance()
+{
+    static ParticleSystemManager manager;
+    return manager;
+}
+
+void ParticleSystemManager::Queue(ParticleComponent* pEmitter, float elapsedSeconds)
+{
+    if (!pEmitter->queued) {
+        queued.push_back(pEmitter);
+        pEmitter->queued = true;
+    }
+    pEmitter->pendingSeconds += elapsedSeconds;
+}
+
+void ParticleSystemManager::Remove(ParticleComponent* pEmitter)
+{
+    queued.erase(std::remove(queued.begin(), queued.end(), pEmitter), queued.end());
+}
+
+/// <summary>
+/// Update - Step the emitters due this frame: integrate, collide and fade their particles in parallel
+/// chunks, then remove the dead particles, emit new ones and sort the alpha blended emitters for the
+/// camera with one job per emitter. Emitters not due keep their elapsed time until their next step.
+/// </summary>
+/// <param name="pCamera">The main camera, nullptr updates every emitter every frame</param>
+void ParticleSystemManager::Update(SceneCamera* pCamera)
+{
+    double t = GetTime();
+    frame++;
+
+    stats = ParticleSystemStats();
+    stats.emittersQueued = (int)queued.size();
+
+    Camera3D* pCamera3D = pCamera != nullptr ? pCamera->GetCamera3D() : nullptr;
+
+    // Integrate needs chunks starting on a group of 4
+    int chunkSize = std::max(4, (ChunkSize + 3) & ~3);
+
+    stepped.clear();
+    chunks.clear();
+    for (ParticleComponent* pEmitter : queued) {
+        pEmitter->queued = false;
+        int interval = GetUpdateInterval(pEmitter, pCamera3D);
+        if ((frame + pEmitter->emitterIndex) % interval != 0) {
+            // keeps its pending time, queued again by its next Update
+            continue;
+        }
+
+        stepped.push_back(pEmitter);
+        int size = pEmitter->particles.Size();
+        for (int begin = 0; begin < size; begin += chunkSize)
+            chunks.push_back(Chunk{ pEmitter, begin, std::min(begin + chunkSize, size) });
+        stats.particles += size;
+    }
+    queued.clear();
+
+    JobSystem& jobs = JobSystem::Instance();
+
+    jobs.ParallelFor((int)chunks.size(), 1, [this](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const Chunk& chunk = chunks[i];
+            ParticleComponent* pEmitter = chunk.pEmitter;
+            pEmitter->particles.Integrate(pEmitter->pendingSeconds, pEmitter->Acceleration, chunk.begin, chunk.end);
+            pEmitter->CollideParticles(chunk.begin, chunk.end);
+            pEmitter->particles.FadeColors(pEmitter->initialColor, chunk.begin, chunk.end);
+        }
+    });
+
+    // the view the particles are drawn from, the camera had its late update already
+    Vector3 eye = { 0 };
+    Vector3 viewDir = { 0, 0, -1 };
+    if (pCamera3D != nullptr) {
+        eye = pCamera3D->position;
+        viewDir = Vector3Normalize(Vector3Subtract(pCamera3D->target, pCamera3D->position));
+    }
+
+    // RemoveDead reorders the whole buffer, so it waits until every chunk of the emitter is integrated
+    jobs.ParallelFor((int)stepped.size(), 1, [this, eye, viewDir, pCamera3D](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            ParticleComponent* pEmitter = stepped[i];
+            pEmitter->particles.RemoveDead();
+            if (pEmitter->IsEmitting())
+                pEmitter->EmitParticles(pEmitter->pendingSeconds);
+            pEmitter->pendingSeconds = 0.0f;
+            if (pCamera3D != nullptr && pEmitter->NeedsDepthSort())
+                pEmitter->SortParticles(eye, viewDir);
+        }
+    });
+
+    for (ParticleComponent* pEmitter : stepped) {
+        if (pCamera3D != nullptr && pEmitter->NeedsDepthSort())
+            stats.particlesSorted += pEmitter->particles.Size();
+    }
+    stats.emittersSimulated = (int)stepped.size();
+    stats.chunks = (int)chunks.size();
+    stats.updateMs = float((GetTime() - t) * 1000.0);
+}
+
+/// <summary>
+/// GetUpdateInterval - Frames between two steps of the emitter. The camera frustum is not extracted
+/// during Update, the emitter is tested against the view cone instead.
+/// </summary>
+/// <param name="pEmitter">The emitter</param>
+/// <param name="pCamera">The main camera</param>
+/// <returns>1 for emitters near and in view, FarUpdateInterval or OffscreenUpdateInterval otherwise</returns>
+int ParticleSystemManager::GetUpdateInterval(ParticleComponent* pEmitter, Camera3D* pCamera)
+{
+    if (pCamera == nullptr)
+        return 1;
+
+    Vector3 toEmitter = Vector3Subtract(pEmitter->_SceneActor->GetWorldPosition(), pCamera->position);
+    float distance = Vector3Length(toEmitter);
+    if (distance <= EmitterRadius)
+        return 1;
+
+    if (pCamera->projection == CAMERA_PERSPECTIVE) {
+        Vector3 forward = Vector3Normalize(Vector3Subtract(pCamera->target, pCamera->position));
+        float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
+        float halfFovY = pCamera->fovy * 0.5f * DEG2RAD;
+        float halfFov = atanf(tanf(halfFovY) * sqrtf(1.0f + aspect * aspect));  // the cone through the screen corners
+
+        float angle = acosf(Clamp(Vector3DotProduct(forward, toEmitter) / distance, -1.0f, 1.0f));
+        float margin = asinf(fminf(EmitterRadius / distance, 1.0f));
+        if (angle - margin > halfFov)
+            return std::max(OffscreenUpdateInterval, 1);
+    }
+
+    if (distance > LodDistance)
+        return std::max(FarUpdateInterval, 1);
+    return 1;
+}
+
+//End of ParticleSystemManager.cpp
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "Knight.h"
+
+class ParticleComponent;
+
+struct ParticleSystemStats
+{
+    int emittersQueued = 0;
+    int emittersSimulated = 0;  // the rest waited for their LOD interval
+    int chunks = 0;
+    int particles = 0;
+    int particlesSorted = 0;
+    float updateMs = 0.0f;
+};
+
+// Simulates every emitter of the frame on the JobSystem. ParticleComponent::Update only queues the
+// emitter with its elapsed time, Update then integrates all queued particles in chunks of ChunkSize
+// in parallel (with the terrain collision) and removes the dead ones, emits and depth sorts per emitter
+// in parallel.
+// Emitters far from the camera or behind it are stepped every few frames with the time they missed.
+// Every emitter has its own random sequence and the chunks only touch their own particles, so the
+// result doesn't depend on the thread count or the order the jobs run in.
+class ParticleSystemManager
+{
+public:
+    static ParticleSystemManager& Instance();
+
+    // Called from ParticleComponent::Update
+    void Queue(ParticleComponent* pEmitter, float elapsedSeconds);
+    // Forget an emitter that is destroyed before the next Update
+    void Remove(ParticleComponent* pEmitter);
+
+    // Simulate the queued emitters, after the scene update. pCamera decides the update rates.
+    void Update(SceneCamera* pCamera);
+
+    const ParticleSystemStats& GetStats() const { return stats; }
+
+    // false simulates every emitter serially in its own Update, as before
+    bool Enabled = true;
+
+    int ChunkSize = 1024;               // particles per job, a multiple of 4
+    float LodDistance = 60.0f;          // beyond this emitters are updated every FarUpdateInterval frames
+    float EmitterRadius = 5.0f;         // margin of the view cone test
+    int FarUpdateInterval = 2;
+    int OffscreenUpdateInterval = 4;
+
+protected:
+    struct Chunk
+    {
+        ParticleComponent* pEmitter;
+        int begin;
+        int end;
+    };
+
+    int GetUpdateInterval(ParticleComponent* pEmitter, Camera3D* pCamera);
+
+    vector<ParticleComponent*> queued;
+    vector<ParticleComponent*> stepped;
+    vector<Chunk> chunks;
+    unsigned int frame = 0;
+    ParticleSystemStats stats;
+};
+
+//End of ParticleSystemManager.h
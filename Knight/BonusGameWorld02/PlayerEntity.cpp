@@ -21,6 +21,7 @@ bool PlayerEntity::Create(Scene* pScene, Entity *pTerrain)
 	ModelComponent* animPlayerComponent = _Actor->CreateAndAddComponent<ModelComponent>();
 	animPlayerComponent->castShadow = Component::eShadowCastingType::Shadow;
 	animPlayerComponent->receiveShadow = true;
+	animPlayerComponent->UseBakedAsset = true;
 	animPlayerComponent->Load3DModel("../../resources/models/gltf/robot.glb");
 	animPlayerComponent->SetAnimationMode(ModelComponent::eAnimMode::Linear_interpolation);
 	animPlayerComponent->SetAnimation(6);
@@ -32,6 +33,12 @@ bool PlayerEntity::Create(Scene* pScene, Entity *pTerrain)
 	//spacial particle effect for blasting magic
 	pAttackEffect = _Actor->CreateAndAddComponent<MagicAttackEffect>();
 	pAttackEffect->CreateFromFile("../../resources/textures/flash00.png", 100, Vector3{ 0.0f,0.5f,0.5f }, WHITE, Vector3{ 0,0,0 });
+	if (pTerrainEntity)
+	{
+		//the blast stops at hills instead of flying through them
+		pAttackEffect->SetCollisionTerrain(pTerrainEntity->_Terrain);
+		pAttackEffect->Collision = PARTICLE_COLLISION_KILL;
+	}
 
 	return true;
 }
@@ -25,15 +25,86 @@ bool PropEntity::Create(Scene* pScene, Entity* pContainer)
 	}
 
 	ModelComponent* modelComponent = _Actor->CreateAndAddComponent<ModelComponent>();
+	modelComponent->OptimizeMeshes = true; //logs the ACMR/ATVR before and after
+	modelComponent->GenerateLODs = true;   //distant castles draw simplified meshes, the shadow pass one level coarser
+	modelComponent->UseBakedAsset = true;  //castle.kna, converted on the first run
 	modelComponent->Load3DModel("../../resources/models/obj/castle.obj", "../../resources/models/obj/castle_diffuse.png");
 	modelComponent->castShadow = Component::eShadowCastingType::Shadow;
 	modelComponent->receiveShadow = true;
+	modelComponent->isStatic = true; //the castle never moves, its shadow is cached
+
+	if (pTerrainEntity != nullptr)
+	{
+		QuadTreeTerrainComponent* tc = pTerrainEntity->_Terrain;
+		CreateVillageProps(pScene, tc, "../../resources/models/obj/house.obj", "../../resources/models/obj/house_diffuse.png", 24, &houseImpostor);
+		CreateVillageProps(pScene, tc, "../../resources/models/obj/turret.obj", "../../resources/models/obj/turret_diffuse.png", 24, &turretImpostor);
+	}
 
 	return true;
 }
 
+/// <summary>
+/// CreateVillageProps - Scatter copies of a model over the terrain. The models are loaded on the worker threads,
+/// the props stand as placeholders until then. The impostor atlas is baked in Update from the first copy and
+/// shared by all of them, beyond the impostor distance a prop costs one quad instead of its meshes.
+/// </summary>
+/// <param name="pScene">The scene to add the props to</param>
+/// <param name="pTerrain">The terrain the props stand on</param>
+/// <param name="modelPath">Model file</param>
+/// <param name="texturePath">Diffuse texture of the model</param>
+/// <param name="count">Number of copies</param>
+/// <param name="pImpostor">The atlas to bake</param>
+/// <returns>False if the model file is missing</returns>
+bool PropEntity::CreateVillageProps(Scene* pScene, QuadTreeTerrainComponent* pTerrain, const char* modelPath, const char* texturePath, int count, ImpostorAtlas* pImpostor)
+{
+	for (int i = 0; i < count; i++)
+	{
+		SceneActor* pProp = pScene->CreateSceneObject<SceneActor>(TextFormat("%s%d", GetFileNameWithoutExt(modelPath), i));
+		pProp->Scale = Vector3{ 0.3f, 0.3f, 0.3f };
+		pProp->Rotation = Vector3{ 0, (float)GetRandomValue(0, 359), 0 };
+		pProp->Position = Vector3{ (float)GetRandomValue(-128, 128), 0, (float)GetRandomValue(-128, 128) };
+		pProp->Position.y = pTerrain->GetTerrainY(pProp->Position.x, pProp->Position.z);
+
+		ModelComponent* pModel = pProp->CreateAndAddComponent<ModelComponent>();
+		pModel->GenerateLODs = true;
+		pModel->UseBakedAsset = true;
+		pModel->Load3DModelAsync(modelPath, texturePath);
+		if (!pModel->IsLoading())
+		{
+			TraceLog(LOG_WARNING, "<PropEntity.CreateVillageProps> Failed to load %s", modelPath);
+			return false;
+		}
+		pModel->castShadow = Component::eShadowCastingType::Shadow;
+		pModel->receiveShadow = true;
+		pModel->isStatic = true;
+
+		//the impostor is skipped until it is baked
+		if (i == 0)
+			pendingImpostors.push_back(make_pair(pModel, pImpostor));
+		pModel->Impostor = pImpostor;
+		pModel->ImpostorDistance = 60.0f;
+		pModel->ImpostorFadeRange = 6.0f;
+	}
+	return true;
+}
+
 void PropEntity::Update(float elapsedTime)
 {
+	for (auto it = pendingImpostors.begin(); it != pendingImpostors.end(); )
+	{
+		ModelComponent* pModel = it->first;
+		if (pModel->IsLoading())
+		{
+			++it;
+			continue;
+		}
+
+		if (pModel->GetModel()->meshCount > 0)
+			it->second->Bake(*pModel->GetModel(), pModel->GetBoundingBox());
+		else
+			TraceLog(LOG_WARNING, "<PropEntity.Update> A village prop failed to load, no impostor");
+		it = pendingImpostors.erase(it);
+	}
 }
 
 //End of PropEntity.cpp
\ No newline at end of file
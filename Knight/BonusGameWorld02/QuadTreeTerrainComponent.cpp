@@ -1,5 +1,7 @@
 #include "QuadTreeTerrainComponent.h"
 #include "KnightUtils.h"
+#include "JobSystem.h"
+#include <algorithm>
 
 QuadTreeTerrainComponent::QuadTreeTerrainComponent()
 {
@@ -14,6 +16,8 @@ QuadTreeTerrainComponent::~QuadTreeTerrainComponent()
         delete rootNode; // Recursively deletes all nodes
     rootNode = nullptr;
     heightmap.clear(); // Clear heightmap data
+    delete tileStream; // Waits for the tile loads in flight
+    tileStream = nullptr;
     if (terrainTexture.id != 0) { // Unload texture if it was loaded
         UnloadTexture(terrainTexture);
     }
@@ -29,11 +33,54 @@ QuadTreeTerrainComponent::~QuadTreeTerrainComponent()
 /// <returns></returns>
 bool QuadTreeTerrainComponent::CreateFromFile(Vector3 dimension, Vector2 texTileSize, const char* pHightmapFilePath, const char* pTerrainTexurePath)
 {
+    // The normals are computed while loading and need the world space dimension
+    terrainDimension = dimension;
+
 	// Load heightmap data from image.also set HeightMapWidth and terrainMapHeight
     if (!LoadHeightmapFromImage(pHightmapFilePath)) {
         return false;
     }
 
+    if (CompactStorage) {
+        BuildCompactStorage();
+    }
+
+    return CreateTerrain(dimension, texTileSize, pTerrainTexurePath);
+}
+
+/// <summary>
+/// CreateFromTiledFile - Open a tiled 16-bit height file (see TerrainTileStream) and initialize terrain and quadtree.
+/// Only the tiles around the camera are kept in memory, they are paged in on worker threads.
+/// </summary>
+/// <param name="dimension">The world space coordinate of the dimension</param>
+/// <param name="texTileSize">The tile size in the world space coordinate.</param>
+/// <param name="pTiledHightmapFilePath">The tiled height file path.</param>
+/// <param name="pTerrainTexurePath">The default Terrain texture</param>
+/// <param name="memoryBudget">Maximum bytes of resident height tiles.</param>
+/// <returns></returns>
+bool QuadTreeTerrainComponent::CreateFromTiledFile(Vector3 dimension, Vector2 texTileSize, const char* pTiledHightmapFilePath, const char* pTerrainTexurePath, size_t memoryBudget)
+{
+    tileStream = new TerrainTileStream();
+    if (!tileStream->Open(pTiledHightmapFilePath, dimension, memoryBudget)) {
+        delete tileStream;
+        tileStream = nullptr;
+        return false;
+    }
+    HeightMapWidth = tileStream->GetWidth();
+    HeightMapDepth = tileStream->GetDepth();
+
+    return CreateTerrain(dimension, texTileSize, pTerrainTexurePath);
+}
+
+/// <summary>
+/// CreateTerrain - Set up scale, texture, quadtree and material once the heightmap source is ready
+/// </summary>
+/// <param name="dimension">The world space coordinate of the dimension</param>
+/// <param name="texTileSize">The tile size in the world space coordinate.</param>
+/// <param name="pTerrainTexurePath">The default Terrain texture</param>
+/// <returns></returns>
+bool QuadTreeTerrainComponent::CreateTerrain(Vector3 dimension, Vector2 texTileSize, const char* pTerrainTexurePath)
+{
     //update terrain scale based on speficied terrain dimension
     terrainDimension = dimension;
     terrainScale.x = terrainDimension.x / HeightMapWidth; // X-axis scale
@@ -64,12 +111,14 @@ bool QuadTreeTerrainComponent::CreateFromFile(Vector3 dimension, Vector2 texTile
     // Create and build the Quadtree root node
     rootNode = new QuadTreeNode(terrainOverallBounds, 0);
     BuildQuadtreeNode(rootNode);
+    UpdateNodeHeightBounds(rootNode);
 
     LocalBoundingBox = rootNode->bounds;
 
     //Create default material
 	materials = new Material[1];
 	materials[0] = LoadMaterialDefault(); // Load default material
+	materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = terrainTexture; // Chunk meshes are drawn with this material
 	NumMaterial = 1; // Set number of materials
 
 	return true;
@@ -88,6 +137,32 @@ void QuadTreeTerrainComponent::Update(float ElapsedSeconds, RenderHints* pRH)
         DebugShowBounds = !DebugShowBounds; // Toggle bounding box visibility
     }
 
+    frameCounter++;
+
+    // Drop the changes every reader had a whole frame to see
+    size_t expired = 0;
+    while (expired < heightChanges.size() && heightChanges[expired].frame + 2 <= frameCounter)
+        expired++;
+    heightChanges.erase(heightChanges.begin(), heightChanges.begin() + expired);
+
+    // Page height tiles in and out around the main camera
+    if (tileStream != nullptr && _SceneActor->GetMainCamera() != nullptr) {
+        Vector3 cameraPos = _SceneActor->GetMainCamera()->GetCamera3D()->position;
+        int focusX = (int)((cameraPos.x + terrainDimension.x / 2.0f) / terrainScale.x);
+        int focusZ = (int)((cameraPos.z + terrainDimension.z / 2.0f) / terrainScale.z);
+        tileStream->Update(focusX, focusZ, (int)(StreamingRadius / std::min(terrainScale.x, terrainScale.z)));
+
+        // Chunks over a tile which was paged in or out were built from the other resolution, rebuild them
+        for (int tileIndex : tileStream->GetChangedTiles()) {
+            int x0, z0, x1, z1;
+            tileStream->GetTileRect(tileIndex, x0, z0, x1, z1);
+            UpdateNodesInRect(rootNode, x0 - 1, z0 - 1, x1 + 1, z1 + 1, false);
+            RecordHeightChange(x0 - 1, z0 - 1, x1 + 1, z1 + 1);
+        }
+    }
+
+    ReleaseUnusedChunks();
+
 }
 
 /// <summary>
@@ -109,21 +184,16 @@ void QuadTreeTerrainComponent::Draw(RenderHints *pRH)
     pCam->ExtractFrustumPlanes(frustumPlanes);
     GatherNodesToDraw(rootNode, pCam, frustumPlanes);
 
+    // Chunks are drawn with DrawMesh, which binds the material's shader, so an override shader goes into the material
+    Shader materialShader = materials[0].shader;
     if (pRH != nullptr && pRH->pOverrideShader != nullptr) {
-		BeginShaderMode(*pRH->pOverrideShader); // Use the provided shader
-        for (int i = 0; i < nodesToDraw.size(); i++) {
-            DrawTerrainChunk(nodesToDraw[i]);
-        }
-		//printf("\n");
-        //DrawQuadtreeNode(rootNode, _SceneActor->GetMainCamera(), DebugShowBounds, frustumPlanes);
-		EndShaderMode(); // End shader mode
+        materials[0].shader = *pRH->pOverrideShader; // Use the provided shader
     }
-    else 
-    {
-        //DrawQuadtreeNode(rootNode, _SceneActor->GetMainCamera(), DebugShowBounds, frustumPlanes); */
-        for (int i = 0; i < nodesToDraw.size(); i++)
-            DrawTerrainChunk(nodesToDraw[i]);
+    for (int i = 0; i < nodesToDraw.size(); i++) {
+        DrawTerrainChunk(nodesToDraw[i]);
     }
+    materials[0].shader = materialShader;
+    //DrawQuadtreeNode(rootNode, _SceneActor->GetMainCamera(), DebugShowBounds, frustumPlanes);
 
 }
 
@@ -138,6 +208,12 @@ float QuadTreeTerrainComponent::GetHeightmapValue(int x, int z)
     if (z < 0) z = 0;
     if (z >= HeightMapDepth) z = HeightMapDepth - 1;
 
+    if (tileStream != nullptr)
+        return tileStream->GetHeight(x, z);
+
+    if (!compactHeights.empty())
+        return heightOffset + compactHeights[z * HeightMapWidth + x] * heightStep;
+
     return heightmap[z * HeightMapWidth + x];
 }
 
@@ -188,6 +264,111 @@ float QuadTreeTerrainComponent::GetTerrainY(float x, float z)
 	//return GetHeightmapValue(mapX, mapZ) * terrainScale.y; // Scale by Y-axis terrain scale
 }
 
+// Height inside a quad from its corners h0 = (0,0), h1 = (1,0), h2 = (0,1), h3 = (1,1), the quad is split
+// along the diagonal from (0,0) to (1,1)
+static inline float GetTriangleHeight(float h0, float h1, float h2, float h3, float fx, float fz)
+{
+    return (fz >= fx) ? h0 + (h3 - h2) * fx + (h2 - h0) * fz
+                      : h0 + (h1 - h0) * fx + (h3 - h1) * fz;
+}
+
+/// <summary>
+/// GetTerrainYBatch - Terrain height under many points, the same triangles as GetTerrainY. The grid transform
+/// is set up once, the height comes from the plane of the triangle instead of a point in triangle test,
+/// and the plain heightmap is read directly. It writes nothing, so the jobs of a ParallelFor may call it while
+/// the main thread waits for them. It is not safe against the main thread: Update publishes and evicts the
+/// streamed tiles and the editing functions rewrite the heights, so asynchronous jobs sample a CopyPatch.
+/// </summary>
+/// <param name="x">World x of the points</param>
+/// <param name="z">World z of the points</param>
+/// <param name="y">Receives the world height of the terrain under each point</param>
+/// <param name="count">Number of points</param>
+void QuadTreeTerrainComponent::GetTerrainYBatch(const float* x, const float* z, float* y, int count)
+{
+    const float originX = -terrainDimension.x / 2.0f;
+    const float originZ = -terrainDimension.z / 2.0f;
+    const float invScaleX = 1.0f / terrainScale.x;
+    const float invScaleZ = 1.0f / terrainScale.z;
+    const float scaleY = terrainScale.y;
+    const int maxX = HeightMapWidth - 1;
+    const int maxZ = HeightMapDepth - 1;
+
+    if (HeightMapWidth == 0 || HeightMapDepth == 0) {
+        std::fill(y, y + count, 0.0f);
+        return;
+    }
+
+    // the compact and tiled storages decode per sample
+    const float* pHeights = (tileStream == nullptr && compactHeights.empty()) ? heightmap.data() : nullptr;
+
+    for (int i = 0; i < count; i++) {
+        float gx = (x[i] - originX) * invScaleX;
+        float gz = (z[i] - originZ) * invScaleZ;
+        int mapX = (int)floorf(gx);
+        int mapZ = (int)floorf(gz);
+        float fx = gx - mapX;
+        float fz = gz - mapZ;
+
+        float h0, h1, h2, h3;
+        if (pHeights != nullptr) {
+            int x0 = std::min(std::max(mapX, 0), maxX);
+            int x1 = std::min(std::max(mapX + 1, 0), maxX);
+            int z0 = std::min(std::max(mapZ, 0), maxZ) * HeightMapWidth;
+            int z1 = std::min(std::max(mapZ + 1, 0), maxZ) * HeightMapWidth;
+            h0 = pHeights[z0 + x0];
+            h1 = pHeights[z0 + x1];
+            h2 = pHeights[z1 + x0];
+            h3 = pHeights[z1 + x1];
+        }
+        else {
+            h0 = GetHeightmapValue(mapX, mapZ);
+            h1 = GetHeightmapValue(mapX + 1, mapZ);
+            h2 = GetHeightmapValue(mapX, mapZ + 1);
+            h3 = GetHeightmapValue(mapX + 1, mapZ + 1);
+        }
+
+        y[i] = GetTriangleHeight(h0, h1, h2, h3, fx, fz) * scaleY;
+    }
+}
+
+/// <summary>
+/// TerrainPatch::GetTerrainYBatch - QuadTreeTerrainComponent::GetTerrainYBatch on the copied samples
+/// </summary>
+void TerrainPatch::GetTerrainYBatch(const float* x, const float* z, float* y, int count) const
+{
+    if (width == 0 || depth == 0) {
+        std::fill(y, y + count, 0.0f);
+        return;
+    }
+
+    const int maxX = width - 1;
+    const int maxZ = depth - 1;
+    for (int i = 0; i < count; i++) {
+        float gx = (x[i] - originX) * invScaleX;
+        float gz = (z[i] - originZ) * invScaleZ;
+        int mapX = (int)floorf(gx);
+        int mapZ = (int)floorf(gz);
+
+        int px0 = std::min(std::max(mapX - x0, 0), maxX);
+        int px1 = std::min(std::max(mapX + 1 - x0, 0), maxX);
+        int pz0 = std::min(std::max(mapZ - z0, 0), maxZ) * width;
+        int pz1 = std::min(std::max(mapZ + 1 - z0, 0), maxZ) * width;
+        y[i] = GetTriangleHeight(heights[pz0 + px0], heights[pz0 + px1], heights[pz1 + px0], heights[pz1 + px1],
+            gx - mapX, gz - mapZ) * scaleY;
+    }
+}
+
+// QuadTreeTerrainComponent::GetTerrainNormal on the copied samples
+Vector3 TerrainPatch::GetTerrainNormal(float x, float z) const
+{
+    if (width == 0 || depth == 0)
+        return Vector3{ 0.0f, 1.0f, 0.0f };
+
+    int px = std::min(std::max((int)floorf((x - originX) * invScaleX + 0.5f) - x0, 0), width - 1);
+    int pz = std::min(std::max((int)floorf((z - originZ) * invScaleZ + 0.5f) - z0, 0), depth - 1);
+    return normals[pz * width + px];
+}
+
 /// <summary>
 /// GetTerrainYForBoundingBox - Get the terrain height for a bounding box by sampling its corners and interpolating
 /// </summary>
@@ -215,20 +396,24 @@ float QuadTreeTerrainComponent::GetTerrainYForBoundingBox(BoundingBox box, float
 	return Lerp(minh, maxh, weight); 
 }
 
-// Load heightmap data from a grayscale image
+// Load heightmap data from a grayscale image.
+// Decoding, normals and the min/max pyramid are computed in row batches on the JobSystem.
 bool QuadTreeTerrainComponent::LoadHeightmapFromImage(const char* fileName)
 {
-    vector<unsigned int> outIndices;
-	vector<Vector3> outVertices; 
-
     if (!FileExists(fileName)) {
         return false;
     }
 
+    double startTime = GetTime();
     Image image = LoadImage(fileName);
     if (image.data == nullptr) { // Check if image loading failed
         return false;
     }
+    double loadTime = GetTime();
+
+    // Convert to 8-bit grayscale once, so the pixels can be read directly instead of through GetImageColor
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+    const unsigned char* pPixels = (const unsigned char*)image.data;
 
     // Store actual dimensions from the loaded image
     HeightMapWidth = image.width;
@@ -236,81 +421,322 @@ bool QuadTreeTerrainComponent::LoadHeightmapFromImage(const char* fileName)
     heightmap.resize(HeightMapWidth * HeightMapDepth);
     heightMapNormals.resize(HeightMapWidth * HeightMapDepth);
 
-	outVertices.resize(HeightMapWidth * HeightMapDepth);
+    JobSystem& jobs = JobSystem::Instance();
+    const int width = HeightMapWidth;
+    const int depth = HeightMapDepth;
 
     //build height map
-    for (int z = 0; z < HeightMapDepth; ++z) {
-        for (int x = 0; x < HeightMapWidth; ++x) {
-            Color pixelColor = GetImageColor(image, x, z);
-            // For grayscale, R, G, and B components are usually the same.
-            // We normalize the R component (0-255) to a float (0.0-1.0).
-            heightmap[z * HeightMapWidth + x] = (float)pixelColor.r / 255.0f;
-        }
-    }
-
-    // Build vertex positions
-    heightMapNormals.assign(HeightMapWidth * HeightMapDepth, { 0,0,0 });
-
-    for (int z = 0; z < HeightMapDepth; ++z) {
-        for (int x = 0; x < HeightMapWidth; ++x) {
-            float y = heightmap[z * HeightMapWidth + x];
-            outVertices[z * HeightMapWidth + x] = { (float)x, y, (float)z };
+    jobs.ParallelFor(depth, HEIGHTMAP_ROWS_PER_JOB, [this, pPixels, width](int beginZ, int endZ) {
+        const float toHeight = 1.0f / 255.0f;
+        for (int i = beginZ * width; i < endZ * width; ++i) {
+            heightmap[i] = pPixels[i] * toHeight;
         }
-    }
+    });
+    double decodeTime = GetTime();
 
     // To achieve smooth lighting for height - mapped terrain, the key concept is: using vertex normals. 
     // Instead of calculating normals per face(or per pixel), you calculate per - vertex normals by averaging normals of adjacent faces.
     // This ensures gradual lighting transitions, removing harsh shading.
-    for (int z = 0; z < HeightMapDepth; ++z) {
-        for (int x = 0; x < HeightMapWidth; ++x) {
-            Vector3 normal = { 0, 0, 0 };
-
-            Vector3 currentPos = {
-                (x - HeightMapWidth / 2) * terrainScale.x,
-                GetHeightmapValue(x, z) * terrainScale.y,
-                (z - HeightMapDepth / 2) * terrainScale.z
-            };
-
-            // Check and average normals of surrounding triangles
-            const int offsets[4][2] = { {-1,0}, {1,0}, {0,-1}, {0,1} };
-            for (auto& offset : offsets) {
-                int nx = x + offset[0];
-                int nz = z + offset[1];
-
-                if (nx < 0 || nz < 0 || nx >= HeightMapWidth || nz >= HeightMapDepth)
-                    continue;
+    // Interior samples read their neighbours directly, only the border rows and columns need the bounds checks.
+    Vector3 sampleScale = { terrainDimension.x / width, terrainDimension.y, terrainDimension.z / depth };
+    jobs.ParallelFor(depth, HEIGHTMAP_ROWS_PER_JOB, [this, width, depth, sampleScale](int beginZ, int endZ) {
+        for (int z = beginZ; z < endZ; ++z) {
+            const float* pRow = &heightmap[z * width];
+            for (int x = 0; x < width; ++x) {
+                float neighbours[4];
+                bool valid[4] = { x > 0, x < width - 1, z > 0, z < depth - 1 };
+                neighbours[0] = valid[0] ? pRow[x - 1] * sampleScale.y : 0.0f;
+                neighbours[1] = valid[1] ? pRow[x + 1] * sampleScale.y : 0.0f;
+                neighbours[2] = valid[2] ? pRow[x - width] * sampleScale.y : 0.0f;
+                neighbours[3] = valid[3] ? pRow[x + width] * sampleScale.y : 0.0f;
+                heightMapNormals[z * width + x] = TerrainTileStream::ComputeNormal(pRow[x] * sampleScale.y, neighbours, valid, sampleScale);
+            }
+        }
+    });
+    double normalTime = GetTime();
 
-                Vector3 neighborPos = {
-                    (nx - HeightMapWidth / 2) * terrainScale.x,
-                    GetHeightmapValue(nx, nz) * terrainScale.y,
-                    (nz - HeightMapDepth / 2) * terrainScale.z
-                };
+    BuildHeightRangePyramid();
+    double pyramidTime = GetTime();
 
-                Vector3 edge = Vector3Subtract(neighborPos, currentPos);
+    UnloadImage(image); // Free image data from RAM
 
-                int nx2 = x + offset[1];
-                int nz2 = z - offset[0];
+    TraceLog(LOG_INFO, "<QuadTreeTerrainComponent.LoadHeightmapFromImage> %dx%d on %d threads: load %.1f ms, decode %.1f ms, normals %.1f ms, min/max pyramid %.1f ms, total %.1f ms",
+        width, depth, jobs.GetNumThreads(), (loadTime - startTime) * 1000, (decodeTime - loadTime) * 1000, (normalTime - decodeTime) * 1000,
+        (pyramidTime - normalTime) * 1000, (GetTime() - startTime) * 1000);
+    return true;
+}
 
-                if (nx2 < 0 || nz2 < 0 || nx2 >= HeightMapWidth || nz2 >= HeightMapDepth)
-                    continue;
+/// <summary>
+/// BuildHeightRangePyramid - Build the min/max height pyramid. Level 0 stores the height range of every
+/// HEIGHT_RANGE_BLOCK_SIZE block of quads (including the samples shared with the next block), each
+/// further level merges 2x2 entries of the level below.
+/// </summary>
+void QuadTreeTerrainComponent::BuildHeightRangePyramid()
+{
+    heightRangePyramid.clear();
+    if (HeightMapWidth == 0 || HeightMapDepth == 0)
+        return;
+
+    HeightRangeLevel level0;
+    level0.blockSize = HEIGHT_RANGE_BLOCK_SIZE;
+    level0.width = (HeightMapWidth + HEIGHT_RANGE_BLOCK_SIZE - 1) / HEIGHT_RANGE_BLOCK_SIZE;
+    level0.depth = (HeightMapDepth + HEIGHT_RANGE_BLOCK_SIZE - 1) / HEIGHT_RANGE_BLOCK_SIZE;
+    level0.minMax.resize(level0.width * level0.depth);
+    heightRangePyramid.push_back(level0);
 
-                Vector3 neighborPos2 = {
-                    (nx2 - HeightMapWidth / 2) * terrainScale.x,
-                    GetHeightmapValue(nx2, nz2) * terrainScale.y,
-                    (nz2 - HeightMapDepth / 2) * terrainScale.z
-                };
+    UpdateHeightRangePyramid(0, 0, HeightMapWidth - 1, HeightMapDepth - 1);
+}
 
-                Vector3 edge2 = Vector3Subtract(neighborPos2, currentPos);
+/// <summary>
+/// UpdateHeightRangePyramid - Recompute the pyramid entries covering the sample rectangle [x0,x1] x [z0,z1].
+/// Level 0 is scanned from the heightmap in parallel, the upper levels are merged from the level below.
+/// </summary>
+void QuadTreeTerrainComponent::UpdateHeightRangePyramid(int x0, int z0, int x1, int z1)
+{
+    if (heightRangePyramid.empty())
+        return;
 
-                normal = Vector3Add(normal, Vector3CrossProduct(edge, edge2));
+    // a sample on a block edge also belongs to the previous block
+    int bx0 = std::max(0, (x0 - 1) / HEIGHT_RANGE_BLOCK_SIZE);
+    int bz0 = std::max(0, (z0 - 1) / HEIGHT_RANGE_BLOCK_SIZE);
+    int bx1 = std::min(heightRangePyramid[0].width - 1, x1 / HEIGHT_RANGE_BLOCK_SIZE);
+    int bz1 = std::min(heightRangePyramid[0].depth - 1, z1 / HEIGHT_RANGE_BLOCK_SIZE);
+
+    HeightRangeLevel& level0 = heightRangePyramid[0];
+    JobSystem::Instance().ParallelFor(bz1 - bz0 + 1, 4, [this, &level0, bx0, bx1, bz0](int begin, int end) {
+        for (int bz = bz0 + begin; bz < bz0 + end; bz++) {
+            for (int bx = bx0; bx <= bx1; bx++) {
+                int sx1 = std::min((bx + 1) * HEIGHT_RANGE_BLOCK_SIZE, HeightMapWidth - 1);
+                int sz1 = std::min((bz + 1) * HEIGHT_RANGE_BLOCK_SIZE, HeightMapDepth - 1);
+                float minHeight = FLT_MAX;
+                float maxHeight = -FLT_MAX;
+                for (int z = bz * HEIGHT_RANGE_BLOCK_SIZE; z <= sz1; z++) {
+                    for (int x = bx * HEIGHT_RANGE_BLOCK_SIZE; x <= sx1; x++) {
+                        float h = GetHeightmapValue(x, z);
+                        minHeight = std::min(minHeight, h);
+                        maxHeight = std::max(maxHeight, h);
+                    }
+                }
+                level0.minMax[bz * level0.width + bx] = Vector2{ minHeight, maxHeight };
             }
+        }
+    });
+
+    // merge 2x2 entries into the next level until a single entry is left
+    for (size_t l = 1; ; l++) {
+        int belowWidth = heightRangePyramid[l - 1].width;
+        int belowDepth = heightRangePyramid[l - 1].depth;
+        if (belowWidth == 1 && belowDepth == 1)
+            break;
+
+        if (l == heightRangePyramid.size()) {
+            HeightRangeLevel level;
+            level.blockSize = heightRangePyramid[l - 1].blockSize * 2;
+            level.width = (belowWidth + 1) / 2;
+            level.depth = (belowDepth + 1) / 2;
+            level.minMax.resize(level.width * level.depth);
+            heightRangePyramid.push_back(level);
+            bx0 = 0; bz0 = 0; bx1 = belowWidth - 1; bz1 = belowDepth - 1; // new level, fill all of it
+        }
 
-            heightMapNormals[z * HeightMapWidth + x] = Vector3Normalize(normal);
+        HeightRangeLevel& lower = heightRangePyramid[l - 1];
+        HeightRangeLevel& level = heightRangePyramid[l];
+        bx0 /= 2; bz0 /= 2; bx1 = std::min(bx1 / 2, level.width - 1); bz1 = std::min(bz1 / 2, level.depth - 1);
+        for (int bz = bz0; bz <= bz1; bz++) {
+            for (int bx = bx0; bx <= bx1; bx++) {
+                Vector2 range = { FLT_MAX, -FLT_MAX };
+                for (int cz = bz * 2; cz <= std::min(bz * 2 + 1, lower.depth - 1); cz++) {
+                    for (int cx = bx * 2; cx <= std::min(bx * 2 + 1, lower.width - 1); cx++) {
+                        Vector2 child = lower.minMax[cz * lower.width + cx];
+                        range.x = std::min(range.x, child.x);
+                        range.y = std::max(range.y, child.y);
+                    }
+                }
+                level.minMax[bz * level.width + bx] = range;
+            }
         }
     }
-    
-    UnloadImage(image); // Free image data from RAM
-    return true;
+}
+
+/// <summary>
+/// GetHeightRange - Normalized height range of the quads in the sample rectangle [x0,x1] x [z0,z1]
+/// </summary>
+/// <param name="x0">First sample x</param>
+/// <param name="z0">First sample z</param>
+/// <param name="x1">Last sample x</param>
+/// <param name="z1">Last sample z</param>
+/// <param name="minHeight">Returns the lowest height</param>
+/// <param name="maxHeight">Returns the highest height</param>
+void QuadTreeTerrainComponent::GetHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight)
+{
+    if (tileStream != nullptr) {
+        tileStream->GetHeightRange(x0, z0, x1, z1, minHeight, maxHeight);
+        return;
+    }
+
+    minHeight = 0.0f;
+    maxHeight = 1.0f;
+    if (heightRangePyramid.empty())
+        return;
+
+    // use the coarsest level which still has at least 2 entries across the rectangle
+    int extent = std::max(x1 - x0, z1 - z0);
+    size_t l = 0;
+    while (l + 1 < heightRangePyramid.size() && heightRangePyramid[l + 1].blockSize * 2 <= extent)
+        l++;
+
+    const HeightRangeLevel& level = heightRangePyramid[l];
+    int bx0 = std::min(std::max(x0 / level.blockSize, 0), level.width - 1);
+    int bz0 = std::min(std::max(z0 / level.blockSize, 0), level.depth - 1);
+    int bx1 = std::min(std::max((x1 - 1) / level.blockSize, 0), level.width - 1);
+    int bz1 = std::min(std::max((z1 - 1) / level.blockSize, 0), level.depth - 1);
+
+    minHeight = FLT_MAX;
+    maxHeight = -FLT_MAX;
+    for (int bz = bz0; bz <= bz1; bz++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            Vector2 range = level.minMax[bz * level.width + bx];
+            minHeight = std::min(minHeight, range.x);
+            maxHeight = std::max(maxHeight, range.y);
+        }
+    }
+}
+
+/// <summary>
+/// BuildCompactStorage - Quantize the loaded heights to uint16 over their actual range and pack the
+/// normals into 4 byte octahedral encodings, then release the float arrays.
+/// 16 bytes per sample become 6, the accessors decode on the fly.
+/// </summary>
+void QuadTreeTerrainComponent::BuildCompactStorage()
+{
+    if (heightmap.empty())
+        return;
+
+    auto range = std::minmax_element(heightmap.begin(), heightmap.end());
+    heightOffset = *range.first;
+    heightStep = std::max(*range.second - *range.first, 1e-6f) / 65535.0f;
+
+    size_t numSamples = heightmap.size();
+    compactHeights.resize(numSamples);
+    compactNormals.resize(numSamples);
+
+    float maxHeightError = 0.0f;
+    float minNormalDot = 1.0f;
+    mutex errorLock;
+    JobSystem::Instance().ParallelFor(HeightMapDepth, HEIGHTMAP_ROWS_PER_JOB, [&](int beginZ, int endZ) {
+        float batchHeightError = 0.0f;
+        float batchNormalDot = 1.0f;
+        for (size_t i = (size_t)beginZ * HeightMapWidth; i < (size_t)endZ * HeightMapWidth; i++) {
+            compactHeights[i] = (unsigned short)Clamp(roundf((heightmap[i] - heightOffset) / heightStep), 0.0f, 65535.0f);
+            compactNormals[i] = EncodeOctahedralNormal(heightMapNormals[i]);
+
+            batchHeightError = std::max(batchHeightError, fabsf(heightOffset + compactHeights[i] * heightStep - heightmap[i]));
+            batchNormalDot = std::min(batchNormalDot, Vector3DotProduct(DecodeOctahedralNormal(compactNormals[i]), heightMapNormals[i]));
+        }
+        lock_guard<mutex> lock(errorLock);
+        maxHeightError = std::max(maxHeightError, batchHeightError);
+        minNormalDot = std::min(minNormalDot, batchNormalDot);
+    });
+
+    // swap with empty vectors to actually free the memory
+    vector<float>().swap(heightmap);
+    vector<Vector3>().swap(heightMapNormals);
+
+    TraceLog(LOG_INFO, "<QuadTreeTerrainComponent.BuildCompactStorage> %d samples, %d KB, max height error %.6f, max normal error %.4f deg",
+        (int)numSamples, (int)(GetHeightmapMemorySize() / 1024), maxHeightError * terrainScale.y, acosf(Clamp(minNormalDot, -1.0f, 1.0f)) * RAD2DEG);
+}
+
+/// <summary>
+/// GetHeightmapMemorySize - Bytes used by the resident height samples and normals
+/// </summary>
+/// <returns>Size in bytes</returns>
+size_t QuadTreeTerrainComponent::GetHeightmapMemorySize() const
+{
+    if (tileStream != nullptr)
+        return tileStream->GetResidentBytes();
+
+    return heightmap.size() * sizeof(float) + heightMapNormals.size() * sizeof(Vector3)
+        + compactHeights.size() * sizeof(unsigned short) + compactNormals.size() * sizeof(unsigned int);
+}
+
+/// <summary>
+/// RunSamplingBenchmark - Measure the cost of the sampling hot path for float and compact storage.
+/// The storage which is not in use is built temporarily, both are read with the same random sample
+/// sequence, then GetTerrainY is timed through the active storage. Results go to the log.
+/// </summary>
+/// <param name="numSamples">Number of random samples per measurement</param>
+void QuadTreeTerrainComponent::RunSamplingBenchmark(int numSamples)
+{
+    if (tileStream != nullptr || HeightMapWidth == 0 || HeightMapDepth == 0) {
+        TraceLog(LOG_WARNING, "<QuadTreeTerrainComponent.RunSamplingBenchmark> Needs an in-memory heightmap");
+        return;
+    }
+
+    size_t count = (size_t)HeightMapWidth * HeightMapDepth;
+    vector<float> floatHeights;
+    vector<Vector3> floatNormals;
+    vector<unsigned short> packedHeights;
+    vector<unsigned int> packedNormals;
+    if (compactHeights.empty()) {
+        floatHeights = heightmap;
+        floatNormals = heightMapNormals;
+        packedHeights.resize(count);
+        packedNormals.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            packedHeights[i] = (unsigned short)Clamp(roundf(heightmap[i] * 65535.0f), 0.0f, 65535.0f);
+            packedNormals[i] = EncodeOctahedralNormal(heightMapNormals[i]);
+        }
+    }
+    else {
+        packedHeights = compactHeights;
+        packedNormals = compactNormals;
+        floatHeights.resize(count);
+        floatNormals.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            floatHeights[i] = heightOffset + compactHeights[i] * heightStep;
+            floatNormals[i] = DecodeOctahedralNormal(compactNormals[i]);
+        }
+    }
+    float offset = compactHeights.empty() ? 0.0f : heightOffset;
+    float step = compactHeights.empty() ? 1.0f / 65535.0f : heightStep;
+
+    // same pseudo random sample indices for every run
+    vector<unsigned int> indices(numSamples);
+    unsigned int seed = 12345u;
+    for (int i = 0; i < numSamples; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        indices[i] = (seed >> 8) % (unsigned int)count;
+    }
+
+    float checksum = 0.0f; // printed, so the loops are not optimized away
+    double t = GetTime();
+    for (int i = 0; i < numSamples; i++) {
+        Vector3 n = floatNormals[indices[i]];
+        checksum += floatHeights[indices[i]] + n.y;
+    }
+    double floatTime = GetTime() - t;
+
+    t = GetTime();
+    for (int i = 0; i < numSamples; i++) {
+        Vector3 n = DecodeOctahedralNormal(packedNormals[indices[i]]);
+        checksum += offset + packedHeights[indices[i]] * step + n.y;
+    }
+    double compactTime = GetTime() - t;
+
+    float worldOriginX = -terrainDimension.x / 2.0f;
+    float worldOriginZ = -terrainDimension.z / 2.0f;
+    t = GetTime();
+    for (int i = 0; i < numSamples; i++) {
+        float x = worldOriginX + (indices[i] % HeightMapWidth + 0.37f) * terrainScale.x;
+        float z = worldOriginZ + (indices[i] / HeightMapWidth + 0.61f) * terrainScale.z;
+        checksum += GetTerrainY(x, z);
+    }
+    double terrainYTime = GetTime() - t;
+
+    TraceLog(LOG_INFO, "<QuadTreeTerrainComponent.RunSamplingBenchmark> %d samples (checksum %.1f)", numSamples, checksum);
+    TraceLog(LOG_INFO, "    float   height+normal: %.2f ns/sample, %d KB", floatTime * 1e9 / numSamples, (int)(count * (sizeof(float) + sizeof(Vector3)) / 1024));
+    TraceLog(LOG_INFO, "    compact height+normal: %.2f ns/sample, %d KB", compactTime * 1e9 / numSamples, (int)(count * (sizeof(unsigned short) + sizeof(unsigned int)) / 1024));
+    TraceLog(LOG_INFO, "    GetTerrainY (%s): %.2f ns/sample", compactHeights.empty() ? "float" : "compact", terrainYTime * 1e9 / numSamples);
 }
 
 // Build the Quadtree recursively
@@ -358,6 +784,36 @@ void QuadTreeTerrainComponent::BuildQuadtreeNode(QuadTreeNode* node)
     for (int i = 0; i < 4; ++i) {
         BuildQuadtreeNode(node->children[i]);
     }
+
+    // Tighten the children bounds to the heights they actually contain,
+    // so frustum culling and LOD work with the real terrain heights
+    for (int i = 0; i < 4; ++i) {
+        UpdateNodeHeightBounds(node->children[i]);
+    }
+}
+
+/// <summary>
+/// UpdateNodeHeightBounds - Set the Y extent of a node's bounds from the min/max pyramid (or the tile table when streaming)
+/// </summary>
+/// <param name="node">The quadtree node</param>
+void QuadTreeTerrainComponent::UpdateNodeHeightBounds(QuadTreeNode* node)
+{
+    int x0, z0, x1, z1;
+    GetNodeSampleRect(node, x0, z0, x1, z1);
+
+    float minHeight, maxHeight;
+    GetHeightRange(x0, z0, x1, z1, minHeight, maxHeight);
+    node->bounds.min.y = minHeight * terrainScale.y;
+    node->bounds.max.y = maxHeight * terrainScale.y;
+}
+
+// Sample rectangle [x0,x1] x [z0,z1] under a node's bounds
+void QuadTreeTerrainComponent::GetNodeSampleRect(const QuadTreeNode* node, int& x0, int& z0, int& x1, int& z1)
+{
+    x0 = (int)floorf((node->bounds.min.x + terrainDimension.x / 2.0f) / terrainScale.x);
+    z0 = (int)floorf((node->bounds.min.z + terrainDimension.z / 2.0f) / terrainScale.z);
+    x1 = (int)ceilf((node->bounds.max.x + terrainDimension.x / 2.0f) / terrainScale.x);
+    z1 = (int)ceilf((node->bounds.max.z + terrainDimension.z / 2.0f) / terrainScale.z);
 }
 
 /// <summary>
@@ -373,6 +829,12 @@ Vector3 QuadTreeTerrainComponent::GetHeightmapNormal(int x, int y)
     if (y < 0) y = 0;
     if (y >= HeightMapDepth) y = HeightMapDepth - 1;
 
+    if (tileStream != nullptr)
+        return tileStream->GetNormal(x, y);
+
+    if (!compactNormals.empty())
+        return DecodeOctahedralNormal(compactNormals[y * HeightMapWidth + x]);
+
     return heightMapNormals[y * HeightMapWidth + x];
 }
 
@@ -391,10 +853,10 @@ Vector3 QuadTreeTerrainComponent::GetSmoothedNormal(float fx, float fz)
     float tz = (float)(z - z0);
 
     // Get normals at four surrounding points
-    Vector3 n00 = heightMapNormals[z0* HeightMapWidth + x0];
-    Vector3 n10 = heightMapNormals[z0* HeightMapWidth + x1];
-    Vector3 n01 = heightMapNormals[z1 * HeightMapWidth + x0];
-    Vector3 n11 = heightMapNormals[z1 * HeightMapWidth + x1];
+    Vector3 n00 = GetHeightmapNormal(x0, z0);
+    Vector3 n10 = GetHeightmapNormal(x1, z0);
+    Vector3 n01 = GetHeightmapNormal(x0, z1);
+    Vector3 n11 = GetHeightmapNormal(x1, z1);
 
     // Bilinear interpolation
     Vector3 n0 = Vector3Lerp(n00, n10, tx);
@@ -402,12 +864,79 @@ Vector3 QuadTreeTerrainComponent::GetSmoothedNormal(float fx, float fz)
     return Vector3Normalize(Vector3Lerp(n0, n1, tz));
 }
 
-// Draw the terrain chunk corresponding to a leaf node using immediate mode
+Vector3 QuadTreeTerrainComponent::GetTerrainNormal(float x, float z)
+{
+    int mapX = (int)floorf((x + terrainDimension.x / 2.0f) / terrainScale.x + 0.5f);
+    int mapZ = (int)floorf((z + terrainDimension.z / 2.0f) / terrainScale.z + 0.5f);
+    return GetHeightmapNormal(mapX, mapZ);
+}
+
+/// <summary>
+/// CopyPatch - Copy the heights and normals under a world rectangle, including the samples to the right and
+/// below its last quads. Main thread only, like the editing functions.
+/// </summary>
+/// <param name="minX">World x of the rectangle's first corner</param>
+/// <param name="minZ">World z of the rectangle's first corner</param>
+/// <param name="maxX">World x of the opposite corner</param>
+/// <param name="maxZ">World z of the opposite corner</param>
+/// <param name="patch">Receives the samples</param>
+void QuadTreeTerrainComponent::CopyPatch(float minX, float minZ, float maxX, float maxZ, TerrainPatch& patch)
+{
+    patch.originX = -terrainDimension.x / 2.0f;
+    patch.originZ = -terrainDimension.z / 2.0f;
+    patch.invScaleX = 1.0f / terrainScale.x;
+    patch.invScaleZ = 1.0f / terrainScale.z;
+    patch.scaleY = terrainScale.y;
+
+    int x0 = std::max((int)floorf((minX - patch.originX) * patch.invScaleX), 0);
+    int z0 = std::max((int)floorf((minZ - patch.originZ) * patch.invScaleZ), 0);
+    int x1 = std::min((int)floorf((maxX - patch.originX) * patch.invScaleX) + 1, HeightMapWidth - 1);
+    int z1 = std::min((int)floorf((maxZ - patch.originZ) * patch.invScaleZ) + 1, HeightMapDepth - 1);
+    patch.x0 = x0;
+    patch.z0 = z0;
+    patch.width = std::max(x1 - x0 + 1, 0);
+    patch.depth = std::max(z1 - z0 + 1, 0);
+    patch.heights.resize((size_t)patch.width * patch.depth);
+    patch.normals.resize((size_t)patch.width * patch.depth);
+
+    size_t i = 0;
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++, i++) {
+            patch.heights[i] = GetHeightmapValue(x, z);
+            patch.normals[i] = GetHeightmapNormal(x, z);
+        }
+    }
+}
+
+// Draw the terrain chunk corresponding to a leaf node. The geometry is built on first use and cached
+// in the node until the heights under it change or it has not been drawn for ChunkCacheFrames frames.
 void QuadTreeTerrainComponent::DrawTerrainChunk(QuadTreeNode* node)
 {
     if (HeightMapWidth == 0 || HeightMapDepth == 0) return; // No map data
     if (terrainTexture.id == 0) return; // No texture loaded
 
+    if (node->chunkMesh == nullptr) {
+        node->chunkMesh = BuildChunkMesh(node);
+        if (node->chunkMesh == nullptr)
+            return;
+        if (!node->inChunkCache) {
+            node->inChunkCache = true;
+            cachedChunkNodes.push_back(node);
+        }
+    }
+    node->lastDrawnFrame = frameCounter;
+
+    DrawMesh(*node->chunkMesh, materials[0], MatrixIdentity());
+    NumTriangles += node->chunkMesh->triangleCount;
+}
+
+/// <summary>
+/// BuildChunkMesh - Build and upload the indexed grid of a node's chunk
+/// </summary>
+/// <param name="node">The quadtree node</param>
+/// <returns>The uploaded mesh, nullptr if the node covers no quads</returns>
+Mesh* QuadTreeTerrainComponent::BuildChunkMesh(QuadTreeNode* node)
+{
     // Calculate the world origin (bottom-left corner of the terrain, assuming centered at 0,0)
     float worldOriginX = -terrainDimension.x / 2.0f;
     float worldOriginZ = -terrainDimension.z / 2.0f;
@@ -421,88 +950,99 @@ void QuadTreeTerrainComponent::DrawTerrainChunk(QuadTreeNode* node)
 
     // Ensure there's at least one quad to draw within the calculated range
     if (mapEndX <= mapStartX || mapEndZ <= mapStartZ)
-        return;
+        return nullptr;
 
-    // Step determines the resolution of this chunk. For simplicity, step is 1.
+    // Step determines the resolution of this chunk. Nodes drawn far away cover more of the map,
+    // double the step until the chunk has no more than MaxChunkQuads quads per side.
     int step = 2;
+    while ((mapEndX - mapStartX) / step > MaxChunkQuads || (mapEndZ - mapStartZ) / step > MaxChunkQuads)
+        step *= 2;
+
+    // A quad starts at every step-th sample up to one step before the end
+    int quadsX = (mapEndX - mapStartX - 1) / step;
+    int quadsZ = (mapEndZ - mapStartZ - 1) / step;
+    if (quadsX <= 0 || quadsZ <= 0)
+        return nullptr;
+
+    int vertsX = quadsX + 1;
+    int vertsZ = quadsZ + 1;
+
+    Mesh* pMesh = new Mesh{ 0 };
+    pMesh->vertexCount = vertsX * vertsZ;
+    pMesh->triangleCount = quadsX * quadsZ * 2;
+    pMesh->vertices = (float*)RL_MALLOC(pMesh->vertexCount * 3 * sizeof(float));
+    pMesh->normals = (float*)RL_MALLOC(pMesh->vertexCount * 3 * sizeof(float));
+    pMesh->texcoords = (float*)RL_MALLOC(pMesh->vertexCount * 2 * sizeof(float));
+    pMesh->indices = (unsigned short*)RL_MALLOC(pMesh->triangleCount * 3 * sizeof(unsigned short));
+
+    // Shared vertices with the pre-calculated vertex normals for smooth lighting
+    for (int j = 0; j < vertsZ; j++) {
+        int z = mapStartZ + j * step;
+        for (int i = 0; i < vertsX; i++) {
+            int x = mapStartX + i * step;
+            int v = j * vertsX + i;
+
+            float h = GetHeightmapValue(x, z);
+            Vector3 n = GetHeightmapNormal(x, z);
+
+            pMesh->vertices[v * 3 + 0] = worldOriginX + x * terrainScale.x;
+            pMesh->vertices[v * 3 + 1] = h * terrainScale.y;
+            pMesh->vertices[v * 3 + 2] = worldOriginZ + z * terrainScale.z;
+
+            pMesh->normals[v * 3 + 0] = n.x;
+            pMesh->normals[v * 3 + 1] = n.y;
+            pMesh->normals[v * 3 + 2] = n.z;
+
+            // These map the texture across the entire terrain, tiled by tilingFactor
+            pMesh->texcoords[v * 2 + 0] = (float)x / (HeightMapWidth - 1.0f) * tilingFactor.x;
+            pMesh->texcoords[v * 2 + 1] = (float)z / (HeightMapDepth - 1.0f) * tilingFactor.y;
+        }
+    }
 
-    rlEnableTexture(terrainTexture.id); // Enable texturing
-
-    rlBegin(RL_TRIANGLES); // Start drawing triangles
-    rlColor4ub(255, 255, 255, 255); // Set vertex color to white to show original texture colors
-
-    rlSetTexture(terrainTexture.id); // Bind the texture for drawing
-
-    for (int z = mapStartZ; z < mapEndZ - step; z += step) { // Iterate through Z, stopping one step early for quad formation
-        for (int x = mapStartX; x < mapEndX - step; x += step) { // Iterate through X, stopping one step early
-            // Get normalized height values for the four corners of the current quad
-            float h1 = GetHeightmapValue(x, z);             // Top-left
-            float h2 = GetHeightmapValue(x + step, z);     // Top-right
-            float h3 = GetHeightmapValue(x, z + step);     // Bottom-left
-            float h4 = GetHeightmapValue(x + step, z + step); // Bottom-right
-
-            Vector3 n1 = GetHeightmapNormal(x, z);             // Top-left
-            Vector3 n2 = GetHeightmapNormal(x + step, z);     // Top-right
-            Vector3 n3 = GetHeightmapNormal(x, z + step);     // Bottom-left
-            Vector3 n4 = GetHeightmapNormal(x + step, z + step); // Bottom-right
-
-            // Calculate world coordinates for the four corners, applying scaling
-            Vector3 p1 = { worldOriginX + x * terrainScale.x ,             h1 * terrainScale.y, worldOriginZ + z * terrainScale.z };
-            Vector3 p2 = { worldOriginX + (x + step) * terrainScale.x, h2 * terrainScale.y, worldOriginZ + z * terrainScale.z };
-            Vector3 p3 = { worldOriginX + x * terrainScale.x ,             h3 * terrainScale.y, worldOriginZ + (z + step) * terrainScale.z };
-            Vector3 p4 = { worldOriginX + (x + step) * terrainScale.x, h4 * terrainScale.y, worldOriginZ + (z + step) * terrainScale.z };
-
-            // Calculate UV coordinates for each vertex of the quad
-			// These map the texture across the entire terrain, tiled by tilingFactor
-            float u1 = (float)x / (HeightMapWidth - 1.0f) * tilingFactor.x;
-            float v1 = (float)z / (HeightMapDepth - 1.0f) * tilingFactor.y;
-
-            float u2 = (float)(x + step) / (HeightMapWidth - 1.0f) * tilingFactor.x;
-            float v2 = v1; // (float)z / (HeightMapDepth - 1.0f) * tilingFactor.y;
-
-            float u3 = u1; // (float)x / (HeightMapWidth - 1.0f) * tilingFacotr.x;
-            float v3 = (float)(z + step) / (HeightMapWidth - 1.0f) * tilingFactor.y;
-
-            float u4 = u2; // (float)(x + step) / (HeightMapWidth - 1.0f) * tilingFactor.x;
-            float v4 = v3; // (float)(z + step) / (HeightMapDepth - 1.0f) * tilingFactor.z;
-
-			//New algorithm improvement: Use pre-calculated veretx normals for smooth lighting
-
-            rlNormal3f(n1.x, n1.y, n1.z);  rlTexCoord2f(u1, v1); rlVertex3f(p1.x, p1.y, p1.z);  // p1
-            rlNormal3f(n3.x, n3.y, n3.z);  rlTexCoord2f(u3, v3); rlVertex3f(p3.x, p3.y, p3.z); // p3
-            rlNormal3f(n4.x, n4.y, n4.z);  rlTexCoord2f(u4, v4); rlVertex3f(p4.x, p4.y, p4.z); // p4
-
-            rlNormal3f(n1.x, n1.y, n1.z);  rlTexCoord2f(u1, v1); rlVertex3f(p1.x, p1.y, p1.z); // p1
-            rlNormal3f(n4.x, n4.y, n4.z);  rlTexCoord2f(u4, v4); rlVertex3f(p4.x, p4.y, p4.z); // p4
-            rlNormal3f(n2.x, n2.y, n2.z);  rlTexCoord2f(u2, v2); rlVertex3f(p2.x, p2.y, p2.z); // p2
-
-            /*
-				//This is older version of the code that uses face normals for lighting
-				//This sometimes is resulting inconsistent shaing result, not smooth lighting
-
-                // Triangle 1: p1, p3, p4
-                Vector3 nn1 = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(p3, p1), Vector3Subtract(p4, p1)));
-                rlNormal3f(nn1.x, nn1.y, nn1.z);
-
-                rlTexCoord2f(u1, v1); rlVertex3f(p1.x, p1.y, p1.z); // p1
-                rlTexCoord2f(u3, v3); rlVertex3f(p3.x, p3.y, p3.z); // p3
-                rlTexCoord2f(u4, v4); rlVertex3f(p4.x, p4.y, p4.z); // p4
+    // Two triangles per quad: (x,z) (x,z+step) (x+step,z+step) and (x,z) (x+step,z+step) (x+step,z)
+    int k = 0;
+    for (int j = 0; j < quadsZ; j++) {
+        for (int i = 0; i < quadsX; i++) {
+            unsigned short i00 = (unsigned short)(j * vertsX + i);
+            unsigned short i10 = (unsigned short)(i00 + 1);
+            unsigned short i01 = (unsigned short)(i00 + vertsX);
+            unsigned short i11 = (unsigned short)(i01 + 1);
+
+            pMesh->indices[k++] = i00; pMesh->indices[k++] = i01; pMesh->indices[k++] = i11;
+            pMesh->indices[k++] = i00; pMesh->indices[k++] = i11; pMesh->indices[k++] = i10;
+        }
+    }
 
-                // Triangle 2: p1, p4, p2
-                Vector3 nn2 = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(p4, p1), Vector3Subtract(p2, p1)));
-                rlNormal3f(nn2.x, nn2.y, nn2.z);
+    UploadMesh(pMesh, false);
 
-                rlTexCoord2f(u1, v1); rlVertex3f(p1.x, p1.y, p1.z); // p1
-                rlTexCoord2f(u4, v4); rlVertex3f(p4.x, p4.y, p4.z); // p4
-                rlTexCoord2f(u2, v2); rlVertex3f(p2.x, p2.y, p2.z); // p2
+    // The GPU buffers are all DrawMesh needs, the chunk is rebuilt from the heightmap when it changes
+    RL_FREE(pMesh->vertices); pMesh->vertices = nullptr;
+    RL_FREE(pMesh->normals); pMesh->normals = nullptr;
+    RL_FREE(pMesh->texcoords); pMesh->texcoords = nullptr;
+    RL_FREE(pMesh->indices); pMesh->indices = nullptr;
 
-            */
+    return pMesh;
+}
 
-            NumTriangles += 2; // Increment triangle count (2 triangles per quad)
+/// <summary>
+/// ReleaseUnusedChunks - Release the cached chunks which have not been drawn for ChunkCacheFrames frames
+/// and drop the nodes whose chunk was released by an edit from the list.
+/// </summary>
+void QuadTreeTerrainComponent::ReleaseUnusedChunks()
+{
+    size_t numCached = 0;
+    for (size_t i = 0; i < cachedChunkNodes.size(); i++) {
+        QuadTreeNode* node = cachedChunkNodes[i];
+        if (node->chunkMesh != nullptr && frameCounter - node->lastDrawnFrame > ChunkCacheFrames) {
+            node->ReleaseChunk();
+        }
+        if (node->chunkMesh == nullptr) {
+            node->inChunkCache = false;
+            continue;
         }
+        cachedChunkNodes[numCached++] = node;
     }
-    rlEnd(); // Finish drawing triangles
-    rlDisableTexture(); // Disable texturing
+    cachedChunkNodes.resize(numCached);
 }
 
 // Traverse the Quadtree and draw appropriate nodes/chunks
@@ -589,3 +1129,273 @@ void QuadTreeTerrainComponent::GatherNodesToDraw(QuadTreeNode* node, SceneCamera
 
     }
 }
+
+/// <summary>
+/// StampBrush - Raise (or dig with a negative heightDelta) the terrain around a point with a smooth falloff
+/// </summary>
+/// <param name="worldCenter">Brush center in world space, only x and z are used</param>
+/// <param name="radius">Brush radius in world units</param>
+/// <param name="heightDelta">Height change at the center in world units</param>
+void QuadTreeTerrainComponent::StampBrush(Vector3 worldCenter, float radius, float heightDelta)
+{
+    if (tileStream != nullptr) {
+        TraceLog(LOG_WARNING, "<QuadTreeTerrainComponent.StampBrush> Tiled terrains are read only");
+        return;
+    }
+    if (rootNode == nullptr || radius <= 0.0f)
+        return;
+
+    float centerX = (worldCenter.x + terrainDimension.x / 2.0f) / terrainScale.x;
+    float centerZ = (worldCenter.z + terrainDimension.z / 2.0f) / terrainScale.z;
+    int x0 = std::max(0, (int)floorf(centerX - radius / terrainScale.x));
+    int z0 = std::max(0, (int)floorf(centerZ - radius / terrainScale.z));
+    int x1 = std::min(HeightMapWidth - 1, (int)ceilf(centerX + radius / terrainScale.x));
+    int z1 = std::min(HeightMapDepth - 1, (int)ceilf(centerZ + radius / terrainScale.z));
+    if (x0 > x1 || z0 > z1)
+        return;
+
+    float radiusSquared = radius * radius;
+    float normalizedDelta = heightDelta / terrainScale.y;
+
+    // compact storage has to cover the new heights before the workers write them
+    if (!compactHeights.empty()) {
+        float minHeight, maxHeight;
+        GetHeightRange(x0, z0, x1 + 1, z1 + 1, minHeight, maxHeight);
+        ReserveCompactRange(minHeight + std::min(normalizedDelta, 0.0f), maxHeight + std::max(normalizedDelta, 0.0f));
+    }
+    JobSystem::Instance().ParallelFor(z1 - z0 + 1, HEIGHTMAP_ROWS_PER_JOB, [=](int begin, int end) {
+        for (int z = z0 + begin; z < z0 + end; z++) {
+            float dz = (z - centerZ) * terrainScale.z;
+            for (int x = x0; x <= x1; x++) {
+                float dx = (x - centerX) * terrainScale.x;
+                float t = 1.0f - (dx * dx + dz * dz) / radiusSquared;
+                if (t <= 0.0f)
+                    continue;
+                SetHeightmapValue(x, z, GetHeightmapValue(x, z) + normalizedDelta * t * t);
+            }
+        }
+    });
+
+    ApplyHeightChanges(x0, z0, x1, z1);
+}
+
+/// <summary>
+/// SetHeightRegion - Overwrite a rectangle of samples
+/// </summary>
+/// <param name="x0">First sample x</param>
+/// <param name="z0">First sample z</param>
+/// <param name="width">Number of samples along x</param>
+/// <param name="depth">Number of samples along z</param>
+/// <param name="pHeights">width * depth normalized heights, row major</param>
+void QuadTreeTerrainComponent::SetHeightRegion(int x0, int z0, int width, int depth, const float* pHeights)
+{
+    if (tileStream != nullptr) {
+        TraceLog(LOG_WARNING, "<QuadTreeTerrainComponent.SetHeightRegion> Tiled terrains are read only");
+        return;
+    }
+    if (rootNode == nullptr || pHeights == nullptr)
+        return;
+
+    // clip the region to the map
+    int sx0 = std::max(x0, 0);
+    int sz0 = std::max(z0, 0);
+    int sx1 = std::min(x0 + width, HeightMapWidth) - 1;
+    int sz1 = std::min(z0 + depth, HeightMapDepth) - 1;
+    if (sx0 > sx1 || sz0 > sz1)
+        return;
+
+    if (!compactHeights.empty()) {
+        float minHeight = FLT_MAX;
+        float maxHeight = -FLT_MAX;
+        for (int z = sz0; z <= sz1; z++) {
+            const float* pRow = pHeights + (size_t)(z - z0) * width - x0;
+            for (int x = sx0; x <= sx1; x++) {
+                minHeight = std::min(minHeight, pRow[x]);
+                maxHeight = std::max(maxHeight, pRow[x]);
+            }
+        }
+        ReserveCompactRange(minHeight, maxHeight);
+    }
+
+    for (int z = sz0; z <= sz1; z++) {
+        const float* pRow = pHeights + (size_t)(z - z0) * width - x0;
+        for (int x = sx0; x <= sx1; x++) {
+            SetHeightmapValue(x, z, pRow[x]);
+        }
+    }
+
+    ApplyHeightChanges(sx0, sz0, sx1, sz1);
+}
+
+/// <summary>
+/// ReserveCompactRange - Widen the quantized range of compact storage to hold [minHeight, maxHeight]. The
+/// stored heights are quantized again against the new offset and step, with a quarter of the new range as
+/// headroom on each side which grew, so a series of brush strokes does not repeat it every time.
+/// </summary>
+/// <param name="minHeight">Lowest normalized height about to be written</param>
+/// <param name="maxHeight">Highest normalized height about to be written</param>
+void QuadTreeTerrainComponent::ReserveCompactRange(float minHeight, float maxHeight)
+{
+    float oldOffset = heightOffset;
+    float oldStep = heightStep;
+    float oldMax = oldOffset + 65535.0f * oldStep;
+    if (compactHeights.empty() || (minHeight >= oldOffset && maxHeight <= oldMax))
+        return;
+
+    float newMin = std::min(minHeight, oldOffset);
+    float newMax = std::max(maxHeight, oldMax);
+    float headroom = (newMax - newMin) * 0.25f;
+    if (minHeight < oldOffset)
+        newMin -= headroom;
+    if (maxHeight > oldMax)
+        newMax += headroom;
+
+    float newStep = std::max(newMax - newMin, 1e-6f) / 65535.0f;
+    JobSystem::Instance().ParallelFor(HeightMapDepth, HEIGHTMAP_ROWS_PER_JOB, [=](int beginZ, int endZ) {
+        for (size_t i = (size_t)beginZ * HeightMapWidth; i < (size_t)endZ * HeightMapWidth; i++) {
+            float height = oldOffset + compactHeights[i] * oldStep;
+            compactHeights[i] = (unsigned short)Clamp(roundf((height - newMin) / newStep), 0.0f, 65535.0f);
+        }
+    });
+    heightOffset = newMin;
+    heightStep = newStep;
+
+    TraceLog(LOG_INFO, "<QuadTreeTerrainComponent.ReserveCompactRange> Heights quantized again over %.3f ~ %.3f",
+        heightOffset * terrainScale.y, (heightOffset + 65535.0f * heightStep) * terrainScale.y);
+}
+
+/// <summary>
+/// RunCompactEditCheck - Write one sample below the lowest height of compact storage, read it back and
+/// restore it. Results go to the log.
+/// </summary>
+/// <returns>true if the edited height survived the round trip within one quantization step</returns>
+bool QuadTreeTerrainComponent::RunCompactEditCheck()
+{
+    if (compactHeights.empty() || rootNode == nullptr) {
+        TraceLog(LOG_WARNING, "<QuadTreeTerrainComponent.RunCompactEditCheck> Needs compact storage");
+        return false;
+    }
+
+    int x = HeightMapWidth / 2;
+    int z = HeightMapDepth / 2;
+    float original = GetHeightmapValue(x, z);
+    float lowest = heightOffset;
+    float target = lowest - 0.05f;
+    SetHeightRegion(x, z, 1, 1, &target);
+    float result = GetHeightmapValue(x, z);
+    SetHeightRegion(x, z, 1, 1, &original);
+
+    bool success = fabsf(result - target) <= heightStep;
+    TraceLog(success ? LOG_INFO : LOG_WARNING, "<QuadTreeTerrainComponent.RunCompactEditCheck> Wrote %.4f below the lowest height %.4f, read back %.4f: %s",
+        target * terrainScale.y, lowest * terrainScale.y, result * terrainScale.y, success ? "passed" : "FAILED");
+    return success;
+}
+
+// Write a normalized height, compact storage clamps it to the quantized range, see ReserveCompactRange
+void QuadTreeTerrainComponent::SetHeightmapValue(int x, int z, float height)
+{
+    if (x < 0 || x >= HeightMapWidth || z < 0 || z >= HeightMapDepth)
+        return;
+
+    if (!compactHeights.empty()) {
+        compactHeights[z * HeightMapWidth + x] = (unsigned short)Clamp(roundf((height - heightOffset) / heightStep), 0.0f, 65535.0f);
+        return;
+    }
+
+    heightmap[z * HeightMapWidth + x] = height;
+}
+
+/// <summary>
+/// UpdateNormals - Recompute the vertex normals of the samples in [x0,x1] x [z0,z1]
+/// </summary>
+void QuadTreeTerrainComponent::UpdateNormals(int x0, int z0, int x1, int z1)
+{
+    x0 = std::max(x0, 0);
+    z0 = std::max(z0, 0);
+    x1 = std::min(x1, HeightMapWidth - 1);
+    z1 = std::min(z1, HeightMapDepth - 1);
+    if (x0 > x1 || z0 > z1)
+        return;
+
+    const Vector3 sampleScale = terrainScale;
+    JobSystem::Instance().ParallelFor(z1 - z0 + 1, HEIGHTMAP_ROWS_PER_JOB, [=](int begin, int end) {
+        for (int z = z0 + begin; z < z0 + end; z++) {
+            for (int x = x0; x <= x1; x++) {
+                float neighbours[4];
+                bool valid[4] = { x > 0, x < HeightMapWidth - 1, z > 0, z < HeightMapDepth - 1 };
+                neighbours[0] = valid[0] ? GetHeightmapValue(x - 1, z) * sampleScale.y : 0.0f;
+                neighbours[1] = valid[1] ? GetHeightmapValue(x + 1, z) * sampleScale.y : 0.0f;
+                neighbours[2] = valid[2] ? GetHeightmapValue(x, z - 1) * sampleScale.y : 0.0f;
+                neighbours[3] = valid[3] ? GetHeightmapValue(x, z + 1) * sampleScale.y : 0.0f;
+                Vector3 normal = TerrainTileStream::ComputeNormal(GetHeightmapValue(x, z) * sampleScale.y, neighbours, valid, sampleScale);
+
+                if (!compactNormals.empty())
+                    compactNormals[z * HeightMapWidth + x] = EncodeOctahedralNormal(normal);
+                else
+                    heightMapNormals[z * HeightMapWidth + x] = normal;
+            }
+        }
+    });
+}
+
+/// <summary>
+/// ApplyHeightChanges - Bring the derived data up to date after the samples in [x0,x1] x [z0,z1] changed.
+/// Only the dirty rectangle is reprocessed: its normals (plus the one sample ring around it whose normals
+/// read the edited heights), the min/max pyramid entries above it, the bounds of the quadtree nodes
+/// overlapping it and their cached chunks.
+/// </summary>
+void QuadTreeTerrainComponent::ApplyHeightChanges(int x0, int z0, int x1, int z1)
+{
+    double startTime = GetTime();
+
+    UpdateNormals(x0 - 1, z0 - 1, x1 + 1, z1 + 1);
+    UpdateHeightRangePyramid(x0, z0, x1, z1);
+    UpdateNodesInRect(rootNode, x0 - 1, z0 - 1, x1 + 1, z1 + 1, true);
+    LocalBoundingBox = rootNode->bounds;
+    RecordHeightChange(x0 - 1, z0 - 1, x1 + 1, z1 + 1);
+
+    TraceLog(LOG_DEBUG, "<QuadTreeTerrainComponent.ApplyHeightChanges> %dx%d samples updated in %.3f ms",
+        x1 - x0 + 1, z1 - z0 + 1, (GetTime() - startTime) * 1000);
+}
+
+// List a changed sample rectangle for GetHeightChanges, clipped to the map
+void QuadTreeTerrainComponent::RecordHeightChange(int x0, int z0, int x1, int z1)
+{
+    TerrainHeightChange change;
+    change.serial = ++heightChangeSerial;
+    change.frame = frameCounter;
+    change.x0 = std::max(x0, 0);
+    change.z0 = std::max(z0, 0);
+    change.x1 = std::min(x1, HeightMapWidth - 1);
+    change.z1 = std::min(z1, HeightMapDepth - 1);
+    change.minX = change.x0 * terrainScale.x - terrainDimension.x / 2.0f;
+    change.minZ = change.z0 * terrainScale.z - terrainDimension.z / 2.0f;
+    change.maxX = change.x1 * terrainScale.x - terrainDimension.x / 2.0f;
+    change.maxZ = change.z1 * terrainScale.z - terrainDimension.z / 2.0f;
+    heightChanges.push_back(change);
+}
+
+/// <summary>
+/// UpdateNodesInRect - Release the cached chunks of the nodes overlapping the sample rectangle and
+/// optionally refresh their height bounds, children first so the parents see the new ranges
+/// </summary>
+/// <param name="node">The quadtree node</param>
+/// <param name="updateBounds">Heights changed, not only their resolution</param>
+void QuadTreeTerrainComponent::UpdateNodesInRect(QuadTreeNode* node, int x0, int z0, int x1, int z1, bool updateBounds)
+{
+    if (node == nullptr)
+        return;
+
+    int nx0, nz0, nx1, nz1;
+    GetNodeSampleRect(node, nx0, nz0, nx1, nz1);
+    if (nx1 < x0 || nx0 > x1 || nz1 < z0 || nz0 > z1)
+        return;
+
+    node->ReleaseChunk();
+    for (int i = 0; i < 4; ++i) {
+        UpdateNodesInRect(node->children[i], x0, z0, x1, z1, updateBounds);
+    }
+
+    if (updateBounds)
+        UpdateNodeHeightBounds(node);
+}
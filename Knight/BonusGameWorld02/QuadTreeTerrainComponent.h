@@ -6,6 +6,11 @@
 
 #include "rlgl.h"
 
+#include "TerrainTileStream.h"
+
+#define HEIGHTMAP_ROWS_PER_JOB 32     // Heightmap rows processed by one job while loading
+#define HEIGHT_RANGE_BLOCK_SIZE 8     // Quads per side covered by one entry of the min/max pyramid
+
 // Simple Quadtree Node
 struct QuadTreeNode {
     BoundingBox bounds;       // Axis-Aligned Bounding Box for this node's area
@@ -14,6 +19,9 @@ struct QuadTreeNode {
     float size;               // Size (width/depth) of the node's square area
     int depth;                // Depth in the tree (0 = root)
     bool isLeaf;              // Is this node a leaf?
+    Mesh* chunkMesh = nullptr; // Cached chunk geometry, built on first draw, released when the heights under it change
+    unsigned int lastDrawnFrame = 0; // Frame the cached chunk was last drawn
+    bool inChunkCache = false; // Listed in the component's cachedChunkNodes
 
     QuadTreeNode(BoundingBox b, int d) : bounds(b), depth(d), isLeaf(true) {
         for (int i = 0; i < 4; ++i) {
@@ -31,9 +39,41 @@ struct QuadTreeNode {
             delete children[i]; // This will recursively delete children
             children[i] = nullptr;
         }
+        ReleaseChunk();
+    }
+
+    void ReleaseChunk() {
+        if (chunkMesh != nullptr) {
+            UnloadMesh(*chunkMesh);
+            delete chunkMesh;
+            chunkMesh = nullptr;
+        }
     }
 };
 
+// Heightmap samples [x0,x1] x [z0,z1] whose heights changed, by an edit or a streamed tile paged in or out
+struct TerrainHeightChange {
+    unsigned int serial;          // Increases by one with every change
+    unsigned int frame;           // Terrain frame the change was recorded in
+    int x0, z0, x1, z1;
+    float minX, minZ, maxX, maxZ; // The same rectangle in world units
+};
+
+// Copy of the heights and normals under a world rectangle, sampled like the terrain itself. Jobs which run
+// while the main thread goes on read the copy, the terrain may be edited or paged in the meantime.
+// Points outside the rectangle get the height of its nearest edge.
+struct TerrainPatch {
+    float originX = 0.0f, originZ = 0.0f; // World position of the terrain's first sample
+    float invScaleX = 1.0f, invScaleZ = 1.0f, scaleY = 1.0f;
+    int x0 = 0, z0 = 0;                   // First sample of the copy
+    int width = 0, depth = 0;
+    vector<float> heights;                // Normalized, row major
+    vector<Vector3> normals;
+
+    void GetTerrainYBatch(const float* x, const float* z, float* y, int count) const;
+    Vector3 GetTerrainNormal(float x, float z) const;
+};
+
 class QuadTreeTerrainComponent : public Component
 {
 public:
@@ -43,25 +83,56 @@ public:
     int HeightMapDepth = 256; // Default, will be overridden
     int NumTriangles = 0;
     bool DebugShowBounds = false; // Toggle for drawing bounding boxes
+    bool CompactStorage = false; // Keep heights as uint16 and normals octahedral encoded, set before CreateFromFile
 
     const int MaxQuadTreeDepth = 7; // Max depth of the quadtree (adjust as needed for map size)
     const float LevelOfDetailDistance = 4.5f; // Lower value = subdivide sooner (higher detail)
+    const int MaxChunkQuads = 64; // Max quads per chunk side, larger (far away) nodes are drawn with a coarser step
+
+    float StreamingRadius = 256.0f; // World space radius around the camera kept resident by the tile stream
+    unsigned int ChunkCacheFrames = 600; // Cached chunk meshes not drawn for this many frames are released
 
     QuadTreeTerrainComponent();
 	~QuadTreeTerrainComponent();
 
     virtual bool CreateFromFile(Vector3 terrainDimension, Vector2 texTileSize, const char* pHightmapFilePath, const char* pTerrainTexurePath);
+    virtual bool CreateFromTiledFile(Vector3 terrainDimension, Vector2 texTileSize, const char* pTiledHightmapFilePath, const char* pTerrainTexurePath, size_t memoryBudget = 256 * 1024 * 1024);
 
 	void Update(float ElapsedSeconds, RenderHints* pRH = nullptr) override;
 	void Draw(RenderHints *pRH = nullptr) override;
 
     float GetHeightmapValue(int x, int z);
     float GetTerrainY(float x, float y);
+    // GetTerrainY for count points at once, y may alias neither x nor z
+    void GetTerrainYBatch(const float* x, const float* z, float* y, int count);
 
 	float GetTerrainYForBoundingBox(BoundingBox box, float weight = 1.0f);
 
     Vector3 GetHeightmapNormal(int x, int y);
     Vector3 GetSmoothedNormal(float x, float z);
+    // Normal of the heightmap sample nearest to a world position, only safe on jobs the main thread waits for, like GetTerrainYBatch
+    Vector3 GetTerrainNormal(float x, float z);
+    void GetHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight);
+    // Copy the samples GetTerrainYBatch and GetTerrainNormal read for points in the world rectangle
+    void CopyPatch(float minX, float minZ, float maxX, float maxZ, TerrainPatch& patch);
+
+    // The height changes of the last two frames, oldest first. Every change stays listed for at least one whole
+    // frame, so a reader checking once a frame for serials above the last one it handled misses none.
+    const vector<TerrainHeightChange>& GetHeightChanges() const { return heightChanges; }
+    unsigned int GetHeightChangeSerial() const { return heightChangeSerial; } // Serial of the latest change
+
+    // Terrain editing (not available for tiled heightmaps). Only the edited area is reprocessed.
+    void StampBrush(Vector3 worldCenter, float radius, float heightDelta);
+    void SetHeightRegion(int x0, int z0, int width, int depth, const float* pHeights);
+
+    TerrainTileStream* GetTileStream() { return tileStream; }
+    const QuadTreeNode* GetRootNode() const { return rootNode; }
+
+    size_t GetHeightmapMemorySize() const;
+    // Log the sampling cost of float against compact storage, in-memory heightmaps only, see BonusGameWorld02 -benchmark
+    void RunSamplingBenchmark(int numSamples = 1 << 20);
+    // Check that compact storage keeps an edit below its original lowest height, see BonusGameWorld02 -benchmark
+    bool RunCompactEditCheck();
 
     int NumMaterial = 0;
 	Material* materials = nullptr; // Array of materials for the terrain
@@ -75,15 +146,50 @@ protected:
     QuadTreeNode* rootNode = nullptr; // Root of the quadtree
     vector<float> heightmap; // Stores normalized height values (0.0 to 1.0)
     vector<Vector3> heightMapNormals; // store normal of each heightmap pixel 
+    vector<unsigned short> compactHeights; // CompactStorage heights, height = heightOffset + value * heightStep
+    vector<unsigned int> compactNormals; // CompactStorage normals, see EncodeOctahedralNormal
+    float heightOffset = 0.0f;
+    float heightStep = 1.0f / 65535.0f;
+
+    // Min/max height pyramid, level 0 has one entry per HEIGHT_RANGE_BLOCK_SIZE block, every level halves the resolution
+    struct HeightRangeLevel {
+        int width = 0;
+        int depth = 0;
+        int blockSize = 0;     // Quads per side covered by one entry
+        vector<Vector2> minMax; // x = min, y = max normalized height
+    };
+    vector<HeightRangeLevel> heightRangePyramid;
     Texture2D terrainTexture = { 0 };
     Vector2 tilingFactor = { 1.0f, 1.0f }; // How many times the texture repeats across the terrain
     Vector3 terrainScale = { 2.0f, 35.0f, 2.0f }; // Scale for X, Z and Y axes
 	Vector3 terrainDimension = { 128.0f, 128.0f }; // Dimension of the terrain in world units
+    TerrainTileStream* tileStream = nullptr; // Paged heightmap, replaces heightmap/heightMapNormals when set
 
     bool LoadHeightmapFromImage(const char* fileName);
+    bool CreateTerrain(Vector3 dimension, Vector2 texTileSize, const char* pTerrainTexurePath);
+    void BuildCompactStorage();
+    void BuildHeightRangePyramid();
+    void UpdateHeightRangePyramid(int x0, int z0, int x1, int z1);
+    void UpdateNodeHeightBounds(QuadTreeNode* node);
     void BuildQuadtreeNode(QuadTreeNode* node);
     void DrawQuadtreeNode(QuadTreeNode* node, SceneCamera *pCam, bool drawBounds, const FrustumPlane frustumPlanes[6]);
     void DrawTerrainChunk(QuadTreeNode* node);
+    Mesh* BuildChunkMesh(QuadTreeNode* node);
+    void ReleaseUnusedChunks();
+
+    void SetHeightmapValue(int x, int z, float height);
+    void ReserveCompactRange(float minHeight, float maxHeight);
+    void UpdateNormals(int x0, int z0, int x1, int z1);
+    void ApplyHeightChanges(int x0, int z0, int x1, int z1);
+    void RecordHeightChange(int x0, int z0, int x1, int z1);
+    void UpdateNodesInRect(QuadTreeNode* node, int x0, int z0, int x1, int z1, bool updateBounds);
+    void GetNodeSampleRect(const QuadTreeNode* node, int& x0, int& z0, int& x1, int& z1);
+
+    vector<QuadTreeNode*> cachedChunkNodes; // Nodes holding a chunk mesh
+    unsigned int frameCounter = 0;
+
+    vector<TerrainHeightChange> heightChanges;
+    unsigned int heightChangeSerial = 0;
 
     void GatherNodesToDraw(QuadTreeNode* node, SceneCamera* pCamera, const FrustumPlane frustumPlanes[6]);
 };
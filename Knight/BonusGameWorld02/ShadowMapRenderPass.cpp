@@ -3,6 +3,7 @@
 #include "rlgl.h"
 
 #include "ShadowMapRenderPass.h"
+#include "ParticleRenderBatcher.h"
 
 ShadowMapRenderPass::ShadowMapRenderPass(ShadowSceneLight* l, int id)
 {
@@ -19,7 +20,7 @@ bool ShadowMapRenderPass::Create(Scene *sc)
 {
 	__super::Create(sc);
 
-	shadowShader = LoadShader("../../resources/shaders/glsl330/shadowmap.vs", "../../resources/shaders/glsl330/kn-lit-sm-pcf.fs");
+	shadowShader = ResourceRegistry::Instance().AcquireShader(vertexShaderFileName, fragmentShaderFileName);
 	lightDirLoc = GetShaderLocation(shadowShader, "lightDir");
 	lightColLoc = GetShaderLocation(shadowShader, "lightColor");
 	shadowShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(shadowShader, "viewPos");
@@ -44,7 +45,7 @@ bool ShadowMapRenderPass::Create(Scene *sc)
 /// Release - Override standard release function to unload shadow map shader
 void ShadowMapRenderPass::Release()
 {
-	UnloadShader(shadowShader);
+	ResourceRegistry::Instance().ReleaseShader(shadowShader);
 }
 
 /// <summary>
@@ -73,21 +74,7 @@ bool ShadowMapRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 		}
 	}
 
-	switch (pSC->renderQueue)
-	{
-		case Component::eRenderQueueType::Background:
-			pScene->_RenderQueue.Background.push_back(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Geometry:
-			pScene->_RenderQueue.Geometry.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::AlphaBlend:
-			pScene->_RenderQueue.AlphaBlending.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Overlay:
-			pScene->_RenderQueue.Overlay.push_back(RenderContext{ pSC, dist2 });
-			break;
-	}
+	AddToRenderQueue(pSC, dist2);
 
 	return true;
 }
@@ -113,8 +100,7 @@ void ShadowMapRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 	pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//update lighting changes (if any)
 	Vector4 lightColorNormalized = ColorNormalize(pLight->lightColor);
@@ -143,7 +129,7 @@ void ShadowMapRenderPass::Render()
 	while (bk != pScene->_RenderQueue.Background.end()) {
 		int receiveShadow = bk->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -152,7 +138,7 @@ void ShadowMapRenderPass::Render()
 	while (opaque != pScene->_RenderQueue.Geometry.end()) {
 		int receiveShadow = opaque->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 	
@@ -164,19 +150,23 @@ void ShadowMapRenderPass::Render()
 		BeginBlendMode(alpha->pComponent->blendingMode);
 		int receiveShadow = alpha->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		rlEnableDepthMask();
 		rlEnableBackfaceCulling();
 		++alpha;
 	}
+
+	//the particle emitters only queued their particles in the alpha loop, draw them in batches now
+	if (pActiveCamera != nullptr)
+		ParticleRenderBatcher::Instance().Flush(*pActiveCamera->GetCamera3D());
 	
 	//render overlay first
 	vector<RenderContext>::iterator overlay = pScene->_RenderQueue.Overlay.begin();
 	while (overlay != pScene->_RenderQueue.Overlay.end()) {
 		int receiveShadow = overlay->pComponent->receiveShadow ? 1 : 0;
 		SetShaderValue(shadowShader, receiveShadowLoc, &receiveShadow, SHADER_UNIFORM_INT);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		++overlay;
 	}	
 }
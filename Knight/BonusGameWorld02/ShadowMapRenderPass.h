@@ -32,4 +32,9 @@ class ShadowMapRenderPass : public ForwardRenderPass
 		int lightVPLoc = -1;
 		int shadowMapLoc = -1;
 		int receiveShadowLoc = -1;
+
+	protected:
+		// Derived passes can bring their own lighting shader with the same uniforms
+		const char* vertexShaderFileName = "../../resources/shaders/glsl330/shadowmap.vs";
+		const char* fragmentShaderFileName = "../../resources/shaders/glsl330/kn-lit-sm-pcf.fs";
 };
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "OrthogonalCamera.h"
 
+#define MAX_SHADOW_CASCADES 4 //cascades of a directional light shadow map
+
 typedef enum {
 	DIRECTIONAL_LIGHT = 0, // Directional light (infinite distance)
 	POINT_LIGHT,           // Point light (omnidirectional)
@@ -25,6 +27,12 @@ class ShadowSceneLight : public OrthogonalCamera
 		Color lightColor = WHITE;
 		Color lightAmbient = CLITERAL(Color) { 50, 50, 50, 255 };
 		SceneLightType lightType = DIRECTIONAL_LIGHT;
+
+		// Cascaded shadow maps, filled by CascadedDepthRenderPass for the shadow receivers
+		int numCascades = 0;
+		Matrix cascadeViewProj[MAX_SHADOW_CASCADES] = { 0 };
+		float cascadeSplits[MAX_SHADOW_CASCADES] = { 0 };		// view depth where each cascade ends
+		float cascadeTexelSize[MAX_SHADOW_CASCADES] = { 0 };	// world units covered by a shadow map texel
 };
 
 
@@ -1,15 +1,34 @@
 //TerrainEntity class implementation.
 #include <random>
+#include <algorithm>
 
 #include "BonusGameWorld02.h"
 
+//Set to 1 to stream the terrain heights from a tiled height file instead of keeping the whole map in memory
+#define USE_TILED_TERRAIN 0
+//Set to 0 to create a SceneActor with a BillboardComponent for every imposter instead of one batch
+#define USE_BILLBOARD_BATCH 1
+//Set to 0 to leave out the procedural foliage
+#define USE_FOLIAGE_SCATTER 1
+
 bool TerrainEntity::Create(Scene* pScene, Entity* pContainer)
 {
 	_Actor = pScene->CreateSceneObject<SceneActor>("Terrain");
 	_Terrain = _Actor->CreateAndAddComponent<QuadTreeTerrainComponent>();
 	_Terrain->receiveShadow = true;
 	_Terrain->castShadow = Component::eShadowCastingType::Shadow;
+	_Terrain->isStatic = true; //kept in the cached shadow map, BonusGameWorld02::Update refreshes it when the heights change
+	_Terrain->CompactStorage = true; //uint16 heights and octahedral normals, "-benchmark" logs the sampling cost
+#if USE_TILED_TERRAIN
+	//page the heights from a tiled 16-bit height file, converted from the png on first run
+	const char* pTiledHeightmapPath = "../../resources/textures/heightmap.ktt";
+	if (!FileExists(pTiledHeightmapPath)) {
+		TerrainTileStream::ConvertFromImage("../../resources/textures/heightmap.png", pTiledHeightmapPath, 128);
+	}
+	bool success = _Terrain->CreateFromTiledFile(Vector3{ 512,16,512 }, Vector2{ 1,1 }, pTiledHeightmapPath, "../../resources/textures/terrain_map.png", 64 * 1024 * 1024);
+#else
 	bool success = _Terrain->CreateFromFile(Vector3{ 512,16,512 }, Vector2{ 1,1 }, "../../resources/textures/heightmap.png", "../../resources/textures/terrain_map.png");	
+#endif
 
 	if (!success)
 	{
@@ -17,9 +36,6 @@ bool TerrainEntity::Create(Scene* pScene, Entity* pContainer)
 		return false;
 	}
 
-	//Load a texture as billboard image
-	treeImage = LoadTexture("../../resources/textures/p15-2.png");    // Our tree billboard texture
-	robotImage = LoadTexture("../../resources/textures/p13.png");    // Our robot billboard texture
 	// Create a random device and seed the Mersenne Twister engine
 	random_device rd;
 	mt19937 gen(rd());
@@ -32,6 +48,46 @@ bool TerrainEntity::Create(Scene* pScene, Entity* pContainer)
 
 	//create billboard imposters on the terrain
 
+#if USE_BILLBOARD_BATCH
+	//the tree and robot images side by side in one atlas, so the far to near sorted imposters are drawn
+	//with one call instead of a new one at every switch between the two
+	Image treePixels = LoadImage("../../resources/textures/p15-2.png");
+	Image robotPixels = LoadImage("../../resources/textures/p13.png");
+	ImageFormat(&treePixels, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	ImageFormat(&robotPixels, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	const int atlasPadding = 4; //transparent gap, the filtering of one image must not reach into the other
+	Rectangle treeSource = { 0.0f, 0.0f, (float)treePixels.width, (float)treePixels.height };
+	Rectangle robotSource = { (float)(treePixels.width + atlasPadding), 0.0f, (float)robotPixels.width, (float)robotPixels.height };
+	Image atlas = GenImageColor(treePixels.width + atlasPadding + robotPixels.width, std::max(treePixels.height, robotPixels.height), BLANK);
+	ImageDraw(&atlas, treePixels, Rectangle{ 0.0f, 0.0f, treeSource.width, treeSource.height }, treeSource, WHITE);
+	ImageDraw(&atlas, robotPixels, Rectangle{ 0.0f, 0.0f, robotSource.width, robotSource.height }, robotSource, WHITE);
+	imposterAtlas = LoadTextureFromImage(atlas);
+	UnloadImage(atlas);
+	UnloadImage(treePixels);
+	UnloadImage(robotPixels);
+
+	//all imposters in one component, culled per cell and drawn with one call per texture
+	SceneActor* pImposterActor = pScene->CreateSceneObject<SceneActor>("Props");
+	pImposterBatch = pImposterActor->CreateAndAddComponent<BillboardBatchComponent>();
+	pImposterBatch->receiveShadow = true;
+	int atlasIndex = pImposterBatch->AddTexture(imposterAtlas);
+
+	for (int i = 0; i < 600; i++)
+	{
+		Vector3 position = Vector3{ randomTerrainRange(gen),0, randomTerrainRange(gen) };
+		Rectangle source = randomTerrainRange(gen) > 16.0f ? treeSource : robotSource;
+		Vector2 size = { randomSizeRange(gen), randomSizeRange(gen) };
+
+		//adjust height based on terrain
+		position.y = _Terrain->GetTerrainY(position.x, position.z) + size.y * 0.45f;
+		pImposterBatch->AddInstance(atlasIndex, position, size, source);
+	}
+	imposters.push_back(pImposterActor);
+#else
+	//Load a texture as billboard image
+	treeImage = LoadTexture("../../resources/textures/p15-2.png");    // Our tree billboard texture
+	robotImage = LoadTexture("../../resources/textures/p13.png");    // Our robot billboard texture
+
 	for (int i = 0; i < 600; i++)
 	{
 		//imposter (billboard)
@@ -63,6 +119,26 @@ bool TerrainEntity::Create(Scene* pScene, Entity* pContainer)
 
 		imposters.push_back(imposter);
 	}
+#endif
+
+#if USE_FOLIAGE_SCATTER
+	//trees grow on gentle slopes below the peaks, generated around the camera as it moves
+	foliageImage = LoadTexture("../../resources/textures/tree01.png");
+	SceneActor* pFoliageActor = pScene->CreateSceneObject<SceneActor>("Foliage");
+	pFoliage = pFoliageActor->CreateAndAddComponent<FoliageScatterComponent>();
+	if (pFoliage->Create(_Terrain))
+	{
+		FoliageLayer trees;
+		trees.texture = foliageImage;
+		trees.density = 0.02f;
+		trees.minSize = Vector2{ 2.0f, 3.0f };
+		trees.maxSize = Vector2{ 4.0f, 6.0f };
+		trees.maxHeight = 12.0f;
+		trees.maxSlope = 25.0f;
+		trees.castShadow = true;
+		pFoliage->AddLayer(trees);
+	}
+#endif
 
 	for (int i = 0; i < 20; i++) {
 		// Set up particle system
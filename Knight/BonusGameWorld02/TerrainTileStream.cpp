@@ -0,0 +1,596 @@
+#include "TerrainTileStream.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+TerrainTileStream::TerrainTileStream()
+{
+}
+
+TerrainTileStream::~TerrainTileStream()
+{
+	Close();
+}
+
+/// <summary>
+/// WriteTiledHeightFile - Write a tiled height file from a row reader. Only one band of
+/// (tileSize + 2 * border) rows is kept in memory, so maps larger than RAM can be converted.
+/// </summary>
+/// <param name="width">Samples along X.</param>
+/// <param name="depth">Samples along Z.</param>
+/// <param name="tileSize">Samples per tile side.</param>
+/// <param name="readRow">Fills width 16-bit samples of row z, returns false on error.</param>
+/// <param name="outFileName">The tiled height file to write.</param>
+/// <returns>true if the file was written.</returns>
+static bool WriteTiledHeightFile(int width, int depth, int tileSize, const function<bool(int, unsigned short*)>& readRow, const char* outFileName)
+{
+	if (width < 2 || depth < 2 || tileSize < 2)
+		return false;
+
+	const int border = TERRAIN_TILE_BORDER;
+	const int tileSide = tileSize + 2 * border;
+
+	TerrainTileFileHeader header = { 0 };
+	header.magic = TERRAIN_TILE_FILE_MAGIC;
+	header.version = TERRAIN_TILE_FILE_VERSION;
+	header.width = width;
+	header.depth = depth;
+	header.tileSize = tileSize;
+	header.border = border;
+	header.tilesX = (width + tileSize - 1) / tileSize;
+	header.tilesZ = (depth + tileSize - 1) / tileSize;
+	header.overviewStep = std::max(1, (std::max(width, depth) + TERRAIN_TILE_MAX_OVERVIEW - 1) / TERRAIN_TILE_MAX_OVERVIEW);
+	header.overviewWidth = (width - 1) / header.overviewStep + 1;
+	header.overviewDepth = (depth - 1) / header.overviewStep + 1;
+
+	size_t numTiles = (size_t)header.tilesX * header.tilesZ;
+	header.tileTableOffset = sizeof(TerrainTileFileHeader);
+	header.overviewOffset = header.tileTableOffset + numTiles * sizeof(TerrainTileRecord);
+	header.tileDataOffset = (header.overviewOffset + (unsigned long long)header.overviewWidth * header.overviewDepth * sizeof(unsigned short) + 15) & ~15ull;
+	header.tileStride = (unsigned long long)tileSide * tileSide * sizeof(unsigned short);
+
+	vector<TerrainTileRecord> records(numTiles);
+	vector<unsigned short> overview((size_t)header.overviewWidth * header.overviewDepth);
+	vector<unsigned short> band((size_t)tileSide * width);
+	vector<unsigned short> tile((size_t)tileSide * tileSide);
+
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, outFileName, "wb") != 0 || fp == nullptr)
+		return false;
+
+	//reserve the space of header, tile table and overview, they are written at the end
+	vector<unsigned char> zeros((size_t)header.tileDataOffset, 0);
+	bool success = fwrite(zeros.data(), 1, zeros.size(), fp) == zeros.size();
+
+	for (int tz = 0; tz < header.tilesZ && success; tz++)
+	{
+		for (int r = 0; r < tileSide && success; r++) {
+			int z = std::min(std::max(tz * tileSize - border + r, 0), depth - 1);
+			success = readRow(z, &band[(size_t)r * width]);
+		}
+
+		for (int r = border; r < border + tileSize && success; r++) {
+			int z = tz * tileSize + r - border;
+			if (z >= depth || z % header.overviewStep != 0)
+				continue;
+			for (int ox = 0; ox < header.overviewWidth; ox++) {
+				overview[(size_t)(z / header.overviewStep) * header.overviewWidth + ox] = band[(size_t)r * width + ox * header.overviewStep];
+			}
+		}
+
+		for (int tx = 0; tx < header.tilesX && success; tx++)
+		{
+			unsigned short minHeight = 0xffff;
+			unsigned short maxHeight = 0;
+			for (int r = 0; r < tileSide; r++) {
+				for (int c = 0; c < tileSide; c++) {
+					int x = std::min(std::max(tx * tileSize - border + c, 0), width - 1);
+					unsigned short h = band[(size_t)r * width + x];
+					tile[(size_t)r * tileSide + c] = h;
+					minHeight = std::min(minHeight, h);
+					maxHeight = std::max(maxHeight, h);
+				}
+			}
+			records[(size_t)tz * header.tilesX + tx] = { minHeight, maxHeight };
+			success = fwrite(tile.data(), sizeof(unsigned short), tile.size(), fp) == tile.size();
+		}
+	}
+
+	if (success) {
+		fseek(fp, 0, SEEK_SET);
+		success = fwrite(&header, sizeof(header), 1, fp) == 1
+			&& fwrite(records.data(), sizeof(TerrainTileRecord), records.size(), fp) == records.size()
+			&& fwrite(overview.data(), sizeof(unsigned short), overview.size(), fp) == overview.size();
+	}
+	fclose(fp);
+
+	if (!success) {
+		TraceLog(LOG_ERROR, "<TerrainTileStream> Failed to write tiled height file %s", outFileName);
+		remove(outFileName);
+	}
+	return success;
+}
+
+/// <summary>
+/// ConvertFromImage - Convert a grayscale heightmap image into a tiled height file.
+/// </summary>
+/// <param name="imageFileName">The heightmap image.</param>
+/// <param name="outFileName">The tiled height file to write.</param>
+/// <param name="tileSize">Samples per tile side.</param>
+/// <returns>true if the file was written.</returns>
+bool TerrainTileStream::ConvertFromImage(const char* imageFileName, const char* outFileName, int tileSize)
+{
+	if (!FileExists(imageFileName))
+		return false;
+
+	Image image = LoadImage(imageFileName);
+	if (image.data == nullptr)
+		return false;
+
+	ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+	const unsigned char* pPixels = (const unsigned char*)image.data;
+	int width = image.width;
+
+	bool success = WriteTiledHeightFile(image.width, image.height, tileSize, [pPixels, width](int z, unsigned short* pRow) {
+		for (int x = 0; x < width; x++) {
+			pRow[x] = (unsigned short)(pPixels[(size_t)z * width + x] * 257); //0..255 to 0..65535
+		}
+		return true;
+	}, outFileName);
+
+	UnloadImage(image);
+	return success;
+}
+
+/// <summary>
+/// ConvertFromRaw16 - Convert a raw little endian 16-bit heightmap (e.g. exported from a terrain tool)
+/// into a tiled height file. The source is read row by row and never loaded as a whole.
+/// </summary>
+/// <param name="rawFileName">The raw heightmap.</param>
+/// <param name="width">Samples along X.</param>
+/// <param name="depth">Samples along Z.</param>
+/// <param name="outFileName">The tiled height file to write.</param>
+/// <param name="tileSize">Samples per tile side.</param>
+/// <returns>true if the file was written.</returns>
+bool TerrainTileStream::ConvertFromRaw16(const char* rawFileName, int width, int depth, const char* outFileName, int tileSize)
+{
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, rawFileName, "rb") != 0 || fp == nullptr)
+		return false;
+
+	bool success = WriteTiledHeightFile(width, depth, tileSize, [fp, width](int z, unsigned short* pRow) {
+		if (_fseeki64(fp, (long long)z * width * sizeof(unsigned short), SEEK_SET) != 0)
+			return false;
+		return fread(pRow, sizeof(unsigned short), width, fp) == (size_t)width;
+	}, outFileName);
+
+	fclose(fp);
+	return success;
+}
+
+/// <summary>
+/// ComputeNormal - Average the face normals around a height sample. A face is skipped when one
+/// of its neighbours is outside the map.
+/// </summary>
+/// <param name="h">The sample height in world units.</param>
+/// <param name="neighbours">Heights of the left(-x), right(+x), down(-z) and up(+z) neighbours.</param>
+/// <param name="valid">Whether each neighbour is inside the map.</param>
+/// <param name="sampleScale">World space distance between samples along x and z, and the height scale.</param>
+/// <returns>The normalized vertex normal.</returns>
+Vector3 TerrainTileStream::ComputeNormal(float h, const float neighbours[4], const bool valid[4], Vector3 sampleScale)
+{
+	Vector3 edges[4] = {
+		{ -sampleScale.x, neighbours[0] - h, 0.0f },
+		{ sampleScale.x, neighbours[1] - h, 0.0f },
+		{ 0.0f, neighbours[2] - h, -sampleScale.z },
+		{ 0.0f, neighbours[3] - h, sampleScale.z }
+	};
+
+	//(left, up), (right, down), (down, left), (up, right) keep the normals pointing up
+	const int faces[4][2] = { {0, 3}, {1, 2}, {2, 0}, {3, 1} };
+	Vector3 normal = { 0, 0, 0 };
+	for (auto& face : faces) {
+		if (valid[face[0]] && valid[face[1]])
+			normal = Vector3Add(normal, Vector3CrossProduct(edges[face[0]], edges[face[1]]));
+	}
+	return Vector3Normalize(normal);
+}
+
+/// <summary>
+/// Open - Open a tiled height file. Only the header, tile table and overview are touched here,
+/// tiles are paged in by Update.
+/// </summary>
+/// <param name="fileName">The tiled height file.</param>
+/// <param name="terrainDimension">World space size of the terrain, used to compute the normals.</param>
+/// <param name="memoryBudget">Maximum bytes of resident tile data.</param>
+/// <returns>false if the file is missing or invalid.</returns>
+bool TerrainTileStream::Open(const char* fileName, Vector3 terrainDimension, size_t memoryBudget)
+{
+	Close();
+
+	if (!_File.Open(fileName)) {
+		TraceLog(LOG_ERROR, "<TerrainTileStream.Open> Failed to map %s", fileName);
+		return false;
+	}
+
+	const TerrainTileFileHeader* pHeader = (const TerrainTileFileHeader*)_File.Map(0, sizeof(TerrainTileFileHeader));
+	if (pHeader == nullptr || pHeader->magic != TERRAIN_TILE_FILE_MAGIC || pHeader->version != TERRAIN_TILE_FILE_VERSION) {
+		TraceLog(LOG_ERROR, "<TerrainTileStream.Open> %s is not a tiled height file", fileName);
+		_File.Close();
+		return false;
+	}
+	_Header = *pHeader;
+	_File.Unmap(pHeader);
+
+	size_t numTiles = (size_t)_Header.tilesX * _Header.tilesZ;
+	if (_Header.tileDataOffset + numTiles * _Header.tileStride > _File.GetSize()) {
+		TraceLog(LOG_ERROR, "<TerrainTileStream.Open> %s is truncated", fileName);
+		_File.Close();
+		return false;
+	}
+
+	_pTileRecords = (const TerrainTileRecord*)_File.Map(_Header.tileTableOffset, numTiles * sizeof(TerrainTileRecord));
+	_pOverview = (const unsigned short*)_File.Map(_Header.overviewOffset, (size_t)_Header.overviewWidth * _Header.overviewDepth * sizeof(unsigned short));
+	if (_pTileRecords == nullptr || _pOverview == nullptr) {
+		Close();
+		return false;
+	}
+
+	Vector3 sampleScale = { terrainDimension.x / _Header.width, terrainDimension.y, terrainDimension.z / _Header.depth };
+	_SampleScale = sampleScale;
+	MemoryBudget = memoryBudget;
+
+	_Tiles.assign(numTiles, nullptr);
+	_TileRequested.assign(numTiles, 0);
+	_ResidentTiles.clear();
+	_ResidentBytes = 0;
+
+	//normals of the always resident overview, used until the tile arrives
+	int ow = _Header.overviewWidth;
+	int od = _Header.overviewDepth;
+	Vector3 overviewScale = { sampleScale.x * _Header.overviewStep, sampleScale.y, sampleScale.z * _Header.overviewStep };
+	_OverviewNormals.resize((size_t)ow * od);
+	JobSystem::Instance().ParallelFor(od, 16, [this, ow, od, overviewScale](int begin, int end) {
+		for (int z = begin; z < end; z++) {
+			for (int x = 0; x < ow; x++) {
+				int nx[4] = { x - 1, x + 1, x, x };
+				int nz[4] = { z, z, z - 1, z + 1 };
+				float neighbours[4];
+				bool valid[4];
+				for (int i = 0; i < 4; i++) {
+					valid[i] = nx[i] >= 0 && nz[i] >= 0 && nx[i] < ow && nz[i] < od;
+					neighbours[i] = valid[i] ? _pOverview[(size_t)nz[i] * ow + nx[i]] / 65535.0f * overviewScale.y : 0.0f;
+				}
+				float h = _pOverview[(size_t)z * ow + x] / 65535.0f * overviewScale.y;
+				_OverviewNormals[(size_t)z * ow + x] = ComputeNormal(h, neighbours, valid, overviewScale);
+			}
+		}
+	});
+
+	TraceLog(LOG_INFO, "<TerrainTileStream.Open> %s: %dx%d samples, %dx%d tiles of %d, overview %dx%d", fileName,
+		_Header.width, _Header.depth, _Header.tilesX, _Header.tilesZ, _Header.tileSize, ow, od);
+	return true;
+}
+
+/// <summary>
+/// Close - Wait for the loads in flight and release all tiles. The jobs leave _CompletedLock before
+/// they count themselves done, so no worker is inside it once nothing is pending.
+/// </summary>
+void TerrainTileStream::Close()
+{
+	while (_NumPending.load() > 0) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	{
+		lock_guard<mutex> lock(_CompletedLock);
+		for (TerrainTile* pTile : _CompletedTiles) {
+			_File.Unmap(pTile->pHeights);
+			delete pTile;
+		}
+		_CompletedTiles.clear();
+	}
+
+	for (int index : _ResidentTiles) {
+		delete _Tiles[index];
+	}
+	_Tiles.clear();
+	_TileRequested.clear();
+	_ResidentTiles.clear();
+	_ResidentBytes = 0;
+	_OverviewNormals.clear();
+
+	_pTileRecords = nullptr;
+	_pOverview = nullptr;
+	_File.Close(); //unmaps all remaining views
+	_Header = { 0 };
+}
+
+size_t TerrainTileStream::GetTileBytes() const
+{
+	return (size_t)_Header.tileStride + (size_t)_Header.tileSize * _Header.tileSize * sizeof(Vector3);
+}
+
+/// <summary>
+/// LoadTile - Runs on a worker thread. Map the tile samples and compute its normals,
+/// touching every sample so the page faults happen here instead of on the main thread.
+/// </summary>
+/// <param name="index">The tile index.</param>
+/// <returns>The new tile, pHeights is nullptr if mapping failed.</returns>
+TerrainTileStream::TerrainTile* TerrainTileStream::LoadTile(int index)
+{
+	TerrainTile* pTile = new TerrainTile();
+	pTile->index = index;
+	pTile->pHeights = (const unsigned short*)_File.Map(_Header.tileDataOffset + (unsigned long long)index * _Header.tileStride, (size_t)_Header.tileStride);
+	if (pTile->pHeights == nullptr)
+		return pTile;
+
+	const int tileSize = _Header.tileSize;
+	const int border = _Header.border;
+	const int side = tileSize + 2 * border;
+	const int originX = (index % _Header.tilesX) * tileSize;
+	const int originZ = (index / _Header.tilesX) * tileSize;
+
+	pTile->normals.resize((size_t)tileSize * tileSize);
+	for (int lz = 0; lz < tileSize; lz++) {
+		for (int lx = 0; lx < tileSize; lx++) {
+			int x = originX + lx;
+			int z = originZ + lz;
+			const unsigned short* pCenter = pTile->pHeights + (size_t)(lz + border) * side + (lx + border);
+
+			float neighbours[4] = {
+				pCenter[-1] / 65535.0f * _SampleScale.y,
+				pCenter[1] / 65535.0f * _SampleScale.y,
+				pCenter[-side] / 65535.0f * _SampleScale.y,
+				pCenter[side] / 65535.0f * _SampleScale.y
+			};
+			bool valid[4] = { x > 0, x < _Header.width - 1, z > 0, z < _Header.depth - 1 };
+			pTile->normals[(size_t)lz * tileSize + lx] = ComputeNormal(pCenter[0] / 65535.0f * _SampleScale.y, neighbours, valid, _SampleScale);
+		}
+	}
+	pTile->residentBytes = GetTileBytes();
+	return pTile;
+}
+
+void TerrainTileStream::RequestTile(int index)
+{
+	_TileRequested[index] = 1;
+	_NumPending++;
+
+	JobSystem::Instance().Submit([this, index]() {
+		TerrainTile* pTile = LoadTile(index);
+		{
+			lock_guard<mutex> lock(_CompletedLock);
+			_CompletedTiles.push_back(pTile);
+		}
+		//last, Close may destroy the stream as soon as nothing is pending
+		_NumPending--;
+	});
+}
+
+void TerrainTileStream::EvictTile(int index)
+{
+	TerrainTile* pTile = _Tiles[index];
+	if (pTile == nullptr)
+		return;
+
+	_Tiles[index] = nullptr;
+	_ResidentBytes -= pTile->residentBytes;
+	auto it = std::find(_ResidentTiles.begin(), _ResidentTiles.end(), index);
+	if (it != _ResidentTiles.end()) {
+		*it = _ResidentTiles.back();
+		_ResidentTiles.pop_back();
+	}
+
+	_File.Unmap(pTile->pHeights);
+	delete pTile;
+	_ChangedTiles.push_back(index);
+	NumTilesEvicted++;
+}
+
+/// <summary>
+/// Update - Publish the tiles loaded since the last frame, request the missing tiles around the
+/// focus (nearest first) and evict the least recently used tiles to stay inside MemoryBudget.
+/// Must be called from the main thread, it is the only place tiles are added or removed.
+/// </summary>
+/// <param name="focusX">Focus sample x, usually the camera position.</param>
+/// <param name="focusZ">Focus sample z.</param>
+/// <param name="radius">Radius in samples to keep resident.</param>
+void TerrainTileStream::Update(int focusX, int focusZ, int radius)
+{
+	if (!_File.IsOpen())
+		return;
+
+	_FrameCounter++;
+	_ChangedTiles.clear();
+
+	vector<TerrainTile*> completed;
+	{
+		lock_guard<mutex> lock(_CompletedLock);
+		completed.swap(_CompletedTiles);
+	}
+	for (TerrainTile* pTile : completed) {
+		if (pTile->pHeights == nullptr) {
+			TraceLog(LOG_WARNING, "<TerrainTileStream.Update> Failed to map tile %d", pTile->index);
+			_TileRequested[pTile->index] = 2; //don't retry
+			delete pTile;
+			continue;
+		}
+		_TileRequested[pTile->index] = 0;
+		pTile->lastUsedFrame = _FrameCounter;
+		_Tiles[pTile->index] = pTile;
+		_ResidentTiles.push_back(pTile->index);
+		_ResidentBytes += pTile->residentBytes;
+		_ChangedTiles.push_back(pTile->index);
+		NumTilesLoaded++;
+	}
+
+	const int tileSize = _Header.tileSize;
+	int tx0 = std::min(std::max((focusX - radius) / tileSize, 0), _Header.tilesX - 1);
+	int tz0 = std::min(std::max((focusZ - radius) / tileSize, 0), _Header.tilesZ - 1);
+	int tx1 = std::min(std::max((focusX + radius) / tileSize, 0), _Header.tilesX - 1);
+	int tz1 = std::min(std::max((focusZ + radius) / tileSize, 0), _Header.tilesZ - 1);
+
+	//mark the wanted tiles as used and collect the missing ones by distance
+	vector<pair<int, int>> missingTiles;
+	for (int tz = tz0; tz <= tz1; tz++) {
+		for (int tx = tx0; tx <= tx1; tx++) {
+			int index = tz * _Header.tilesX + tx;
+			if (_Tiles[index] != nullptr) {
+				_Tiles[index]->lastUsedFrame = _FrameCounter;
+			}
+			else if (_TileRequested[index] == 0) {
+				int dx = tx * tileSize + tileSize / 2 - focusX;
+				int dz = tz * tileSize + tileSize / 2 - focusZ;
+				missingTiles.push_back(make_pair(dx * dx + dz * dz, index));
+			}
+		}
+	}
+	std::sort(missingTiles.begin(), missingTiles.end());
+
+	auto evictLeastRecentlyUsed = [this]() {
+		int lruIndex = -1;
+		unsigned int lruFrame = _FrameCounter;
+		for (int index : _ResidentTiles) {
+			if (_Tiles[index]->lastUsedFrame < lruFrame) {
+				lruFrame = _Tiles[index]->lastUsedFrame;
+				lruIndex = index;
+			}
+		}
+		if (lruIndex < 0)
+			return false; //every resident tile is in use this frame
+		EvictTile(lruIndex);
+		return true;
+	};
+
+	const size_t tileBytes = GetTileBytes();
+	for (auto& missing : missingTiles) {
+		if (_NumPending.load() >= MaxLoadsInFlight)
+			break;
+
+		bool hasRoom = true;
+		while (_ResidentBytes + (_NumPending.load() + 1) * tileBytes > MemoryBudget) {
+			if (!evictLeastRecentlyUsed()) {
+				hasRoom = false;
+				break;
+			}
+		}
+		if (!hasRoom)
+			break;
+
+		RequestTile(missing.second);
+	}
+
+	while (_ResidentBytes > MemoryBudget && evictLeastRecentlyUsed());
+}
+
+/// <summary>
+/// GetTileRect - Sample rectangle covered by a tile, without the border.
+/// </summary>
+/// <param name="index">Tile index.</param>
+void TerrainTileStream::GetTileRect(int index, int& x0, int& z0, int& x1, int& z1) const
+{
+	const int tileSize = _Header.tileSize;
+	x0 = (index % _Header.tilesX) * tileSize;
+	z0 = (index / _Header.tilesX) * tileSize;
+	x1 = std::min(x0 + tileSize, _Header.width) - 1;
+	z1 = std::min(z0 + tileSize, _Header.depth) - 1;
+}
+
+/// <summary>
+/// GetHeight - Normalized height of a sample. Reads the resident tile, or interpolates the overview
+/// if the tile has not been paged in yet.
+/// </summary>
+/// <param name="x">Sample x.</param>
+/// <param name="z">Sample z.</param>
+/// <returns>Height in 0.0 ~ 1.0</returns>
+float TerrainTileStream::GetHeight(int x, int z) const
+{
+	if (_Tiles.empty())
+		return 0.0f;
+
+	x = std::min(std::max(x, 0), _Header.width - 1);
+	z = std::min(std::max(z, 0), _Header.depth - 1);
+
+	const int tileSize = _Header.tileSize;
+	int tx = x / tileSize;
+	int tz = z / tileSize;
+	const TerrainTile* pTile = _Tiles[tz * _Header.tilesX + tx];
+	if (pTile != nullptr) {
+		int side = tileSize + 2 * _Header.border;
+		return pTile->pHeights[(size_t)(z - tz * tileSize + _Header.border) * side + (x - tx * tileSize + _Header.border)] / 65535.0f;
+	}
+
+	//bilinear interpolation of the overview
+	const int step = _Header.overviewStep;
+	const int ow = _Header.overviewWidth;
+	int ox0 = x / step;
+	int oz0 = z / step;
+	int ox1 = std::min(ox0 + 1, ow - 1);
+	int oz1 = std::min(oz0 + 1, _Header.overviewDepth - 1);
+	float fx = (float)(x - ox0 * step) / step;
+	float fz = (float)(z - oz0 * step) / step;
+
+	float h0 = Lerp(_pOverview[(size_t)oz0 * ow + ox0], _pOverview[(size_t)oz0 * ow + ox1], fx);
+	float h1 = Lerp(_pOverview[(size_t)oz1 * ow + ox0], _pOverview[(size_t)oz1 * ow + ox1], fx);
+	return Lerp(h0, h1, fz) / 65535.0f;
+}
+
+/// <summary>
+/// GetNormal - Normal of a sample, from the resident tile or the closest overview sample.
+/// </summary>
+/// <param name="x">Sample x.</param>
+/// <param name="z">Sample z.</param>
+/// <returns>The normalized normal.</returns>
+Vector3 TerrainTileStream::GetNormal(int x, int z) const
+{
+	if (_Tiles.empty())
+		return Vector3{ 0.0f, 1.0f, 0.0f };
+
+	x = std::min(std::max(x, 0), _Header.width - 1);
+	z = std::min(std::max(z, 0), _Header.depth - 1);
+
+	const int tileSize = _Header.tileSize;
+	int tx = x / tileSize;
+	int tz = z / tileSize;
+	const TerrainTile* pTile = _Tiles[tz * _Header.tilesX + tx];
+	if (pTile != nullptr) {
+		return pTile->normals[(size_t)(z - tz * tileSize) * tileSize + (x - tx * tileSize)];
+	}
+
+	int ox = std::min((x + _Header.overviewStep / 2) / _Header.overviewStep, _Header.overviewWidth - 1);
+	int oz = std::min((z + _Header.overviewStep / 2) / _Header.overviewStep, _Header.overviewDepth - 1);
+	return _OverviewNormals[(size_t)oz * _Header.overviewWidth + ox];
+}
+
+/// <summary>
+/// GetHeightRange - Conservative normalized height range of a sample rectangle from the per tile min/max.
+/// </summary>
+void TerrainTileStream::GetHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const
+{
+	minHeight = 0.0f;
+	maxHeight = 1.0f;
+	if (_pTileRecords == nullptr)
+		return;
+
+	const int tileSize = _Header.tileSize;
+	int tx0 = std::min(std::max(x0 / tileSize, 0), _Header.tilesX - 1);
+	int tz0 = std::min(std::max(z0 / tileSize, 0), _Header.tilesZ - 1);
+	int tx1 = std::min(std::max(x1 / tileSize, 0), _Header.tilesX - 1);
+	int tz1 = std::min(std::max(z1 / tileSize, 0), _Header.tilesZ - 1);
+
+	unsigned short minSample = 0xffff;
+	unsigned short maxSample = 0;
+	for (int tz = tz0; tz <= tz1; tz++) {
+		for (int tx = tx0; tx <= tx1; tx++) {
+			const TerrainTileRecord& record = _pTileRecords[tz * _Header.tilesX + tx];
+			minSample = std::min(minSample, record.minHeight);
+			maxSample = std::max(maxSample, record.maxHeight);
+		}
+	}
+	minHeight = minSample / 65535.0f;
+	maxHeight = maxSample / 65535.0f;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "raylib.h"
+#include "raymath.h"
+
+#include "MappedFile.h"
+
+using namespace std;
+
+// Tiled terrain height file (.ktt)
+//
+// [TerrainTileFileHeader]
+// [TerrainTileRecord x tilesX * tilesZ]  min/max height of every tile
+// [overview samples]                      every overviewStep-th sample, always resident
+// [tile samples x tilesX * tilesZ]        (tileSize + 2 * border)^2 samples per tile, row major
+//
+// All heights are unsigned 16-bit, 0..65535 maps to the normalized height 0.0..1.0.
+#define TERRAIN_TILE_FILE_MAGIC		0x3154544B	//"KTT1"
+#define TERRAIN_TILE_FILE_VERSION	1
+#define TERRAIN_TILE_DEFAULT_SIZE	256
+#define TERRAIN_TILE_BORDER			1
+#define TERRAIN_TILE_MAX_OVERVIEW	1024
+
+struct TerrainTileFileHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int width;			// samples along X of the whole terrain
+	int depth;			// samples along Z of the whole terrain
+	int tileSize;		// samples per tile side, without border
+	int border;			// extra samples stored on each side of a tile
+	int tilesX;
+	int tilesZ;
+	int overviewStep;	// the overview keeps every overviewStep-th sample
+	int overviewWidth;
+	int overviewDepth;
+	int reserved;
+	unsigned long long tileTableOffset;
+	unsigned long long overviewOffset;
+	unsigned long long tileDataOffset;
+	unsigned long long tileStride;	// bytes between two tiles
+};
+
+struct TerrainTileRecord
+{
+	unsigned short minHeight;
+	unsigned short maxHeight;
+};
+
+class TerrainTileStream
+{
+public:
+	TerrainTileStream();
+	~TerrainTileStream();
+
+	// Convert a grayscale image or a raw little endian 16-bit heightmap into a tiled height file
+	static bool ConvertFromImage(const char* imageFileName, const char* outFileName, int tileSize = TERRAIN_TILE_DEFAULT_SIZE);
+	static bool ConvertFromRaw16(const char* rawFileName, int width, int depth, const char* outFileName, int tileSize = TERRAIN_TILE_DEFAULT_SIZE);
+
+	// Smooth vertex normal from the left/right/down/up neighbour heights, heights in world units
+	static Vector3 ComputeNormal(float h, const float neighbours[4], const bool valid[4], Vector3 sampleScale);
+
+	bool Open(const char* fileName, Vector3 terrainDimension, size_t memoryBudget);
+	void Close();
+
+	// Main thread, once per frame: publish finished loads, request the tiles within radius
+	// samples around the focus sample and evict least recently used tiles over the budget
+	void Update(int focusX, int focusZ, int radius);
+
+	// Normalized height/normal of a sample, falls back to the overview when the tile is not resident
+	float GetHeight(int x, int z) const;
+	Vector3 GetNormal(int x, int z) const;
+
+	// Normalized height range of the samples in [x0, x1] x [z0, z1], from the tile table
+	void GetHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const;
+
+	int GetWidth() const { return _Header.width; }
+	int GetDepth() const { return _Header.depth; }
+	int GetTileSize() const { return _Header.tileSize; }
+
+	// Tiles paged in or evicted by the last Update, heights inside them changed resolution
+	const vector<int>& GetChangedTiles() const { return _ChangedTiles; }
+	// Sample rectangle [x0, x1] x [z0, z1] covered by a tile
+	void GetTileRect(int index, int& x0, int& z0, int& x1, int& z1) const;
+
+	size_t MemoryBudget = 256 * 1024 * 1024;
+	int MaxLoadsInFlight = 8;
+
+	//statistics
+	size_t GetResidentBytes() const { return _ResidentBytes; }
+	int GetNumResidentTiles() const { return (int)_ResidentTiles.size(); }
+	int GetNumPendingTiles() const { return _NumPending.load(); }
+	int NumTilesLoaded = 0;
+	int NumTilesEvicted = 0;
+
+protected:
+	struct TerrainTile
+	{
+		int index = 0;
+		const unsigned short* pHeights = nullptr;	// mapped samples including the border
+		vector<Vector3> normals;					// tileSize * tileSize
+		size_t residentBytes = 0;
+		unsigned int lastUsedFrame = 0;
+	};
+
+	TerrainTile* LoadTile(int index);
+	void RequestTile(int index);
+	void EvictTile(int index);
+	size_t GetTileBytes() const;
+
+	MappedFile _File;
+	TerrainTileFileHeader _Header = { 0 };
+	Vector3 _SampleScale = { 1.0f, 1.0f, 1.0f };
+
+	const TerrainTileRecord* _pTileRecords = nullptr;
+	const unsigned short* _pOverview = nullptr;
+	vector<Vector3> _OverviewNormals;
+
+	// owned by the main thread
+	vector<TerrainTile*> _Tiles;			// one slot per tile, nullptr when not resident
+	vector<unsigned char> _TileRequested;	// a load is in flight
+	vector<int> _ResidentTiles;
+	vector<int> _ChangedTiles;
+	size_t _ResidentBytes = 0;
+	unsigned int _FrameCounter = 0;
+
+	// filled by the loading jobs
+	vector<TerrainTile*> _CompletedTiles;
+	mutex _CompletedLock;
+	atomic<int> _NumPending{ 0 };
+};
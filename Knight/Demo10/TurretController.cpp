@@ -15,7 +15,7 @@ TurretController::TurretController(Scene* Scene, SceneActor* Cannon)
 	_Fireball->CreateAndAddComponent<SphereComponent>();
 	_Fireball->Position = _Cannon->Position;
 	_Fireball->Scale = Vector3{ 0.5f, 0.5f, 0.5f };
-	_Fireball->IsActive = false;
+	_Fireball->SetActive(false);
 	_IsLoaded = _FireballDuration;
 }
 
@@ -274,7 +274,7 @@ void TurretController::Update(float DeltaTime)
 	//Fire at the player
 	if (_IsLoaded == _FireballDuration && outputs[0] > 0.6f)
 	{
-		_Fireball->IsActive = true;
+		_Fireball->SetActive(true);
 		_FiringDir = _CannonDir;
 		_Fireball->Position = Vector3Add(_Cannon->Position, Vector3Scale(_FiringDir, 3.0f));
 		_IsLoaded = 0.0f;
@@ -288,7 +288,7 @@ void TurretController::Update(float DeltaTime)
 		if (_IsLoaded >= _FireballDuration)
 		{
 			_IsLoaded = _FireballDuration;
-			_Fireball->IsActive = false;
+			_Fireball->SetActive(false);
 		}
 	}
 }
@@ -69,7 +69,7 @@ void EnemyEntity::Update(float elaspedTime)
 void EnemyEntity::Die()
 {
 	HP = 0;
-	Actor->IsActive = false;
+	Actor->SetActive(false);
 	respawnInterval = 5.0f;
 }
 
@@ -77,7 +77,7 @@ void EnemyEntity::Die()
 void EnemyEntity::Resurrect()
 {
 	HP = 100;
-	Actor->IsActive = true;
+	Actor->SetActive(true);
 	respawnInterval = -1.0f;
 }
 
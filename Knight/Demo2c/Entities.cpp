@@ -66,7 +66,7 @@ void EnemyEntity::Update(float elaspedTime)
 void EnemyEntity::Die()
 {
 	HP = 0;
-	Actor->IsActive = false;
+	Actor->SetActive(false);
 	respawnInterval = 5.0f;
 }
 
@@ -74,7 +74,7 @@ void EnemyEntity::Die()
 void EnemyEntity::Resurrect()
 {
 	HP = 100;
-	Actor->IsActive = true;
+	Actor->SetActive(true);
 	respawnInterval = -1.0f;
 }
 
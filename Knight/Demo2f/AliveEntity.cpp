@@ -49,7 +49,7 @@ void AliveEntity::DealDamage(int originalValue)
 void AliveEntity::Die()
 {
 	HP = 0;
-	Actor->IsActive = false;
+	Actor->SetActive(false);
 }
 
 void AliveEntity::Update(float elaspedTime)
@@ -75,7 +75,7 @@ void Demo4TexOps::InitEntities()
 {	
 	demos.push_back(new SimpleDrawTextureDemo());
 	demos.push_back(new CompressTextureDemo());
-	demos.push_back(new LRUTextureCacheDemo(3));
+	demos.push_back(new LRUTextureCacheDemo(3 * 500 * 726 * 4));	//room for three of the 500x726 RGBA cards
 	demos.push_back(new DrawPartialRotateDemo());
 	demos.push_back(new ColorBlendingDemo());
 	demos.push_back(new SmoothColorBlendingDemo()); 
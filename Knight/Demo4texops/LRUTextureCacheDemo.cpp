@@ -11,10 +11,10 @@ vector<string> texturePaths = {
     "../../resources/textures/PokerDeckCards/52.png"
 };
 
-LRUTextureCacheDemo::LRUTextureCacheDemo(int capacity) : textureCache(capacity)
+LRUTextureCacheDemo::LRUTextureCacheDemo(size_t budgetBytes) : textureCache(budgetBytes)
 {
 	title = "LRU Texture Cache Demo";
-	description = "Implement a simple LRU texture cache to avoid loading duplicate textures.";
+	description = "A texture cache with a memory budget: misses load in the background, the least recently used texture is evicted when the budget is exceeded.";
 }
 
 void LRUTextureCacheDemo::Create()
@@ -22,25 +22,39 @@ void LRUTextureCacheDemo::Create()
 	isReady = true;
 }
 
+void LRUTextureCacheDemo::Update(float elapsedTime)
+{
+    // Take the finished loads in and evict down to the budget, before the textures are used this frame
+    textureCache.Update();
+}
+
 void LRUTextureCacheDemo::Draw2D()
 {
     int index = ((int)GetTime()/2) % texturePaths.size();
 
-    Texture2D* texture = textureCache.GetTexture(texturePaths[index]);
+    Texture2D texture = textureCache.Get(texturePaths[index].c_str());
 
-    // Draw the texture
-    DrawTexture(*texture, SCREEN_WIDTH / 2 - texture->width / 2, SCREEN_HEIGHT / 2 - texture->height / 2, WHITE);
+    // Draw the texture, the placeholder is a 1x1 texture while the card is loading
+    if (texture.width > 1)
+        DrawTexture(texture, SCREEN_WIDTH / 2 - texture.width / 2, SCREEN_HEIGHT / 2 - texture.height / 2, WHITE);
+    else
+        Knight::Instance->DrawText("Loading...", SCREEN_WIDTH / 2 - 80, SCREEN_HEIGHT / 2, 40, WHITE);
 
     // Draw cache info
-    Knight::Instance->DrawText(TextFormat("Cache Size: %d/%d Hit:%d, Miss:%d", 
-        textureCache.Size(), textureCache.MaxSize(), textureCache.NumHit, textureCache.NumMiss), 10, 30, 20, WHITE);
-	for (int i = 0; i < textureCache.Size(); i++) {
-        Knight::Instance->DrawText(TextFormat("Texture:%s", textureCache.GetTexturePath(i).c_str()), 15, 75 + i * 35, 30, (i == index) ? GREEN : WHITE);
+    const TextureCacheStats& stats = textureCache.GetStats();
+    Knight::Instance->DrawText(TextFormat("Cache: %.1f/%.1f MB Hit:%d, Miss:%d, Evicted:%d", 
+        textureCache.GetResidentBytes() / (1024.0f * 1024.0f), textureCache.GetBudget() / (1024.0f * 1024.0f),
+        stats.hits, stats.misses, stats.evictions), 10, 30, 20, WHITE);
+	for (int i = 0; i < textureCache.GetNumResident(); i++) {
+        const char* path = textureCache.GetResidentPath(i);
+        Knight::Instance->DrawText(TextFormat("Texture:%s", path), 15, 75 + i * 35, 30, (texturePaths[index] == path) ? GREEN : WHITE);
 	}
 }
 
 void LRUTextureCacheDemo::Release() 
 {
+    textureCache.LogStats();
+    textureCache.Clear();
 
 	isReady = false;
 }
@@ -74,6 +74,8 @@ void Demo5FPC::Start()
 	SceneActor* pProp2 = _Scene->CreateSceneObject<SceneActor>("scene prop2");
 	pProp2->Position = Vector3{ 0, 0, -11 };
 	ModelComponent* prop2Component = pProp2->CreateAndAddComponent<ModelComponent>();
+	prop2Component->OptimizeMeshes = true;
+	prop2Component->GenerateLODs = true;
 	prop2Component->Load3DModel("../../resources/models/obj/market.obj", "../../resources/models/obj/market_diffuse.png");
 	pProp2->AddComponent(prop2Component);
 
@@ -1,5 +1,9 @@
 #include "HMapTerrainModelComponent.h"
 #include "KnightUtils.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <algorithm>
 
 bool HMapTerrainModelComponent::CreateFromFile(Vector3 terrainDimension, Vector2 texTileSize, const char* pHightmapFilePath, const char* pTerrainTexurePath)
 {
@@ -10,11 +14,15 @@ bool HMapTerrainModelComponent::CreateFromFile(Vector3 terrainDimension, Vector2
 		return false;
 	}
 
-    mesh = GenMeshHeightmapEx(hightMapImage, terrainDimension, texTileSize); // Generate heightmap mesh (RAM and VRAM)    
-    ConvertMeshToIndexed(&mesh); 
+    double t = GetTime();
+    model = GenModelHeightmapIndexed(hightMapImage, terrainDimension, texTileSize); // Generate indexed heightmap meshes with smooth normals (RAM and VRAM)
+    if (model.meshCount == 0) {
+        printf("[Error] Unable to generate terrrain mesh from height map %s!\n", pHightmapFilePath);
+        return false;
+    }
+    mesh = model.meshes[0];
 
-    model = LoadModelFromMesh(mesh);                  // Load model from generated mesh
-	RecalculateSmoothNormals(model);        // Recalculate smooth normals for the model    
+    TraceLog(LOG_INFO, "Heightmap terrain %dx%d generated in %.1f ms, %d sub-meshes", hightMapImage.width, hightMapImage.height, (GetTime() - t) * 1000, model.meshCount);
 
 	if (pTerrainTexurePath == NULL)
 		model.materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = texture; // Set map diffuse texture
@@ -41,136 +49,150 @@ void HMapTerrainModelComponent::Draw(RenderHints *pRH)
         DrawModel(model, this->_SceneActor->Position, 1.0f, tint);
 }
 
-Mesh HMapTerrainModelComponent::GenMeshHeightmapEx(Image heightmap, Vector3 size, Vector2 texPatchSize)
+/// <summary>
+/// GenModelHeightmapIndexed - Generate the terrain as a shared vertex indexed grid with smooth normals.
+/// The grid is split into sub-meshes of at most HEIGHTMAP_CHUNK_QUADS quads per side so every
+/// sub-mesh stays within 16-bit indices, neighbouring sub-meshes duplicate their shared edge.
+/// Face normals, vertex normals and the sub-meshes are built on the JobSystem, only the upload runs here.
+/// </summary>
+/// <param name="heightmap">The heightmap image</param>
+/// <param name="size">World space size of the terrain</param>
+/// <param name="texPatchSize">Texture patch size in pixels</param>
+/// <returns>The model, one mesh per chunk sharing one default material</returns>
+Model HMapTerrainModelComponent::GenModelHeightmapIndexed(Image heightmap, Vector3 size, Vector2 texPatchSize)
 {
-#define GRAY_VALUE(c) ((float)(c.r + c.g + c.b)/3.0f)
-
-    Mesh mesh = { 0 };
-
-    int mapX = heightmap.width;
-    int mapZ = heightmap.height;
-
-    Color* pixels = LoadImageColors(heightmap);
+    Model terrainModel = { 0 };
 
-    // NOTE: One vertex per pixel
-    mesh.triangleCount = (mapX - 1) * (mapZ - 1) * 2;    // One quad every four pixels
-
-    mesh.vertexCount = mesh.triangleCount * 3;
-
-    mesh.vertices = (float*)RL_MALLOC(mesh.vertexCount * 3 * sizeof(float));
-    mesh.normals = (float*)RL_MALLOC(mesh.vertexCount * 3 * sizeof(float));
-    mesh.texcoords = (float*)RL_MALLOC(mesh.vertexCount * 2 * sizeof(float));
-    mesh.colors = NULL;
-
-    int vCounter = 0;       // Used to count vertices float by float
-    int tcCounter = 0;      // Used to count texcoords float by float
-    int nCounter = 0;       // Used to count normals float by float
+    const int mapX = heightmap.width;
+    const int mapZ = heightmap.height;
+    if (mapX < 2 || mapZ < 2)
+        return terrainModel;
 
+    JobSystem& jobs = JobSystem::Instance();
     Vector3 scaleFactor = { size.x / (mapX - 1), size.y / 255.0f, size.z / (mapZ - 1) };
 
-    Vector3 vA = { 0 };
-    Vector3 vB = { 0 };
-    Vector3 vC = { 0 };
-    Vector3 vN = { 0 };
-
     int px = mapX / (int)texPatchSize.x;
     int pz = mapZ / (int)texPatchSize.y;
 
-    for (int z = 0; z < mapZ - 1; z++)
-    {
-        for (int x = 0; x < mapX - 1; x++)
-        {
-            // Fill vertices array with data
-            //----------------------------------------------------------
-
-            // one triangle - 3 vertex
-            mesh.vertices[vCounter] = (float)x * scaleFactor.x;
-            mesh.vertices[vCounter + 1] = GRAY_VALUE(pixels[x + z * mapX]) * scaleFactor.y;
-            mesh.vertices[vCounter + 2] = (float)z * scaleFactor.z;
-
-            mesh.vertices[vCounter + 3] = (float)x * scaleFactor.x;
-            mesh.vertices[vCounter + 4] = GRAY_VALUE(pixels[x + (z + 1) * mapX]) * scaleFactor.y;
-            mesh.vertices[vCounter + 5] = (float)(z + 1) * scaleFactor.z;
-
-            mesh.vertices[vCounter + 6] = (float)(x + 1) * scaleFactor.x;
-            mesh.vertices[vCounter + 7] = GRAY_VALUE(pixels[(x + 1) + z * mapX]) * scaleFactor.y;
-            mesh.vertices[vCounter + 8] = (float)z * scaleFactor.z;
-
-            // Another triangle - 3 vertex
-            mesh.vertices[vCounter + 9] = mesh.vertices[vCounter + 6];
-            mesh.vertices[vCounter + 10] = mesh.vertices[vCounter + 7];
-            mesh.vertices[vCounter + 11] = mesh.vertices[vCounter + 8];
-
-            mesh.vertices[vCounter + 12] = mesh.vertices[vCounter + 3];
-            mesh.vertices[vCounter + 13] = mesh.vertices[vCounter + 4];
-            mesh.vertices[vCounter + 14] = mesh.vertices[vCounter + 5];
-
-            mesh.vertices[vCounter + 15] = (float)(x + 1) * scaleFactor.x;
-            mesh.vertices[vCounter + 16] = GRAY_VALUE(pixels[(x + 1) + (z + 1) * mapX]) * scaleFactor.y;
-            mesh.vertices[vCounter + 17] = (float)(z + 1) * scaleFactor.z;
-            vCounter += 18;     // 6 vertex, 18 floats
-
-
-            // Fill texcoords array with data
-            //--------------------------------------------------------------
-            mesh.texcoords[tcCounter] = (float)x / (px - 1);
-            mesh.texcoords[tcCounter + 1] = (float)z / (pz - 1);
-
-            mesh.texcoords[tcCounter + 2] = (float)x / (px - 1);
-            mesh.texcoords[tcCounter + 3] = (float)(z + 1) / (pz - 1);
-
-            mesh.texcoords[tcCounter + 4] = (float)(x + 1) / (px - 1);
-            mesh.texcoords[tcCounter + 5] = (float)z / (pz - 1);
-
-            mesh.texcoords[tcCounter + 6] = mesh.texcoords[tcCounter + 4];
-            mesh.texcoords[tcCounter + 7] = mesh.texcoords[tcCounter + 5];
-
-            mesh.texcoords[tcCounter + 8] = mesh.texcoords[tcCounter + 2];
-            mesh.texcoords[tcCounter + 9] = mesh.texcoords[tcCounter + 3];
-
-            mesh.texcoords[tcCounter + 10] = (float)(x + 1) / (px - 1);
-            mesh.texcoords[tcCounter + 11] = (float)(z + 1) / (pz - 1);
-            tcCounter += 12;    // 6 texcoords, 12 floats
-
-            // Fill normals array with data
-            //--------------------------------------------------------------
-            for (int i = 0; i < 18; i += 9)
-            {
-                vA.x = mesh.vertices[nCounter + i];
-                vA.y = mesh.vertices[nCounter + i + 1];
-                vA.z = mesh.vertices[nCounter + i + 2];
-
-                vB.x = mesh.vertices[nCounter + i + 3];
-                vB.y = mesh.vertices[nCounter + i + 4];
-                vB.z = mesh.vertices[nCounter + i + 5];
-
-                vC.x = mesh.vertices[nCounter + i + 6];
-                vC.y = mesh.vertices[nCounter + i + 7];
-                vC.z = mesh.vertices[nCounter + i + 8];
-
-                vN = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(vB, vA), Vector3Subtract(vC, vA)));
-
-                mesh.normals[nCounter + i] = vN.x;
-                mesh.normals[nCounter + i + 1] = vN.y;
-                mesh.normals[nCounter + i + 2] = vN.z;
-
-                mesh.normals[nCounter + i + 3] = vN.x;
-                mesh.normals[nCounter + i + 4] = vN.y;
-                mesh.normals[nCounter + i + 5] = vN.z;
-
-                mesh.normals[nCounter + i + 6] = vN.x;
-                mesh.normals[nCounter + i + 7] = vN.y;
-                mesh.normals[nCounter + i + 8] = vN.z;
+    // Gray value of every pixel, one vertex per pixel
+    Color* pixels = LoadImageColors(heightmap);
+    vector<float> heights((size_t)mapX * mapZ);
+    jobs.ParallelFor(mapZ, 64, [&](int beginZ, int endZ) {
+        for (size_t i = (size_t)beginZ * mapX; i < (size_t)endZ * mapX; i++) {
+            heights[i] = (float)(pixels[i].r + pixels[i].g + pixels[i].b) / 3.0f * scaleFactor.y;
+        }
+    });
+    UnloadImageColors(pixels);
+
+    auto position = [&](int x, int z) {
+        return Vector3{ x * scaleFactor.x, heights[(size_t)z * mapX + x], z * scaleFactor.z };
+    };
+
+    // Two triangles per quad: (x,z) (x,z+1) (x+1,z) and (x+1,z) (x,z+1) (x+1,z+1)
+    const int quadsX = mapX - 1;
+    const int quadsZ = mapZ - 1;
+    vector<Vector3> faceNormals((size_t)quadsX * quadsZ * 2);
+    jobs.ParallelFor(quadsZ, 64, [&](int beginZ, int endZ) {
+        for (int z = beginZ; z < endZ; z++) {
+            for (int x = 0; x < quadsX; x++) {
+                Vector3 p00 = position(x, z);
+                Vector3 p01 = position(x, z + 1);
+                Vector3 p10 = position(x + 1, z);
+                Vector3 p11 = position(x + 1, z + 1);
+                size_t quad = (size_t)z * quadsX + x;
+                faceNormals[quad * 2] = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(p01, p00), Vector3Subtract(p10, p00)));
+                faceNormals[quad * 2 + 1] = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(p01, p10), Vector3Subtract(p11, p10)));
             }
-
-            nCounter += 18;     // 6 vertex, 18 floats
         }
-    }
+    });
+
+    // Smooth vertex normal = sum of the (up to 6) adjacent face normals, gathered per vertex so no two jobs write the same vertex
+    vector<Vector3> vertexNormals((size_t)mapX * mapZ);
+    jobs.ParallelFor(mapZ, 64, [&](int beginZ, int endZ) {
+        for (int z = beginZ; z < endZ; z++) {
+            for (int x = 0; x < mapX; x++) {
+                Vector3 n = { 0, 0, 0 };
+                if (x < quadsX && z < quadsZ) {
+                    n = Vector3Add(n, faceNormals[((size_t)z * quadsX + x) * 2]);
+                }
+                if (x > 0 && z < quadsZ) {
+                    n = Vector3Add(n, faceNormals[((size_t)z * quadsX + x - 1) * 2]);
+                    n = Vector3Add(n, faceNormals[((size_t)z * quadsX + x - 1) * 2 + 1]);
+                }
+                if (x < quadsX && z > 0) {
+                    n = Vector3Add(n, faceNormals[((size_t)(z - 1) * quadsX + x) * 2]);
+                    n = Vector3Add(n, faceNormals[((size_t)(z - 1) * quadsX + x) * 2 + 1]);
+                }
+                if (x > 0 && z > 0) {
+                    n = Vector3Add(n, faceNormals[((size_t)(z - 1) * quadsX + x - 1) * 2 + 1]);
+                }
+                vertexNormals[(size_t)z * mapX + x] = Vector3Normalize(n);
+            }
+        }
+    });
+
+    const int chunksX = (quadsX + HEIGHTMAP_CHUNK_QUADS - 1) / HEIGHTMAP_CHUNK_QUADS;
+    const int chunksZ = (quadsZ + HEIGHTMAP_CHUNK_QUADS - 1) / HEIGHTMAP_CHUNK_QUADS;
+    const int numChunks = chunksX * chunksZ;
+
+    terrainModel.transform = MatrixIdentity();
+    terrainModel.meshCount = numChunks;
+    terrainModel.meshes = (Mesh*)RL_CALLOC(numChunks, sizeof(Mesh));
+    terrainModel.materialCount = 1;
+    terrainModel.materials = (Material*)RL_CALLOC(1, sizeof(Material));
+    terrainModel.materials[0] = LoadMaterialDefault();
+    terrainModel.meshMaterial = (int*)RL_CALLOC(numChunks, sizeof(int));
+
+    jobs.ParallelFor(numChunks, 1, [&](int begin, int end) {
+        for (int c = begin; c < end; c++) {
+            int startX = (c % chunksX) * HEIGHTMAP_CHUNK_QUADS;
+            int startZ = (c / chunksX) * HEIGHTMAP_CHUNK_QUADS;
+            int chunkQuadsX = std::min(HEIGHTMAP_CHUNK_QUADS, quadsX - startX);
+            int chunkQuadsZ = std::min(HEIGHTMAP_CHUNK_QUADS, quadsZ - startZ);
+            int rowVertices = chunkQuadsX + 1;
+
+            Mesh& chunk = terrainModel.meshes[c];
+            chunk.vertexCount = rowVertices * (chunkQuadsZ + 1);
+            chunk.triangleCount = chunkQuadsX * chunkQuadsZ * 2;
+            chunk.vertices = (float*)RL_MALLOC(chunk.vertexCount * 3 * sizeof(float));
+            chunk.normals = (float*)RL_MALLOC(chunk.vertexCount * 3 * sizeof(float));
+            chunk.texcoords = (float*)RL_MALLOC(chunk.vertexCount * 2 * sizeof(float));
+            chunk.indices = (unsigned short*)RL_MALLOC(chunk.triangleCount * 3 * sizeof(unsigned short));
+
+            int v = 0;
+            for (int z = startZ; z <= startZ + chunkQuadsZ; z++) {
+                for (int x = startX; x <= startX + chunkQuadsX; x++, v++) {
+                    Vector3 p = position(x, z);
+                    Vector3 n = vertexNormals[(size_t)z * mapX + x];
+                    chunk.vertices[v * 3] = p.x;
+                    chunk.vertices[v * 3 + 1] = p.y;
+                    chunk.vertices[v * 3 + 2] = p.z;
+                    chunk.normals[v * 3] = n.x;
+                    chunk.normals[v * 3 + 1] = n.y;
+                    chunk.normals[v * 3 + 2] = n.z;
+                    chunk.texcoords[v * 2] = (float)x / (px - 1);
+                    chunk.texcoords[v * 2 + 1] = (float)z / (pz - 1);
+                }
+            }
 
-    UnloadImageColors(pixels);  // Unload pixels color data
+            int i = 0;
+            for (int z = 0; z < chunkQuadsZ; z++) {
+                for (int x = 0; x < chunkQuadsX; x++) {
+                    unsigned short i00 = (unsigned short)(z * rowVertices + x);
+                    unsigned short i10 = (unsigned short)(i00 + 1);
+                    unsigned short i01 = (unsigned short)(i00 + rowVertices);
+                    unsigned short i11 = (unsigned short)(i01 + 1);
+                    chunk.indices[i++] = i00; chunk.indices[i++] = i01; chunk.indices[i++] = i10;
+                    chunk.indices[i++] = i10; chunk.indices[i++] = i01; chunk.indices[i++] = i11;
+                }
+            }
+        }
+    });
 
-    // Upload vertex data to GPU (static mesh)
-    UploadMesh(&mesh, false);
+    // Upload vertex data to GPU (static mesh), GL calls have to stay on this thread
+    for (int c = 0; c < numChunks; c++) {
+        UploadMesh(&terrainModel.meshes[c], false);
+    }
 
-    return mesh;
-}
\ No newline at end of file
+    return terrainModel;
+}
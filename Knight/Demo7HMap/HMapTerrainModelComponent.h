@@ -5,6 +5,9 @@
 #include "SceneActor.h"
 #include "Component.h"
 
+// Quads per side of one terrain sub-mesh, (255 + 1)^2 vertices still fit 16-bit indices
+#define HEIGHTMAP_CHUNK_QUADS 255
+
 class HMapTerrainModelComponent : public Component
 {
 public:
@@ -21,6 +24,6 @@ public:
 	friend SceneActor;
 
 protected:
-	Mesh GenMeshHeightmapEx(Image heightmap, Vector3 size, Vector2 texPatchSize);
+	Model GenModelHeightmapIndexed(Image heightmap, Vector3 size, Vector2 texPatchSize);
 };
 
@@ -48,8 +48,7 @@ void DepthRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 		pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//Override shader 
 	BeginShaderMode(depthShader);
@@ -52,21 +52,7 @@ bool ShadowMapRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 			dist2 = Vector3DistanceSqr(pos, pActiveCamera->GetPosition());
 	}
 
-	switch (pSC->renderQueue)
-	{
-		case Component::eRenderQueueType::Background:
-			pScene->_RenderQueue.Background.push_back(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Geometry:
-			pScene->_RenderQueue.Geometry.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::AlphaBlend:
-			pScene->_RenderQueue.AlphaBlending.insert(RenderContext{ pSC, dist2 });
-			break;
-		case Component::eRenderQueueType::Overlay:
-			pScene->_RenderQueue.Overlay.push_back(RenderContext{ pSC, dist2 });
-			break;
-	}
+	AddToRenderQueue(pSC, dist2);
 
 	return true;
 }
@@ -86,8 +72,7 @@ void ShadowMapRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 	pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	//update lighting changes (if any)
 	Vector4 lightColorNormalized = ColorNormalize(pLight->lightColor);
@@ -108,14 +93,14 @@ void ShadowMapRenderPass::Render()
 	//render background first
 	vector<RenderContext>::iterator bk = pScene->_RenderQueue.Background.begin();
 	while (bk != pScene->_RenderQueue.Background.end()) {
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
 	//render opauqe geometry from nearest to farest
 	multiset<RenderContext, CompareDistanceAscending>::iterator opaque = pScene->_RenderQueue.Geometry.begin();
 	while (opaque != pScene->_RenderQueue.Geometry.end()) {
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 	
@@ -125,7 +110,7 @@ void ShadowMapRenderPass::Render()
 		rlDisableDepthMask();
 		rlDisableBackfaceCulling();
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		rlEnableDepthMask();
 		rlEnableBackfaceCulling();
@@ -135,7 +120,7 @@ void ShadowMapRenderPass::Render()
 	//render overlay first
 	vector<RenderContext>::iterator overlay = pScene->_RenderQueue.Overlay.begin();
 	while (overlay != pScene->_RenderQueue.Overlay.end()) {
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		++overlay;
 	}	
 }
@@ -0,0 +1,383 @@
+#include "AsyncAssetLoader.h"
+#include "ResourceRegistry.h"
+#include "JobSystem.h"
+
+#include "rlgl.h"
+
+#include <cfloat>
+#include <chrono>
+#include <thread>
+
+static const char* OptionalPath(const string& path)
+{
+	return path.empty() ? nullptr : path.c_str();
+}
+
+// LoadFileText on a worker, an empty path is raylib's default shader
+static bool ReadTextFile(const string& path, string& text)
+{
+	text.clear();
+	if (path.empty())
+		return true;
+
+	char* pText = LoadFileText(path.c_str());
+	if (pText == nullptr)
+		return false;
+	text = pText;
+	UnloadFileText(pText);
+	return true;
+}
+
+AsyncTexture::~AsyncTexture()
+{
+	if (IsReady())
+		ResourceRegistry::Instance().ReleaseTexture(_Texture);
+}
+
+/// <summary>
+/// GetTexture - The loaded texture, or a placeholder while it's loading or if it failed.
+/// </summary>
+/// <returns>The texture, raylib's 1x1 white default texture until it is ready.</returns>
+Texture2D AsyncTexture::GetTexture() const
+{
+	if (IsReady())
+		return _Texture;
+	return Texture2D{ rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+}
+
+bool AsyncTexture::Decode()
+{
+	if (_UseCooked)
+		return KnightAsset::LoadTextureImage(_Path.c_str(), &_Image);
+	_Image = LoadImage(_Path.c_str());
+	return _Image.data != nullptr;
+}
+
+bool AsyncTexture::Upload(bool decoded)
+{
+	if (!decoded)
+	{
+		TraceLog(LOG_WARNING, "ASYNC: [%s] Failed to load texture", _Path.c_str());
+		return false;
+	}
+
+	Texture2D texture = LoadTextureFromImage(_Image);
+	if (texture.mipmaps > 1)
+		SetTextureFilter(texture, TEXTURE_FILTER_TRILINEAR);
+	Discard();
+
+	_Texture = ResourceRegistry::Instance().AddTexture(_Path.c_str(), _UseCooked, texture);
+	return _Texture.id != 0;
+}
+
+void AsyncTexture::Discard()
+{
+	UnloadImage(_Image);
+	_Image = Image{ 0 };
+}
+
+AsyncShader::~AsyncShader()
+{
+	if (IsReady())
+		ResourceRegistry::Instance().ReleaseShader(_Shader);
+}
+
+/// <summary>
+/// GetShader - The loaded shader, or a placeholder while it's loading or if it failed.
+/// </summary>
+/// <returns>The shader, raylib's default shader until it is ready.</returns>
+Shader AsyncShader::GetShader() const
+{
+	if (IsReady())
+		return _Shader;
+	return Shader{ rlGetShaderIdDefault(), rlGetShaderLocsDefault() };
+}
+
+bool AsyncShader::Decode()
+{
+	return ReadTextFile(_VsPath, _VsCode) && ReadTextFile(_FsPath, _FsCode);
+}
+
+bool AsyncShader::Upload(bool decoded)
+{
+	Shader shader = { 0 };
+	if (decoded)
+		shader = LoadShaderFromMemory(OptionalPath(_VsCode), OptionalPath(_FsCode));
+	Discard();
+
+	//a shader that fails to compile falls back to raylib's default one, which is not registered
+	if (shader.id == 0 || shader.id == rlGetShaderIdDefault())
+	{
+		TraceLog(LOG_WARNING, "ASYNC: [%s] Failed to load shader", _Path.c_str());
+		return false;
+	}
+	_Shader = ResourceRegistry::Instance().AddShader(OptionalPath(_VsPath), OptionalPath(_FsPath), shader);
+	return true;
+}
+
+void AsyncShader::Discard()
+{
+	string().swap(_VsCode);
+	string().swap(_FsCode);
+}
+
+AsyncModel::~AsyncModel()
+{
+	if (IsReady())
+		ResourceRegistry::Instance().ReleaseModel(_pModel);
+}
+
+bool AsyncModel::Decode()
+{
+	//without a baked file there is nothing to do off the main thread
+	if (_BakedPath.empty())
+		return true;
+	return KnightAsset::ReadModel(_BakedPath.c_str(), &_Data);
+}
+
+bool AsyncModel::Upload(bool decoded)
+{
+	bool useData = decoded && !_BakedPath.empty();
+	_pModel = ResourceRegistry::Instance().AcquireModel(_Path.c_str(), _Params.c_str(), [this, useData](SharedModel& shared) {
+		//a baked file that could not be read is left to the loader, which may convert it again
+		if (!useData)
+			return _Loader(shared);
+
+		KnightAsset::UploadModel(&_Data, _KeepMeshData);
+		shared.model = _Data.model;
+		shared.pAnimations = _Data.pAnimations;
+		shared.animationCount = _Data.animationCount;
+		shared.meshBounds = _Data.meshBounds;
+		_Data = KnightAssetModelData();
+		return true;
+	});
+
+	//nothing is left if the data was uploaded, else the model was registered meanwhile or failed
+	Discard();
+	if (_pModel == nullptr)
+		TraceLog(LOG_WARNING, "ASYNC: [%s] Failed to load model", _Path.c_str());
+	return _pModel != nullptr;
+}
+
+void AsyncModel::Discard()
+{
+	if (_Data.model.meshes != nullptr)
+		KnightAsset::UnloadModelData(&_Data);
+}
+
+AsyncAssetLoader::AsyncAssetLoader()
+{
+}
+
+AsyncAssetLoader::~AsyncAssetLoader()
+{
+}
+
+/// <summary>
+/// Instance - Get the engine wide loader.
+/// </summary>
+/// <returns>The shared AsyncAssetLoader.</returns>
+AsyncAssetLoader& AsyncAssetLoader::Instance()
+{
+	static AsyncAssetLoader loader;
+	return loader;
+}
+
+// A request in flight, even if all its handles were dropped meanwhile
+template<typename T>
+shared_ptr<T> AsyncAssetLoader::FindRequest(const string& key)
+{
+	auto it = _Requests.find(key);
+	if (it == _Requests.end())
+		return nullptr;
+	return static_pointer_cast<T>(_InFlight[it->second]);
+}
+
+/// <summary>
+/// LoadTextureAsync - Request a texture, the image is decoded on a worker.
+/// </summary>
+/// <param name="path">The image, or a cooked .knt file.</param>
+/// <param name="useCooked">Read the up to date .knt next to the image instead of decoding it, as for ResourceRegistry::AcquireTexture.</param>
+/// <returns>The handle, ready at once if the texture is already loaded.</returns>
+shared_ptr<AsyncTexture> AsyncAssetLoader::LoadTextureAsync(const char* path, bool useCooked)
+{
+	string key = "texture|" + ResourceRegistry::NormalizePath(path) + (useCooked ? "|cooked" : "");
+	shared_ptr<AsyncTexture> pTexture = FindRequest<AsyncTexture>(key);
+	if (pTexture != nullptr)
+		return pTexture;
+
+	pTexture = make_shared<AsyncTexture>();
+	pTexture->_Path = path;
+	pTexture->_UseCooked = useCooked;
+	if (ResourceRegistry::Instance().IsTextureLoaded(path, useCooked))
+	{
+		pTexture->_Texture = ResourceRegistry::Instance().AcquireTexture(path, useCooked);
+		pTexture->_State = ASYNC_ASSET_READY;
+		return pTexture;
+	}
+
+	Start(key, pTexture);
+	return pTexture;
+}
+
+/// <summary>
+/// LoadShaderAsync - Request a shader, the sources are read on a worker and compiled on the main thread.
+/// </summary>
+/// <param name="vsPath">Vertex shader file, null for raylib's default.</param>
+/// <param name="fsPath">Fragment shader file, null for raylib's default.</param>
+/// <returns>The handle, ready at once if the shader is already loaded.</returns>
+shared_ptr<AsyncShader> AsyncAssetLoader::LoadShaderAsync(const char* vsPath, const char* fsPath)
+{
+	string key = "shader|" + ResourceRegistry::NormalizePath(vsPath) + "|" + ResourceRegistry::NormalizePath(fsPath);
+	shared_ptr<AsyncShader> pShader = FindRequest<AsyncShader>(key);
+	if (pShader != nullptr)
+		return pShader;
+
+	pShader = make_shared<AsyncShader>();
+	pShader->_VsPath = vsPath != nullptr ? vsPath : "";
+	pShader->_FsPath = fsPath != nullptr ? fsPath : "";
+	pShader->_Path = pShader->_VsPath + "|" + pShader->_FsPath;
+	if (ResourceRegistry::Instance().IsShaderLoaded(vsPath, fsPath))
+	{
+		pShader->_Shader = ResourceRegistry::Instance().AcquireShader(vsPath, fsPath);
+		pShader->_State = ASYNC_ASSET_READY;
+		return pShader;
+	}
+
+	Start(key, pShader);
+	return pShader;
+}
+
+/// <summary>
+/// LoadModelAsync - Request a shared model.
+/// </summary>
+/// <param name="path">The model file, the registry key together with params.</param>
+/// <param name="params">Load parameters, as for ResourceRegistry::AcquireModel.</param>
+/// <param name="bakedPath">The up to date .kna of the model to read on a worker, null or empty if there is none.</param>
+/// <param name="keepMeshData">Keep the CPU copies of the static meshes of the baked file.</param>
+/// <param name="loader">Fills the entry on the main thread when there is no baked file, as for ResourceRegistry::AcquireModel.</param>
+/// <returns>The handle, ready at once if the model is already loaded.</returns>
+shared_ptr<AsyncModel> AsyncAssetLoader::LoadModelAsync(const char* path, const char* params, const char* bakedPath, bool keepMeshData,
+	const function<bool(SharedModel&)>& loader)
+{
+	string key = "model|" + ResourceRegistry::NormalizePath(path) + "|" + (params != nullptr ? params : "");
+	shared_ptr<AsyncModel> pModel = FindRequest<AsyncModel>(key);
+	if (pModel != nullptr)
+		return pModel;
+
+	pModel = make_shared<AsyncModel>();
+	pModel->_Path = path;
+	pModel->_Params = params != nullptr ? params : "";
+	pModel->_BakedPath = bakedPath != nullptr ? bakedPath : "";
+	pModel->_KeepMeshData = keepMeshData;
+	pModel->_Loader = loader;
+	if (ResourceRegistry::Instance().IsModelLoaded(path, params))
+	{
+		pModel->_pModel = ResourceRegistry::Instance().AcquireModel(path, params, loader);
+		pModel->_State = ASYNC_ASSET_READY;
+		return pModel;
+	}
+
+	Start(key, pModel);
+	return pModel;
+}
+
+/// <summary>
+/// ProcessUploads - Upload the requests the workers have decoded, in the order they finished. One upload
+/// can't be split, so a large texture or a model loaded by raylib may take longer than the budget.
+/// </summary>
+/// <param name="budgetMs">Milliseconds to spend, the first upload is always done.</param>
+/// <returns>The number of requests completed.</returns>
+int AsyncAssetLoader::ProcessUploads(float budgetMs)
+{
+	auto startTime = chrono::steady_clock::now();
+	int numCompleted = 0;
+	for (;;)
+	{
+		pair<AsyncAsset*, bool> upload;
+		{
+			lock_guard<mutex> lock(_UploadsLock);
+			if (_Uploads.empty())
+				break;
+			upload = _Uploads.front();
+			_Uploads.pop_front();
+		}
+
+		Complete(upload.first, upload.second);
+		numCompleted++;
+
+		if (chrono::duration<float, milli>(chrono::steady_clock::now() - startTime).count() >= budgetMs)
+			break;
+	}
+	return numCompleted;
+}
+
+/// <summary>
+/// Flush - Wait for the workers and upload everything, without a time budget.
+/// </summary>
+void AsyncAssetLoader::Flush()
+{
+	while (!_InFlight.empty())
+	{
+		if (ProcessUploads(FLT_MAX) == 0)
+			this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+/// <summary>
+/// Shutdown - Wait for the decoding still running and drop every request in flight, they end up failed.
+/// </summary>
+void AsyncAssetLoader::Shutdown()
+{
+	while (_NumDecoding.load() > 0)
+		this_thread::sleep_for(chrono::milliseconds(1));
+
+	{
+		lock_guard<mutex> lock(_UploadsLock);
+		_Uploads.clear();
+	}
+	for (auto& it : _InFlight)
+	{
+		it.second->Discard();
+		it.second->_State = ASYNC_ASSET_FAILED;
+	}
+	_InFlight.clear();
+	_InFlightKeys.clear();
+	_Requests.clear();
+}
+
+void AsyncAssetLoader::Start(const string& key, shared_ptr<AsyncAsset> pAsset)
+{
+	AsyncAsset* pRequest = pAsset.get();
+	_Requests[key] = pRequest;
+	_InFlight[pRequest] = pAsset;
+	_InFlightKeys[pRequest] = key;
+
+	//the job only sees the raw pointer, the request lives in _InFlight until the main thread completes it
+	_NumDecoding++;
+	JobSystem::Instance().Submit([this, pRequest]() {
+		bool decoded = pRequest->Decode();
+		{
+			lock_guard<mutex> lock(_UploadsLock);
+			_Uploads.push_back(make_pair(pRequest, decoded));
+		}
+		_NumDecoding--;
+	});
+}
+
+void AsyncAssetLoader::Complete(AsyncAsset* pAsset, bool decoded)
+{
+	auto it = _InFlight.find(pAsset);
+	if (it == _InFlight.end())
+		return;
+
+	//keep the request alive until it is marked, the handles may all be gone already
+	shared_ptr<AsyncAsset> pRequest = it->second;
+	_InFlight.erase(it);
+	_Requests.erase(_InFlightKeys[pAsset]);
+	_InFlightKeys.erase(pAsset);
+
+	pRequest->_State = pRequest->Upload(decoded) ? ASYNC_ASSET_READY : ASYNC_ASSET_FAILED;
+}
+
+//End of AsyncAssetLoader.cpp
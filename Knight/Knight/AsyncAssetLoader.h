@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+#include "raylib.h"
+#include "KnightAsset.h"
+
+using namespace std;
+
+struct SharedModel;
+
+#define ASYNC_UPLOAD_BUDGET_MS	2.0f	//default main thread time per frame spent on uploads
+
+enum eAsyncAssetState
+{
+	ASYNC_ASSET_PENDING = 0,	// decoding on a worker, or decoded and waiting for its upload
+	ASYNC_ASSET_READY,
+	ASYNC_ASSET_FAILED
+};
+
+// A resource requested from the AsyncAssetLoader. Once ready the handle holds one ResourceRegistry
+// reference to it, released when the last copy of the handle goes away. Users keeping the resource
+// acquire their own reference from the registry, which is a cache hit while the handle lives.
+// Handles are created and dropped on the main thread.
+class AsyncAsset
+{
+public:
+	virtual ~AsyncAsset() {}
+
+	eAsyncAssetState GetState() const { return (eAsyncAssetState)_State.load(); }
+	bool IsPending() const { return GetState() == ASYNC_ASSET_PENDING; }
+	bool IsReady() const { return GetState() == ASYNC_ASSET_READY; }
+	bool IsFailed() const { return GetState() == ASYNC_ASSET_FAILED; }
+	const string& GetPath() const { return _Path; }
+
+protected:
+	friend class AsyncAssetLoader;
+
+	// Worker thread: file I/O and decoding, no raylib calls that touch the GPU or shared text buffers
+	virtual bool Decode() = 0;
+	// Main thread: create the GPU resource from the decoded data and register it
+	virtual bool Upload(bool decoded) = 0;
+	// Main thread: free the decoded data of a request that will not be uploaded
+	virtual void Discard() {}
+
+	string _Path;
+	atomic<int> _State{ ASYNC_ASSET_PENDING };
+};
+
+class AsyncTexture : public AsyncAsset
+{
+public:
+	~AsyncTexture();
+
+	// The texture once ready, raylib's white default texture as placeholder until then
+	Texture2D GetTexture() const;
+
+protected:
+	friend class AsyncAssetLoader;
+
+	bool Decode() override;
+	bool Upload(bool decoded) override;
+	void Discard() override;
+
+	bool _UseCooked = false;
+	Image _Image = { 0 };
+	Texture2D _Texture = { 0 };
+};
+
+class AsyncShader : public AsyncAsset
+{
+public:
+	~AsyncShader();
+
+	// The shader once ready, raylib's default shader as placeholder until then
+	Shader GetShader() const;
+
+protected:
+	friend class AsyncAssetLoader;
+
+	bool Decode() override;
+	bool Upload(bool decoded) override;
+	void Discard() override;
+
+	string _VsPath;		// empty for raylib's default, like a null path for LoadShader
+	string _FsPath;
+	string _VsCode;
+	string _FsCode;
+	Shader _Shader = { 0 };
+};
+
+class AsyncModel : public AsyncAsset
+{
+public:
+	~AsyncModel();
+
+	// The registered model once ready, nullptr until then
+	SharedModel* GetSharedModel() const { return IsReady() ? _pModel : nullptr; }
+
+protected:
+	friend class AsyncAssetLoader;
+
+	bool Decode() override;
+	bool Upload(bool decoded) override;
+	void Discard() override;
+
+	string _Params;
+	string _BakedPath;		// the .kna read on the worker, empty if the loader has to run on the main thread
+	bool _KeepMeshData = true;
+	function<bool(SharedModel&)> _Loader;
+	KnightAssetModelData _Data;
+	SharedModel* _pModel = nullptr;
+};
+
+// Background loading: files are read and decoded on the JobSystem workers, the GPU uploads are queued
+// and done on the main thread by ProcessUploads within a time budget per frame. Requests for a resource
+// which is already registered are ready immediately, requests for one that is on its way share the handle.
+class AsyncAssetLoader
+{
+public:
+	AsyncAssetLoader();
+	~AsyncAssetLoader();
+
+	static AsyncAssetLoader& Instance();
+
+	shared_ptr<AsyncTexture> LoadTextureAsync(const char* path, bool useCooked = false);
+	shared_ptr<AsyncShader> LoadShaderAsync(const char* vsPath, const char* fsPath);
+
+	// Models go through ResourceRegistry::AcquireModel with the same path and params. A baked .kna file is
+	// read on a worker; raylib's own loaders upload while they parse, so for any other file the loader is
+	// called on the main thread when the request reaches the front of the upload queue.
+	shared_ptr<AsyncModel> LoadModelAsync(const char* path, const char* params, const char* bakedPath, bool keepMeshData,
+		const function<bool(SharedModel&)>& loader);
+
+	// Main thread, once per frame: upload decoded requests until budgetMs is spent, at least one.
+	// Returns the number of requests completed.
+	int ProcessUploads(float budgetMs = ASYNC_UPLOAD_BUDGET_MS);
+
+	// Main thread: complete every request, for loading screens
+	void Flush();
+
+	// Main thread, before the window closes: wait for the workers and drop the requests not uploaded yet
+	void Shutdown();
+
+	int GetNumPending() const { return (int)_InFlight.size(); }
+
+protected:
+	void Start(const string& key, shared_ptr<AsyncAsset> pAsset);
+	void Complete(AsyncAsset* pAsset, bool decoded);
+
+	template<typename T>
+	shared_ptr<T> FindRequest(const string& key);
+
+	// The loader's reference to every request in flight, so no handle is released on a worker.
+	// Main thread only, like the requests by key.
+	unordered_map<AsyncAsset*, shared_ptr<AsyncAsset>> _InFlight;
+	unordered_map<string, AsyncAsset*> _Requests;
+	unordered_map<AsyncAsset*, string> _InFlightKeys;
+
+	// Decoded requests, filled by the workers
+	mutex _UploadsLock;
+	deque<pair<AsyncAsset*, bool>> _Uploads;
+	atomic<int> _NumDecoding{ 0 };
+};
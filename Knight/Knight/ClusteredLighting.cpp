@@ -0,0 +1,397 @@
+#include "Knight.h"
+
+#include "rlgl.h"
+#include "raymath.h"
+
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <xmmintrin.h>
+
+ClusteredLighting::~ClusteredLighting()
+{
+	Release();
+}
+
+/// <summary>
+/// Create - Allocate the grid texture, one texel (offset, count) per froxel with the tiles of a depth slice
+/// in a row. The index and light textures grow with the lights in Build.
+/// </summary>
+/// <returns>false if float textures are not supported</returns>
+bool ClusteredLighting::Create()
+{
+	Release();
+
+	_GridData.assign(LIGHT_CLUSTER_TILES * LIGHT_CLUSTER_Z * 3, 0.0f);
+	_GridTextureId = rlLoadTexture(_GridData.data(), LIGHT_CLUSTER_TILES, LIGHT_CLUSTER_Z, PIXELFORMAT_UNCOMPRESSED_R32G32B32, 1);
+	if (_GridTextureId == 0)
+	{
+		TraceLog(LOG_WARNING, "<ClusteredLighting.Create> Float textures are not supported, no clustered lighting");
+		return false;
+	}
+	return true;
+}
+
+void ClusteredLighting::Release()
+{
+	if (_GridTextureId != 0)
+		rlUnloadTexture(_GridTextureId);
+	if (_IndexTextureId != 0)
+		rlUnloadTexture(_IndexTextureId);
+	if (_LightTextureId != 0)
+		rlUnloadTexture(_LightTextureId);
+
+	_GridTextureId = _IndexTextureId = _LightTextureId = 0;
+	_IndexRows = _LightRows = 0;
+	_Ready = false;
+}
+
+/// <summary>
+/// InitUniforms - Find the cluster uniforms of the shader and point its samplers to the texture units.
+/// </summary>
+/// <param name="shader">Shader declaring the clustered light uniforms, like kn_lit.fs</param>
+void ClusteredLighting::InitUniforms(const Shader& shader)
+{
+	_EnabledLoc = GetShaderLocation(shader, "clusterEnabled");
+	_ViewLoc = GetShaderLocation(shader, "clusterView");
+	_ProjScaleLoc = GetShaderLocation(shader, "clusterProjScale");
+	_DepthParamsLoc = GetShaderLocation(shader, "clusterDepthParams");
+	_DimsLoc = GetShaderLocation(shader, "clusterDims");
+
+	const char* samplers[3] = { "clusterGrid", "clusterIndices", "clusterLights" };
+	for (int i = 0; i < 3; i++)
+	{
+		int slot = LIGHT_CLUSTER_TEXTURE_SLOT + i;
+		SetShaderValue(shader, GetShaderLocation(shader, samplers[i]), &slot, SHADER_UNIFORM_INT);
+	}
+
+	int enabled = 0;
+	SetShaderValue(shader, _EnabledLoc, &enabled, SHADER_UNIFORM_INT);
+}
+
+/// <summary>
+/// Build - Cull the lights against the view frustum, bucket the rest into the depth slices their spheres
+/// reach and fill the froxel light lists of every slice on the workers. The lists are then concatenated
+/// slice by slice and uploaded with the data of the visible lights.
+/// </summary>
+/// <param name="lights">The scene point lights</param>
+/// <param name="camera">The view camera, the projection is taken from rlgl</param>
+/// <returns>false if no light is visible or the projection is orthographic</returns>
+bool ClusteredLighting::Build(const vector<PointLightData>& lights, const Camera3D& camera)
+{
+	NumLights = (int)lights.size();
+	NumVisibleLights = NumIndices = NumLitClusters = 0;
+	_Ready = false;
+
+	Matrix proj = rlGetMatrixProjection();
+	if (_GridTextureId == 0 || lights.empty() || proj.m15 != 0.0f)
+		return false;
+
+	_View = GetCameraMatrix(camera);
+	_ProjScale = Vector2{ proj.m0, proj.m5 };
+
+	float nearDistance = std::max(NearDistance, 0.01f);
+	float farDistance = std::max(FarDistance, nearDistance * 2.0f);
+	float logRatio = logf(farDistance / nearDistance);
+	_DepthParams.x = LIGHT_CLUSTER_Z / logRatio;
+	_DepthParams.y = -LIGHT_CLUSTER_Z * logf(nearDistance) / logRatio;
+	for (int k = 0; k <= LIGHT_CLUSTER_Z; k++)
+		_SliceDepth[k] = nearDistance * powf(farDistance / nearDistance, (float)k / LIGHT_CLUSTER_Z);
+	_SliceDepth[0] = 0.0f;
+
+	for (LightClusterSlice& slice : _Slices)
+		slice.lights.clear();
+
+	//view space spheres of the lights in the frustum, the side test is conservative: the sphere is out if it
+	//lies beyond the plane even at the farthest depth it reaches
+	_Visible.clear();
+	_LightX.clear();
+	_LightY.clear();
+	_LightDepth.clear();
+	_LightRadius2.clear();
+	for (int i = 0; i < NumLights; i++)
+	{
+		const PointLightData& light = lights[i];
+		float radius = light.radius;
+		if (radius <= 0.0f || light.intensity <= 0.0f)
+			continue;
+
+		Vector3 center = Vector3Transform(light.position, _View);
+		float depth = -center.z;
+		if (depth + radius < 0.0f || depth - radius > farDistance)
+			continue;
+		float farthest = depth + radius;
+		if (fabsf(center.x) - radius > farthest / _ProjScale.x || fabsf(center.y) - radius > farthest / _ProjScale.y)
+			continue;
+
+		int visible = (int)_Visible.size();
+		_Visible.push_back(i);
+		_LightX.push_back(center.x);
+		_LightY.push_back(center.y);
+		_LightDepth.push_back(depth);
+		_LightRadius2.push_back(radius * radius);
+
+		//one slice extra on both ends for the rounding of the slice boundaries, the sphere tests sort it out
+		int first = std::max(GetSlice(depth - radius) - 1, 0);
+		int last = std::min(GetSlice(depth + radius) + 1, LIGHT_CLUSTER_Z - 1);
+		for (int k = first; k <= last; k++)
+			_Slices[k].lights.push_back(visible);
+	}
+
+	NumVisibleLights = (int)_Visible.size();
+	if (NumVisibleLights == 0)
+		return false;
+
+	JobSystem::Instance().ParallelFor(LIGHT_CLUSTER_Z, 1, [this](int begin, int end) {
+		for (int k = begin; k < end; k++)
+			AssignSlice(k);
+	});
+
+	//concatenate the slices
+	int offset = 0;
+	for (int k = 0; k < LIGHT_CLUSTER_Z; k++)
+	{
+		const LightClusterSlice& slice = _Slices[k];
+		float* pGrid = &_GridData[k * LIGHT_CLUSTER_TILES * 3];
+		for (int c = 0; c < LIGHT_CLUSTER_TILES; c++)
+		{
+			pGrid[c * 3] = (float)(offset + slice.offsets[c]);
+			pGrid[c * 3 + 1] = (float)slice.counts[c];
+			if (slice.counts[c] > 0)
+				NumLitClusters++;
+		}
+		offset += (int)slice.indices.size();
+	}
+	NumIndices = offset;
+
+	int indexRows = std::max((NumIndices + LIGHT_CLUSTER_TEXTURE_WIDTH - 1) / LIGHT_CLUSTER_TEXTURE_WIDTH, 1);
+	_IndexData.resize(indexRows * LIGHT_CLUSTER_TEXTURE_WIDTH);
+	float* pIndex = _IndexData.data();
+	for (const LightClusterSlice& slice : _Slices)
+	{
+		for (int index : slice.indices)
+			*pIndex++ = (float)index;
+	}
+
+	//two texels per light: position and radius, color and intensity
+	int lightRows = (NumVisibleLights * 2 + LIGHT_CLUSTER_TEXTURE_WIDTH - 1) / LIGHT_CLUSTER_TEXTURE_WIDTH;
+	_LightData.resize(lightRows * LIGHT_CLUSTER_TEXTURE_WIDTH * 4);
+	for (int n = 0; n < NumVisibleLights; n++)
+	{
+		const PointLightData& light = lights[_Visible[n]];
+		float* pLight = &_LightData[n * 8];
+		pLight[0] = light.position.x;
+		pLight[1] = light.position.y;
+		pLight[2] = light.position.z;
+		pLight[3] = light.radius;
+		pLight[4] = (float)light.color.r / 255.0f;
+		pLight[5] = (float)light.color.g / 255.0f;
+		pLight[6] = (float)light.color.b / 255.0f;
+		pLight[7] = light.intensity;
+	}
+
+	if (!ReserveRows(_IndexTextureId, _IndexRows, indexRows, PIXELFORMAT_UNCOMPRESSED_R32) ||
+		!ReserveRows(_LightTextureId, _LightRows, lightRows, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32))
+		return false;
+
+	rlUpdateTexture(_GridTextureId, 0, 0, LIGHT_CLUSTER_TILES, LIGHT_CLUSTER_Z, PIXELFORMAT_UNCOMPRESSED_R32G32B32, _GridData.data());
+	rlUpdateTexture(_IndexTextureId, 0, 0, LIGHT_CLUSTER_TEXTURE_WIDTH, indexRows, PIXELFORMAT_UNCOMPRESSED_R32, _IndexData.data());
+	rlUpdateTexture(_LightTextureId, 0, 0, LIGHT_CLUSTER_TEXTURE_WIDTH, lightRows, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, _LightData.data());
+
+	_Ready = true;
+	return true;
+}
+
+/// <summary>
+/// Bind - Hand the result of the last Build to the shader. The textures stay bound to their units
+/// for the draws that follow.
+/// </summary>
+/// <param name="shader">The shader InitUniforms was called with</param>
+void ClusteredLighting::Bind(const Shader& shader)
+{
+	int enabled = _Ready ? 1 : 0;
+	SetShaderValue(shader, _EnabledLoc, &enabled, SHADER_UNIFORM_INT);
+	if (!_Ready)
+		return;
+
+	int dims[3] = { LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z };
+	SetShaderValueMatrix(shader, _ViewLoc, _View);
+	SetShaderValue(shader, _ProjScaleLoc, &_ProjScale, SHADER_UNIFORM_VEC2);
+	SetShaderValue(shader, _DepthParamsLoc, &_DepthParams, SHADER_UNIFORM_VEC2);
+	SetShaderValue(shader, _DimsLoc, dims, SHADER_UNIFORM_IVEC3);
+
+	unsigned int textures[3] = { _GridTextureId, _IndexTextureId, _LightTextureId };
+	for (int i = 0; i < 3; i++)
+	{
+		rlActiveTextureSlot(LIGHT_CLUSTER_TEXTURE_SLOT + i);
+		rlEnableTexture(textures[i]);
+	}
+	rlActiveTextureSlot(0);
+}
+
+/// <summary>
+/// GetSlice - The depth slice of a view depth, the same formula the shader uses.
+/// </summary>
+int ClusteredLighting::GetSlice(float depth) const
+{
+	if (depth <= _SliceDepth[1])
+		return 0;
+	int slice = (int)floorf(logf(depth) * _DepthParams.x + _DepthParams.y);
+	return std::min(std::max(slice, 0), LIGHT_CLUSTER_Z - 1);
+}
+
+/// <summary>
+/// AssignSlice - Fill the light lists of the tiles of one depth slice. The lights bucketed into the slice are
+/// tested against each row of tiles first, the ones touching the row against each of its tiles.
+/// A froxel is bounded by the box around its corners in view space. Runs on a worker.
+/// </summary>
+/// <param name="k">Depth slice</param>
+void ClusteredLighting::AssignSlice(int k)
+{
+	LightClusterSlice& slice = _Slices[k];
+	slice.indices.clear();
+	memset(slice.offsets, 0, sizeof(slice.offsets));
+	memset(slice.counts, 0, sizeof(slice.counts));
+	if (slice.lights.empty())
+		return;
+
+	float nearDepth = _SliceDepth[k];
+	float farDepth = _SliceDepth[k + 1];
+	GatherSpheres(slice.lights, slice.sliceSpheres);
+
+	LightClusterBox box;
+	box.min.z = nearDepth;
+	box.max.z = farDepth;
+	for (int j = 0; j < LIGHT_CLUSTER_Y; j++)
+	{
+		float y0 = -1.0f + 2.0f * j / LIGHT_CLUSTER_Y;
+		float y1 = -1.0f + 2.0f * (j + 1) / LIGHT_CLUSTER_Y;
+		box.min.y = std::min(y0 * nearDepth, y0 * farDepth) / _ProjScale.y;
+		box.max.y = std::max(y1 * nearDepth, y1 * farDepth) / _ProjScale.y;
+		box.min.x = -farDepth / _ProjScale.x;
+		box.max.x = farDepth / _ProjScale.x;
+
+		slice.rowLights.clear();
+		TestSpheres(slice.sliceSpheres, box, slice.rowLights, INT_MAX);
+		if (slice.rowLights.empty())
+		{
+			for (int i = 0; i < LIGHT_CLUSTER_X; i++)
+				slice.offsets[j * LIGHT_CLUSTER_X + i] = (int)slice.indices.size();
+			continue;
+		}
+		GatherSpheres(slice.rowLights, slice.rowSpheres);
+
+		for (int i = 0; i < LIGHT_CLUSTER_X; i++)
+		{
+			float x0 = -1.0f + 2.0f * i / LIGHT_CLUSTER_X;
+			float x1 = -1.0f + 2.0f * (i + 1) / LIGHT_CLUSTER_X;
+			box.min.x = std::min(x0 * nearDepth, x0 * farDepth) / _ProjScale.x;
+			box.max.x = std::max(x1 * nearDepth, x1 * farDepth) / _ProjScale.x;
+
+			int tile = j * LIGHT_CLUSTER_X + i;
+			slice.offsets[tile] = (int)slice.indices.size();
+			TestSpheres(slice.rowSpheres, box, slice.indices, MaxLightsPerCluster);
+			slice.counts[tile] = (int)slice.indices.size() - slice.offsets[tile];
+		}
+	}
+}
+
+/// <summary>
+/// GatherSpheres - Copy the spheres of the given visible lights into packed arrays for TestSpheres, the
+/// padding spheres have a negative squared radius and never pass.
+/// </summary>
+void ClusteredLighting::GatherSpheres(const vector<int>& lights, LightSphereSet& spheres) const
+{
+	int count = (int)lights.size();
+	int padded = (count + 3) & ~3;
+	spheres.x.resize(padded);
+	spheres.y.resize(padded);
+	spheres.depth.resize(padded);
+	spheres.radius2.resize(padded);
+	spheres.index.resize(padded);
+	spheres.count = padded;
+
+	for (int n = 0; n < count; n++)
+	{
+		int light = lights[n];
+		spheres.x[n] = _LightX[light];
+		spheres.y[n] = _LightY[light];
+		spheres.depth[n] = _LightDepth[light];
+		spheres.radius2[n] = _LightRadius2[light];
+		spheres.index[n] = light;
+	}
+	for (int n = count; n < padded; n++)
+	{
+		spheres.x[n] = spheres.y[n] = spheres.depth[n] = 0.0f;
+		spheres.radius2[n] = -1.0f;
+		spheres.index[n] = -1;
+	}
+}
+
+/// <summary>
+/// TestSpheres - Append the spheres touching the box to result, four at a time: the squared distance from
+/// each center to the box is compared with the squared radius.
+/// </summary>
+/// <param name="maxCount">Stop once this many spheres were appended</param>
+void ClusteredLighting::TestSpheres(const LightSphereSet& spheres, const LightClusterBox& box, vector<int>& result, int maxCount) const
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 minX = _mm_set1_ps(box.min.x);
+	const __m128 maxX = _mm_set1_ps(box.max.x);
+	const __m128 minY = _mm_set1_ps(box.min.y);
+	const __m128 maxY = _mm_set1_ps(box.max.y);
+	const __m128 minDepth = _mm_set1_ps(box.min.z);
+	const __m128 maxDepth = _mm_set1_ps(box.max.z);
+
+	size_t start = result.size();
+	for (int n = 0; n < spheres.count; n += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres.x[n]);
+		__m128 y = _mm_loadu_ps(&spheres.y[n]);
+		__m128 depth = _mm_loadu_ps(&spheres.depth[n]);
+
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minDepth, depth), _mm_sub_ps(depth, maxDepth)), zero);
+		__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_loadu_ps(&spheres.radius2[n])));
+		if (mask == 0)
+			continue;
+
+		for (int b = 0; b < 4; b++)
+		{
+			if ((mask & (1 << b)) == 0)
+				continue;
+			if ((int)(result.size() - start) >= maxCount)
+				return;
+			result.push_back(spheres.index[n + b]);
+		}
+	}
+}
+
+/// <summary>
+/// ReserveRows - Make sure a data texture has at least neededRows rows of LIGHT_CLUSTER_TEXTURE_WIDTH texels,
+/// it is reloaded with twice the rows when it is too small.
+/// </summary>
+bool ClusteredLighting::ReserveRows(unsigned int& textureId, int& rows, int neededRows, int format)
+{
+	if (textureId != 0 && rows >= neededRows)
+		return true;
+
+	if (textureId != 0)
+		rlUnloadTexture(textureId);
+
+	rows = std::max(neededRows, rows * 2);
+	textureId = rlLoadTexture(nullptr, LIGHT_CLUSTER_TEXTURE_WIDTH, rows, format, 1);
+	if (textureId == 0)
+	{
+		TraceLog(LOG_WARNING, "<ClusteredLighting.Build> Failed to create a %d x %d light data texture", LIGHT_CLUSTER_TEXTURE_WIDTH, rows);
+		rows = 0;
+		return false;
+	}
+	return true;
+}
+
+//End of ClusteredLighting.cpp
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+#include "Scene.h"
+
+using namespace std;
+
+#define LIGHT_CLUSTER_X				16		//screen tiles across
+#define LIGHT_CLUSTER_Y				9		//screen tiles down
+#define LIGHT_CLUSTER_Z				24		//depth slices, exponentially spaced
+#define LIGHT_CLUSTER_TILES			(LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y)
+#define LIGHT_CLUSTER_TEXTURE_WIDTH	1024	//texels per row of the light and index textures, even
+#define LIGHT_CLUSTER_TEXTURE_SLOT	5		//the grid, index and light textures take units 5 ~ 7, after the shadow map
+
+// Clustered forward lighting for the Scene's PointLights. The view frustum is split into a grid of
+// froxels (screen tiles times exponential depth slices) and every froxel gets the list of lights whose
+// bounding sphere touches it. The lights are first bucketed into the depth slices they reach, then every
+// slice is tested row by row and tile by tile on the JobSystem, four spheres at a time, so the cost follows
+// how many froxels the lights overlap rather than lights times froxels.
+// The result goes into float textures the lit shaders read with texelFetch: the grid (offset and count per
+// froxel), the concatenated light indices and the light data. Main thread only, Create needs the GL context.
+class ClusteredLighting
+{
+public:
+	~ClusteredLighting();
+
+	// Returns false if the platform has no float textures
+	bool Create();
+	void Release();
+
+	// Look up the cluster uniforms of a shader, once after it was loaded
+	void InitUniforms(const Shader& shader);
+
+	// Assign the lights to the froxels of the camera and upload the result. Uses the current rlgl projection,
+	// which has to be a perspective one. Returns false if there is no light to shade with.
+	bool Build(const vector<PointLightData>& lights, const Camera3D& camera);
+
+	// Set the uniforms and bind the textures, the shader skips the clustered lights if the last Build failed
+	void Bind(const Shader& shader);
+
+	float NearDistance = 0.5f;			// the first slice also covers everything in front of it
+	float FarDistance = 300.0f;			// lights farther away are left out
+	int MaxLightsPerCluster = 128;		// lights beyond are dropped from a froxel
+
+	// Counters of the last Build
+	int NumLights = 0;
+	int NumVisibleLights = 0;
+	int NumIndices = 0;
+	int NumLitClusters = 0;
+
+protected:
+	// Bounding spheres in view space (x, y and depth along the view direction), padded to a multiple of 4
+	struct LightSphereSet
+	{
+		vector<float> x, y, depth, radius2;
+		vector<int> index;
+		int count = 0;
+	};
+
+	struct LightClusterBox
+	{
+		Vector3 min, max;	// x, y and depth
+	};
+
+	struct LightClusterSlice
+	{
+		vector<int> lights;			// visible lights reaching the slice
+		vector<int> indices;		// light lists of the tiles one after the other
+		int offsets[LIGHT_CLUSTER_TILES];
+		int counts[LIGHT_CLUSTER_TILES];
+		LightSphereSet sliceSpheres;
+		LightSphereSet rowSpheres;
+		vector<int> rowLights;
+	};
+
+	int GetSlice(float depth) const;
+	void AssignSlice(int slice);
+	void GatherSpheres(const vector<int>& lights, LightSphereSet& spheres) const;
+	void TestSpheres(const LightSphereSet& spheres, const LightClusterBox& box, vector<int>& result, int maxCount) const;
+	bool ReserveRows(unsigned int& textureId, int& rows, int neededRows, int format);
+
+	// Visible lights
+	vector<int> _Visible;
+	vector<float> _LightX, _LightY, _LightDepth, _LightRadius2;
+
+	LightClusterSlice _Slices[LIGHT_CLUSTER_Z];
+	float _SliceDepth[LIGHT_CLUSTER_Z + 1] = { 0 };
+
+	Matrix _View = { 0 };
+	Vector2 _ProjScale = { 1.0f, 1.0f };	// view to normalized device coordinates at depth 1
+	Vector2 _DepthParams = { 0 };			// slice = log(depth) * x + y
+	bool _Ready = false;
+
+	vector<float> _GridData;
+	vector<float> _IndexData;
+	vector<float> _LightData;
+	unsigned int _GridTextureId = 0;
+	unsigned int _IndexTextureId = 0;
+	unsigned int _LightTextureId = 0;
+	int _IndexRows = 0;
+	int _LightRows = 0;
+
+	int _EnabledLoc = -1;
+	int _ViewLoc = -1;
+	int _ProjScaleLoc = -1;
+	int _DepthParamsLoc = -1;
+	int _DimsLoc = -1;
+};
+
+//end of ClusteredLighting.h
@@ -47,6 +47,12 @@ public:
 	/// </summary>
 	bool receiveShadow = false;
 
+	/// <summary>
+	/// isStatic - the component and its actor neither move nor change shape, so shadow passes can keep
+	/// it in a cached shadow map. Call Scene::InvalidateRenderLists after changing it.
+	/// </summary>
+	bool isStatic = false;
+
 	/// <summary>
 	/// blendingMode - Specify the type of alpha blending when render this component
 	/// </summary>
@@ -70,6 +76,12 @@ public:
 
 	bool EnableAlphaTest = false; // If true, this component will use alpha test when rendering
 
+	/// <summary>
+	/// levelOfDetail - the level of detail this component selected for the main camera, 0 is the full detail.
+	/// Render passes forward it (plus their bias) in RenderHints::levelOfDetail
+	/// </summary>
+	unsigned levelOfDetail = 0;
+
 public:
 	Component() 
 		: Type(eComponentType::Undefined)
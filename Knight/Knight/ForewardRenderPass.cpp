@@ -7,9 +7,16 @@ bool ForwardRenderPass::Create(Scene* sc)
 	__super::Create(sc);
 
 	//default forward rendering pipeline use simple lighting model
-	LightShader = LoadShader("../../resources/shaders/glsl330/kn_lit.vs", "../../resources/shaders/glsl330/kn_lit.fs");
+	LightShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/kn_lit.vs", "../../resources/shaders/glsl330/kn_lit.fs");
 	InitLightUniforms(LightShader);
 	alphaTestLoc = GetShaderLocation(LightShader, "alphaTest");
+	viewPosLoc = GetShaderLocation(LightShader, "viewPos");
+
+	if (EnableClusteredLighting)
+	{
+		EnableClusteredLighting = Clusters.Create();
+		Clusters.InitUniforms(LightShader);
+	}
 
 	//Note: rlight of Raylib use a hardcoded value of 16.0f for shininess in the 
 	//this value should be overridden by the material, if not set, we provided a default value same as Raylib's rlight module 
@@ -24,6 +31,8 @@ bool ForwardRenderPass::Create(Scene* sc)
 
 void ForwardRenderPass::Release()
 {
+	Clusters.Release();
+	ResourceRegistry::Instance().ReleaseShader(LightShader);
 }
 
 void ForwardRenderPass::BeginScene(SceneCamera *pOverrideCamera)
@@ -34,8 +43,16 @@ void ForwardRenderPass::BeginScene(SceneCamera *pOverrideCamera)
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
 	pScene->_CurrentRenderPass = this;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);	
+	UpdateRenderQueue();
+
+	SetShaderValue(LightShader, viewPosLoc, &pActiveCamera->GetCamera3D()->position, SHADER_UNIFORM_VEC3);
+
+	//froxel light lists of this camera, the shader skips the clustered lights without them
+	if (EnableClusteredLighting)
+	{
+		Clusters.Build(pScene->PointLights, *pActiveCamera->GetCamera3D());
+		Clusters.Bind(LightShader);
+	}
 }
 
 void ForwardRenderPass::EndScene()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SceneRenderPass.h"
+#include "ClusteredLighting.h"
 
 class ForwardRenderPass : public SceneRenderPass
 {
@@ -14,5 +15,12 @@ class ForwardRenderPass : public SceneRenderPass
 
 		Shader LightShader = { 0 };
 
+		// Shade the Scene's PointLights through a froxel grid, set before Create
+		bool EnableClusteredLighting = true;
+		ClusteredLighting Clusters;
+
+	protected:
+		int viewPosLoc = -1;
+
         
 };
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "ImpostorAtlas.h"
+
+#include "raymath.h"
+#include "rlgl.h"
+
+ImpostorAtlas::ImpostorAtlas()
+{
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+	Unload();
+}
+
+/// <summary>
+/// Bake - Render the model into the atlas, one cell per view. Column c looks from the azimuth
+/// c * 360 / viewsAround, row r from the elevation r * IMPOSTOR_MAX_ELEVATION / (viewsAbove - 1).
+/// Every view is an orthographic projection of the bounding sphere, so the quad drawn later has
+/// the size of the sphere whatever the view. The cells keep an alpha of zero where the model is
+/// not covering them.
+/// </summary>
+/// <param name="model">The model, drawn with its own materials and without its transform.</param>
+/// <param name="bounds">Model space bounding box.</param>
+/// <param name="viewsAround">Number of azimuth views.</param>
+/// <param name="viewsAbove">Number of elevation rings.</param>
+/// <param name="cellSize">Pixel size of one view.</param>
+/// <returns>false if the render texture could not be created.</returns>
+bool ImpostorAtlas::Bake(const Model& model, BoundingBox bounds, int viewsAround, int viewsAbove, int cellSize)
+{
+	Unload();
+	if (model.meshCount == 0 || viewsAround < 1 || viewsAbove < 1 || cellSize < 1)
+		return false;
+
+	_Atlas = LoadRenderTexture(viewsAround * cellSize, viewsAbove * cellSize);
+	if (!IsRenderTextureReady(_Atlas))
+	{
+		TraceLog(LOG_WARNING, "IMPOSTOR: Failed to create a %dx%d atlas", viewsAround * cellSize, viewsAbove * cellSize);
+		_Atlas = { 0 };
+		return false;
+	}
+
+	_ViewsAround = viewsAround;
+	_ViewsAbove = viewsAbove;
+	_CellSize = cellSize;
+	_Center = Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5f);
+	_Radius = 0.5f * Vector3Distance(bounds.min, bounds.max);
+	if (_Radius <= 0.0f)
+		_Radius = 1.0f;
+
+	Model local = model;
+	local.transform = MatrixIdentity();
+
+	BeginTextureMode(_Atlas);
+	ClearBackground(BLANK);
+	for (int row = 0; row < viewsAbove; row++)
+	{
+		float elevation = viewsAbove > 1 ? row * IMPOSTOR_MAX_ELEVATION / (viewsAbove - 1) * DEG2RAD : 0.0f;
+		for (int column = 0; column < viewsAround; column++)
+		{
+			float azimuth = column * 2.0f * PI / viewsAround;
+			Vector3 direction = { sinf(azimuth) * cosf(elevation), sinf(elevation), cosf(azimuth) * cosf(elevation) };
+			Vector3 eye = Vector3Add(_Center, Vector3Scale(direction, 2.0f * _Radius));
+
+			//same setup as BeginMode3D, with a square projection for the cell instead of the render target aspect
+			rlDrawRenderBatchActive();
+			rlViewport(column * cellSize, row * cellSize, cellSize, cellSize);
+			rlMatrixMode(RL_PROJECTION);
+			rlPushMatrix();
+			rlLoadIdentity();
+			rlOrtho(-_Radius, _Radius, -_Radius, _Radius, 0.5 * _Radius, 3.5 * _Radius);
+			rlMatrixMode(RL_MODELVIEW);
+			rlLoadIdentity();
+			rlMultMatrixf(MatrixToFloat(MatrixLookAt(eye, _Center, Vector3{ 0.0f, 1.0f, 0.0f })));
+			rlEnableDepthTest();
+
+			DrawModel(local, Vector3Zero(), 1.0f, WHITE);
+
+			rlDrawRenderBatchActive();
+			rlMatrixMode(RL_PROJECTION);
+			rlPopMatrix();
+			rlMatrixMode(RL_MODELVIEW);
+			rlLoadIdentity();
+			rlDisableDepthTest();
+		}
+	}
+	EndTextureMode();
+
+	//distant impostors are small on screen, filter them through the mip chain
+	GenTextureMipmaps(&_Atlas.texture);
+	SetTextureFilter(_Atlas.texture, TEXTURE_FILTER_TRILINEAR);
+
+	TraceLog(LOG_INFO, "IMPOSTOR: Baked %d views into a %dx%d atlas", viewsAround * viewsAbove, _Atlas.texture.width, _Atlas.texture.height);
+	return true;
+}
+
+/// <summary>
+/// Unload - Release the atlas render texture.
+/// </summary>
+void ImpostorAtlas::Unload()
+{
+	if (_Atlas.id > 0)
+		UnloadRenderTexture(_Atlas);
+	_Atlas = { 0 };
+	_ViewsAround = _ViewsAbove = _CellSize = 0;
+}
+
+/// <summary>
+/// GetViewCell - Pick the baked view closest to a view direction.
+/// </summary>
+/// <param name="localViewDirection">Direction from the model center to the viewer, model space.</param>
+/// <returns>The cell as a source rectangle, with a negative height since render textures are stored bottom up.</returns>
+Rectangle ImpostorAtlas::GetViewCell(Vector3 localViewDirection) const
+{
+	float azimuth = atan2f(localViewDirection.x, localViewDirection.z);
+	int column = (int)floorf(azimuth / (2.0f * PI) * _ViewsAround + 0.5f);
+	column = ((column % _ViewsAround) + _ViewsAround) % _ViewsAround;
+
+	int row = 0;
+	if (_ViewsAbove > 1)
+	{
+		float horizontal = sqrtf(localViewDirection.x * localViewDirection.x + localViewDirection.z * localViewDirection.z);
+		float elevation = Clamp(atan2f(localViewDirection.y, horizontal) * RAD2DEG, 0.0f, IMPOSTOR_MAX_ELEVATION);
+		row = (int)(elevation / IMPOSTOR_MAX_ELEVATION * (_ViewsAbove - 1) + 0.5f);
+	}
+
+	return Rectangle{ (float)(column * _CellSize), (float)((row + 1) * _CellSize), (float)_CellSize, -(float)_CellSize };
+}
+
+/// <summary>
+/// Draw - Draw the impostor as a screen aligned quad at the world position of the bounding sphere center.
+/// </summary>
+/// <param name="camera">The camera the quad faces, also selects the view.</param>
+/// <param name="transform">World transform of the model.</param>
+/// <param name="tint">Color and alpha of the quad.</param>
+void ImpostorAtlas::Draw(const Camera3D& camera, const Matrix& transform, Color tint) const
+{
+	if (!IsBaked())
+		return;
+
+	Vector3 center = Vector3Transform(_Center, transform);
+	Vector3 localEye = Vector3Transform(camera.position, MatrixInvert(transform));
+	Rectangle cell = GetViewCell(Vector3Subtract(localEye, _Center));
+
+	float scale = Vector3Length(Vector3{ transform.m0, transform.m1, transform.m2 });
+	float size = 2.0f * _Radius * scale;
+
+	Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+	Vector3 up = { view.m1, view.m5, view.m9 };
+	DrawBillboardPro(camera, _Atlas.texture, cell, center, up, Vector2{ size, size }, Vector2{ size * 0.5f, size * 0.5f }, 0.0f, tint);
+}
+
+//End of ImpostorAtlas.cpp
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "raylib.h"
+
+#define IMPOSTOR_DEFAULT_VIEWS_AROUND	8		//views on a ring around the Y axis
+#define IMPOSTOR_DEFAULT_VIEWS_ABOVE	3		//rings from the horizon up to IMPOSTOR_MAX_ELEVATION
+#define IMPOSTOR_DEFAULT_CELL_SIZE		128		//pixels per view
+#define IMPOSTOR_MAX_ELEVATION			60.0f	//degrees above the horizon of the highest ring
+
+// A model rendered from a set of view directions into one texture, drawn as a camera facing quad
+// showing the view closest to the camera direction. One atlas can be shared by all instances of a model.
+class ImpostorAtlas
+{
+public:
+	ImpostorAtlas();
+	~ImpostorAtlas();
+
+	// Render the model (in its local space) from viewsAround x viewsAbove directions, main thread
+	bool Bake(const Model& model, BoundingBox bounds,
+		int viewsAround = IMPOSTOR_DEFAULT_VIEWS_AROUND,
+		int viewsAbove = IMPOSTOR_DEFAULT_VIEWS_ABOVE,
+		int cellSize = IMPOSTOR_DEFAULT_CELL_SIZE);
+	void Unload();
+	bool IsBaked() const { return _Atlas.id > 0; }
+
+	// Atlas rectangle of the view closest to a direction from the model towards the viewer, in model space
+	Rectangle GetViewCell(Vector3 localViewDirection) const;
+
+	// Draw the quad for a model with the given world transform
+	void Draw(const Camera3D& camera, const Matrix& transform, Color tint = WHITE) const;
+
+	Texture2D GetTexture() const { return _Atlas.texture; }
+	float GetRadius() const { return _Radius; }
+
+protected:
+	RenderTexture2D _Atlas = { 0 };
+	int _ViewsAround = 0;
+	int _ViewsAbove = 0;
+	int _CellSize = 0;
+	Vector3 _Center = { 0 };	//bounding sphere of the baked model, model space
+	float _Radius = 0.0f;
+};
@@ -0,0 +1,157 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <memory>
+
+JobSystem::JobSystem()
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+/// <summary>
+/// Instance - Get the engine wide job system, the worker threads are started on first use.
+/// </summary>
+/// <returns>The shared JobSystem.</returns>
+JobSystem& JobSystem::Instance()
+{
+	static JobSystem jobSystem;
+	static once_flag started;
+	call_once(started, []() { jobSystem.Initialize(); });
+	return jobSystem;
+}
+
+/// <summary>
+/// Initialize - Start the worker threads.
+/// </summary>
+/// <param name="numWorkers">Number of worker threads, values <= 0 use one less than the hardware threads.</param>
+void JobSystem::Initialize(int numWorkers)
+{
+	if (!_Workers.empty())
+		return;
+
+	if (numWorkers <= 0) {
+		numWorkers = std::max(1, (int)thread::hardware_concurrency() - 1);
+	}
+
+	_Stopping = false;
+	for (int i = 0; i < numWorkers; i++) {
+		_Workers.emplace_back(&JobSystem::WorkerMain, this);
+	}
+}
+
+/// <summary>
+/// Shutdown - Run the remaining queued jobs and join the worker threads.
+/// </summary>
+void JobSystem::Shutdown()
+{
+	{
+		lock_guard<mutex> lock(_JobsLock);
+		_Stopping = true;
+	}
+	_JobsSignal.notify_all();
+
+	for (auto& worker : _Workers) {
+		if (worker.joinable())
+			worker.join();
+	}
+	_Workers.clear();
+}
+
+/// <summary>
+/// Submit - Queue a job for a worker thread.
+/// </summary>
+/// <param name="job">The work to run.</param>
+/// <returns>A future which becomes ready after the job has run.</returns>
+future<void> JobSystem::Submit(function<void()> job)
+{
+	auto task = make_shared<packaged_task<void()>>(std::move(job));
+	future<void> result = task->get_future();
+	Enqueue([task]() { (*task)(); });
+	return result;
+}
+
+/// <summary>
+/// ParallelFor - Run func over [0, count) in batches on the workers and the calling thread.
+/// Batches are handed out through an atomic counter so callers may nest ParallelFor inside jobs
+/// without dead locking, the calling thread simply processes the batches nobody picked up.
+/// </summary>
+/// <param name="count">Number of items.</param>
+/// <param name="batchSize">Items per batch.</param>
+/// <param name="func">Called with a [begin, end) range of items.</param>
+void JobSystem::ParallelFor(int count, int batchSize, const function<void(int begin, int end)>& func)
+{
+	if (count <= 0)
+		return;
+
+	batchSize = std::max(1, batchSize);
+	int numBatches = (count + batchSize - 1) / batchSize;
+
+	if (numBatches == 1 || _Workers.empty()) {
+		func(0, count);
+		return;
+	}
+
+	struct ParallelForState
+	{
+		atomic<int> nextBatch{ 0 };
+		atomic<int> doneBatches{ 0 };
+		mutex doneLock;
+		condition_variable doneSignal;
+	};
+	auto state = make_shared<ParallelForState>();
+	const function<void(int, int)>* pFunc = &func;
+
+	auto runBatches = [state, pFunc, count, batchSize, numBatches]() {
+		int batch;
+		while ((batch = state->nextBatch.fetch_add(1)) < numBatches) {
+			int begin = batch * batchSize;
+			int end = std::min(begin + batchSize, count);
+			(*pFunc)(begin, end);
+			if (state->doneBatches.fetch_add(1) + 1 == numBatches) {
+				lock_guard<mutex> lock(state->doneLock);
+				state->doneSignal.notify_all();
+			}
+		}
+	};
+
+	int numHelpers = std::min((int)_Workers.size(), numBatches - 1);
+	for (int i = 0; i < numHelpers; i++) {
+		Enqueue(runBatches);
+	}
+
+	runBatches();
+
+	//wait for the batches still running on the workers
+	unique_lock<mutex> lock(state->doneLock);
+	state->doneSignal.wait(lock, [&state, numBatches]() { return state->doneBatches.load() >= numBatches; });
+}
+
+void JobSystem::Enqueue(function<void()> job)
+{
+	{
+		lock_guard<mutex> lock(_JobsLock);
+		_Jobs.push_back(std::move(job));
+	}
+	_JobsSignal.notify_one();
+}
+
+void JobSystem::WorkerMain()
+{
+	for (;;)
+	{
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(_JobsLock);
+			_JobsSignal.wait(lock, [this]() { return _Stopping || !_Jobs.empty(); });
+			if (_Jobs.empty())
+				return; //stopping and nothing left to run
+			job = std::move(_Jobs.front());
+			_Jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+
+using namespace std;
+
+// Minimal worker thread pool used by the engine for background loading and data-parallel loops.
+// Jobs must not touch raylib/OpenGL state, GPU uploads have to stay on the main thread.
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	static JobSystem& Instance();
+
+	// Start the worker threads, numWorkers <= 0 means (hardware threads - 1)
+	void Initialize(int numWorkers = 0);
+	void Shutdown();
+
+	// Queue a job on a worker thread, the returned future becomes ready once it has run
+	future<void> Submit(function<void()> job);
+
+	// Split [0, count) into batches of batchSize and run them on the workers.
+	// The calling thread works on batches too and returns after all of them are done.
+	void ParallelFor(int count, int batchSize, const function<void(int begin, int end)>& func);
+
+	int GetNumWorkers() const { return (int)_Workers.size(); }
+	int GetNumThreads() const { return (int)_Workers.size() + 1; }
+
+protected:
+	void WorkerMain();
+	void Enqueue(function<void()> job);
+
+	vector<thread> _Workers;
+	deque<function<void()>> _Jobs;
+	mutex _JobsLock;
+	condition_variable _JobsSignal;
+	bool _Stopping = false;
+};
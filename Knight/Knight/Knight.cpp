@@ -123,6 +123,8 @@ void Knight::Start()
 
 void Knight::EndGame()
 {
+	AsyncAssetLoader::Instance().Shutdown();
+
 	OnReleaseDefaultResources();
 
 	UnloadFont(_Font);
@@ -137,6 +139,9 @@ void Knight::GameLoop()
 {
 	while (!WindowShouldClose() && (!_shouldExitGameLoop))
 	{	
+		//finish the asynchronous loads the workers have decoded, so components see them in this Update
+		AsyncAssetLoader::Instance().ProcessUploads(Config.AssetUploadBudgetMs);
+
 		Update(GetFrameTime());
 
 		DrawOffscreen();
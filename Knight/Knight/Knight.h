@@ -16,10 +16,20 @@
 #include "CylinderComponent.h"
 #include "ConeComponent.h"
 #include "SceneRenderPass.h"
+#include "ClusteredLighting.h"
 #include "ForwardRenderPass.h"
 #include "LitDepthRenderPass.h"
 #include "LitShadowRenderPass.h"
 #include "KnightUtils.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "ImpostorAtlas.h"
+#include "KnightAsset.h"
+#include "ResourceRegistry.h"
+#include "AsyncAssetLoader.h"
+#include "TextureCache.h"
+#include "StreamingQuadBuffer.h"
 
 struct KnightConfig
 {
@@ -27,6 +37,7 @@ struct KnightConfig
 	bool ShowDebugInfo = false;
 	bool EnableDefaultLight = true;
 	bool EnableDefaultRenderPasses = true;
+	float AssetUploadBudgetMs = ASYNC_UPLOAD_BUDGET_MS;	// main thread time per frame for finishing asynchronous loads
 };
 
 struct ComparePriorityDescending
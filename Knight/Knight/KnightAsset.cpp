@@ -0,0 +1,779 @@
+#include "KnightAsset.h"
+#include "KnightUtils.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+#include "rlgl.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+// Bytes per vertex of every stream, in eKnightAssetStream order
+static const int StreamStrides[KNA_STREAM_COUNT] = {
+	3 * sizeof(float), 2 * sizeof(float), 2 * sizeof(float), 3 * sizeof(float),
+	4 * sizeof(float), 4, 4, 4 * sizeof(float)
+};
+
+// The Mesh member holding every stream, in eKnightAssetStream order
+static void GetMeshStreams(Mesh& mesh, void** ppStreams[KNA_STREAM_COUNT])
+{
+	ppStreams[KNA_STREAM_POSITIONS] = (void**)&mesh.vertices;
+	ppStreams[KNA_STREAM_TEXCOORDS] = (void**)&mesh.texcoords;
+	ppStreams[KNA_STREAM_TEXCOORDS2] = (void**)&mesh.texcoords2;
+	ppStreams[KNA_STREAM_NORMALS] = (void**)&mesh.normals;
+	ppStreams[KNA_STREAM_TANGENTS] = (void**)&mesh.tangents;
+	ppStreams[KNA_STREAM_COLORS] = (void**)&mesh.colors;
+	ppStreams[KNA_STREAM_BONE_IDS] = (void**)&mesh.boneIds;
+	ppStreams[KNA_STREAM_BONE_WEIGHTS] = (void**)&mesh.boneWeights;
+}
+
+// Append a section at the next aligned offset, pData may be null to reserve zeroed space
+static unsigned long long AppendSection(vector<unsigned char>& blob, const void* pData, size_t size)
+{
+	size_t offset = (blob.size() + KNIGHT_ASSET_ALIGNMENT - 1) & ~(size_t)(KNIGHT_ASSET_ALIGNMENT - 1);
+	blob.resize(offset + size, 0);
+	if (pData != nullptr && size > 0)
+		memcpy(&blob[offset], pData, size);
+	return offset;
+}
+
+static void* CopyData(const void* pSource, size_t size)
+{
+	void* pCopy = RL_MALLOC(size);
+	memcpy(pCopy, pSource, size);
+	return pCopy;
+}
+
+/// <summary>
+/// Convert - Load a model with raylib, apply the processing ModelComponent would do after loading
+/// (smooth normals, vertex deduplication and cache/overdraw/fetch optimization) and save the result.
+/// </summary>
+/// <param name="sourcePath">Any model file raylib can load (.obj, .glb, .gltf, .iqm, .m3d, .vox).</param>
+/// <param name="outPath">The .kna file to write.</param>
+/// <param name="generateTangents">Also bake tangents for the meshes with texture coordinates.</param>
+/// <returns>true if the file was written.</returns>
+bool KnightAsset::Convert(const char* sourcePath, const char* outPath, bool generateTangents)
+{
+	if (!FileExists(sourcePath))
+		return false;
+
+	double startTime = GetTime();
+	Model model = LoadModel(sourcePath);
+	if (model.meshCount == 0)
+	{
+		UnloadModel(model);
+		return false;
+	}
+	int animationCount = 0;
+	ModelAnimation* pAnimations = LoadModelAnimations(sourcePath, &animationCount);
+
+	RecalculateSmoothNormals(model);
+	JobSystem::Instance().ParallelFor(model.meshCount, 1, [&model, generateTangents](int begin, int end) {
+		for (int m = begin; m < end; m++)
+		{
+			MeshOptimizer::OptimizeMesh(&model.meshes[m]);
+			if (generateTangents && model.meshes[m].texcoords != nullptr)
+				MeshOptimizer::GenerateTangents(&model.meshes[m]);
+		}
+	});
+
+	bool success = Save(model, pAnimations, animationCount, outPath);
+
+	if (pAnimations != nullptr)
+		UnloadModelAnimations(pAnimations, animationCount);
+	UnloadModel(model);
+
+	if (success)
+		TraceLog(LOG_INFO, "KNA: [%s] Converted to %s in %.1f ms", sourcePath, outPath, (GetTime() - startTime) * 1000.0);
+	else
+		TraceLog(LOG_WARNING, "KNA: [%s] Failed to write %s", sourcePath, outPath);
+	return success;
+}
+
+/// <summary>
+/// Save - Write the CPU arrays of a model, its materials and animations into one file. Textures which
+/// are not the default texture are exported as png files next to the .kna and referenced by name.
+/// </summary>
+/// <param name="model">The model, its meshes need their CPU arrays.</param>
+/// <param name="pAnimations">Animations, may be null.</param>
+/// <param name="animationCount">Number of animations.</param>
+/// <param name="outPath">The .kna file to write.</param>
+/// <returns>true if the file was written.</returns>
+bool KnightAsset::Save(const Model& model, const ModelAnimation* pAnimations, int animationCount, const char* outPath)
+{
+	if (model.meshCount == 0 || model.meshes == nullptr)
+		return false;
+	if (pAnimations == nullptr)
+		animationCount = 0;
+
+	KnightAssetHeader header = { 0 };
+	header.magic = KNIGHT_ASSET_MAGIC;
+	header.version = KNIGHT_ASSET_VERSION;
+	header.meshCount = model.meshCount;
+	header.materialCount = model.materialCount;
+	header.boneCount = model.bones != nullptr ? model.boneCount : 0;
+	header.animationCount = animationCount;
+
+	vector<unsigned char> blob(sizeof(KnightAssetHeader), 0);
+	header.meshTableOffset = AppendSection(blob, nullptr, model.meshCount * sizeof(KnightAssetMesh));
+	header.materialTableOffset = AppendSection(blob, nullptr, model.materialCount * sizeof(KnightAssetMaterial));
+	header.bonesOffset = AppendSection(blob, model.bones, header.boneCount * sizeof(BoneInfo));
+	header.bindPoseOffset = AppendSection(blob, model.bindPose, model.bindPose != nullptr ? header.boneCount * sizeof(Transform) : 0);
+	header.animationTableOffset = AppendSection(blob, nullptr, animationCount * sizeof(KnightAssetAnimation));
+
+	vector<KnightAssetMesh> meshes(model.meshCount);
+	for (int m = 0; m < model.meshCount; m++)
+	{
+		Mesh mesh = model.meshes[m];
+		KnightAssetMesh& record = meshes[m];
+		memset(&record, 0, sizeof(record));
+		record.vertexCount = mesh.vertexCount;
+		record.triangleCount = mesh.triangleCount;
+		record.indexCount = mesh.indices != nullptr ? mesh.triangleCount * 3 : 0;
+		record.materialIndex = model.meshMaterial != nullptr ? model.meshMaterial[m] : 0;
+		record.bounds = GetMeshBoundingBox(mesh);
+
+		void** ppStreams[KNA_STREAM_COUNT];
+		GetMeshStreams(mesh, ppStreams);
+		for (int s = 0; s < KNA_STREAM_COUNT; s++)
+		{
+			if (*ppStreams[s] != nullptr)
+				record.streamOffsets[s] = AppendSection(blob, *ppStreams[s], (size_t)mesh.vertexCount * StreamStrides[s]);
+		}
+		if (record.indexCount > 0)
+			record.indexOffset = AppendSection(blob, mesh.indices, record.indexCount * sizeof(unsigned short));
+
+		if (m == 0)
+			header.bounds = record.bounds;
+		header.bounds.min = Vector3Min(header.bounds.min, record.bounds.min);
+		header.bounds.max = Vector3Max(header.bounds.max, record.bounds.max);
+	}
+
+	vector<KnightAssetMaterial> materials(model.materialCount);
+	for (int i = 0; i < model.materialCount; i++)
+	{
+		KnightAssetMaterial& record = materials[i];
+		memset(&record, 0, sizeof(record));
+		if (model.materials[i].maps == nullptr)
+			continue;
+		for (int j = 0; j < KNIGHT_ASSET_MAX_MAPS; j++)
+		{
+			MaterialMap map = model.materials[i].maps[j];
+			record.colors[j] = map.color;
+			record.values[j] = map.value;
+			if (map.texture.id > 0 && map.texture.id != rlGetTextureIdDefault())
+			{
+				char fileName[KNIGHT_ASSET_MAX_PATH];
+				snprintf(fileName, sizeof(fileName), "%s_m%d_%d.png", GetFileNameWithoutExt(outPath), i, j);
+				Image image = LoadImageFromTexture(map.texture);
+				if (ExportImage(image, TextFormat("%s/%s", GetDirectoryPath(outPath), fileName)))
+					memcpy(record.texturePaths[j], fileName, sizeof(fileName));
+				UnloadImage(image);
+			}
+		}
+	}
+
+	vector<KnightAssetAnimation> animations(animationCount);
+	for (int a = 0; a < animationCount; a++)
+	{
+		const ModelAnimation& animation = pAnimations[a];
+		KnightAssetAnimation& record = animations[a];
+		memset(&record, 0, sizeof(record));
+		memcpy(record.name, animation.name, sizeof(record.name));
+		record.boneCount = animation.boneCount;
+		record.frameCount = animation.frameCount;
+		record.bonesOffset = AppendSection(blob, animation.bones, animation.boneCount * sizeof(BoneInfo));
+
+		vector<Transform> poses((size_t)animation.frameCount * animation.boneCount);
+		for (int f = 0; f < animation.frameCount; f++)
+			memcpy(&poses[(size_t)f * animation.boneCount], animation.framePoses[f], animation.boneCount * sizeof(Transform));
+		record.framePosesOffset = AppendSection(blob, poses.data(), poses.size() * sizeof(Transform));
+	}
+
+	//tables last, the sections above have resized the blob
+	header.fileSize = blob.size();
+	memcpy(&blob[0], &header, sizeof(header));
+	if (!meshes.empty())
+		memcpy(&blob[(size_t)header.meshTableOffset], meshes.data(), meshes.size() * sizeof(KnightAssetMesh));
+	if (!materials.empty())
+		memcpy(&blob[(size_t)header.materialTableOffset], materials.data(), materials.size() * sizeof(KnightAssetMaterial));
+	if (!animations.empty())
+		memcpy(&blob[(size_t)header.animationTableOffset], animations.data(), animations.size() * sizeof(KnightAssetAnimation));
+
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, outPath, "wb") != 0 || fp == nullptr)
+		return false;
+	bool success = fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+	fclose(fp);
+	return success;
+}
+
+static bool IsInFile(unsigned long long fileSize, unsigned long long offset, unsigned long long size)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+// Check the header and the tables of a mapped .kna file, the sections themselves are used as they are
+static bool IsValidAsset(const unsigned char* pData, unsigned long long fileSize)
+{
+	if (fileSize < sizeof(KnightAssetHeader))
+		return false;
+
+	const KnightAssetHeader* pHeader = (const KnightAssetHeader*)pData;
+	bool valid = pHeader->magic == KNIGHT_ASSET_MAGIC && pHeader->version == KNIGHT_ASSET_VERSION && pHeader->fileSize == fileSize
+		&& pHeader->meshCount > 0 && pHeader->materialCount >= 0 && pHeader->boneCount >= 0 && pHeader->animationCount >= 0
+		&& IsInFile(fileSize, pHeader->meshTableOffset, pHeader->meshCount * sizeof(KnightAssetMesh))
+		&& IsInFile(fileSize, pHeader->materialTableOffset, pHeader->materialCount * sizeof(KnightAssetMaterial))
+		&& IsInFile(fileSize, pHeader->bonesOffset, pHeader->boneCount * sizeof(BoneInfo))
+		&& IsInFile(fileSize, pHeader->animationTableOffset, pHeader->animationCount * sizeof(KnightAssetAnimation));
+
+	const KnightAssetMesh* pMeshes = valid ? (const KnightAssetMesh*)(pData + pHeader->meshTableOffset) : nullptr;
+	for (int m = 0; valid && m < pHeader->meshCount; m++)
+	{
+		const KnightAssetMesh& record = pMeshes[m];
+		valid = record.vertexCount > 0 && record.streamOffsets[KNA_STREAM_POSITIONS] != 0
+			&& (record.indexCount == 0 || IsInFile(fileSize, record.indexOffset, record.indexCount * sizeof(unsigned short)));
+		for (int s = 0; valid && s < KNA_STREAM_COUNT; s++)
+			valid = record.streamOffsets[s] == 0 || IsInFile(fileSize, record.streamOffsets[s], (unsigned long long)record.vertexCount * StreamStrides[s]);
+	}
+	return valid;
+}
+
+// Point the streams of a mesh at a mapped mesh record. Skinned meshes are animated on the CPU,
+// they get their own animated arrays like raylib's loaders create them.
+static void MapMeshStreams(const unsigned char* pData, const KnightAssetMesh& record, Mesh& mesh)
+{
+	mesh.vertexCount = record.vertexCount;
+	mesh.triangleCount = record.triangleCount;
+
+	void** ppStreams[KNA_STREAM_COUNT];
+	GetMeshStreams(mesh, ppStreams);
+	for (int s = 0; s < KNA_STREAM_COUNT; s++)
+		*ppStreams[s] = record.streamOffsets[s] != 0 ? (void*)(pData + record.streamOffsets[s]) : nullptr;
+	mesh.indices = record.indexCount > 0 ? (unsigned short*)(pData + record.indexOffset) : nullptr;
+
+	if (mesh.boneIds != nullptr && mesh.boneWeights != nullptr)
+	{
+		mesh.animVertices = (float*)CopyData(mesh.vertices, (size_t)mesh.vertexCount * StreamStrides[KNA_STREAM_POSITIONS]);
+		if (mesh.normals != nullptr)
+			mesh.animNormals = (float*)CopyData(mesh.normals, (size_t)mesh.vertexCount * StreamStrides[KNA_STREAM_NORMALS]);
+	}
+}
+
+// Replace the mapped streams of a mesh with copies, or forget them if copy is false
+static void CopyMeshStreams(Mesh& mesh, int indexCount, bool copy)
+{
+	void** ppStreams[KNA_STREAM_COUNT];
+	GetMeshStreams(mesh, ppStreams);
+	for (int s = 0; s < KNA_STREAM_COUNT; s++)
+	{
+		if (*ppStreams[s] != nullptr)
+			*ppStreams[s] = copy ? CopyData(*ppStreams[s], (size_t)mesh.vertexCount * StreamStrides[s]) : nullptr;
+	}
+	if (mesh.indices != nullptr)
+		mesh.indices = copy ? (unsigned short*)CopyData(mesh.indices, indexCount * sizeof(unsigned short)) : nullptr;
+}
+
+// Skeleton and bind pose, copied out of the mapping
+static void ReadSkeleton(const unsigned char* pData, unsigned long long fileSize, Model& model)
+{
+	const KnightAssetHeader* pHeader = (const KnightAssetHeader*)pData;
+	if (pHeader->boneCount <= 0)
+		return;
+
+	model.boneCount = pHeader->boneCount;
+	model.bones = (BoneInfo*)CopyData(pData + pHeader->bonesOffset, model.boneCount * sizeof(BoneInfo));
+	if (IsInFile(fileSize, pHeader->bindPoseOffset, model.boneCount * sizeof(Transform)))
+		model.bindPose = (Transform*)CopyData(pData + pHeader->bindPoseOffset, model.boneCount * sizeof(Transform));
+}
+
+// Animations, in the allocation layout UnloadModelAnimations expects. Invalid records are skipped.
+static void ReadAnimations(const unsigned char* pData, unsigned long long fileSize, ModelAnimation** ppAnimations, int* pAnimationCount)
+{
+	const KnightAssetHeader* pHeader = (const KnightAssetHeader*)pData;
+	if (pHeader->animationCount <= 0)
+		return;
+
+	const KnightAssetAnimation* pRecords = (const KnightAssetAnimation*)(pData + pHeader->animationTableOffset);
+	ModelAnimation* pAnimations = (ModelAnimation*)RL_CALLOC(pHeader->animationCount, sizeof(ModelAnimation));
+	int count = 0;
+	for (int a = 0; a < pHeader->animationCount; a++)
+	{
+		const KnightAssetAnimation& record = pRecords[a];
+		size_t frameBytes = record.boneCount * sizeof(Transform);
+		if (record.boneCount <= 0 || record.frameCount <= 0 || !IsInFile(fileSize, record.bonesOffset, record.boneCount * sizeof(BoneInfo))
+			|| !IsInFile(fileSize, record.framePosesOffset, (unsigned long long)record.frameCount * frameBytes))
+			continue;
+
+		ModelAnimation& animation = pAnimations[count++];
+		memcpy(animation.name, record.name, sizeof(animation.name));
+		animation.boneCount = record.boneCount;
+		animation.frameCount = record.frameCount;
+		animation.bones = (BoneInfo*)CopyData(pData + record.bonesOffset, record.boneCount * sizeof(BoneInfo));
+		animation.framePoses = (Transform**)RL_MALLOC(record.frameCount * sizeof(Transform*));
+		for (int f = 0; f < record.frameCount; f++)
+			animation.framePoses[f] = (Transform*)CopyData(pData + record.framePosesOffset + f * frameBytes, frameBytes);
+	}
+	*ppAnimations = pAnimations;
+	*pAnimationCount = count;
+}
+
+// The texture path of a material map, relative to the .kna file, empty if the map has none
+static string GetMaterialTexturePath(const string& directory, const KnightAssetMaterial& material, int map)
+{
+	char texturePath[KNIGHT_ASSET_MAX_PATH];
+	memcpy(texturePath, material.texturePaths[map], sizeof(texturePath));
+	texturePath[KNIGHT_ASSET_MAX_PATH - 1] = 0;
+	return texturePath[0] != 0 ? directory + "/" + texturePath : string();
+}
+
+// Directory part of a path, without TextFormat's shared buffers so workers can use it
+static string GetDirectory(const string& path)
+{
+	size_t separator = path.find_last_of("/\\");
+	return separator == string::npos ? string(".") : path.substr(0, separator);
+}
+
+/// <summary>
+/// Load - Map a .kna file and build the model from it. Only the tables are validated, the sections are
+/// used as they are. The file is unmapped before returning, the GPU and CPU copies don't reference it.
+/// </summary>
+/// <param name="path">The .kna file.</param>
+/// <param name="pModel">Returns the model, release it with UnloadModel.</param>
+/// <param name="ppAnimations">Returns the animations (null if there are none), may be null.</param>
+/// <param name="pAnimationCount">Returns the number of animations, may be null.</param>
+/// <param name="keepMeshData">Keep CPU copies of the vertex streams and indices of static meshes.</param>
+/// <param name="pMeshBounds">Returns the bounding box of every mesh, may be null.</param>
+/// <returns>false if the file is missing or not a valid .kna file.</returns>
+bool KnightAsset::Load(const char* path, Model* pModel, ModelAnimation** ppAnimations, int* pAnimationCount, bool keepMeshData, vector<BoundingBox>* pMeshBounds)
+{
+	*pModel = Model{ 0 };
+	if (ppAnimations != nullptr)
+		*ppAnimations = nullptr;
+	if (pAnimationCount != nullptr)
+		*pAnimationCount = 0;
+
+	double startTime = GetTime();
+	MappedFile file;
+	if (!file.Open(path) || file.GetSize() < sizeof(KnightAssetHeader))
+	{
+		TraceLog(LOG_WARNING, "KNA: [%s] Failed to open file", path);
+		return false;
+	}
+	const unsigned long long fileSize = file.GetSize();
+	const unsigned char* pData = file.Map(0, (size_t)fileSize);
+	if (pData == nullptr)
+	{
+		TraceLog(LOG_WARNING, "KNA: [%s] Failed to map file", path);
+		return false;
+	}
+	if (!IsValidAsset(pData, fileSize))
+	{
+		TraceLog(LOG_WARNING, "KNA: [%s] Not a valid Knight asset file", path);
+		file.Unmap(pData);
+		return false;
+	}
+
+	const KnightAssetHeader* pHeader = (const KnightAssetHeader*)pData;
+	Model model = { 0 };
+	model.transform = MatrixIdentity();
+
+	//meshes, uploaded straight from the mapping
+	const KnightAssetMesh* pMeshes = (const KnightAssetMesh*)(pData + pHeader->meshTableOffset);
+	model.meshCount = pHeader->meshCount;
+	model.meshes = (Mesh*)RL_CALLOC(model.meshCount, sizeof(Mesh));
+	model.meshMaterial = (int*)RL_CALLOC(model.meshCount, sizeof(int));
+	for (int m = 0; m < model.meshCount; m++)
+	{
+		const KnightAssetMesh& record = pMeshes[m];
+		Mesh& mesh = model.meshes[m];
+		MapMeshStreams(pData, record, mesh);
+		UploadMesh(&mesh, false);
+
+		bool skinned = mesh.boneIds != nullptr && mesh.boneWeights != nullptr;
+		CopyMeshStreams(mesh, record.indexCount, keepMeshData || skinned);
+
+		model.meshMaterial[m] = (record.materialIndex >= 0 && record.materialIndex < pHeader->materialCount) ? record.materialIndex : 0;
+		if (pMeshBounds != nullptr)
+			pMeshBounds->push_back(record.bounds);
+	}
+
+	//materials, textures are loaded relative to the .kna file
+	string directory = GetDirectory(path);
+	model.materialCount = pHeader->materialCount > 0 ? pHeader->materialCount : 1;
+	model.materials = (Material*)RL_CALLOC(model.materialCount, sizeof(Material));
+	const KnightAssetMaterial* pMaterials = (const KnightAssetMaterial*)(pData + pHeader->materialTableOffset);
+	for (int i = 0; i < model.materialCount; i++)
+	{
+		model.materials[i] = LoadMaterialDefault();
+		if (i >= pHeader->materialCount)
+			continue;
+		for (int j = 0; j < KNIGHT_ASSET_MAX_MAPS; j++)
+		{
+			model.materials[i].maps[j].color = pMaterials[i].colors[j];
+			model.materials[i].maps[j].value = pMaterials[i].values[j];
+			string texturePath = GetMaterialTexturePath(directory, pMaterials[i], j);
+			if (!texturePath.empty())
+				model.materials[i].maps[j].texture = KnightAsset::LoadTexture(texturePath.c_str());
+		}
+	}
+
+	ReadSkeleton(pData, fileSize, model);
+	if (ppAnimations != nullptr && pAnimationCount != nullptr)
+		ReadAnimations(pData, fileSize, ppAnimations, pAnimationCount);
+
+	file.Unmap(pData);
+	*pModel = model;
+	TraceLog(LOG_INFO, "KNA: [%s] Loaded %d meshes, %d bones, %d animations in %.1f ms", path,
+		model.meshCount, model.boneCount, pAnimationCount != nullptr ? *pAnimationCount : 0, (GetTime() - startTime) * 1000.0);
+	return true;
+}
+
+/// <summary>
+/// ReadModel - The CPU half of Load for background loading: the meshes are copied out of the mapping
+/// and the material textures decoded, nothing touches the GPU. Safe on worker threads.
+/// </summary>
+/// <param name="path">The .kna file.</param>
+/// <param name="pData">Returns the model data, pass it to UploadModel or UnloadModelData.</param>
+/// <returns>false if the file is missing or not a valid .kna file.</returns>
+bool KnightAsset::ReadModel(const char* path, KnightAssetModelData* pData)
+{
+	*pData = KnightAssetModelData();
+
+	MappedFile file;
+	const unsigned char* pFile = file.Open(path) ? file.Map(0, (size_t)file.GetSize()) : nullptr;
+	if (pFile == nullptr || !IsValidAsset(pFile, file.GetSize()))
+	{
+		TraceLog(LOG_WARNING, "KNA: [%s] Not a valid Knight asset file", path);
+		if (pFile != nullptr)
+			file.Unmap(pFile);
+		return false;
+	}
+
+	const unsigned long long fileSize = file.GetSize();
+	const KnightAssetHeader* pHeader = (const KnightAssetHeader*)pFile;
+	Model& model = pData->model;
+	model.transform = MatrixIdentity();
+
+	const KnightAssetMesh* pMeshes = (const KnightAssetMesh*)(pFile + pHeader->meshTableOffset);
+	model.meshCount = pHeader->meshCount;
+	model.meshes = (Mesh*)RL_CALLOC(model.meshCount, sizeof(Mesh));
+	model.meshMaterial = (int*)RL_CALLOC(model.meshCount, sizeof(int));
+	for (int m = 0; m < model.meshCount; m++)
+	{
+		const KnightAssetMesh& record = pMeshes[m];
+		MapMeshStreams(pFile, record, model.meshes[m]);
+		CopyMeshStreams(model.meshes[m], record.indexCount, true);
+		model.meshMaterial[m] = (record.materialIndex >= 0 && record.materialIndex < pHeader->materialCount) ? record.materialIndex : 0;
+		pData->meshBounds.push_back(record.bounds);
+	}
+
+	//LoadMaterialDefault only reads the ids of raylib's defaults, the textures are decoded here and uploaded later
+	string directory = GetDirectory(path);
+	model.materialCount = pHeader->materialCount > 0 ? pHeader->materialCount : 1;
+	model.materials = (Material*)RL_CALLOC(model.materialCount, sizeof(Material));
+	const KnightAssetMaterial* pMaterials = (const KnightAssetMaterial*)(pFile + pHeader->materialTableOffset);
+	for (int i = 0; i < model.materialCount; i++)
+	{
+		model.materials[i] = LoadMaterialDefault();
+		if (i >= pHeader->materialCount)
+			continue;
+		for (int j = 0; j < KNIGHT_ASSET_MAX_MAPS; j++)
+		{
+			model.materials[i].maps[j].color = pMaterials[i].colors[j];
+			model.materials[i].maps[j].value = pMaterials[i].values[j];
+			string texturePath = GetMaterialTexturePath(directory, pMaterials[i], j);
+			Image image = { 0 };
+			if (!texturePath.empty() && LoadTextureImage(texturePath.c_str(), &image))
+			{
+				pData->images.push_back(image);
+				pData->imageMaps.push_back(i * KNIGHT_ASSET_MAX_MAPS + j);
+			}
+		}
+	}
+
+	ReadSkeleton(pFile, fileSize, model);
+	ReadAnimations(pFile, fileSize, &pData->pAnimations, &pData->animationCount);
+
+	file.Unmap(pFile);
+	return true;
+}
+
+/// <summary>
+/// UploadModel - Create the GPU buffers and textures of a model read by ReadModel. Main thread only.
+/// Afterwards the model and the animations belong to the caller, like the ones Load returns.
+/// </summary>
+/// <param name="pData">The model data, its images are released.</param>
+/// <param name="keepMeshData">Keep the CPU copies of the vertex streams and indices of static meshes.</param>
+void KnightAsset::UploadModel(KnightAssetModelData* pData, bool keepMeshData)
+{
+	Model& model = pData->model;
+	for (int m = 0; m < model.meshCount; m++)
+	{
+		Mesh& mesh = model.meshes[m];
+		UploadMesh(&mesh, false);
+
+		if (keepMeshData || (mesh.boneIds != nullptr && mesh.boneWeights != nullptr))
+			continue;
+		void** ppStreams[KNA_STREAM_COUNT];
+		GetMeshStreams(mesh, ppStreams);
+		for (int s = 0; s < KNA_STREAM_COUNT; s++)
+		{
+			RL_FREE(*ppStreams[s]);
+			*ppStreams[s] = nullptr;
+		}
+		RL_FREE(mesh.indices);
+		mesh.indices = nullptr;
+	}
+
+	for (size_t i = 0; i < pData->images.size(); i++)
+	{
+		Texture2D texture = LoadTextureFromImage(pData->images[i]);
+		if (texture.mipmaps > 1)
+			SetTextureFilter(texture, TEXTURE_FILTER_TRILINEAR);
+		model.materials[pData->imageMaps[i] / KNIGHT_ASSET_MAX_MAPS].maps[pData->imageMaps[i] % KNIGHT_ASSET_MAX_MAPS].texture = texture;
+		UnloadImage(pData->images[i]);
+	}
+	pData->images.clear();
+	pData->imageMaps.clear();
+}
+
+/// <summary>
+/// UnloadModelData - Free the data of a ReadModel that is not going to be uploaded. Nothing of it is on the GPU yet.
+/// </summary>
+/// <param name="pData">The model data.</param>
+void KnightAsset::UnloadModelData(KnightAssetModelData* pData)
+{
+	Model& model = pData->model;
+	for (int m = 0; m < model.meshCount; m++)
+	{
+		Mesh& mesh = model.meshes[m];
+		void** ppStreams[KNA_STREAM_COUNT];
+		GetMeshStreams(mesh, ppStreams);
+		for (int s = 0; s < KNA_STREAM_COUNT; s++)
+			RL_FREE(*ppStreams[s]);
+		RL_FREE(mesh.indices);
+		RL_FREE(mesh.animVertices);
+		RL_FREE(mesh.animNormals);
+	}
+	RL_FREE(model.meshes);
+	RL_FREE(model.meshMaterial);
+	for (int i = 0; i < model.materialCount; i++)
+		RL_FREE(model.materials[i].maps);
+	RL_FREE(model.materials);
+	RL_FREE(model.bones);
+	RL_FREE(model.bindPose);
+
+	if (pData->pAnimations != nullptr)
+		UnloadModelAnimations(pData->pAnimations, pData->animationCount);
+	for (Image& image : pData->images)
+		UnloadImage(image);
+	*pData = KnightAssetModelData();
+}
+
+/// <summary>
+/// GetBakedPath - The .kna file name for a source model, in the same directory.
+/// </summary>
+/// <param name="sourcePath">The source model file.</param>
+/// <returns>The path, in a TextFormat buffer.</returns>
+const char* KnightAsset::GetBakedPath(const char* sourcePath)
+{
+	return TextFormat("%s/%s.kna", GetDirectoryPath(sourcePath), GetFileNameWithoutExt(sourcePath));
+}
+
+/// <summary>
+/// NeedsConvert - Check if the baked file has to be (re)built from its source.
+/// </summary>
+/// <param name="sourcePath">The source model file.</param>
+/// <param name="bakedPath">The .kna file.</param>
+/// <returns>true if the baked file is missing or older than the source.</returns>
+bool KnightAsset::NeedsConvert(const char* sourcePath, const char* bakedPath)
+{
+	if (!FileExists(bakedPath))
+		return true;
+	return FileExists(sourcePath) && GetFileModTime(sourcePath) > GetFileModTime(bakedPath);
+}
+
+// Bytes of a mip chain, the levels halve down to 1 pixel like ImageMipmaps() and rlLoadTexture() do
+static size_t GetMipChainSize(int width, int height, int format, int mipmaps)
+{
+	size_t size = 0;
+	for (int i = 0; i < mipmaps; i++)
+	{
+		size += (size_t)GetPixelDataSize(width, height, format);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return size;
+}
+
+/// <summary>
+/// CookTexture - Decode an image and generate its mip chain, so the runtime only uploads it.
+/// Compressed images are saved with the mip levels they come with.
+/// </summary>
+/// <param name="sourcePath">Any image raylib can load.</param>
+/// <param name="outPath">The .knt file to write.</param>
+/// <returns>true if the file was written.</returns>
+bool KnightAsset::CookTexture(const char* sourcePath, const char* outPath)
+{
+	Image image = LoadImage(sourcePath);
+	if (image.data == nullptr)
+		return false;
+
+	if (image.format < PIXELFORMAT_COMPRESSED_DXT1_RGB)
+		ImageMipmaps(&image);
+
+	bool success = SaveTexture(image, outPath);
+	UnloadImage(image);
+	return success;
+}
+
+/// <summary>
+/// SaveTexture - Write an image with all its mip levels as .knt.
+/// </summary>
+/// <param name="image">The image.</param>
+/// <param name="outPath">The .knt file to write.</param>
+/// <returns>true if the file was written.</returns>
+bool KnightAsset::SaveTexture(const Image& image, const char* outPath)
+{
+	if (image.data == nullptr || image.width <= 0 || image.height <= 0)
+		return false;
+
+	KnightTextureHeader header = { 0 };
+	header.magic = KNIGHT_TEXTURE_MAGIC;
+	header.version = KNIGHT_TEXTURE_VERSION;
+	header.width = image.width;
+	header.height = image.height;
+	header.format = image.format;
+	header.mipmaps = image.mipmaps > 0 ? image.mipmaps : 1;
+	header.dataSize = GetMipChainSize(image.width, image.height, image.format, header.mipmaps);
+
+	vector<unsigned char> blob(sizeof(KnightTextureHeader), 0);
+	header.dataOffset = AppendSection(blob, image.data, (size_t)header.dataSize);
+	memcpy(&blob[0], &header, sizeof(header));
+
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, outPath, "wb") != 0 || fp == nullptr)
+		return false;
+	bool success = fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+	fclose(fp);
+	return success;
+}
+
+static bool IsValidTexture(const unsigned char* pData, unsigned long long fileSize)
+{
+	if (fileSize < sizeof(KnightTextureHeader))
+		return false;
+
+	const KnightTextureHeader* pHeader = (const KnightTextureHeader*)pData;
+	return pHeader->magic == KNIGHT_TEXTURE_MAGIC && pHeader->version == KNIGHT_TEXTURE_VERSION
+		&& pHeader->width > 0 && pHeader->height > 0 && pHeader->mipmaps > 0
+		&& pHeader->dataSize == GetMipChainSize(pHeader->width, pHeader->height, pHeader->format, pHeader->mipmaps)
+		&& IsInFile(fileSize, pHeader->dataOffset, pHeader->dataSize);
+}
+
+/// <summary>
+/// LoadTexture - Upload a cooked texture straight from a memory mapping of the file. Source images
+/// are redirected to their .knt when it is newer than the image, and loaded as they are otherwise.
+/// </summary>
+/// <param name="path">A .knt file or a source image.</param>
+/// <returns>The texture, id 0 if nothing could be loaded.</returns>
+Texture2D KnightAsset::LoadTexture(const char* path)
+{
+	char cookedPath[512] = { 0 };
+	if (IsFileExtension(path, ".knt"))
+		TextCopy(cookedPath, path);
+	else
+	{
+		TextCopy(cookedPath, GetCookedTexturePath(path));
+		if (!FileExists(cookedPath) || NeedsConvert(path, cookedPath))
+			return ::LoadTexture(path);
+	}
+
+	Texture2D texture = { 0 };
+	MappedFile file;
+	const unsigned char* pData = file.Open(cookedPath) ? file.Map(0, (size_t)file.GetSize()) : nullptr;
+	if (pData != nullptr)
+	{
+		if (IsValidTexture(pData, file.GetSize()))
+		{
+			const KnightTextureHeader* pHeader = (const KnightTextureHeader*)pData;
+			texture.id = rlLoadTexture(pData + pHeader->dataOffset, pHeader->width, pHeader->height, pHeader->format, pHeader->mipmaps);
+			texture.width = pHeader->width;
+			texture.height = pHeader->height;
+			texture.format = pHeader->format;
+			texture.mipmaps = pHeader->mipmaps;
+		}
+		file.Unmap(pData);
+	}
+
+	if (texture.id == 0)
+	{
+		TraceLog(LOG_WARNING, "KNT: [%s] Not a valid cooked texture", cookedPath);
+		return IsFileExtension(path, ".knt") ? texture : ::LoadTexture(path);
+	}
+	if (texture.mipmaps > 1)
+		SetTextureFilter(texture, TEXTURE_FILTER_TRILINEAR);
+	return texture;
+}
+
+/// <summary>
+/// LoadTextureImage - The CPU half of LoadTexture for background loading, the pixels of the cooked texture
+/// or the decoded image are returned instead of uploaded. Safe on worker threads, so the paths are built
+/// without raylib's shared text buffers.
+/// </summary>
+/// <param name="path">A .knt file or a source image.</param>
+/// <param name="pImage">Returns the image with all its mip levels, upload it with LoadTextureFromImage.</param>
+/// <returns>false if nothing could be loaded.</returns>
+bool KnightAsset::LoadTextureImage(const char* path, Image* pImage)
+{
+	*pImage = Image{ 0 };
+	string sourcePath = path;
+	size_t extension = sourcePath.find_last_of('.');
+	size_t separator = sourcePath.find_last_of("/\\");
+	if (separator != string::npos && extension != string::npos && extension < separator)
+		extension = string::npos;
+	string extensionLower = extension != string::npos ? sourcePath.substr(extension) : string();
+	std::transform(extensionLower.begin(), extensionLower.end(), extensionLower.begin(), [](unsigned char c) { return (char)tolower(c); });
+	bool isCooked = extensionLower == ".knt";
+	string cookedPath = isCooked ? sourcePath : sourcePath.substr(0, extension) + ".knt";
+
+	if (isCooked || (FileExists(cookedPath.c_str()) && !NeedsConvert(path, cookedPath.c_str())))
+	{
+		MappedFile file;
+		const unsigned char* pData = file.Open(cookedPath.c_str()) ? file.Map(0, (size_t)file.GetSize()) : nullptr;
+		if (pData != nullptr)
+		{
+			if (IsValidTexture(pData, file.GetSize()))
+			{
+				const KnightTextureHeader* pHeader = (const KnightTextureHeader*)pData;
+				pImage->data = CopyData(pData + pHeader->dataOffset, (size_t)pHeader->dataSize);
+				pImage->width = pHeader->width;
+				pImage->height = pHeader->height;
+				pImage->format = pHeader->format;
+				pImage->mipmaps = pHeader->mipmaps;
+			}
+			file.Unmap(pData);
+		}
+		if (pImage->data == nullptr)
+			TraceLog(LOG_WARNING, "KNT: [%s] Not a valid cooked texture", cookedPath.c_str());
+	}
+
+	if (pImage->data == nullptr && !isCooked)
+		*pImage = LoadImage(path);
+	return pImage->data != nullptr;
+}
+
+/// <summary>
+/// GetCookedTexturePath - The .knt file name for a source image, in the same directory.
+/// </summary>
+/// <param name="sourcePath">The source image.</param>
+/// <returns>The path, in a TextFormat buffer.</returns>
+const char* KnightAsset::GetCookedTexturePath(const char* sourcePath)
+{
+	return TextFormat("%s/%s.knt", GetDirectoryPath(sourcePath), GetFileNameWithoutExt(sourcePath));
+}
+
+//End of KnightAsset.cpp
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+
+using namespace std;
+
+// Baked model file (.kna)
+//
+// [KnightAssetHeader]
+// [KnightAssetMesh x meshCount]
+// [KnightAssetMaterial x materialCount]
+// [BoneInfo x boneCount] [Transform x boneCount]        skeleton and bind pose
+// [KnightAssetAnimation x animationCount]
+// [data sections]                                        vertex streams, indices, bones and frame poses
+//
+// Every section starts at a KNIGHT_ASSET_ALIGNMENT boundary and is referenced by its file offset,
+// there are no pointers in the file so it can be used straight from a memory mapping.
+// Vertex streams have the layout raylib uploads, the meshes are already indexed, optimized
+// and have smooth normals, so nothing is recomputed at load time.
+#define KNIGHT_ASSET_MAGIC			0x31414E4B	//"KNA1"
+#define KNIGHT_ASSET_VERSION		1
+#define KNIGHT_ASSET_ALIGNMENT		16
+#define KNIGHT_ASSET_MAX_PATH		128
+#define KNIGHT_ASSET_MAX_MAPS		(MATERIAL_MAP_BRDF + 1)
+
+enum eKnightAssetStream
+{
+	KNA_STREAM_POSITIONS = 0,	// 3 floats
+	KNA_STREAM_TEXCOORDS,		// 2 floats
+	KNA_STREAM_TEXCOORDS2,		// 2 floats
+	KNA_STREAM_NORMALS,			// 3 floats
+	KNA_STREAM_TANGENTS,		// 4 floats
+	KNA_STREAM_COLORS,			// 4 unsigned bytes
+	KNA_STREAM_BONE_IDS,		// 4 unsigned bytes
+	KNA_STREAM_BONE_WEIGHTS,	// 4 floats
+	KNA_STREAM_COUNT
+};
+
+// Cooked texture file (.knt): [KnightTextureHeader] [pixel data, every mip level after the previous one]
+// The pixels are in the layout rlLoadTexture takes, so loading is a single upload without decoding.
+#define KNIGHT_TEXTURE_MAGIC		0x31544E4B	//"KNT1"
+#define KNIGHT_TEXTURE_VERSION		1
+
+struct KnightAssetHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int meshCount;
+	int materialCount;
+	int boneCount;
+	int animationCount;
+	BoundingBox bounds;		// all meshes, model space
+	unsigned long long meshTableOffset;
+	unsigned long long materialTableOffset;
+	unsigned long long bonesOffset;
+	unsigned long long bindPoseOffset;
+	unsigned long long animationTableOffset;
+	unsigned long long fileSize;
+};
+
+struct KnightAssetMesh
+{
+	int vertexCount;
+	int triangleCount;
+	int indexCount;			// 0 for a non indexed mesh
+	int materialIndex;
+	BoundingBox bounds;
+	unsigned long long streamOffsets[KNA_STREAM_COUNT];	// 0 if the mesh has no such stream
+	unsigned long long indexOffset;						// unsigned short indices
+};
+
+struct KnightAssetMaterial
+{
+	Color colors[KNIGHT_ASSET_MAX_MAPS];
+	float values[KNIGHT_ASSET_MAX_MAPS];
+	char texturePaths[KNIGHT_ASSET_MAX_MAPS][KNIGHT_ASSET_MAX_PATH];	// relative to the .kna file, empty if none
+};
+
+struct KnightAssetAnimation
+{
+	char name[32];
+	int boneCount;
+	int frameCount;
+	unsigned long long bonesOffset;			// BoneInfo x boneCount
+	unsigned long long framePosesOffset;	// Transform x boneCount, frameCount times
+};
+
+struct KnightTextureHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int width;
+	int height;
+	int format;		// PixelFormat
+	int mipmaps;
+	unsigned long long dataOffset;
+	unsigned long long dataSize;
+};
+
+// A .kna model read on a worker thread by KnightAsset::ReadModel, nothing of it is on the GPU yet
+struct KnightAssetModelData
+{
+	Model model = { 0 };					// meshes with their CPU streams, materials without textures
+	ModelAnimation* pAnimations = nullptr;
+	int animationCount = 0;
+	vector<BoundingBox> meshBounds;
+	vector<Image> images;					// decoded material textures
+	vector<int> imageMaps;					// material * KNIGHT_ASSET_MAX_MAPS + map of every image
+};
+
+class KnightAsset
+{
+public:
+	// Load any model raylib can load, bake normals and mesh optimization in and save it as .kna.
+	// Textures the source format embeds are exported as png files next to the .kna.
+	// generateTangents adds tangents to the meshes with texture coordinates.
+	static bool Convert(const char* sourcePath, const char* outPath, bool generateTangents = false);
+
+	// Write a model and its animations as they are
+	static bool Save(const Model& model, const ModelAnimation* pAnimations, int animationCount, const char* outPath);
+
+	// Load a .kna file through a memory mapping. The GPU buffers are filled straight from the mapped
+	// file; the CPU copies of the vertex streams are only made with keepMeshData (skinned meshes always
+	// keep theirs for the animation). pMeshBounds optionally returns the baked bounding box of every mesh.
+	static bool Load(const char* path, Model* pModel, ModelAnimation** ppAnimations, int* pAnimationCount,
+		bool keepMeshData = true, vector<BoundingBox>* pMeshBounds = nullptr);
+
+	// Load split for background loading: ReadModel does the file I/O and texture decoding and is safe on
+	// worker threads, UploadModel creates the GPU resources on the main thread. Data that is never
+	// uploaded is released with UnloadModelData.
+	static bool ReadModel(const char* path, KnightAssetModelData* pData);
+	static void UploadModel(KnightAssetModelData* pData, bool keepMeshData = true);
+	static void UnloadModelData(KnightAssetModelData* pData);
+
+	// The baked file next to a source model, "castle.obj" -> "castle.kna"
+	static const char* GetBakedPath(const char* sourcePath);
+	// True if the baked file is missing or older than the source
+	static bool NeedsConvert(const char* sourcePath, const char* bakedPath);
+
+	// Decode an image, build its full mip chain and save it as .knt. CPU only, safe on worker threads.
+	static bool CookTexture(const char* sourcePath, const char* outPath);
+	static bool SaveTexture(const Image& image, const char* outPath);
+
+	// Load a .knt file, or for any other image the up to date .knt next to it if there is one,
+	// else the image itself through raylib. Mipmapped textures get trilinear filtering.
+	static Texture2D LoadTexture(const char* path);
+	// The same without the upload, safe on worker threads. Upload the image with LoadTextureFromImage.
+	static bool LoadTextureImage(const char* path, Image* pImage);
+
+	// The cooked texture next to a source image, "castle_diffuse.png" -> "castle_diffuse.knt"
+	static const char* GetCookedTexturePath(const char* sourcePath);
+};
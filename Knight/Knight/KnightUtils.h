@@ -19,7 +19,15 @@ struct Vector3Compare {
 extern Rectangle& CenterRectangle(Rectangle& r, int width, int height);
 extern float DegreesToRadians(float degrees);
 extern BoundingRect Get2DBoundingRectOfCube(const Vector3& cubePosition, float cubeSize, const Camera3D& camera);
-extern void RecalculateSmoothNormals(const Model& model);
+// Face normal weighting used by RecalculateSmoothNormals
+enum eNormalWeighting
+{
+	NormalWeightUniform = 0,
+	NormalWeightArea,
+	NormalWeightAngle
+};
+
+extern void RecalculateSmoothNormals(const Model& model, eNormalWeighting weighting = NormalWeightUniform);
 extern void ConvertMeshToIndexed(Mesh* mesh);
 extern bool IsPointInTriangle2D(Vector2 p, Vector2 v0, Vector2 v1, Vector2 v2);
 
@@ -40,4 +48,8 @@ extern float PointToBoxDistanceSqr(Vector3 p, BoundingBox box);
 
 extern bool IsBoundingBoxValid(BoundingBox box);
 
+// Octahedral normal encoding, a unit vector packed into two 16-bit snorm values
+extern unsigned int EncodeOctahedralNormal(Vector3 n);
+extern Vector3 DecodeOctahedralNormal(unsigned int packed);
+
 //End of KnightUtils.h
\ No newline at end of file
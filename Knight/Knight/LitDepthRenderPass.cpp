@@ -1,5 +1,8 @@
 #include "Knight.h"
 
+#include <algorithm>
+#include <cfloat>
+
 #include "rlgl.h"
 
 #include "LitDepthRenderPass.h"
@@ -8,83 +11,279 @@ LitDepthRenderPass::LitDepthRenderPass()
 {
 }
 
+/// <summary>
+/// Create - Load the depth shader and the shadow atlas shared by all lights
+/// </summary>
+/// <param name="sc">The Scene to render shadow</param>
+/// <returns>True if the atlas could be created.</returns>
 bool LitDepthRenderPass::Create(Scene* sc)
 {
 	__super::Create(sc);
 
-	depthShader = LoadShader("../../resources/shaders/glsl330/kn_depth.vs", "../../resources/shaders/glsl330/kn_depth.fs");
+	depthShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/kn_depth.vs", "../../resources/shaders/glsl330/kn_depth.fs");
 
 	Hints.pOverrideShader = &depthShader;
+	LevelOfDetailBias = 1;	//shadow casters can use a coarser mesh
 
-	//Create shadowmap render textures
-	for(int i=0;i< NUM_MAX_LIGHTS; ++i)
+	//One depth texture for all lights, each light renders into its own tile
+	ShadowAtlas = LoadShadowmapRenderTexture(shadowMapResolution, shadowMapResolution);
+	if (ShadowAtlas.id == 0)
 	{
-		ShadowMaps.push_back(LoadShadowmapRenderTexture(SHADOWMAP_RESOLUTION, SHADOWMAP_RESOLUTION));
-		// We only care about the depth buffer, so no need for a color attachment
-		// and disable filtering/mipmaps on the depth texture to keep it sharp
-		SetTextureFilter(ShadowMaps[i].depth, TEXTURE_FILTER_POINT);
-		SetTextureWrap(ShadowMaps[i].depth, TEXTURE_WRAP_CLAMP);
-	}
-
-	for (int i = 0; i < NUM_MAX_LIGHTS; ++i) {
-		ShadowMapsLocs[i] = GetShaderLocation(depthShader, TextFormat("shadowMaps[%d]", i));
+		TraceLog(LOG_ERROR, "<LitDepthRenderPass.Create> Failed to create the shadow atlas");
+		return false;
 	}
+	// We only care about the depth buffer, so no need for a color attachment
+	// and disable filtering/mipmaps on the depth texture to keep it sharp
+	SetTextureFilter(ShadowAtlas.depth, TEXTURE_FILTER_POINT);
+	SetTextureWrap(ShadowAtlas.depth, TEXTURE_WRAP_CLAMP);
 
 	pLightCamera = new OrthogonalCamera(pScene, "Light Camera", false);
+	InvalidateLight();
 
 	return true;
 }
 
 void LitDepthRenderPass::Release()
 {
-	for(int i = 0; i < NUM_MAX_LIGHTS; ++i)
-	{
-		if (ShadowMaps[i].id > 0)
-		{
-			UnloadShadowmapRenderTexture(ShadowMaps[i]);
-		}
-	}
-	UnloadShader(depthShader);
+	UnloadShadowmapRenderTexture(ShadowAtlas);
+	ShadowAtlas = { 0 };
+	ResourceRegistry::Instance().ReleaseShader(depthShader);
 }
 
 void LitDepthRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 {
 	pScene->_CurrentRenderPass = this;
 
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	//the render queue is culled for every light in Render
+	pActiveCamera = pLightCamera;
 
 	//Override shader 
 	BeginShaderMode(depthShader);
 }
 
+/// <summary>
+/// Render - Size the atlas tiles of the lights and render the lights due this frame, at most
+/// MaxUpdatesPerFrame of them. Lights without a valid tile go first, then the ones waiting the longest
+/// relative to their update interval.
+/// </summary>
 void LitDepthRenderPass::Render()
 {
-	pActiveCamera = pLightCamera;
-
-	for(int i=0;i<NUM_MAX_LIGHTS; ++i)
+	NumLightsUpdated = 0;
+	NumLightsPending = 0;
+	if (ShadowAtlas.id == 0)
+		return;
+
+	int sizes[NUM_MAX_LIGHTS];
+	bool repack = false;
+	for (int i = 0; i < NUM_MAX_LIGHTS; ++i)
 	{
-		if (pScene->Lights[i].enabled) 
+		sizes[i] = pScene->Lights[i].enabled ? GetTileSize(i) : 0;
+		if (sizes[i] != lightStates[i].tile.size)
+			repack = true;
+	}
+	if (repack && !PackAtlas(sizes))
+		TraceLog(LOG_WARNING, "<LitDepthRenderPass.Render> The light shadow maps do not fit into the atlas");
+
+	//pick the lights to render
+	unsigned int frame = pScene->GetFrameNumber();
+	float urgency[NUM_MAX_LIGHTS];
+	int due[NUM_MAX_LIGHTS];
+	int numDue = 0;
+	for (int i = 0; i < NUM_MAX_LIGHTS; ++i)
+	{
+		const LightData& light = pScene->Lights[i];
+		LightShadowState& state = lightStates[i];
+		if (!light.enabled || state.tile.size == 0)
+		{
+			AtlasRects[i] = Vector4{ 0 };
+			continue;
+		}
+
+		if (!state.valid)
 		{
-			pLightCamera->SetUp(pScene->Lights[i].position, pScene->Lights[i].target, 45);
+			urgency[i] = FLT_MAX;
+		}
+		else
+		{
+			//near lights which moved are refreshed every frame, the others every DistantUpdateInterval frames
+			bool moved = light.type != state.rendered.type
+				|| Vector3Equals(light.position, state.rendered.position) == 0
+				|| Vector3Equals(light.target, state.rendered.target) == 0;
+			int interval = moved && state.tile.size >= shadowMapResolution / 4 ? 1 : std::max(DistantUpdateInterval, 1);
+			float waited = (float)(frame - state.lastFrame);
+			if (waited < (float)interval)
+				continue;
+			urgency[i] = waited / (float)interval;
+		}
+		due[numDue++] = i;
+	}
+	std::sort(due, due + numDue, [&urgency](int a, int b) { return urgency[a] > urgency[b]; });
+
+	int numUpdates = std::min(numDue, std::max(MaxUpdatesPerFrame, 0));
+	NumLightsPending = numDue - numUpdates;
+	if (numUpdates == 0)
+		return;
+
+	BeginTextureMode(ShadowAtlas);
+	for (int i = 0; i < numUpdates; ++i)
+		RenderLight(due[i]);
+	EndTextureMode();
+	NumLightsUpdated = numUpdates;
+}
+
+/// <summary>
+/// RenderLight - Render one light into its tile of the atlas, the render queue is culled against the light
+/// </summary>
+/// <param name="light">Index of the scene light</param>
+void LitDepthRenderPass::RenderLight(int light)
+{
+	const LightData& lightData = pScene->Lights[light];
+	LightShadowState& state = lightStates[light];
+	const ShadowAtlasTile& tile = state.tile;
+
+	Matrix lightView = GetLightView(lightData);
+	Matrix lightProjection = GetLightProjection(lightData);
+
+	//the light camera only serves the culling and the components, the matrices are loaded below
+	Vector3 direction = Vector3Normalize(Vector3Subtract(lightData.target, lightData.position));
+	pLightCamera->SetUp(lightData.position, lightData.target, 45);
+	pLightCamera->SetUpward(fabsf(direction.y) > 0.99f ? Vector3{ 0.0f, 0.0f, 1.0f } : Vector3{ 0.0f, 1.0f, 0.0f });
+	pLightCamera->SetProjectionMode(lightData.type == 0 ? CAMERA_ORTHOGRAPHIC : CAMERA_PERSPECTIVE); //0 is directional
+
+	rlDrawRenderBatchActive();
+	rlViewport(tile.x, tile.y, tile.size, tile.size);
+
+	// Clear the depth of the tile to the farthest value (1.0) so objects behind occluders are marked as in shadow.
+	rlEnableScissorTest();
+	rlScissor(tile.x, tile.y, tile.size, tile.size);
+	rlClearColor(0, 0, 0, 0);
+	rlClearScreenBuffers();
+	rlDisableScissorTest();
+
+	rlMatrixMode(RL_PROJECTION);
+	rlPushMatrix();
+	rlLoadIdentity();
+	rlMultMatrixf(MatrixToFloat(lightProjection));
+	rlMatrixMode(RL_MODELVIEW);
+	rlLoadIdentity();
+	rlMultMatrixf(MatrixToFloat(lightView));
+	rlEnableDepthTest();
+
+	UpdateRenderQueue();
+	SceneRenderPass::Render();
+
+	rlDrawRenderBatchActive();
+	rlMatrixMode(RL_PROJECTION);
+	rlPopMatrix();
+	rlMatrixMode(RL_MODELVIEW);
+	rlLoadIdentity();
+
+	float invResolution = 1.0f / (float)shadowMapResolution;
+	LightSpaceMatrices[light] = MatrixMultiply(lightView, lightProjection);
+	AtlasRects[light] = Vector4{ tile.x * invResolution, tile.y * invResolution, tile.size * invResolution, tile.size * invResolution };
+	state.rendered = lightData;
+	state.lastFrame = pScene->GetFrameNumber();
+	state.valid = true;
+}
+
+/// <summary>
+/// GetTileSize - The atlas tile a light should get: directional lights get the largest one, point lights one
+/// by the share of the view their range covers, as a power of two. A light keeps its current size until
+/// it is clearly too small or too large, so the atlas is not repacked back and forth.
+/// </summary>
+/// <param name="light">Index of the scene light</param>
+/// <returns>Tile size in pixels</returns>
+int LitDepthRenderPass::GetTileSize(int light) const
+{
+	const LightData& lightData = pScene->Lights[light];
+	int maxSize = shadowMapResolution / 2;
+	int minSize = std::min(SHADOW_ATLAS_MIN_TILE, maxSize);
+	SceneCamera* pCamera = pScene->GetMainCameraActor();
+	if (lightData.type == 0 || pCamera == nullptr) //directional lights cover the whole view
+		return maxSize;
+
+	float distance = std::max(Vector3Distance(pCamera->GetPosition(), lightData.position), 1.0f);
+	float viewHeight = 2.0f * distance * tanf(pCamera->GetFov() * DEG2RAD * 0.5f);
+	float wanted = (float)maxSize * TileImportanceScale * LightRange / std::max(viewHeight, 0.001f);
+
+	int current = lightStates[light].tile.size;
+	if (current > 0 && wanted >= current * 0.8f && wanted < current * 2.5f)
+		return current;
+
+	int size = maxSize;
+	while (size > minSize && (float)size > wanted)
+		size /= 2;
+	return size;
+}
 
-			BeginTextureMode(ShadowMaps[i]);
+/// <summary>
+/// PackAtlas - Place the tiles, largest first. Every tile is a power of two, so splitting the smallest free
+/// square that fits into quarters always packs them while their area fits into the atlas.
+/// Lights whose tile moved have to be rendered again.
+/// </summary>
+/// <param name="sizes">Tile size of every light, 0 for none</param>
+/// <returns>False if a tile did not fit, that light has no shadow</returns>
+bool LitDepthRenderPass::PackAtlas(const int* sizes)
+{
+	int order[NUM_MAX_LIGHTS];
+	for (int i = 0; i < NUM_MAX_LIGHTS; ++i)
+		order[i] = i;
+	std::sort(order, order + NUM_MAX_LIGHTS, [sizes](int a, int b) { return sizes[a] > sizes[b]; });
 
-			// Clear the depth buffer. VERY IMPORTANT!
-		    // Clear the depth buffer to the farthest value (1.0) so objects behind occluders are marked as in shadow.
-			rlClearColor(0, 0, 0, 0); // Clear color buffer (not used, but good practice)
-			rlClearScreenBuffers();
-			// Set the shadow map texture for the current light
-			SetShaderValueTexture(depthShader, ShadowMapsLocs[i], ShadowMaps[i].depth);
+	vector<ShadowAtlasTile> freeTiles;
+	freeTiles.push_back(ShadowAtlasTile{ 0, 0, shadowMapResolution });
 
-			BeginMode3D(*pLightCamera->GetCamera3D());
-			SceneRenderPass::Render();
-			EndMode3D();
+	bool packed = true;
+	for (int i = 0; i < NUM_MAX_LIGHTS; ++i)
+	{
+		int light = order[i];
+		ShadowAtlasTile tile = { 0, 0, 0 };
+		int best = -1;
+		for (int j = 0; j < (int)freeTiles.size() && sizes[light] > 0; ++j)
+		{
+			if (freeTiles[j].size >= sizes[light] && (best < 0 || freeTiles[j].size < freeTiles[best].size))
+				best = j;
+		}
+		if (best >= 0)
+		{
+			tile = freeTiles[best];
+			freeTiles.erase(freeTiles.begin() + best);
+			while (tile.size > sizes[light])
+			{
+				int half = tile.size / 2;
+				freeTiles.push_back(ShadowAtlasTile{ tile.x + half, tile.y, half });
+				freeTiles.push_back(ShadowAtlasTile{ tile.x, tile.y + half, half });
+				freeTiles.push_back(ShadowAtlasTile{ tile.x + half, tile.y + half, half });
+				tile.size = half;
+			}
+		}
+		else if (sizes[light] > 0)
+		{
+			packed = false;
+		}
 
-			EndTextureMode();
+		LightShadowState& state = lightStates[light];
+		if (tile.x != state.tile.x || tile.y != state.tile.y || tile.size != state.tile.size)
+		{
+			state.tile = tile;
+			state.valid = false;
+			AtlasRects[light] = Vector4{ 0 };
 		}
 	}
-	
+	return packed;
+}
+
+/// <summary>
+/// InvalidateLight - Render a light again at the next Render, before the lights which are only due
+/// </summary>
+/// <param name="light">Index of the scene light, -1 for all of them</param>
+void LitDepthRenderPass::InvalidateLight(int light)
+{
+	for (int i = 0; i < NUM_MAX_LIGHTS; ++i)
+	{
+		if (light < 0 || light == i)
+			lightStates[i].valid = false;
+	}
 }
 
 void LitDepthRenderPass::EndScene()
@@ -148,19 +347,26 @@ RenderTexture2D LitDepthRenderPass::LoadShadowmapRenderTexture(int width, int he
 }
 
 // Function to calculate a light's projection matrix
-Matrix GetLightProjection(LightData light) {
+Matrix LitDepthRenderPass::GetLightProjection(const LightData& light) const
+{
 	if (light.type == 0) {
 		// Orthographic projection for directional lights (like the sun)
 		// Adjust the orthographic frustum size as needed to cover your scene
-		return MatrixOrtho(-50.0f, 50.0f, -50.0f, 50.0f, 1.0f, 100.0f);
+		return MatrixOrtho(-50.0f, 50.0f, -50.0f, 50.0f, 1.0f, LightRange);
 	}
 	else { // LIGHT_POINT
 		// Perspective projection for point lights
-		return MatrixPerspective(DEG2RAD * 90.0f, 1.0f, 0.1f, 100.0f);
+		return MatrixPerspective(DEG2RAD * 90.0f, 1.0f, 0.1f, LightRange);
 	}
 }
 
 // Function to calculate a light's view matrix
-Matrix GetLightView(LightData light) {
-	return MatrixLookAt(light.position, light.target, Vector3 { 0.0f, 1.0f, 0.0f });
+Matrix LitDepthRenderPass::GetLightView(const LightData& light) const
+{
+	//looking straight down, the default up vector would be parallel to the view direction
+	Vector3 direction = Vector3Normalize(Vector3Subtract(light.target, light.position));
+	Vector3 up = fabsf(direction.y) > 0.99f ? Vector3{ 0.0f, 0.0f, 1.0f } : Vector3{ 0.0f, 1.0f, 0.0f };
+	return MatrixLookAt(light.position, light.target, up);
 }
+
+//End of LitDepthRenderPass.cpp
@@ -3,7 +3,11 @@
 #include "Knight.h"
 
 #define SHADOWMAP_RESOLUTION 2048
+#define SHADOW_ATLAS_MIN_TILE 256 //smallest shadow map a light gets in the atlas
 
+// Renders the shadow maps of the scene lights into tiles of one shared depth atlas. Every light gets a square
+// power of two tile sized by how large its light range appears on screen, and the lights are refreshed on a
+// budget: near lights that move every frame, distant or unchanged lights every few frames.
 class LitDepthRenderPass : public SceneRenderPass
 {
 public:
@@ -18,10 +22,25 @@ public:
 	void EndScene() override;
 	bool OnAddToRender(Component* pSC, SceneObject* pSO) override;
 
-	std::vector<RenderTexture2D> ShadowMaps;
-	int shadowMapResolution = SHADOWMAP_RESOLUTION;
+	// Force the light to be rendered again at the next Render, -1 for all of them
+	void InvalidateLight(int light = -1);
 
-	int ShadowMapsLocs[NUM_MAX_LIGHTS] = { 0 };
+	RenderTexture2D ShadowAtlas = { 0 };
+	int shadowMapResolution = SHADOWMAP_RESOLUTION;	// of the whole atlas
+
+	// Per light, valid once the light was rendered: the light view projection and its tile in the atlas
+	// (offset and size in texture coordinates, a zero size means the light has no shadow yet)
+	Matrix LightSpaceMatrices[NUM_MAX_LIGHTS] = { 0 };
+	Vector4 AtlasRects[NUM_MAX_LIGHTS] = { 0 };
+
+	float LightRange = 100.0f;			// far plane of the light projections, also sizes the tiles
+	int MaxUpdatesPerFrame = 2;			// lights rendered per frame at most
+	int DistantUpdateInterval = 4;		// frames between the updates of a light with a small tile or without changes
+	float TileImportanceScale = 1.0f;	// larger values give the lights bigger tiles
+
+	// Counters of the last Render
+	int NumLightsUpdated = 0;
+	int NumLightsPending = 0;
 
 	Shader depthShader = { 0 };
 
@@ -29,8 +48,30 @@ public:
 
 protected:
 
+	struct ShadowAtlasTile
+	{
+		int x, y, size;		// in pixels, size 0 if the light has no tile
+	};
+
+	struct LightShadowState
+	{
+		ShadowAtlasTile tile;
+		LightData rendered;			// the light as it was rendered
+		unsigned int lastFrame;		// frame of the last render
+		bool valid;					// rendered into its current tile
+	};
+
+	int GetTileSize(int light) const;
+	bool PackAtlas(const int* sizes);
+	void RenderLight(int light);
+
+	Matrix GetLightProjection(const LightData& light) const;
+	Matrix GetLightView(const LightData& light) const;
+
 	RenderTexture2D LoadShadowmapRenderTexture(int width, int height);
 	void UnloadShadowmapRenderTexture(RenderTexture2D target);
-};
 
+	LightShadowState lightStates[NUM_MAX_LIGHTS] = { 0 };
+};
 
+//end of LitDepthRenderPass.h
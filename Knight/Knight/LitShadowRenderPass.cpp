@@ -13,24 +13,24 @@ bool LitShadowRenderPass::Create(Scene* sc)
 {
 	__super::Create(sc);
 
-	shadowShader = LoadShader("../../resources/shaders/glsl330/kn-sm.vs", "../../resources/shaders/glsl330/kn-sm-pcf.fs");
+	shadowShader = ResourceRegistry::Instance().AcquireShader("../../resources/shaders/glsl330/kn_sm.vs", "../../resources/shaders/glsl330/kn-sm-pcf.fs");
 	InitLightUniforms(shadowShader);
 
 	for (int i = 0; i < NUM_MAX_LIGHTS; ++i) {
-		ShadowMapsLocs[i] = GetShaderLocation(shadowShader, TextFormat("shadowMaps[%d]", i));
+		atlasRectsLocs[i] = GetShaderLocation(shadowShader, TextFormat("shadowAtlasRects[%d]", i));
 		lightSpaceMatricesLocs[i] = GetShaderLocation(shadowShader, TextFormat("lightSpaceMatrices[%d]", i));
 	}
+	shadowAtlasLoc = GetShaderLocation(shadowShader, "shadowAtlas");
 
 	viewPosLoc = GetShaderLocation(shadowShader, "viewPos");
 	ambientLoc = GetShaderLocation(shadowShader, "ambient");
 	shinenessLoc = GetShaderLocation(shadowShader, "materialShininess");
 	specularColorLoc = GetShaderLocation(shadowShader, "materialSpecularColor");
 
-	// Tell the shader which texture unit corresponds to which shadow map
-	for (int i = 0; i < NUM_MAX_LIGHTS; ++i) {
-		int unitid = 4 + i; // Start from texture unit 4 for shadow maps
-		SetShaderValue(shadowShader, ShadowMapsLocs[i], &unitid, SHADER_UNIFORM_INT);
-	}
+	// All lights sample the shadow atlas, bound to texture unit 4
+	int unitid = 4;
+	SetShaderValue(shadowShader, shadowAtlasLoc, &unitid, SHADER_UNIFORM_INT);
+	SetShaderValue(shadowShader, GetShaderLocation(shadowShader, "shadowAtlasResolution"), &pLitDepthPass->shadowMapResolution, SHADER_UNIFORM_INT);
 
 	//lightDirLoc = GetShaderLocation(shadowShader, "lightDir");
 	//lightColLoc = GetShaderLocation(shadowShader, "lightColor");
@@ -54,7 +54,7 @@ bool LitShadowRenderPass::Create(Scene* sc)
 
 void LitShadowRenderPass::Release()
 {
-	UnloadShader(shadowShader);
+	ResourceRegistry::Instance().ReleaseShader(shadowShader);
 }
 
 bool LitShadowRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
@@ -70,21 +70,7 @@ bool LitShadowRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 			dist2 = Vector3DistanceSqr(pos, pActiveCamera->GetPosition());
 	}
 
-	switch (pSC->renderQueue)
-	{
-	case Component::eRenderQueueType::Background:
-		pScene->_RenderQueue.Background.push_back(RenderContext{ pSC, dist2 });
-		break;
-	case Component::eRenderQueueType::Geometry:
-		pScene->_RenderQueue.Geometry.insert(RenderContext{ pSC, dist2 });
-		break;
-	case Component::eRenderQueueType::AlphaBlend:
-		pScene->_RenderQueue.AlphaBlending.insert(RenderContext{ pSC, dist2 });
-		break;
-	case Component::eRenderQueueType::Overlay:
-		pScene->_RenderQueue.Overlay.push_back(RenderContext{ pSC, dist2 });
-		break;
-	}
+	AddToRenderQueue(pSC, dist2);
 
 	return true;
 }
@@ -96,6 +82,7 @@ void LitShadowRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 
 	//Make shadow map referenced texture as 5th texture, the first four textures are commonly used by other effects
 	int slot = 4;
+	depthTextureId = pLitDepthPass->ShadowAtlas.depth.id;
 	rlActiveTextureSlot(slot);
 	rlEnableTexture(depthTextureId);
 	//rlSetUniform(shadowMapLoc, &slot, SHADER_UNIFORM_INT, 1);
@@ -104,8 +91,7 @@ void LitShadowRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 	pActiveCamera = pScene->GetMainCameraActor();
 	if (pOverrideCamera != nullptr)
 		pActiveCamera = pOverrideCamera;
-	pScene->ClearRenderQueue();
-	BuildRenderQueue(pScene->SceneRoot);
+	UpdateRenderQueue();
 
 	// Set shader uniforms for the light shader (once)
 	SetShaderValue(shadowShader, viewPosLoc, &pActiveCamera->GetCamera3D()->position, SHADER_UNIFORM_VEC3);
@@ -116,20 +102,12 @@ void LitShadowRenderPass::BeginScene(SceneCamera* pOverrideCamera)
 
 	UpdateLightData(shadowShader);
 
-	//activate shadow textures and light space matrices
+	//the light space matrices and atlas tiles the lights were last rendered with, lights not rendered yet
+	//have an empty tile and no shadow
 	for(int i = 0; i < NUM_MAX_LIGHTS; ++i) 
 	{
-		if (pScene->Lights[i].enabled) 
-		{
-			rlActiveTextureSlot(i+4); // Use a different texture unit for each map
-			rlEnableTexture(pLitDepthPass->ShadowMaps[i].depth.id);
-
-			// Pass the light-space matrix for shadow calculation
-			Matrix lightProjection = GetLightProjection(pScene->Lights[i]);
-			Matrix lightView = GetLightView(pScene->Lights[i]);
-			Matrix lightSpaceMatrix = MatrixMultiply(lightView, lightProjection);
-			SetShaderValueMatrix(shadowShader, lightSpaceMatricesLocs[i], lightSpaceMatrix);
-		}
+		SetShaderValueMatrix(shadowShader, lightSpaceMatricesLocs[i], pLitDepthPass->LightSpaceMatrices[i]);
+		SetShaderValue(shadowShader, atlasRectsLocs[i], &pLitDepthPass->AtlasRects[i], SHADER_UNIFORM_VEC4);
 	}
 }
 
@@ -145,14 +123,14 @@ void LitShadowRenderPass::Render()
 	//render background first
 	vector<RenderContext>::iterator bk = pScene->_RenderQueue.Background.begin();
 	while (bk != pScene->_RenderQueue.Background.end()) {
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
 	//render opauqe geometry from nearest to farest
 	multiset<RenderContext, CompareDistanceAscending>::iterator opaque = pScene->_RenderQueue.Geometry.begin();
 	while (opaque != pScene->_RenderQueue.Geometry.end()) {
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 
@@ -162,7 +140,7 @@ void LitShadowRenderPass::Render()
 		rlDisableDepthMask();
 		rlDisableBackfaceCulling();
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		rlEnableDepthMask();
 		rlEnableBackfaceCulling();
@@ -172,27 +150,9 @@ void LitShadowRenderPass::Render()
 	//render overlay first
 	vector<RenderContext>::iterator overlay = pScene->_RenderQueue.Overlay.begin();
 	while (overlay != pScene->_RenderQueue.Overlay.end()) {
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		++overlay;
 	}
 }
 
-// Function to calculate a light's projection matrix
-Matrix LitShadowRenderPass::GetLightProjection(const LightData& light)
-{
-	if (light.type == 0) {
-		// Orthographic projection for directional lights (like the sun)
-		// Adjust the orthographic frustum size as needed to cover your scene
-		return MatrixOrtho(-50.0f, 50.0f, -50.0f, 50.0f, 1.0f, 100.0f);
-	}
-	else { // LIGHT_POINT
-		// Perspective projection for point lights
-		return MatrixPerspective(DEG2RAD * 90.0f, 1.0f, 0.1f, 100.0f);
-	}
-}
-
-// Function to calculate a light's view matrix
-Matrix LitShadowRenderPass::GetLightView(const LightData& light)
-{
-	return MatrixLookAt(light.position, light.target, Vector3 { 0.0f, 1.0f, 0.0f });
-}
+//End of LitShadowRenderPass.cpp
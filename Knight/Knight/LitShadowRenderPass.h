@@ -23,7 +23,8 @@ public:
 
 	Shader shadowShader = { 0 };
 
-	int ShadowMapsLocs[NUM_MAX_LIGHTS] = { 0 };
+	int shadowAtlasLoc = -1;
+	int atlasRectsLocs[NUM_MAX_LIGHTS] = { 0 };
 	int lightSpaceMatricesLocs[NUM_MAX_LIGHTS] = { 0 };
 
 	int viewPosLoc = -1;
@@ -38,9 +39,5 @@ public:
 
 	int lightVPLoc = -1;
 	//int shadowMapLoc = -1;
-
-protected:
-	Matrix GetLightProjection(const LightData& light);
-	Matrix GetLightView(const LightData& light);
 }; 
 
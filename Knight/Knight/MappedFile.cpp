@@ -0,0 +1,172 @@
+//MappedFile deliberately does not include raylib.h, windows.h declares symbols with the same names
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/// <summary>
+/// Open - Open a file for read only mapping.
+/// </summary>
+/// <param name="fileName">The file path.</param>
+/// <returns>false if the file does not exist, is empty or can not be mapped.</returns>
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == nullptr) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	_FileHandle = hFile;
+	_MappingHandle = hMapping;
+	_FileSize = (unsigned long long)size.QuadPart;
+#else
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	_FileHandle = (void*)(long long)(fd + 1); //store fd + 1 so 0 stays "not open"
+	_FileSize = (unsigned long long)st.st_size;
+#endif
+	return true;
+}
+
+/// <summary>
+/// Close - Unmap all views which are still mapped and close the file.
+/// </summary>
+void MappedFile::Close()
+{
+	{
+		lock_guard<mutex> lock(_ViewsLock);
+		for (auto& view : _Views) {
+#if defined(_WIN32)
+			UnmapViewOfFile(view.pBase);
+#else
+			munmap(view.pBase, view.viewSize);
+#endif
+		}
+		_Views.clear();
+	}
+
+#if defined(_WIN32)
+	if (_MappingHandle)
+		CloseHandle((HANDLE)_MappingHandle);
+	if (_FileHandle)
+		CloseHandle((HANDLE)_FileHandle);
+#else
+	if (_FileHandle)
+		close((int)(long long)_FileHandle - 1);
+#endif
+	_MappingHandle = nullptr;
+	_FileHandle = nullptr;
+	_FileSize = 0;
+}
+
+/// <summary>
+/// Map - Map a range of the file into memory. The OS requires the view to start at an
+/// allocation granularity boundary, so the view starts at the aligned offset below the
+/// requested one and the returned pointer is adjusted into it.
+/// </summary>
+/// <param name="offset">File offset of the first byte.</param>
+/// <param name="size">Number of bytes.</param>
+/// <returns>Pointer to the byte at offset, nullptr on failure.</returns>
+const unsigned char* MappedFile::Map(unsigned long long offset, size_t size)
+{
+	if (!IsOpen() || size == 0 || offset + size > _FileSize)
+		return nullptr;
+
+	unsigned long long granularity = GetAllocationGranularity();
+	unsigned long long viewOffset = (offset / granularity) * granularity;
+	size_t viewSize = (size_t)(offset - viewOffset) + size;
+
+#if defined(_WIN32)
+	void* pBase = MapViewOfFile((HANDLE)_MappingHandle, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xffffffff), viewSize);
+	if (pBase == nullptr)
+		return nullptr;
+#else
+	void* pBase = mmap(nullptr, viewSize, PROT_READ, MAP_SHARED, (int)(long long)_FileHandle - 1, (off_t)viewOffset);
+	if (pBase == MAP_FAILED)
+		return nullptr;
+#endif
+
+	MappedView view;
+	view.pBase = pBase;
+	view.pData = (const unsigned char*)pBase + (offset - viewOffset);
+	view.viewSize = viewSize;
+
+	lock_guard<mutex> lock(_ViewsLock);
+	_Views.push_back(view);
+	return view.pData;
+}
+
+/// <summary>
+/// Unmap - Release a view returned by Map.
+/// </summary>
+/// <param name="pData">The pointer returned by Map.</param>
+void MappedFile::Unmap(const void* pData)
+{
+	if (pData == nullptr)
+		return;
+
+	lock_guard<mutex> lock(_ViewsLock);
+	for (size_t i = 0; i < _Views.size(); i++) {
+		if (_Views[i].pData == pData) {
+#if defined(_WIN32)
+			UnmapViewOfFile(_Views[i].pBase);
+#else
+			munmap(_Views[i].pBase, _Views[i].viewSize);
+#endif
+			_Views[i] = _Views.back();
+			_Views.pop_back();
+			return;
+		}
+	}
+}
+
+size_t MappedFile::GetAllocationGranularity()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (size_t)info.dwAllocationGranularity;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
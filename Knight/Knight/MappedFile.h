@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+using namespace std;
+
+// Read only memory mapped file.
+// Views can be mapped and unmapped from any thread, the OS pages the data in on first access.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* fileName);
+	void Close();
+	bool IsOpen() const { return _FileSize > 0; }
+
+	unsigned long long GetSize() const { return _FileSize; }
+
+	// Map [offset, offset + size) of the file, returns a pointer to the byte at offset or nullptr
+	const unsigned char* Map(unsigned long long offset, size_t size);
+	// Unmap a pointer previously returned by Map
+	void Unmap(const void* pData);
+
+	// Granularity mapping offsets are aligned to (64KB on Windows, page size elsewhere)
+	static size_t GetAllocationGranularity();
+
+protected:
+	struct MappedView
+	{
+		const unsigned char* pData;	//pointer returned to the caller
+		void* pBase;				//start of the OS view
+		size_t viewSize;
+	};
+
+	void* _FileHandle = nullptr;
+	void* _MappingHandle = nullptr;
+	unsigned long long _FileSize = 0;
+
+	vector<MappedView> _Views;
+	mutex _ViewsLock;
+};
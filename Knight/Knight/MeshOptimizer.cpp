@@ -0,0 +1,1007 @@
+#include "MeshOptimizer.h"
+#include "JobSystem.h"
+
+#include "rlgl.h"
+#include <config.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <cmath>
+
+#define MESH_OPTIMIZER_MAX_CACHE_SIZE	64
+#define MESH_OPTIMIZER_MAX_STREAMS		10
+
+// One per-vertex attribute array of a mesh
+struct VertexStream
+{
+	unsigned char** ppData;
+	int stride;
+};
+
+static int GetVertexStreams(Mesh* pMesh, VertexStream streams[MESH_OPTIMIZER_MAX_STREAMS])
+{
+	int numStreams = 0;
+	auto addStream = [&](void* ppData, int stride) {
+		unsigned char** ppBytes = (unsigned char**)ppData;
+		if (*ppBytes != nullptr)
+			streams[numStreams++] = VertexStream{ ppBytes, stride };
+	};
+
+	addStream(&pMesh->vertices, 3 * sizeof(float));
+	addStream(&pMesh->texcoords, 2 * sizeof(float));
+	addStream(&pMesh->texcoords2, 2 * sizeof(float));
+	addStream(&pMesh->normals, 3 * sizeof(float));
+	addStream(&pMesh->tangents, 4 * sizeof(float));
+	addStream(&pMesh->colors, 4 * sizeof(unsigned char));
+	addStream(&pMesh->animVertices, 3 * sizeof(float));
+	addStream(&pMesh->animNormals, 3 * sizeof(float));
+	addStream(&pMesh->boneIds, 4 * sizeof(unsigned char));
+	addStream(&pMesh->boneWeights, 4 * sizeof(float));
+	return numStreams;
+}
+
+// Rebuild every attribute array with newCount vertices, vertex i of the new arrays is old vertex source[i]
+static void GatherVertexStreams(Mesh* pMesh, const vector<unsigned int>& source)
+{
+	VertexStream streams[MESH_OPTIMIZER_MAX_STREAMS];
+	int numStreams = GetVertexStreams(pMesh, streams);
+	for (int s = 0; s < numStreams; s++) {
+		const unsigned char* pOld = *streams[s].ppData;
+		unsigned char* pNew = (unsigned char*)RL_MALLOC(source.size() * streams[s].stride);
+		for (size_t i = 0; i < source.size(); i++) {
+			memcpy(pNew + i * streams[s].stride, pOld + (size_t)source[i] * streams[s].stride, streams[s].stride);
+		}
+		RL_FREE(*streams[s].ppData);
+		*streams[s].ppData = pNew;
+	}
+	pMesh->vertexCount = (int)source.size();
+}
+
+static vector<unsigned int> GetTriangleList(const Mesh& mesh)
+{
+	vector<unsigned int> indices;
+	if (mesh.indices != nullptr) {
+		indices.assign(mesh.indices, mesh.indices + mesh.triangleCount * 3);
+	}
+	else {
+		indices.resize(mesh.vertexCount);
+		for (int i = 0; i < mesh.vertexCount; i++)
+			indices[i] = (unsigned int)i;
+	}
+	return indices;
+}
+
+/// <summary>
+/// DeduplicateVertices - Merge vertices whose attributes are all bitwise equal. The hash covers every
+/// attribute array of the mesh, so vertices on UV seams or hard edges stay separate.
+/// Non-indexed meshes get an index buffer, indexed meshes get their indices remapped.
+/// </summary>
+/// <param name="pMesh">The mesh, only the CPU arrays are changed.</param>
+/// <returns>false if the unique vertices don't fit 16-bit indices.</returns>
+bool MeshOptimizer::DeduplicateVertices(Mesh* pMesh)
+{
+	if (pMesh->vertices == nullptr || pMesh->vertexCount == 0)
+		return false;
+
+	VertexStream streams[MESH_OPTIMIZER_MAX_STREAMS];
+	int numStreams = GetVertexStreams(pMesh, streams);
+	const int vertexCount = pMesh->vertexCount;
+
+	auto hashVertex = [&](int v) {
+		unsigned int hash = 2166136261u; //FNV-1a
+		for (int s = 0; s < numStreams; s++) {
+			const unsigned char* pBytes = *streams[s].ppData + (size_t)v * streams[s].stride;
+			for (int b = 0; b < streams[s].stride; b++) {
+				hash = (hash ^ pBytes[b]) * 16777619u;
+			}
+		}
+		return hash;
+	};
+	auto equalVertices = [&](int a, int b) {
+		for (int s = 0; s < numStreams; s++) {
+			int stride = streams[s].stride;
+			if (memcmp(*streams[s].ppData + (size_t)a * stride, *streams[s].ppData + (size_t)b * stride, stride) != 0)
+				return false;
+		}
+		return true;
+	};
+
+	//open addressing table of the first vertex of every unique attribute set
+	size_t tableSize = 1;
+	while (tableSize < (size_t)vertexCount * 2)
+		tableSize *= 2;
+	vector<int> table(tableSize, -1);
+
+	vector<unsigned int> remap(vertexCount);
+	vector<unsigned int> uniqueSource;
+	for (int v = 0; v < vertexCount; v++) {
+		size_t slot = hashVertex(v) & (tableSize - 1);
+		while (table[slot] >= 0 && !equalVertices(table[slot], v))
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] < 0) {
+			table[slot] = v;
+			remap[v] = (unsigned int)uniqueSource.size();
+			uniqueSource.push_back((unsigned int)v);
+		}
+		else {
+			remap[v] = remap[table[slot]];
+		}
+	}
+
+	// raylib meshes use 16-bit indices, more unique vertices than that can not be addressed
+	if (uniqueSource.size() > 65536)
+		return false;
+
+	if (pMesh->indices != nullptr && uniqueSource.size() == (size_t)vertexCount)
+		return true; //nothing to merge
+
+	vector<unsigned int> indices = GetTriangleList(*pMesh);
+	unsigned short* pIndices = (unsigned short*)RL_MALLOC(indices.size() * sizeof(unsigned short));
+	for (size_t i = 0; i < indices.size(); i++) {
+		pIndices[i] = (unsigned short)remap[indices[i]];
+	}
+	RL_FREE(pMesh->indices);
+	pMesh->indices = pIndices;
+	pMesh->triangleCount = (int)indices.size() / 3;
+
+	GatherVertexStreams(pMesh, uniqueSource);
+	return true;
+}
+
+/// <summary>
+/// OptimizeVertexCache - Greedy triangle reordering for the post-transform vertex cache after Tom Forsyth,
+/// "Linear-Speed Vertex Cache Optimisation". Vertices score high when they are recently used (in a
+/// simulated LRU cache) and when few triangles still use them, the next triangle is the best scoring
+/// one among the triangles of the vertices in the cache.
+/// </summary>
+/// <param name="pIndices">Triangle list, reordered in place.</param>
+/// <param name="indexCount">Number of indices.</param>
+/// <param name="vertexCount">Number of vertices.</param>
+/// <param name="cacheSize">Simulated cache size.</param>
+void MeshOptimizer::OptimizeVertexCache(unsigned int* pIndices, int indexCount, int vertexCount, int cacheSize)
+{
+	const int triangleCount = indexCount / 3;
+	if (triangleCount < 2 || vertexCount == 0)
+		return;
+
+	cacheSize = std::min(std::max(cacheSize, 4), MESH_OPTIMIZER_MAX_CACHE_SIZE);
+
+	//score tables
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+	float cacheScores[MESH_OPTIMIZER_MAX_CACHE_SIZE];
+	for (int i = 0; i < cacheSize; i++) {
+		cacheScores[i] = i < 3 ? lastTriangleScore : powf(1.0f - (float)(i - 3) / (cacheSize - 3), cacheDecayPower);
+	}
+	float valenceScores[32];
+	for (int i = 1; i < 32; i++) {
+		valenceScores[i] = valenceBoostScale * powf((float)i, -valenceBoostPower);
+	}
+	auto vertexScore = [&](int cachePosition, int liveTriangles) {
+		if (liveTriangles == 0)
+			return -1.0f; //no triangle needs this vertex any more
+		float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+		score += liveTriangles < 32 ? valenceScores[liveTriangles] : valenceBoostScale * powf((float)liveTriangles, -valenceBoostPower);
+		return score;
+	};
+
+	//triangles using every vertex, the live ones are kept at the front of each list
+	vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int i = 0; i < indexCount; i++)
+		adjacencyOffsets[pIndices[i] + 1]++;
+	for (int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	vector<int> liveTriangles(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+	vector<int> adjacency(indexCount);
+	{
+		vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (int i = 0; i < indexCount; i++)
+			adjacency[fill[pIndices[i]]++] = i / 3;
+	}
+
+	vector<int> cachePositions(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+
+	vector<unsigned char> emitted(triangleCount, 0);
+	int bestTriangle = -1;
+	float bestScore = -FLT_MAX;
+	for (int t = 0; t < triangleCount; t++) {
+		float score = vertexScores[pIndices[t * 3]] + vertexScores[pIndices[t * 3 + 1]] + vertexScores[pIndices[t * 3 + 2]];
+		if (score > bestScore) {
+			bestScore = score;
+			bestTriangle = t;
+		}
+	}
+
+	int cache[MESH_OPTIMIZER_MAX_CACHE_SIZE + 3];
+	int newCache[MESH_OPTIMIZER_MAX_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int nextUnemitted = 0;
+
+	vector<unsigned int> output(triangleCount * 3);
+	for (int n = 0; n < triangleCount; n++) {
+		if (bestTriangle < 0) {
+			//nothing in the cache has live triangles left, continue with the next triangle in input order
+			while (emitted[nextUnemitted])
+				nextUnemitted++;
+			bestTriangle = nextUnemitted;
+		}
+
+		const unsigned int* pTriangle = pIndices + bestTriangle * 3;
+		output[n * 3 + 0] = pTriangle[0];
+		output[n * 3 + 1] = pTriangle[1];
+		output[n * 3 + 2] = pTriangle[2];
+		emitted[bestTriangle] = 1;
+
+		//remove the triangle from the live lists of its vertices
+		for (int k = 0; k < 3; k++) {
+			int v = (int)pTriangle[k];
+			int* pList = &adjacency[adjacencyOffsets[v]];
+			for (int i = 0; i < liveTriangles[v]; i++) {
+				if (pList[i] == bestTriangle) {
+					std::swap(pList[i], pList[liveTriangles[v] - 1]);
+					liveTriangles[v]--;
+					break;
+				}
+			}
+		}
+
+		//the triangle's vertices move to the front of the LRU cache
+		int newCount = 0;
+		for (int k = 0; k < 3; k++) {
+			int v = (int)pTriangle[k];
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+				newCache[newCount++] = v;
+		}
+		for (int i = 0; i < cacheCount; i++) {
+			int v = cache[i];
+			if (v != (int)pTriangle[0] && v != (int)pTriangle[1] && v != (int)pTriangle[2])
+				newCache[newCount++] = v;
+		}
+
+		for (int i = 0; i < newCount; i++) {
+			int v = newCache[i];
+			cachePositions[v] = i < cacheSize ? i : -1;
+			vertexScores[v] = vertexScore(cachePositions[v], liveTriangles[v]);
+		}
+
+		//rescore the triangles touching the cache and pick the best one
+		bestTriangle = -1;
+		bestScore = -FLT_MAX;
+		for (int i = 0; i < newCount; i++) {
+			int v = newCache[i];
+			const int* pList = &adjacency[adjacencyOffsets[v]];
+			for (int j = 0; j < liveTriangles[v]; j++) {
+				int t = pList[j];
+				float score = vertexScores[pIndices[t * 3]] + vertexScores[pIndices[t * 3 + 1]] + vertexScores[pIndices[t * 3 + 2]];
+				if (score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, cacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(int));
+	}
+
+	memcpy(pIndices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+/// <summary>
+/// OptimizeOverdraw - Overdraw aware cluster ordering after Sander, Nehab and Barczak, "Fast Triangle
+/// Reordering for Vertex Locality and Reduced Overdraw". The cache optimized list is cut where the cache
+/// restarts anyway (hard boundaries) and where a cluster's ACMR is within threshold of its hard cluster
+/// (soft boundaries). Clusters facing away from the mesh center are drawn first, they tend to occlude
+/// the rest of the mesh.
+/// </summary>
+/// <param name="pIndices">Cache optimized triangle list, reordered in place.</param>
+/// <param name="indexCount">Number of indices.</param>
+/// <param name="pVertices">xyz positions.</param>
+/// <param name="vertexCount">Number of vertices.</param>
+/// <param name="threshold">Allowed ACMR growth, 1.05 = 5%.</param>
+void MeshOptimizer::OptimizeOverdraw(unsigned int* pIndices, int indexCount, const float* pVertices, int vertexCount, float threshold)
+{
+	const int triangleCount = indexCount / 3;
+	if (triangleCount < 2 || pVertices == nullptr)
+		return;
+
+	//cache misses of every triangle in the current order
+	const unsigned int cacheSize = MESH_OPTIMIZER_REPORT_CACHE_SIZE;
+	vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	vector<int> misses(triangleCount, 0);
+	for (int t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = pIndices[t * 3 + k];
+			if (time - timestamps[v] > cacheSize) {
+				timestamps[v] = time++;
+				misses[t]++;
+			}
+		}
+	}
+
+	vector<int> clusterStarts;
+	for (int t = 0; t < triangleCount; ) {
+		//hard cluster: runs until the next triangle which misses with all three vertices
+		int hardEnd = t + 1;
+		int hardMisses = misses[t];
+		while (hardEnd < triangleCount && misses[hardEnd] < 3)
+			hardMisses += misses[hardEnd++];
+		float hardAcmr = (float)hardMisses / (hardEnd - t);
+
+		//soft clusters: cut as soon as the running ACMR is close enough to the hard cluster's
+		int clusterStart = t;
+		int clusterMisses = 0;
+		clusterStarts.push_back(t);
+		for (int i = t; i < hardEnd - 1; i++) {
+			clusterMisses += misses[i];
+			if ((float)clusterMisses / (i + 1 - clusterStart) <= hardAcmr * threshold) {
+				clusterStart = i + 1;
+				clusterMisses = 0;
+				clusterStarts.push_back(clusterStart);
+			}
+		}
+		t = hardEnd;
+	}
+	clusterStarts.push_back(triangleCount);
+
+	int clusterCount = (int)clusterStarts.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	//area weighted centroid and normal of every cluster and of the whole mesh
+	auto position = [pVertices](unsigned int v) { return Vector3{ pVertices[v * 3], pVertices[v * 3 + 1], pVertices[v * 3 + 2] }; };
+	vector<Vector3> clusterCentroids(clusterCount);
+	vector<Vector3> clusterNormals(clusterCount);
+	Vector3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (int c = 0; c < clusterCount; c++) {
+		Vector3 centroid = { 0.0f, 0.0f, 0.0f };
+		Vector3 normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+			Vector3 p0 = position(pIndices[t * 3]);
+			Vector3 p1 = position(pIndices[t * 3 + 1]);
+			Vector3 p2 = position(pIndices[t * 3 + 2]);
+			Vector3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			Vector3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			Vector3 cross = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+			float triangleArea = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+
+			centroid.x += (p0.x + p1.x + p2.x) / 3.0f * triangleArea;
+			centroid.y += (p0.y + p1.y + p2.y) / 3.0f * triangleArea;
+			centroid.z += (p0.z + p1.z + p2.z) / 3.0f * triangleArea;
+			normal.x += cross.x;
+			normal.y += cross.y;
+			normal.z += cross.z;
+			area += triangleArea;
+		}
+		meshCentroid.x += centroid.x;
+		meshCentroid.y += centroid.y;
+		meshCentroid.z += centroid.z;
+		meshArea += area;
+
+		float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+		clusterCentroids[c] = Vector3{ centroid.x * invArea, centroid.y * invArea, centroid.z * invArea };
+		float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+		clusterNormals[c] = Vector3{ normal.x * invLength, normal.y * invLength, normal.z * invLength };
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid.x /= meshArea;
+		meshCentroid.y /= meshArea;
+		meshCentroid.z /= meshArea;
+	}
+
+	vector<float> sortKeys(clusterCount);
+	vector<int> order(clusterCount);
+	for (int c = 0; c < clusterCount; c++) {
+		Vector3 d = { clusterCentroids[c].x - meshCentroid.x, clusterCentroids[c].y - meshCentroid.y, clusterCentroids[c].z - meshCentroid.z };
+		sortKeys[c] = d.x * clusterNormals[c].x + d.y * clusterNormals[c].y + d.z * clusterNormals[c].z;
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](int a, int b) { return sortKeys[a] > sortKeys[b]; });
+
+	vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (int c : order) {
+		output.insert(output.end(), pIndices + clusterStarts[c] * 3, pIndices + clusterStarts[c + 1] * 3);
+	}
+	memcpy(pIndices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+/// <summary>
+/// OptimizeVertexFetch - Renumber the vertices in the order the triangles first reference them, so the
+/// vertex fetch reads the buffers mostly sequentially. Unreferenced vertices are removed.
+/// </summary>
+/// <param name="pMesh">An indexed mesh.</param>
+void MeshOptimizer::OptimizeVertexFetch(Mesh* pMesh)
+{
+	if (pMesh->indices == nullptr)
+		return;
+
+	const int indexCount = pMesh->triangleCount * 3;
+	vector<int> remap(pMesh->vertexCount, -1);
+	vector<unsigned int> source;
+	source.reserve(pMesh->vertexCount);
+	for (int i = 0; i < indexCount; i++) {
+		unsigned short v = pMesh->indices[i];
+		if (remap[v] < 0) {
+			remap[v] = (int)source.size();
+			source.push_back(v);
+		}
+		pMesh->indices[i] = (unsigned short)remap[v];
+	}
+
+	GatherVertexStreams(pMesh, source);
+}
+
+// Symmetric 4x4 matrix of the weighted sum of squared distances to a set of planes, and the sum of the weights
+struct Quadric
+{
+	double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+	double weight;
+};
+
+static void QuadricAddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+{
+	q.a00 += weight * a * a; q.a01 += weight * a * b; q.a02 += weight * a * c; q.a03 += weight * a * d;
+	q.a11 += weight * b * b; q.a12 += weight * b * c; q.a13 += weight * b * d;
+	q.a22 += weight * c * c; q.a23 += weight * c * d;
+	q.a33 += weight * d * d;
+	q.weight += weight;
+}
+
+static void QuadricAdd(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+	q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+	q.a22 += other.a22; q.a23 += other.a23;
+	q.a33 += other.a33;
+	q.weight += other.weight;
+}
+
+static double QuadricError(const Quadric& q, Vector3 p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	return q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x
+		+ q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y
+		+ q.a22 * z * z + 2 * q.a23 * z
+		+ q.a33;
+}
+
+// Weighted mean squared distance of p to the planes of both quadrics
+static double QuadricError(const Quadric& q, const Quadric& other, Vector3 p)
+{
+	Quadric sum = q;
+	QuadricAdd(sum, other);
+	return sum.weight > 0.0 ? QuadricError(sum, p) / sum.weight : 0.0;
+}
+
+static Vector3 TriangleNormal(Vector3 p0, Vector3 p1, Vector3 p2)
+{
+	Vector3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+	Vector3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+	return Vector3{ e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+}
+
+/// <summary>
+/// SimplifyMesh - Quadric error metric simplification after Garland and Heckbert, "Surface Simplification
+/// Using Quadric Error Metrics". Edges are collapsed onto one of their vertices (half edge collapse), so
+/// the simplified mesh keeps a subset of the original vertices and needs no attribute interpolation.
+/// Vertices sharing a position are treated as one; a collapse is only allowed if every attribute vertex of
+/// the removed position has a counterpart across the edge, which keeps UV seams and hard edges closed.
+/// Open borders only collapse along the border. Every pass collapses the cheapest independent edges.
+/// </summary>
+/// <param name="mesh">An indexed mesh, not modified.</param>
+/// <param name="targetRatio">Fraction of the triangles to keep.</param>
+/// <param name="maxError">Largest allowed collapse error, relative to the mesh radius.</param>
+/// <param name="pLod">Returns the simplified mesh (CPU arrays only).</param>
+/// <returns>The relative error of the most expensive collapse (0 if nothing could be collapsed, pLod is
+/// a copy then), negative if the mesh is not indexed.</returns>
+float MeshOptimizer::SimplifyMesh(const Mesh& mesh, float targetRatio, float maxError, Mesh* pLod)
+{
+	memset(pLod, 0, sizeof(Mesh));
+	if (mesh.indices == nullptr || mesh.vertices == nullptr || mesh.triangleCount == 0)
+		return -1.0f;
+
+	const int vertexCount = mesh.vertexCount;
+	vector<unsigned int> indices = GetTriangleList(mesh);
+
+	//weld the attribute vertices sharing a position
+	vector<unsigned int> posIds(vertexCount);
+	vector<Vector3> positions;
+	{
+		size_t tableSize = 1;
+		while (tableSize < (size_t)vertexCount * 2)
+			tableSize *= 2;
+		vector<int> table(tableSize, -1);
+		for (int v = 0; v < vertexCount; v++) {
+			const float* p = mesh.vertices + v * 3;
+			unsigned int hash = 2166136261u;
+			for (size_t b = 0; b < 3 * sizeof(float); b++)
+				hash = (hash ^ ((const unsigned char*)p)[b]) * 16777619u;
+			size_t slot = hash & (tableSize - 1);
+			while (table[slot] >= 0 && memcmp(mesh.vertices + table[slot] * 3, p, 3 * sizeof(float)) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+			if (table[slot] < 0) {
+				table[slot] = v;
+				posIds[v] = (unsigned int)positions.size();
+				positions.push_back(Vector3{ p[0], p[1], p[2] });
+			}
+			else {
+				posIds[v] = posIds[table[slot]];
+			}
+		}
+	}
+	const int posCount = (int)positions.size();
+
+	Vector3 boundsMin = positions[0], boundsMax = positions[0];
+	for (const Vector3& p : positions) {
+		boundsMin = Vector3{ std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z) };
+		boundsMax = Vector3{ std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z) };
+	}
+	Vector3 extent = { boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z };
+	double radius = 0.5 * sqrt((double)extent.x * extent.x + (double)extent.y * extent.y + (double)extent.z * extent.z);
+	if (radius <= 0.0)
+		radius = 1.0;
+	const double maxCost = (maxError * radius) * (maxError * radius);
+
+	auto edgeKey = [](unsigned int a, unsigned int b) {
+		return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+	};
+
+	//plane quadrics of the triangles, border edges add a perpendicular plane so they stay in place
+	vector<Quadric> quadrics(posCount, Quadric{ 0 });
+	vector<unsigned long long> edges;
+	const int triangleCount = (int)indices.size() / 3;
+	for (int t = 0; t < triangleCount; t++) {
+		unsigned int p[3] = { posIds[indices[t * 3]], posIds[indices[t * 3 + 1]], posIds[indices[t * 3 + 2]] };
+		Vector3 n = TriangleNormal(positions[p[0]], positions[p[1]], positions[p[2]]);
+		double length = sqrt((double)n.x * n.x + (double)n.y * n.y + (double)n.z * n.z);
+		if (length <= 0.0)
+			continue;
+		double a = n.x / length, b = n.y / length, c = n.z / length;
+		double d = -(a * positions[p[0]].x + b * positions[p[0]].y + c * positions[p[0]].z);
+		for (int k = 0; k < 3; k++) {
+			QuadricAddPlane(quadrics[p[k]], a, b, c, d, length * 0.5); //area weighted
+			if (p[k] != p[(k + 1) % 3])
+				edges.push_back(edgeKey(p[k], p[(k + 1) % 3]));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	vector<unsigned char> isBorder(posCount, 0);
+	for (int t = 0; t < triangleCount; t++) {
+		unsigned int p[3] = { posIds[indices[t * 3]], posIds[indices[t * 3 + 1]], posIds[indices[t * 3 + 2]] };
+		Vector3 n = TriangleNormal(positions[p[0]], positions[p[1]], positions[p[2]]);
+		for (int k = 0; k < 3; k++) {
+			unsigned int pa = p[k], pb = p[(k + 1) % 3];
+			if (pa == pb)
+				continue;
+			auto range = std::equal_range(edges.begin(), edges.end(), edgeKey(pa, pb));
+			if (range.second - range.first != 1)
+				continue;
+			isBorder[pa] = isBorder[pb] = 1;
+
+			Vector3 e = { positions[pb].x - positions[pa].x, positions[pb].y - positions[pa].y, positions[pb].z - positions[pa].z };
+			Vector3 perp = { e.y * n.z - e.z * n.y, e.z * n.x - e.x * n.z, e.x * n.y - e.y * n.x };
+			double length = sqrt((double)perp.x * perp.x + (double)perp.y * perp.y + (double)perp.z * perp.z);
+			if (length <= 0.0)
+				continue;
+			double a = perp.x / length, b = perp.y / length, c = perp.z / length;
+			double d = -(a * positions[pa].x + b * positions[pa].y + c * positions[pa].z);
+			double weight = ((double)e.x * e.x + (double)e.y * e.y + (double)e.z * e.z) * MESH_OPTIMIZER_BORDER_WEIGHT;
+			QuadricAddPlane(quadrics[pa], a, b, c, d, weight);
+			QuadricAddPlane(quadrics[pb], a, b, c, d, weight);
+		}
+	}
+
+	int liveTriangles = triangleCount;
+	const int targetTriangles = std::max(1, (int)(triangleCount * targetRatio));
+	double resultCost = 0.0;
+
+	vector<unsigned int> attributeRemap(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		attributeRemap[v] = (unsigned int)v;
+
+	vector<int> triOffsets(posCount + 1);
+	vector<int> trianglesOfPos;
+	vector<unsigned char> locked(posCount);
+	vector<pair<unsigned int, unsigned int>> attributeMap;
+
+	//checks collapsing position u onto v and fills attributeMap with the attribute vertex each one of u becomes
+	auto canCollapse = [&](unsigned int u, unsigned int v, bool borderEdge) {
+		if (isBorder[u] && !borderEdge)
+			return false;
+
+		attributeMap.clear();
+		for (int i = triOffsets[u]; i < triOffsets[u + 1]; i++) {
+			const unsigned int* pTriangle = &indices[trianglesOfPos[i] * 3];
+			int cu = -1, cv = -1;
+			for (int k = 0; k < 3; k++) {
+				if (posIds[pTriangle[k]] == u) cu = k;
+				if (posIds[pTriangle[k]] == v) cv = k;
+			}
+			if (cv < 0)
+				continue;
+			bool found = false;
+			for (auto& mapping : attributeMap) {
+				if (mapping.first == pTriangle[cu]) {
+					if (mapping.second != pTriangle[cv])
+						return false; //one attribute vertex would have to become two
+					found = true;
+				}
+			}
+			if (!found)
+				attributeMap.push_back(make_pair(pTriangle[cu], pTriangle[cv]));
+		}
+
+		Vector3 target = positions[v];
+		for (int i = triOffsets[u]; i < triOffsets[u + 1]; i++) {
+			const unsigned int* pTriangle = &indices[trianglesOfPos[i] * 3];
+			Vector3 corners[3];
+			bool hasV = false;
+			int cu = 0;
+			for (int k = 0; k < 3; k++) {
+				corners[k] = positions[posIds[pTriangle[k]]];
+				if (posIds[pTriangle[k]] == v) hasV = true;
+				if (posIds[pTriangle[k]] == u) cu = k;
+			}
+			if (hasV)
+				continue;
+
+			//an attribute vertex without counterpart across the edge would tear a seam open
+			bool mapped = false;
+			for (auto& mapping : attributeMap)
+				mapped |= mapping.first == pTriangle[cu];
+			if (!mapped)
+				return false;
+
+			//reject collapses which flip a remaining triangle
+			Vector3 before = TriangleNormal(corners[0], corners[1], corners[2]);
+			corners[cu] = target;
+			Vector3 after = TriangleNormal(corners[0], corners[1], corners[2]);
+			if (before.x * after.x + before.y * after.y + before.z * after.z <= 0.0f)
+				return false;
+		}
+		return true;
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int u, v;
+		bool operator<(const Collapse& other) const { return cost < other.cost; }
+	};
+	vector<Collapse> collapses;
+
+	while (liveTriangles > targetTriangles) {
+		//triangles around every position
+		std::fill(triOffsets.begin(), triOffsets.end(), 0);
+		for (size_t i = 0; i < indices.size(); i++)
+			triOffsets[posIds[indices[i]] + 1]++;
+		for (int p = 0; p < posCount; p++)
+			triOffsets[p + 1] += triOffsets[p];
+		trianglesOfPos.resize(indices.size());
+		{
+			vector<int> fill(triOffsets.begin(), triOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				trianglesOfPos[fill[posIds[indices[i]]]++] = (int)(i / 3);
+		}
+
+		edges.clear();
+		for (size_t t = 0; t < indices.size() / 3; t++) {
+			for (int k = 0; k < 3; k++)
+				edges.push_back(edgeKey(posIds[indices[t * 3 + k]], posIds[indices[t * 3 + (k + 1) % 3]]));
+		}
+		std::sort(edges.begin(), edges.end());
+
+		//cheapest valid direction of every edge
+		collapses.clear();
+		for (size_t i = 0; i < edges.size(); ) {
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				j++;
+			bool borderEdge = (j - i) == 1;
+			unsigned int a = (unsigned int)(edges[i] >> 32), b = (unsigned int)(edges[i] & 0xffffffff);
+			i = j;
+
+			Collapse best = { DBL_MAX, 0, 0 };
+			for (int dir = 0; dir < 2; dir++) {
+				unsigned int u = dir == 0 ? a : b, v = dir == 0 ? b : a;
+				if (!canCollapse(u, v, borderEdge))
+					continue;
+				double cost = QuadricError(quadrics[u], quadrics[v], positions[v]);
+				if (cost < best.cost)
+					best = Collapse{ cost, u, v };
+			}
+			if (best.cost < DBL_MAX)
+				collapses.push_back(best);
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		//apply the cheapest collapses which don't touch each other's neighbourhood
+		std::fill(locked.begin(), locked.end(), 0);
+		int removed = 0;
+		int applied = 0;
+		for (const Collapse& collapse : collapses) {
+			if (collapse.cost > maxCost || liveTriangles - removed <= targetTriangles)
+				break;
+			if (locked[collapse.u] || locked[collapse.v])
+				continue;
+
+			canCollapse(collapse.u, collapse.v, true); //border state was checked already, rebuild the attribute map
+			for (auto& mapping : attributeMap)
+				attributeRemap[mapping.first] = mapping.second;
+			QuadricAdd(quadrics[collapse.v], quadrics[collapse.u]);
+
+			for (int i = triOffsets[collapse.u]; i < triOffsets[collapse.u + 1]; i++) {
+				const unsigned int* pTriangle = &indices[trianglesOfPos[i] * 3];
+				bool hasV = false;
+				for (int k = 0; k < 3; k++) {
+					locked[posIds[pTriangle[k]]] = 1;
+					hasV |= posIds[pTriangle[k]] == collapse.v;
+				}
+				removed += hasV ? 1 : 0;
+			}
+			resultCost = std::max(resultCost, collapse.cost);
+			applied++;
+		}
+		if (applied == 0)
+			break;
+
+		//remap the triangles and drop the ones which collapsed
+		size_t write = 0;
+		for (size_t t = 0; t < indices.size() / 3; t++) {
+			unsigned int a = attributeRemap[indices[t * 3]];
+			unsigned int b = attributeRemap[indices[t * 3 + 1]];
+			unsigned int c = attributeRemap[indices[t * 3 + 2]];
+			if (posIds[a] == posIds[b] || posIds[b] == posIds[c] || posIds[a] == posIds[c])
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+		liveTriangles = (int)write / 3;
+	}
+
+	if (indices.empty())
+		return -1.0f;
+
+	OptimizeVertexCache(indices.data(), (int)indices.size(), vertexCount);
+
+	//copy the used vertices in first use order
+	vector<int> remap(vertexCount, -1);
+	vector<unsigned int> source;
+	pLod->indices = (unsigned short*)RL_MALLOC(indices.size() * sizeof(unsigned short));
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (remap[indices[i]] < 0) {
+			remap[indices[i]] = (int)source.size();
+			source.push_back(indices[i]);
+		}
+		pLod->indices[i] = (unsigned short)remap[indices[i]];
+	}
+	pLod->triangleCount = (int)indices.size() / 3;
+
+	VertexStream streams[MESH_OPTIMIZER_MAX_STREAMS];
+	int numStreams = GetVertexStreams(const_cast<Mesh*>(&mesh), streams);
+	for (int s = 0; s < numStreams; s++) {
+		//the same array member in the simplified mesh
+		size_t member = (unsigned char*)streams[s].ppData - (unsigned char*)&mesh;
+		unsigned char** ppLodData = (unsigned char**)((unsigned char*)pLod + member);
+		*ppLodData = (unsigned char*)RL_MALLOC(source.size() * streams[s].stride);
+		for (size_t i = 0; i < source.size(); i++) {
+			memcpy(*ppLodData + i * streams[s].stride, *streams[s].ppData + (size_t)source[i] * streams[s].stride, streams[s].stride);
+		}
+	}
+	pLod->vertexCount = (int)source.size();
+
+	return (float)(sqrt(resultCost) / radius);
+}
+
+/// <summary>
+/// AnalyzeVertexCache - Count the vertex shader invocations of a triangle list with a FIFO cache,
+/// the model most hardware post-transform caches are closest to.
+/// </summary>
+/// <param name="pIndices">Triangle list.</param>
+/// <param name="indexCount">Number of indices.</param>
+/// <param name="vertexCount">Number of vertices.</param>
+/// <param name="cacheSize">FIFO size.</param>
+/// <returns>ACMR and ATVR of the list.</returns>
+MeshCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* pIndices, int indexCount, int vertexCount, int cacheSize)
+{
+	MeshCacheStats stats;
+	stats.vertexCount = vertexCount;
+	stats.triangleCount = indexCount / 3;
+
+	//a vertex is in the cache if fewer than cacheSize misses happened since it was loaded
+	vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = (unsigned int)cacheSize + 1;
+	for (int i = 0; i < indexCount; i++) {
+		unsigned int v = pIndices[i];
+		if (time - timestamps[v] > (unsigned int)cacheSize) {
+			timestamps[v] = time++;
+			stats.transformedVertices++;
+		}
+	}
+
+	if (stats.triangleCount > 0)
+		stats.acmr = (float)stats.transformedVertices / stats.triangleCount;
+	if (vertexCount > 0)
+		stats.atvr = (float)stats.transformedVertices / vertexCount;
+	return stats;
+}
+
+MeshCacheStats MeshOptimizer::AnalyzeVertexCache(const Mesh& mesh, int cacheSize)
+{
+	vector<unsigned int> indices = GetTriangleList(mesh);
+	return AnalyzeVertexCache(indices.data(), (int)indices.size(), mesh.vertexCount, cacheSize);
+}
+
+/// <summary>
+/// GenerateTangents - Per vertex tangents from the texture coordinate gradients of the triangles around it
+/// (Lengyel's method). Unlike raylib's GenMeshTangents it follows the index buffer, so it works on indexed
+/// meshes. The tangent is made orthogonal to the normal and w holds the handedness of the bitangent.
+/// </summary>
+/// <param name="pMesh">The mesh, needs positions, normals and texture coordinates. Only the CPU arrays are changed.</param>
+/// <returns>false if the mesh lacks one of the required arrays.</returns>
+bool MeshOptimizer::GenerateTangents(Mesh* pMesh)
+{
+	if (pMesh->vertices == nullptr || pMesh->normals == nullptr || pMesh->texcoords == nullptr || pMesh->vertexCount == 0)
+		return false;
+
+	vector<unsigned int> indices = GetTriangleList(*pMesh);
+	vector<Vector3> tan1(pMesh->vertexCount, Vector3{ 0.0f, 0.0f, 0.0f });
+	vector<Vector3> tan2(pMesh->vertexCount, Vector3{ 0.0f, 0.0f, 0.0f });
+	const float* p = pMesh->vertices;
+	const float* uv = pMesh->texcoords;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		unsigned int i0 = indices[t], i1 = indices[t + 1], i2 = indices[t + 2];
+		float x1 = p[i1 * 3] - p[i0 * 3], y1 = p[i1 * 3 + 1] - p[i0 * 3 + 1], z1 = p[i1 * 3 + 2] - p[i0 * 3 + 2];
+		float x2 = p[i2 * 3] - p[i0 * 3], y2 = p[i2 * 3 + 1] - p[i0 * 3 + 1], z2 = p[i2 * 3 + 2] - p[i0 * 3 + 2];
+		float s1 = uv[i1 * 2] - uv[i0 * 2], t1 = uv[i1 * 2 + 1] - uv[i0 * 2 + 1];
+		float s2 = uv[i2 * 2] - uv[i0 * 2], t2 = uv[i2 * 2 + 1] - uv[i0 * 2 + 1];
+		float div = s1 * t2 - s2 * t1;
+		float r = div != 0.0f ? 1.0f / div : 0.0f;
+		Vector3 sdir = { (t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r };
+		Vector3 tdir = { (s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r };
+		for (unsigned int v : { i0, i1, i2 }) {
+			tan1[v].x += sdir.x; tan1[v].y += sdir.y; tan1[v].z += sdir.z;
+			tan2[v].x += tdir.x; tan2[v].y += tdir.y; tan2[v].z += tdir.z;
+		}
+	}
+
+	if (pMesh->tangents == nullptr)
+		pMesh->tangents = (float*)RL_MALLOC((size_t)pMesh->vertexCount * 4 * sizeof(float));
+	for (int v = 0; v < pMesh->vertexCount; v++) {
+		Vector3 n = { pMesh->normals[v * 3], pMesh->normals[v * 3 + 1], pMesh->normals[v * 3 + 2] };
+		Vector3 t = tan1[v];
+
+		//Gram-Schmidt, fall back to any vector orthogonal to the normal for degenerate mappings
+		float nDotT = n.x * t.x + n.y * t.y + n.z * t.z;
+		Vector3 o = { t.x - n.x * nDotT, t.y - n.y * nDotT, t.z - n.z * nDotT };
+		float length = sqrtf(o.x * o.x + o.y * o.y + o.z * o.z);
+		if (length < 1e-6f) {
+			o = fabsf(n.x) < 0.9f ? Vector3{ 0.0f, -n.z, n.y } : Vector3{ n.z, 0.0f, -n.x };
+			length = sqrtf(o.x * o.x + o.y * o.y + o.z * o.z);
+		}
+		o = length > 0.0f ? Vector3{ o.x / length, o.y / length, o.z / length } : Vector3{ 1.0f, 0.0f, 0.0f };
+
+		Vector3 b = { n.y * t.z - n.z * t.y, n.z * t.x - n.x * t.z, n.x * t.y - n.y * t.x };
+		float handedness = (b.x * tan2[v].x + b.y * tan2[v].y + b.z * tan2[v].z) < 0.0f ? -1.0f : 1.0f;
+
+		pMesh->tangents[v * 4] = o.x;
+		pMesh->tangents[v * 4 + 1] = o.y;
+		pMesh->tangents[v * 4 + 2] = o.z;
+		pMesh->tangents[v * 4 + 3] = handedness;
+	}
+	return true;
+}
+
+/// <summary>
+/// OptimizeMesh - Deduplicate, reorder for the vertex cache and overdraw, then reorder the vertex buffers.
+/// </summary>
+/// <param name="pMesh">The mesh, only the CPU arrays are changed.</param>
+/// <returns>false if the mesh could not be indexed with 16-bit indices, it is left unchanged then.</returns>
+bool MeshOptimizer::OptimizeMesh(Mesh* pMesh)
+{
+	if (!DeduplicateVertices(pMesh))
+		return false;
+
+	vector<unsigned int> indices = GetTriangleList(*pMesh);
+	OptimizeVertexCache(indices.data(), (int)indices.size(), pMesh->vertexCount);
+	OptimizeOverdraw(indices.data(), (int)indices.size(), pMesh->vertices, pMesh->vertexCount);
+	for (size_t i = 0; i < indices.size(); i++) {
+		pMesh->indices[i] = (unsigned short)indices[i];
+	}
+
+	OptimizeVertexFetch(pMesh);
+	return true;
+}
+
+/// <summary>
+/// OptimizeModel - Optimize all meshes of a model on the JobSystem and report the expected vertex shader savings.
+/// The GPU buffers are replaced on the calling thread afterwards.
+/// </summary>
+/// <param name="model">The model</param>
+/// <param name="pName">Name used in the report, usually the file path</param>
+void MeshOptimizer::OptimizeModel(const Model& model, const char* pName)
+{
+	double t = GetTime();
+
+	vector<MeshCacheStats> before(model.meshCount);
+	vector<MeshCacheStats> after(model.meshCount);
+	vector<unsigned char> optimized(model.meshCount, 0);
+	JobSystem::Instance().ParallelFor(model.meshCount, 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			before[i] = AnalyzeVertexCache(model.meshes[i]);
+			optimized[i] = OptimizeMesh(&model.meshes[i]) ? 1 : 0;
+			after[i] = AnalyzeVertexCache(model.meshes[i]);
+		}
+	});
+
+	MeshCacheStats totalBefore, totalAfter;
+	int numSkipped = 0;
+	for (int i = 0; i < model.meshCount; i++) {
+		if (optimized[i])
+			ReuploadMesh(&model.meshes[i]);
+		else
+			numSkipped++;
+
+		totalBefore.vertexCount += before[i].vertexCount;
+		totalBefore.triangleCount += before[i].triangleCount;
+		totalBefore.transformedVertices += before[i].transformedVertices;
+		totalAfter.vertexCount += after[i].vertexCount;
+		totalAfter.triangleCount += after[i].triangleCount;
+		totalAfter.transformedVertices += after[i].transformedVertices;
+	}
+
+	for (MeshCacheStats* pStats : { &totalBefore, &totalAfter }) {
+		if (pStats->triangleCount > 0)
+			pStats->acmr = (float)pStats->transformedVertices / pStats->triangleCount;
+		if (pStats->vertexCount > 0)
+			pStats->atvr = (float)pStats->transformedVertices / pStats->vertexCount;
+	}
+
+	TraceLog(LOG_INFO, "<MeshOptimizer.OptimizeModel> %s: %d meshes, %d triangles, vertices %d -> %d, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertex shader invocations %d -> %d (FIFO %d), %.2f ms",
+		pName != nullptr ? pName : "model", model.meshCount, totalAfter.triangleCount, totalBefore.vertexCount, totalAfter.vertexCount,
+		totalBefore.acmr, totalAfter.acmr, totalBefore.atvr, totalAfter.atvr, totalBefore.transformedVertices, totalAfter.transformedVertices,
+		MESH_OPTIMIZER_REPORT_CACHE_SIZE, (GetTime() - t) * 1000);
+	if (numSkipped > 0)
+		TraceLog(LOG_WARNING, "<MeshOptimizer.OptimizeModel> %s: %d meshes have more unique vertices than 16-bit indices can address, left unchanged",
+			pName != nullptr ? pName : "model", numSkipped);
+}
+
+/// <summary>
+/// ReuploadMesh - raylib skips UploadMesh for meshes which already have a VAO, so the old buffers
+/// are released first and the mesh is uploaded again from its CPU arrays.
+/// </summary>
+/// <param name="pMesh">The mesh</param>
+void MeshOptimizer::ReuploadMesh(Mesh* pMesh)
+{
+	if (pMesh->vaoId == 0)
+		return;
+
+	// Do not use UnloadMesh() as it would free the CPU arrays too
+	rlUnloadVertexArray(pMesh->vaoId);
+	pMesh->vaoId = 0;
+	if (pMesh->vboId != nullptr) {
+		for (int i = 0; i < MAX_MESH_VERTEX_BUFFERS; i++)
+			rlUnloadVertexBuffer(pMesh->vboId[i]);
+		RL_FREE(pMesh->vboId);
+		pMesh->vboId = nullptr;
+	}
+
+	UploadMesh(pMesh, false);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+
+using namespace std;
+
+#define MESH_OPTIMIZER_CACHE_SIZE		32		//vertex cache size the triangle order is optimized for
+#define MESH_OPTIMIZER_REPORT_CACHE_SIZE	16		//FIFO cache size used for the ACMR/ATVR report
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD	1.05f	//allowed ACMR growth when splitting clusters for overdraw
+#define MESH_OPTIMIZER_BORDER_WEIGHT		10.0f	//quadric weight keeping open borders in place during simplification
+
+// Post-transform vertex cache efficiency of a triangle list
+struct MeshCacheStats
+{
+	int vertexCount = 0;
+	int triangleCount = 0;
+	int transformedVertices = 0;	//cache misses of a simulated FIFO cache
+	float acmr = 0.0f;				//average cache miss ratio, transformed vertices per triangle (0.5 .. 3)
+	float atvr = 0.0f;				//average transformed vertex ratio, transformed vertices per vertex (1 is optimal)
+};
+
+// Mesh optimization steps, all work on the CPU arrays of the mesh
+class MeshOptimizer
+{
+public:
+	// Merge vertices whose attributes are all bitwise equal and build (or rebuild) the index buffer.
+	// Returns false if the unique vertices don't fit 16-bit indices, the mesh is left unchanged then.
+	static bool DeduplicateVertices(Mesh* pMesh);
+
+	// Reorder triangles for the post-transform vertex cache (Forsyth's linear speed algorithm)
+	static void OptimizeVertexCache(unsigned int* pIndices, int indexCount, int vertexCount, int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+	// Split the cache optimized triangles into clusters and draw the outward facing ones first (Tipsify style),
+	// the ACMR grows by at most threshold
+	static void OptimizeOverdraw(unsigned int* pIndices, int indexCount, const float* pVertices, int vertexCount, float threshold = MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+
+	// Reorder the vertices in the order the triangles first use them and drop unreferenced ones
+	static void OptimizeVertexFetch(Mesh* pMesh);
+
+	// Quadric error metric simplification of an indexed mesh into a new mesh with about targetRatio of the
+	// triangles. Collapses stop early once their error exceeds maxError, relative to the mesh radius.
+	// Returns the relative error reached, or a negative value if the mesh is not indexed.
+	static float SimplifyMesh(const Mesh& mesh, float targetRatio, float maxError, Mesh* pLod);
+
+	// Tangents (w = bitangent sign) from normals and texture coordinates, works on indexed meshes
+	static bool GenerateTangents(Mesh* pMesh);
+
+	// Simulate a FIFO vertex cache over a triangle list
+	static MeshCacheStats AnalyzeVertexCache(const unsigned int* pIndices, int indexCount, int vertexCount, int cacheSize = MESH_OPTIMIZER_REPORT_CACHE_SIZE);
+	static MeshCacheStats AnalyzeVertexCache(const Mesh& mesh, int cacheSize = MESH_OPTIMIZER_REPORT_CACHE_SIZE);
+
+	// Run all steps on one mesh, CPU only so it can run on a worker thread
+	static bool OptimizeMesh(Mesh* pMesh);
+
+	// Optimize every mesh of a model in parallel, re-upload the ones already on the GPU and log the
+	// ACMR/ATVR before and after
+	static void OptimizeModel(const Model& model, const char* pName = nullptr);
+
+	// Replace the GPU buffers of an uploaded mesh with its current CPU arrays (main thread)
+	static void ReuploadMesh(Mesh* pMesh);
+};
@@ -1,7 +1,10 @@
 #include "ModelComponent.h"
 #include "SceneActor.h"
 #include "KnightUtils.h"
+#include "ResourceRegistry.h"
+#include "AsyncAssetLoader.h"
 #include "rlgl.h"
+#include <config.h>
 
 #include <map>
 
@@ -27,47 +30,50 @@ ModelComponent::~ModelComponent()
 {
 	if (_LoadState & DiffuseMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_DIFFUSE]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_DIFFUSE]);
 	}
 	if (_LoadState & SpecularMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_SPECULAR]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_SPECULAR]);
 	}
 	if (_LoadState & NormalMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_NORMAL]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_NORMAL]);
 	}
 	if (_LoadState & MetalicMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_METALNESS]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_METALNESS]);
 	}	
 	if (_LoadState & RoughnessMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_ROUGHNESS]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_ROUGHNESS]);
 	}	
 	if (_LoadState & HeightMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_HEIGHT]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_HEIGHT]);
 	}	
 	if (_LoadState & CubeMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_CUBEMAP]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_CUBEMAP]);
 	}	
 	if (_LoadState & EmmissionMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_EMISSION]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_EMISSION]);
 	}
 	if (_LoadState & OcclusionMap)
 	{
-		UnloadTexture(_Texture2DMaps[MATERIAL_MAP_OCCLUSION]);
+		ResourceRegistry::Instance().ReleaseTexture(_Texture2DMaps[MATERIAL_MAP_OCCLUSION]);
 	}
 
-	if (_LoadState & Loaded_Animations)
+	UnloadLevelsOfDetail();
+
+	//the meshes and animations of a file belong to the registry
+	if (_pSharedModel != nullptr)
 	{
-		UnloadModelAnimations(_Animations, _AnimationsCount);
+		ReleaseModelInstance();
+		ResourceRegistry::Instance().ReleaseModel(_pSharedModel);
 	}
-	
-	if (_LoadState & Loaded_Model)
+	else if (_LoadState & Loaded_Model)
 	{
 		UnloadModel(_Model);
 	}
@@ -77,9 +83,13 @@ void ModelComponent::Update(float ElapsedSeconds, RenderHints* pRH)
 {
 	__super::Update(ElapsedSeconds, pRH);
 
+	if (_pPendingModel != nullptr)
+		UpdateAsyncLoad();
+
 	if (_SceneActor)
 	{
 		_Model.transform = *(_SceneActor->GetWorldTransformMatrix());
+		UpdateLevelOfDetail();
 	}
 
 	if ((_LoadState & Loaded_Animations) && 
@@ -115,20 +125,18 @@ void ModelComponent::Update(float ElapsedSeconds, RenderHints* pRH)
 
 void ModelComponent::Draw(RenderHints* pRH)
 {
-	if (pRH != nullptr && pRH->pOverrideShader != nullptr) {
-
-		Shader* pShaders = new Shader[_Model.materialCount];
-		for (int i=0; i < _Model.materialCount; i++) {
-			pShaders[i] = _Model.materials[i].shader;
-			_Model.materials[i].shader = *pRH->pOverrideShader;
-		}
-		DrawModel(_Model, Vector3Zero(), 1.0f, _Color);
-		for (int i=0; i < _Model.materialCount; i++) {
-			_Model.materials[i].shader = pShaders[i];
-		}
+	if (_pPendingModel != nullptr)
+	{
+		if (DrawPlaceholder && _SceneActor)
+			DrawCubeWires(Vector3Add(_SceneActor->GetWorldPosition(), Vector3{ 0.0f, 0.5f, 0.0f }), 1.0f, 1.0f, 1.0f, LIGHTGRAY);
+		return;
 	}
-	else
-		DrawModel(_Model, Vector3Zero(), 1.0f, _Color);
+
+	//inside the fade band both are drawn, the meshes fading out over the impostor
+	if (_ImpostorBlend < 1.0f)
+		DrawMeshes(pRH, _ImpostorBlend > 0.0f ? Fade(_Color, 1.0f - _ImpostorBlend) : _Color);
+	if (_ImpostorBlend > 0.0f)
+		DrawImpostor(pRH, Fade(_Color, _ImpostorBlend));
 
 	if (DrawBoundingBox)
 	{
@@ -143,6 +151,62 @@ void ModelComponent::Draw(RenderHints* pRH)
 	}
 }
 
+/// <summary>
+/// DrawMeshes - draw the level of detail requested by the render hints, or the one selected in Update
+/// </summary>
+/// <param name="pRH">The RenderHints of the render pass</param>
+/// <param name="tint">Color of the model</param>
+void ModelComponent::DrawMeshes(RenderHints* pRH, Color tint)
+{
+	//the levels of detail share the materials of _Model, so the shader override below applies to them as well
+	int lod = (int)(pRH != nullptr ? pRH->levelOfDetail : levelOfDetail);
+	if (lod > (int)_LodModels.size())
+		lod = (int)_LodModels.size();
+	Model& model = lod > 0 ? _LodModels[lod - 1] : _Model;
+
+	if (pRH != nullptr && pRH->pOverrideShader != nullptr) {
+
+		Shader* pShaders = new Shader[_Model.materialCount];
+		for (int i=0; i < _Model.materialCount; i++) {
+			pShaders[i] = _Model.materials[i].shader;
+			_Model.materials[i].shader = *pRH->pOverrideShader;
+		}
+		DrawModel(model, Vector3Zero(), 1.0f, tint);
+		for (int i=0; i < _Model.materialCount; i++) {
+			_Model.materials[i].shader = pShaders[i];
+		}
+	}
+	else
+		DrawModel(model, Vector3Zero(), 1.0f, tint);
+}
+
+/// <summary>
+/// DrawImpostor - draw the impostor facing the camera of the render pass (the light for shadow maps)
+/// </summary>
+/// <param name="pRH">The RenderHints of the render pass</param>
+/// <param name="tint">Color and alpha of the impostor</param>
+void ModelComponent::DrawImpostor(RenderHints* pRH, Color tint)
+{
+	SceneCamera* pCamera = (pRH != nullptr && pRH->pOverrideCamera != nullptr) ? pRH->pOverrideCamera : _SceneActor->GetMainCamera();
+	if (pCamera == nullptr)
+		return;
+
+	//while fading, the meshes keep the depth so the quad through their center doesn't cut them
+	bool fading = _ImpostorBlend < 1.0f;
+	if (fading)
+		rlDisableDepthMask();
+	if (pRH != nullptr && pRH->pOverrideShader != nullptr)
+		BeginShaderMode(*pRH->pOverrideShader);
+
+	Impostor->Draw(*pCamera->GetCamera3D(), _Model.transform, tint);
+
+	if (pRH != nullptr && pRH->pOverrideShader != nullptr)
+		EndShaderMode();
+	rlDrawRenderBatchActive();
+	if (fading)
+		rlEnableDepthMask();
+}
+
 void ModelComponent::LoadMaterialTextures(int idx,
 	const char* DiffuseMapPath,
 	const char* SpecularMapPath,
@@ -154,39 +218,42 @@ void ModelComponent::LoadMaterialTextures(int idx,
 	const char* EmissionMapPath ,
 	const char* OcclusionMapPath)
 {
+	//textures are shared through the registry, the cooked .knt ones are used together with the baked model
+	auto loadTexture = [this](const char* path) { return ResourceRegistry::Instance().AcquireTexture(path, UseBakedAsset); };
+
 	if (DiffuseMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_DIFFUSE] = LoadTexture(DiffuseMapPath);
+		_Texture2DMaps[MATERIAL_MAP_DIFFUSE] = loadTexture(DiffuseMapPath);
 		_LoadState |= DiffuseMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_DIFFUSE].texture = _Texture2DMaps[MATERIAL_MAP_DIFFUSE];
 	}
 	if (SpecularMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_SPECULAR] = LoadTexture(SpecularMapPath);
+		_Texture2DMaps[MATERIAL_MAP_SPECULAR] = loadTexture(SpecularMapPath);
 		_LoadState |= SpecularMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_SPECULAR].texture = _Texture2DMaps[MATERIAL_MAP_SPECULAR];
 	}
 	if (NormalMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_NORMAL] = LoadTexture(NormalMapPath);
+		_Texture2DMaps[MATERIAL_MAP_NORMAL] = loadTexture(NormalMapPath);
 		_LoadState |= NormalMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_NORMAL].texture = _Texture2DMaps[MATERIAL_MAP_NORMAL];
 	}
 	if (MetalicMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_METALNESS] = LoadTexture(MetalicMapPath);
+		_Texture2DMaps[MATERIAL_MAP_METALNESS] = loadTexture(MetalicMapPath);
 		_LoadState |= MetalicMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_SPECULAR].texture = _Texture2DMaps[MATERIAL_MAP_METALNESS];
 	}
 	if (RoughnessMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_ROUGHNESS] = LoadTexture(RoughnessMapPath);
+		_Texture2DMaps[MATERIAL_MAP_ROUGHNESS] = loadTexture(RoughnessMapPath);
 		_LoadState |= RoughnessMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_SPECULAR].texture = _Texture2DMaps[MATERIAL_MAP_ROUGHNESS];
 	}
 	if (HeightMapPath)
 	{
-		_Texture2DMaps[MATERIAL_MAP_HEIGHT] = LoadTexture(HeightMapPath);
+		_Texture2DMaps[MATERIAL_MAP_HEIGHT] = loadTexture(HeightMapPath);
 		_LoadState |= HeightMap;
 		_Model.materials[idx].maps[MATERIAL_MAP_SPECULAR].texture = _Texture2DMaps[MATERIAL_MAP_HEIGHT];
 	}
@@ -218,6 +285,10 @@ void ModelComponent::LoadFromMesh(Mesh mesh,
 		OcclusionMapPath);
 
 	RecalculateSmoothNormals(_Model);
+	if (OptimizeMeshes)
+		MeshOptimizer::OptimizeModel(_Model);
+	if (GenerateLODs)
+		GenerateLevelsOfDetail();
 }
 
 void ModelComponent::Load3DModel(const char* ModelPath,
@@ -237,10 +308,22 @@ void ModelComponent::Load3DModel(const char* ModelPath,
 		return;
 	}
 
-	_Model = LoadModel(ModelPath);
-	_LoadState |= Loaded_Model;
+	//the file is loaded once per set of load parameters, this component draws a copy with its own materials
+	string modelPath = ModelPath;
+	bool useBaked = UseBakedAsset, keepMeshData = KeepMeshData || GenerateLODs, optimize = OptimizeMeshes;
+	_pSharedModel = ResourceRegistry::Instance().AcquireModel(ModelPath, GetSharedModelParams().c_str(), [&](SharedModel& shared) {
+		return LoadSharedModel(shared, modelPath.c_str(), useBaked, keepMeshData, optimize);
+	});
+	if (_pSharedModel == nullptr)
+	{
+		return;
+	}
 
-	_Animations = LoadModelAnimations(ModelPath, &_AnimationsCount);
+	CreateModelInstance();
+	_LoadState |= Loaded_Model;
+	_Animations = _pSharedModel->pAnimations;
+	_AnimationsCount = _pSharedModel->animationCount;
+	_MeshBoundingBoxes = _pSharedModel->meshBounds;
 	if (_AnimationsCount > 0)
 	{
 		_LoadState |= Loaded_Animations;
@@ -260,11 +343,244 @@ void ModelComponent::Load3DModel(const char* ModelPath,
 		OcclusionMapPath);
 
 	_Color = Color;
-	if (_Model.meshCount > 0)
+	UpdateMeshBoundingBoxes();
+	if (GenerateLODs)
+		GenerateLevelsOfDetail();
+}
+
+/// <summary>
+/// Load3DModelAsync - Like Load3DModel, but the files are read on the worker threads. The component draws
+///    a placeholder until the model and its textures are ready, Update finishes the load in that frame.
+///    Only baked models are read in the background, other files are loaded by raylib during the upload.
+/// </summary>
+void ModelComponent::Load3DModelAsync(const char* ModelPath,
+	const char* DiffuseMapPath,
+	const char* SpecularMapPath,
+	const char* NormalMapPath,
+	const char* MetalicMapPath,
+	const char* RoughnessMapPath,
+	const char* HeightMapPath,
+	const char* CubeMapPath,
+	const char* EmissionMapPath,
+	const char* OcclusionMapPath,
+	Color Color)
+{
+	if (!FileExists(ModelPath))
+	{
+		return;
+	}
+
+	const char* mapPaths[] = { DiffuseMapPath, SpecularMapPath, NormalMapPath, MetalicMapPath, RoughnessMapPath,
+		HeightMapPath, CubeMapPath, EmissionMapPath, OcclusionMapPath };
+	_PendingPaths.assign(1, ModelPath);
+	for (const char* path : mapPaths)
+		_PendingPaths.push_back(path != nullptr ? path : "");
+	_Color = Color;
+
+	//an up to date baked file can be read on a worker, converting it needs raylib's loaders
+	char bakedPath[512] = { 0 };
+	if (IsFileExtension(ModelPath, ".kna"))
+	{
+		TextCopy(bakedPath, ModelPath);
+	}
+	else if (UseBakedAsset)
+	{
+		TextCopy(bakedPath, KnightAsset::GetBakedPath(ModelPath));
+		if (KnightAsset::NeedsConvert(ModelPath, bakedPath))
+			bakedPath[0] = 0;
+	}
+
+	//the loader may run after this component is gone, it only captures values
+	string modelPath = ModelPath;
+	bool useBaked = UseBakedAsset, keepMeshData = KeepMeshData || GenerateLODs, optimize = OptimizeMeshes;
+	_pPendingModel = AsyncAssetLoader::Instance().LoadModelAsync(ModelPath, GetSharedModelParams().c_str(), bakedPath, keepMeshData,
+		[modelPath, useBaked, keepMeshData, optimize](SharedModel& shared) {
+			return LoadSharedModel(shared, modelPath.c_str(), useBaked, keepMeshData, optimize);
+		});
+
+	_PendingTextures.clear();
+	for (const char* path : mapPaths)
+	{
+		if (path != nullptr)
+			_PendingTextures.push_back(AsyncAssetLoader::Instance().LoadTextureAsync(path, UseBakedAsset));
+	}
+
+	//a unit box standing on the origin until the real bounds are known, so the placeholder isn't culled
+	LocalBoundingBox = BoundingBox{ Vector3{ -0.5f, 0.0f, -0.5f }, Vector3{ 0.5f, 1.0f, 0.5f } };
+}
+
+/// <summary>
+/// UpdateAsyncLoad - Finish Load3DModelAsync once the model and all textures are done. The requests keep
+///    everything registered, so Load3DModel only acquires it from the registry.
+/// </summary>
+void ModelComponent::UpdateAsyncLoad()
+{
+	if (_pPendingModel->IsPending())
+		return;
+	for (const auto& pTexture : _PendingTextures)
+	{
+		if (pTexture->IsPending())
+			return;
+	}
+
+	if (_pPendingModel->IsReady())
+	{
+		auto mapPath = [this](int map) { return _PendingPaths[map].empty() ? nullptr : _PendingPaths[map].c_str(); };
+		Load3DModel(_PendingPaths[0].c_str(), mapPath(1), mapPath(2), mapPath(3), mapPath(4), mapPath(5),
+			mapPath(6), mapPath(7), mapPath(8), mapPath(9), _Color);
+	}
+
+	_pPendingModel.reset();
+	_PendingTextures.clear();
+	_PendingPaths.clear();
+
+	//the bounds grew from the placeholder box, the render passes have to queue the meshes again
+	if (_SceneActor)
+		_SceneActor->GetScene()->InvalidateRenderLists();
+}
+
+/// <summary>
+/// GetSharedModelParams - The load settings which change the data of the shared model, part of its registry key.
+/// </summary>
+std::string ModelComponent::GetSharedModelParams() const
+{
+	char params[64];
+	snprintf(params, sizeof(params), "baked=%d meshdata=%d optimize=%d", UseBakedAsset ? 1 : 0, (KeepMeshData || GenerateLODs) ? 1 : 0, OptimizeMeshes ? 1 : 0);
+	return params;
+}
+
+/// <summary>
+/// LoadSharedModel - Fill a new registry entry from a model file. Static, as asynchronous loads call it
+///    after the requesting component may be gone.
+/// </summary>
+bool ModelComponent::LoadSharedModel(SharedModel& shared, const char* ModelPath, bool UseBaked, bool KeepMeshData, bool Optimize)
+{
+	//use the baked .kna file next to the source, (re)converted when it's missing or outdated
+	char bakedPath[512] = { 0 };
+	if (UseBaked && !IsFileExtension(ModelPath, ".kna"))
 	{
-		UpdateMeshBoundingBoxes();
-		RecalculateSmoothNormals(_Model);
+		TextCopy(bakedPath, KnightAsset::GetBakedPath(ModelPath));
+		if (KnightAsset::NeedsConvert(ModelPath, bakedPath) && !KnightAsset::Convert(ModelPath, bakedPath))
+			bakedPath[0] = 0;
 	}
+	else if (IsFileExtension(ModelPath, ".kna"))
+	{
+		TextCopy(bakedPath, ModelPath);
+	}
+
+	//normals and mesh optimization are baked in, the CPU arrays are only needed to build levels of detail
+	bool baked = bakedPath[0] != 0 && KnightAsset::Load(bakedPath, &shared.model, &shared.pAnimations, &shared.animationCount,
+		KeepMeshData, &shared.meshBounds);
+	if (!baked)
+	{
+		shared.model = LoadModel(ModelPath);
+		shared.pAnimations = LoadModelAnimations(ModelPath, &shared.animationCount);
+	}
+	if (shared.model.meshCount == 0)
+		return false;
+
+	if (shared.meshBounds.size() != shared.model.meshCount)
+	{
+		shared.meshBounds.clear();
+		for (int i = 0; i < shared.model.meshCount; i++)
+			shared.meshBounds.push_back(GetMeshBoundingBox(shared.model.meshes[i]));
+	}
+	if (!baked)
+	{
+		RecalculateSmoothNormals(shared.model);
+		if (Optimize)
+			MeshOptimizer::OptimizeModel(shared.model, ModelPath);
+	}
+	return true;
+}
+
+/// <summary>
+/// CreateModelInstance - make _Model a copy of the shared model that can change per component. It gets its
+///    own materials, as textures and shaders are assigned per component. The meshes of skinned models get
+///    their own animated vertex arrays and GPU buffers, since the skinning writes the pose of this component
+///    into them; everything else is used from the shared model.
+/// </summary>
+void ModelComponent::CreateModelInstance()
+{
+	const Model& shared = _pSharedModel->model;
+	_Model = shared;
+
+	_Model.materials = (Material*)RL_CALLOC(shared.materialCount, sizeof(Material));
+	for (int i = 0; i < shared.materialCount; i++)
+	{
+		_Model.materials[i] = shared.materials[i];
+		_Model.materials[i].maps = (MaterialMap*)RL_CALLOC(MAX_MATERIAL_MAPS, sizeof(MaterialMap));
+		if (shared.materials[i].maps != nullptr)
+			memcpy(_Model.materials[i].maps, shared.materials[i].maps, MAX_MATERIAL_MAPS * sizeof(MaterialMap));
+	}
+
+	if (_pSharedModel->animationCount == 0)
+		return;
+
+	_Model.meshes = (Mesh*)RL_MALLOC(shared.meshCount * sizeof(Mesh));
+	memcpy(_Model.meshes, shared.meshes, shared.meshCount * sizeof(Mesh));
+	for (int m = 0; m < _Model.meshCount; m++)
+	{
+		Mesh& mesh = _Model.meshes[m];
+		if (mesh.boneIds == nullptr || mesh.animVertices == nullptr)
+			continue;
+
+		size_t bytes = (size_t)mesh.vertexCount * 3 * sizeof(float);
+		mesh.animVertices = (float*)RL_MALLOC(bytes);
+		memcpy(mesh.animVertices, shared.meshes[m].animVertices, bytes);
+		if (mesh.animNormals != nullptr)
+		{
+			mesh.animNormals = (float*)RL_MALLOC(bytes);
+			memcpy(mesh.animNormals, shared.meshes[m].animNormals, bytes);
+		}
+		//tangents too, so GenMeshTangents on this copy can replace them
+		if (mesh.tangents != nullptr)
+		{
+			mesh.tangents = (float*)RL_MALLOC((size_t)mesh.vertexCount * 4 * sizeof(float));
+			memcpy(mesh.tangents, shared.meshes[m].tangents, (size_t)mesh.vertexCount * 4 * sizeof(float));
+		}
+		mesh.vaoId = 0;
+		mesh.vboId = nullptr;
+		UploadMesh(&mesh, true);
+	}
+}
+
+/// <summary>
+/// ReleaseModelInstance - free what CreateModelInstance (or the user) allocated for this component only
+/// </summary>
+void ModelComponent::ReleaseModelInstance()
+{
+	const Model& shared = _pSharedModel->model;
+	if (_Model.meshes != shared.meshes)
+	{
+		for (int m = 0; m < _Model.meshCount; m++)
+		{
+			Mesh& mesh = _Model.meshes[m];
+			const Mesh& sharedMesh = shared.meshes[m];
+			if (mesh.vaoId != sharedMesh.vaoId)
+			{
+				rlUnloadVertexArray(mesh.vaoId);
+				if (mesh.vboId != nullptr)
+				{
+					for (int i = 0; i < MAX_MESH_VERTEX_BUFFERS; i++)
+						rlUnloadVertexBuffer(mesh.vboId[i]);
+					RL_FREE(mesh.vboId);
+				}
+			}
+			if (mesh.animVertices != sharedMesh.animVertices)
+				RL_FREE(mesh.animVertices);
+			if (mesh.animNormals != sharedMesh.animNormals)
+				RL_FREE(mesh.animNormals);
+			if (mesh.tangents != sharedMesh.tangents)
+				RL_FREE(mesh.tangents);
+		}
+		RL_FREE(_Model.meshes);
+	}
+
+	for (int i = 0; i < _Model.materialCount; i++)
+		RL_FREE(_Model.materials[i].maps);
+	RL_FREE(_Model.materials);
+	_Model = Model{ 0 };
 }
 
 bool ModelComponent::SetAnimation(int AnimationIndex)
@@ -646,4 +962,188 @@ void ModelComponent::UpdateMeshBoundingBoxes()
 	}
 }
 
+/// <summary>
+/// GenerateLevelsOfDetail - build simplified copies of the model with quadric error metric simplification.
+///    Every level simplifies the previous one on a worker per mesh, the allowed error doubles every level.
+///    A level which removes less than MODEL_LOD_MIN_REDUCTION of the triangles is not worth a draw and ends the chain.
+/// </summary>
+/// <param name="NumLevels">Number of simplified levels to generate</param>
+/// <param name="Reduction">Triangle ratio between two levels</param>
+/// <returns>The number of levels of detail including the full detail model</returns>
+/// <remarks>Bone animated models are skipped, their skinning works on the full detail meshes.
+///    The levels of a model loaded from a file are generated by its first user and shared by the others.</remarks>
+int ModelComponent::GenerateLevelsOfDetail(int NumLevels, float Reduction)
+{
+	UnloadLevelsOfDetail();
+	if (!(_LoadState & Loaded_Model) || _Model.meshCount == 0)
+		return 1;
+	if (_Model.boneCount > 0 || (_LoadState & Loaded_Animations))
+	{
+		TraceLog(LOG_WARNING, "MODEL: Levels of detail are not generated for animated models");
+		return 1;
+	}
+
+	if (_pSharedModel != nullptr && _pSharedModel->lodsGenerated)
+	{
+		for (const Model& sharedLod : _pSharedModel->lodModels)
+		{
+			Model lod = sharedLod;
+			lod.materialCount = _Model.materialCount;
+			lod.materials = _Model.materials;
+			_LodModels.push_back(lod);
+		}
+		return GetNumLevelsOfDetail();
+	}
+	if (_pSharedModel != nullptr)
+		_pSharedModel->lodsGenerated = true;	//also when it fails below, the next user would fail the same way
+
+	//the simplification works on indexed meshes
+	for (int m = 0; m < _Model.meshCount; m++)
+	{
+		if (_Model.meshes[m].indices != nullptr)
+			continue;
+		if (!MeshOptimizer::DeduplicateVertices(&_Model.meshes[m]))
+		{
+			TraceLog(LOG_WARNING, "MODEL: Mesh %d has too many vertices to generate levels of detail", m);
+			return 1;
+		}
+		MeshOptimizer::ReuploadMesh(&_Model.meshes[m]);
+	}
+
+	NumLevels = std::min(NumLevels, MODEL_MAX_LODS - 1);
+	const int meshCount = _Model.meshCount;
+	std::vector<Mesh> lodMeshes(NumLevels * meshCount);
+
+	JobSystem::Instance().ParallelFor(meshCount, 1, [&](int begin, int end) {
+		for (int m = begin; m < end; m++)
+		{
+			const Mesh* pSource = &_Model.meshes[m];
+			float maxError = MODEL_LOD_MAX_ERROR;
+			for (int level = 0; level < NumLevels; level++)
+			{
+				Mesh* pLod = &lodMeshes[level * meshCount + m];
+				MeshOptimizer::SimplifyMesh(*pSource, Reduction, maxError, pLod);
+				pSource = pLod;
+				maxError *= 2.0f;
+			}
+		}
+	});
+
+	//GPU upload on the main thread
+	int previousTriangles = 0;
+	for (int m = 0; m < meshCount; m++)
+		previousTriangles += _Model.meshes[m].triangleCount;
+	TraceLog(LOG_INFO, "MODEL: Level of detail 0: %d triangles", previousTriangles);
+
+	for (int level = 0; level < NumLevels; level++)
+	{
+		Mesh* pMeshes = &lodMeshes[level * meshCount];
+		int triangles = 0;
+		for (int m = 0; m < meshCount; m++)
+			triangles += pMeshes[m].triangleCount;
+
+		if (triangles > previousTriangles * (1.0f - MODEL_LOD_MIN_REDUCTION))
+		{
+			for (int i = level * meshCount; i < NumLevels * meshCount; i++)
+				UnloadMesh(lodMeshes[i]);
+			break;
+		}
+
+		Model lod = _Model;
+		lod.meshes = (Mesh*)RL_CALLOC(meshCount, sizeof(Mesh));
+		lod.meshMaterial = (int*)RL_CALLOC(meshCount, sizeof(int));
+		memcpy(lod.meshMaterial, _Model.meshMaterial, meshCount * sizeof(int));
+		lod.boneCount = 0;
+		lod.bones = nullptr;
+		lod.bindPose = nullptr;
+		for (int m = 0; m < meshCount; m++)
+		{
+			lod.meshes[m] = pMeshes[m];
+			UploadMesh(&lod.meshes[m], false);
+		}
+		_LodModels.push_back(lod);
+
+		TraceLog(LOG_INFO, "MODEL: Level of detail %d: %d triangles", level + 1, triangles);
+		previousTriangles = triangles;
+	}
+
+	if (_pSharedModel != nullptr)
+	{
+		_pSharedModel->lodModels = _LodModels;
+		for (Model& lod : _pSharedModel->lodModels)
+			lod.materials = _pSharedModel->model.materials;
+	}
+	return GetNumLevelsOfDetail();
+}
+
+/// <summary>
+/// UpdateLevelOfDetail - select the level of detail from the projected size of the world bounding box
+///    on the main camera. The thresholds are widened by LodHysteresis in the direction of the change,
+///    so an object standing close to a threshold does not switch back and forth.
+///    The impostor blend follows the distance to the camera.
+/// </summary>
+void ModelComponent::UpdateLevelOfDetail()
+{
+	for (Model& lod : _LodModels)
+		lod.transform = _Model.transform;
+
+	bool hasImpostor = Impostor != nullptr && Impostor->IsBaked();
+	_ImpostorBlend = 0.0f;
+	if (_LodModels.empty() && !hasImpostor)
+		return;
+
+	SceneCamera* pCamera = _SceneActor->GetMainCamera();
+	if (pCamera == nullptr || !IsBoundingBoxValid(_SceneActor->WorldBoundingBox))
+		return;
+
+	//projected radius relative to half the screen height
+	BoundingBox box = _SceneActor->WorldBoundingBox;
+	float radius = 0.5f * Vector3Distance(box.min, box.max);
+	Camera3D* pCam3D = pCamera->GetCamera3D();
+	Vector3 center = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+	float distance = Vector3Distance(center, pCam3D->position);
+	float screenSize = 1.0f;
+	if (pCam3D->projection == CAMERA_ORTHOGRAPHIC)
+	{
+		screenSize = radius / (pCam3D->fovy * 0.5f);
+	}
+	else if (distance > radius)
+	{
+		screenSize = radius / (distance * tanf(pCam3D->fovy * 0.5f * DEG2RAD));
+	}
+
+	if (hasImpostor)
+	{
+		float fadeStart = ImpostorDistance - ImpostorFadeRange;
+		_ImpostorBlend = ImpostorFadeRange > 0.0f ? Clamp((distance - fadeStart) / ImpostorFadeRange, 0.0f, 1.0f) : (distance >= ImpostorDistance ? 1.0f : 0.0f);
+	}
+
+	int maxLevel = (int)_LodModels.size();
+	int level = std::min((int)levelOfDetail, maxLevel);
+	while (level < maxLevel && screenSize < LodScreenSizes[level] * (1.0f - LodHysteresis))
+		level++;
+	while (level > 0 && screenSize > LodScreenSizes[level - 1] * (1.0f + LodHysteresis))
+		level--;
+	levelOfDetail = (unsigned)level;
+}
+
+/// <summary>
+/// UnloadLevelsOfDetail - release the simplified meshes, the materials belong to _Model and the meshes
+///    of a shared model to the registry
+/// </summary>
+void ModelComponent::UnloadLevelsOfDetail()
+{
+	for (Model& lod : _LodModels)
+	{
+		if (_pSharedModel != nullptr)
+			break;
+		for (int m = 0; m < lod.meshCount; m++)
+			UnloadMesh(lod.meshes[m]);
+		RL_FREE(lod.meshes);
+		RL_FREE(lod.meshMaterial);
+	}
+	_LodModels.clear();
+	levelOfDetail = 0;
+}
+
 //End of ModelComponent.cpp
\ No newline at end of file
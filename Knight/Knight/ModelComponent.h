@@ -2,12 +2,22 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <memory>
 
 #include "raylib.h"
 
 #include "Component.h"
+#include "ImpostorAtlas.h"
+
+struct SharedModel;
+class AsyncModel;
+class AsyncTexture;
 
 #define LOAD_FLAG_COUNT  (MATERIAL_MAP_BRDF + 1)
+#define MODEL_MAX_LODS	4	//full detail model plus up to three simplified ones
+#define MODEL_LOD_MAX_ERROR	0.01f		//simplification error of the first level relative to the mesh size, doubles every level
+#define MODEL_LOD_MIN_REDUCTION	0.1f	//a level has to remove at least this fraction of the previous level's triangles
 
 class ModelComponent : public Component
 {
@@ -62,6 +72,23 @@ public:
 		const char* OcclusionMapPath = nullptr,
 		Color Color = WHITE);
 
+	/* Funciton: Load3DModelAsync
+	*  Description: Load3DModel with the file I/O and decoding on the worker threads. A placeholder is drawn
+	*		until the model and its textures are uploaded, then Update finishes the load like Load3DModel.
+	*/
+	void Load3DModelAsync(const char* ModelPath,
+		const char* DiffuseMapPath = nullptr,
+		const char* SpecularMapPath = nullptr,
+		const char* NormalMapPath = nullptr,
+		const char* MetalicMapPath = nullptr,
+		const char* RoughnessMapPath = nullptr,
+		const char* HeightMapPath = nullptr,
+		const char* CubeMapPath = nullptr,
+		const char* EmissionMapPath = nullptr,
+		const char* OcclusionMapPath = nullptr,
+		Color Color = WHITE);
+	bool IsLoading() { return _pPendingModel != nullptr; }
+
 	void LoadFromMesh(Mesh mesh, 
 		const char* DiffuseMapPath = nullptr,
 		const char* SpecularMapPath = nullptr,
@@ -112,6 +139,31 @@ public:
 	eAnimTransitionMode GetTransitionMode();
 
 	bool DrawBoundingBox = false;
+	bool OptimizeMeshes = false;	//Reorder the meshes for the vertex cache and overdraw at load time, set before Load3DModel
+	bool GenerateLODs = false;		//Generate simplified levels of detail at load time, set before Load3DModel
+	bool UseBakedAsset = false;		//Load the baked .kna file next to the model, converted on first use, and the cooked .knt textures, set before Load3DModel
+	bool KeepMeshData = true;		//Keep the CPU copy of baked static meshes (tangents, picking), set before Load3DModel
+	bool DrawPlaceholder = true;	//Draw a wire cube while Load3DModelAsync is in progress
+
+	/* Funciton: GenerateLevelsOfDetail
+	*  Description: Build simplified copies of the model, every level keeps about reduction of the triangles of the previous one
+	*  Paramaters:
+	*		NumLevels: number of simplified levels, at most MODEL_MAX_LODS - 1
+	*		Reduction: triangle ratio between two levels
+	*  Return: the number of levels of detail including the full detail model
+	*/
+	int GenerateLevelsOfDetail(int NumLevels = MODEL_MAX_LODS - 1, float Reduction = 0.5f);
+	int GetNumLevelsOfDetail() { return 1 + (int)_LodModels.size(); }
+
+	//Projected height (fraction of the screen height) below which the next coarser level is used
+	float LodScreenSizes[MODEL_MAX_LODS - 1] = { 0.25f, 0.12f, 0.05f };
+	float LodHysteresis = 0.15f;	//relative margin around the thresholds so the level doesn't flicker
+
+	//Impostor closing the chain of levels of detail, owned by the caller so all instances of a model can share it.
+	//The meshes fade out over the impostor in the last ImpostorFadeRange units before ImpostorDistance.
+	ImpostorAtlas* Impostor = nullptr;
+	float ImpostorDistance = 80.0f;
+	float ImpostorFadeRange = 8.0f;
 	BoundingBox GetBoundingBox();
 	ModelAnimation* _Animations = nullptr;
 	int _AnimationsCount;
@@ -137,10 +189,28 @@ protected:
 	Color _Color;
 
 	std::vector<BoundingBox> _MeshBoundingBoxes;
+
+	SharedModel* _pSharedModel = nullptr;	//the loaded file, from the ResourceRegistry; _Model is this component's copy of it
+
+	std::shared_ptr<AsyncModel> _pPendingModel;		//Load3DModelAsync in progress
+	std::vector<std::shared_ptr<AsyncTexture>> _PendingTextures;
+	std::vector<std::string> _PendingPaths;			//the model and the nine map paths, empty for none
+
+	std::vector<Model> _LodModels;		//simplified levels, they share the materials of _Model
+	float _ImpostorBlend = 0.0f;		//0 draws the meshes only, 1 the impostor only
 	
 	int GetNextFrame(float InterpolationTime = 0.0f, int Channel = 0);
 	void UpdateModelAnimationWithInterpolation(float ElapsedSeconds);
 	void InterpolateAnimation(int ChannelCount);
 
 	void UpdateMeshBoundingBoxes();
+	void UpdateLevelOfDetail();
+	void DrawMeshes(RenderHints* pRH, Color tint);
+	void DrawImpostor(RenderHints* pRH, Color tint);
+	void UnloadLevelsOfDetail();
+	void CreateModelInstance();
+	void UpdateAsyncLoad();
+	std::string GetSharedModelParams() const;
+	static bool LoadSharedModel(SharedModel& shared, const char* ModelPath, bool UseBaked, bool KeepMeshData, bool Optimize);
+	void ReleaseModelInstance();
 };
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "ResourceRegistry.h"
+#include "KnightAsset.h"
+
+#include "rlgl.h"
+#include <config.h>
+
+#include <algorithm>
+#include <cctype>
+
+ResourceRegistry::ResourceRegistry()
+{
+}
+
+ResourceRegistry::~ResourceRegistry()
+{
+	//the GPU resources still registered went away with the window, only the CPU side is left
+}
+
+/// <summary>
+/// Instance - Get the engine wide registry.
+/// </summary>
+/// <returns>The shared ResourceRegistry.</returns>
+ResourceRegistry& ResourceRegistry::Instance()
+{
+	static ResourceRegistry registry;
+	return registry;
+}
+
+/// <summary>
+/// NormalizePath - Turn a path into the form used as key, so "../../resources/a/../b.png" and the
+/// same file reached from another relative path share one entry.
+/// </summary>
+/// <param name="path">Absolute or relative to the working directory.</param>
+/// <returns>The normalized path, empty for a null path.</returns>
+string ResourceRegistry::NormalizePath(const char* path)
+{
+	if (path == nullptr || path[0] == 0)
+		return string();
+
+	string full = path;
+	bool isAbsolute = full[0] == '/' || full[0] == '\\' || (full.size() > 1 && full[1] == ':');
+	if (!isAbsolute)
+		full = string(GetWorkingDirectory()) + "/" + full;
+	std::replace(full.begin(), full.end(), '\\', '/');
+
+	//split at the separators and resolve "." and ".." lexically
+	vector<string> parts;
+	size_t start = 0;
+	while (start <= full.size())
+	{
+		size_t end = full.find('/', start);
+		if (end == string::npos)
+			end = full.size();
+		string part = full.substr(start, end - start);
+		if (part == "..")
+		{
+			if (!parts.empty() && !parts.back().empty() && parts.back() != "..")
+				parts.pop_back();
+		}
+		else if (part != "." && (!part.empty() || parts.empty()))
+			parts.push_back(part);
+		start = end + 1;
+	}
+
+	string normalized;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0)
+			normalized += '/';
+		normalized += parts[i];
+	}
+#if defined(_WIN32)
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return (char)tolower(c); });
+#endif
+	return normalized;
+}
+
+/// <summary>
+/// AcquireModel - Get the shared model for a file and a set of load parameters, loading it on the first request.
+/// </summary>
+/// <param name="path">The model file.</param>
+/// <param name="params">Load parameters which change the loaded data, part of the key.</param>
+/// <param name="loader">Fills a new entry, returns false if the model could not be loaded.</param>
+/// <returns>The shared model, nullptr if it could not be loaded.</returns>
+SharedModel* ResourceRegistry::AcquireModel(const char* path, const char* params, const function<bool(SharedModel&)>& loader)
+{
+	string key = GetModelKey(path, params);
+	_NumRequests++;
+
+	auto it = _Models.find(key);
+	if (it != _Models.end())
+	{
+		it->second.refCount++;
+		return it->second.resource;
+	}
+
+	double startTime = GetTime();
+	SharedModel* pModel = new SharedModel();
+	if (!loader(*pModel))
+	{
+		UnloadSharedModel(pModel);
+		return nullptr;
+	}
+	_NumLoads++;
+	_LoadSeconds += GetTime() - startTime;
+
+	_Models[key] = Entry<SharedModel*>{ pModel, 1 };
+	_ModelKeys[pModel] = key;
+	return pModel;
+}
+
+/// <summary>
+/// ReleaseModel - Drop one reference, the last one unloads the model with its animations and levels of detail.
+/// </summary>
+/// <param name="pModel">A model returned by AcquireModel.</param>
+void ResourceRegistry::ReleaseModel(SharedModel* pModel)
+{
+	auto keyIt = _ModelKeys.find(pModel);
+	if (keyIt == _ModelKeys.end())
+	{
+		TraceLog(LOG_WARNING, "REGISTRY: Released a model which is not registered");
+		return;
+	}
+
+	auto it = _Models.find(keyIt->second);
+	if (--it->second.refCount > 0)
+		return;
+
+	UnloadSharedModel(pModel);
+	_Models.erase(it);
+	_ModelKeys.erase(keyIt);
+}
+
+/// <summary>
+/// AcquireTexture - Get the shared texture of an image file, loading it on the first request.
+/// </summary>
+/// <param name="path">The image, or a cooked .knt file.</param>
+/// <param name="useCooked">Load the up to date .knt next to the image instead of decoding it.</param>
+/// <returns>The texture, id 0 if it could not be loaded.</returns>
+Texture2D ResourceRegistry::AcquireTexture(const char* path, bool useCooked)
+{
+	string key = GetTextureKey(path, useCooked);
+	_NumRequests++;
+
+	auto it = _Textures.find(key);
+	if (it != _Textures.end())
+	{
+		it->second.refCount++;
+		return it->second.resource;
+	}
+
+	double startTime = GetTime();
+	Texture2D texture = useCooked ? KnightAsset::LoadTexture(path) : LoadTexture(path);
+	if (texture.id == 0)
+		return texture;
+	_NumLoads++;
+	_LoadSeconds += GetTime() - startTime;
+
+	_Textures[key] = Entry<Texture2D>{ texture, 1 };
+	_TextureKeys[texture.id] = key;
+	return texture;
+}
+
+/// <summary>
+/// ReleaseTexture - Drop one reference, the last one unloads the texture.
+/// </summary>
+/// <param name="texture">A texture returned by AcquireTexture.</param>
+void ResourceRegistry::ReleaseTexture(Texture2D texture)
+{
+	if (texture.id == 0)
+		return;
+
+	auto keyIt = _TextureKeys.find(texture.id);
+	if (keyIt == _TextureKeys.end())
+	{
+		TraceLog(LOG_WARNING, "REGISTRY: [ID %i] Released a texture which is not registered", texture.id);
+		return;
+	}
+
+	auto it = _Textures.find(keyIt->second);
+	if (--it->second.refCount > 0)
+		return;
+
+	UnloadTexture(it->second.resource);
+	_Textures.erase(it);
+	_TextureKeys.erase(keyIt);
+}
+
+/// <summary>
+/// AcquireShader - Get the shared shader program of a vertex and fragment shader pair, loading it on the first request.
+/// The users share the program and its uniform values, so uniforms set once at creation must agree between them.
+/// </summary>
+/// <param name="vsPath">Vertex shader file, null for raylib's default.</param>
+/// <param name="fsPath">Fragment shader file, null for raylib's default.</param>
+/// <returns>The shader, id 0 if it could not be loaded.</returns>
+Shader ResourceRegistry::AcquireShader(const char* vsPath, const char* fsPath)
+{
+	string key = GetShaderKey(vsPath, fsPath);
+	_NumRequests++;
+
+	auto it = _Shaders.find(key);
+	if (it != _Shaders.end())
+	{
+		it->second.refCount++;
+		return it->second.resource;
+	}
+
+	double startTime = GetTime();
+	Shader shader = LoadShader(vsPath, fsPath);
+	if (shader.id == 0 || shader.id == rlGetShaderIdDefault())
+		return shader;
+	_NumLoads++;
+	_LoadSeconds += GetTime() - startTime;
+
+	_Shaders[key] = Entry<Shader>{ shader, 1 };
+	_ShaderKeys[shader.id] = key;
+	return shader;
+}
+
+/// <summary>
+/// ReleaseShader - Drop one reference, the last one unloads the shader.
+/// </summary>
+/// <param name="shader">A shader returned by AcquireShader.</param>
+void ResourceRegistry::ReleaseShader(Shader shader)
+{
+	if (shader.id == 0 || shader.id == rlGetShaderIdDefault())
+		return;
+
+	auto keyIt = _ShaderKeys.find(shader.id);
+	if (keyIt == _ShaderKeys.end())
+	{
+		TraceLog(LOG_WARNING, "REGISTRY: [ID %i] Released a shader which is not registered", shader.id);
+		return;
+	}
+
+	auto it = _Shaders.find(keyIt->second);
+	if (--it->second.refCount > 0)
+		return;
+
+	UnloadShader(it->second.resource);
+	_Shaders.erase(it);
+	_ShaderKeys.erase(keyIt);
+}
+
+/// <summary>
+/// IsModelLoaded - Check if AcquireModel would share an already loaded model.
+/// </summary>
+/// <param name="path">The model file.</param>
+/// <param name="params">The same as for AcquireModel.</param>
+/// <returns>true if the model is registered.</returns>
+bool ResourceRegistry::IsModelLoaded(const char* path, const char* params) const
+{
+	return _Models.find(GetModelKey(path, params)) != _Models.end();
+}
+
+/// <summary>
+/// IsTextureLoaded - Check if AcquireTexture would share an already loaded texture.
+/// </summary>
+/// <param name="path">The image, or a cooked .knt file.</param>
+/// <param name="useCooked">The same as for AcquireTexture.</param>
+/// <returns>true if the texture is registered.</returns>
+bool ResourceRegistry::IsTextureLoaded(const char* path, bool useCooked) const
+{
+	return _Textures.find(GetTextureKey(path, useCooked)) != _Textures.end();
+}
+
+/// <summary>
+/// AddTexture - Register a texture loaded outside the registry, with one reference.
+/// </summary>
+/// <param name="path">The file it was loaded from.</param>
+/// <param name="useCooked">The same as for AcquireTexture.</param>
+/// <param name="texture">The texture, it belongs to the registry afterwards.</param>
+/// <returns>The registered texture, which is not the given one if the file was loaded meanwhile.</returns>
+Texture2D ResourceRegistry::AddTexture(const char* path, bool useCooked, Texture2D texture)
+{
+	if (texture.id == 0)
+		return texture;
+
+	string key = GetTextureKey(path, useCooked);
+	_NumRequests++;
+
+	auto it = _Textures.find(key);
+	if (it != _Textures.end())
+	{
+		UnloadTexture(texture);
+		it->second.refCount++;
+		return it->second.resource;
+	}
+
+	_NumLoads++;
+	_Textures[key] = Entry<Texture2D>{ texture, 1 };
+	_TextureKeys[texture.id] = key;
+	return texture;
+}
+
+/// <summary>
+/// IsShaderLoaded - Check if AcquireShader would share an already loaded shader.
+/// </summary>
+/// <param name="vsPath">Vertex shader file, may be null.</param>
+/// <param name="fsPath">Fragment shader file, may be null.</param>
+/// <returns>true if the shader is registered.</returns>
+bool ResourceRegistry::IsShaderLoaded(const char* vsPath, const char* fsPath) const
+{
+	return _Shaders.find(GetShaderKey(vsPath, fsPath)) != _Shaders.end();
+}
+
+/// <summary>
+/// AddShader - Register a shader loaded outside the registry, with one reference.
+/// </summary>
+/// <param name="vsPath">Vertex shader file, may be null.</param>
+/// <param name="fsPath">Fragment shader file, may be null.</param>
+/// <param name="shader">The shader, it belongs to the registry afterwards.</param>
+/// <returns>The registered shader, which is not the given one if the files were loaded meanwhile.</returns>
+Shader ResourceRegistry::AddShader(const char* vsPath, const char* fsPath, Shader shader)
+{
+	if (shader.id == 0 || shader.id == rlGetShaderIdDefault())
+		return shader;
+
+	string key = GetShaderKey(vsPath, fsPath);
+	_NumRequests++;
+
+	auto it = _Shaders.find(key);
+	if (it != _Shaders.end())
+	{
+		UnloadShader(shader);
+		it->second.refCount++;
+		return it->second.resource;
+	}
+
+	_NumLoads++;
+	_Shaders[key] = Entry<Shader>{ shader, 1 };
+	_ShaderKeys[shader.id] = key;
+	return shader;
+}
+
+/// <summary>
+/// LogStats - Log the resident resources, their approximate memory and the loads saved by sharing.
+/// </summary>
+void ResourceRegistry::LogStats() const
+{
+	size_t textureBytes = 0;
+	for (const auto& it : _Textures)
+	{
+		const Texture2D& texture = it.second.resource;
+		size_t bytes = (size_t)GetPixelDataSize(texture.width, texture.height, texture.format);
+		textureBytes += texture.mipmaps > 1 ? bytes * 4 / 3 : bytes;
+	}
+
+	size_t vertexCount = 0;
+	int references = 0;
+	for (const auto& it : _Models)
+	{
+		references += it.second.refCount;
+		for (int m = 0; m < it.second.resource->model.meshCount; m++)
+			vertexCount += it.second.resource->model.meshes[m].vertexCount;
+	}
+
+	TraceLog(LOG_INFO, "REGISTRY: %d models (%d users, %d vertices), %d textures (%.1f MB), %d shaders",
+		(int)_Models.size(), references, (int)vertexCount, (int)_Textures.size(), textureBytes / (1024.0 * 1024.0), (int)_Shaders.size());
+	TraceLog(LOG_INFO, "REGISTRY: %d requests served by %d loads taking %.1f ms", _NumRequests, _NumLoads, _LoadSeconds * 1000.0);
+}
+
+string ResourceRegistry::GetModelKey(const char* path, const char* params)
+{
+	return NormalizePath(path) + "|" + (params != nullptr ? params : "");
+}
+
+string ResourceRegistry::GetTextureKey(const char* path, bool useCooked)
+{
+	return NormalizePath(path) + (useCooked ? "|cooked" : "");
+}
+
+string ResourceRegistry::GetShaderKey(const char* vsPath, const char* fsPath)
+{
+	return NormalizePath(vsPath) + "|" + NormalizePath(fsPath);
+}
+
+void ResourceRegistry::UnloadSharedModel(SharedModel* pModel)
+{
+	for (Model& lod : pModel->lodModels)
+	{
+		for (int m = 0; m < lod.meshCount; m++)
+			UnloadMesh(lod.meshes[m]);
+		RL_FREE(lod.meshes);
+		RL_FREE(lod.meshMaterial);
+	}
+
+	if (pModel->pAnimations != nullptr)
+		UnloadModelAnimations(pModel->pAnimations, pModel->animationCount);
+
+	//UnloadModel leaves the textures alone, the ones the model file brought are owned by the entry
+	vector<unsigned int> textureIds;
+	for (int i = 0; i < pModel->model.materialCount; i++)
+	{
+		if (pModel->model.materials[i].maps == nullptr)
+			continue;
+		for (int j = 0; j < MAX_MATERIAL_MAPS; j++)
+		{
+			Texture2D texture = pModel->model.materials[i].maps[j].texture;
+			if (texture.id > 0 && texture.id != rlGetTextureIdDefault()
+				&& std::find(textureIds.begin(), textureIds.end(), texture.id) == textureIds.end())
+			{
+				textureIds.push_back(texture.id);
+				UnloadTexture(texture);
+			}
+		}
+	}
+
+	if (pModel->model.meshes != nullptr || pModel->model.materials != nullptr)
+		UnloadModel(pModel->model);
+	delete pModel;
+}
+
+//End of ResourceRegistry.cpp
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+#include "raylib.h"
+
+using namespace std;
+
+// A model loaded once for every ModelComponent using the same file and load parameters. The meshes,
+// skeleton, animations and simplified levels of detail belong to the registry, the components draw
+// shallow copies with their own materials and transform.
+struct SharedModel
+{
+	Model model = { 0 };
+	ModelAnimation* pAnimations = nullptr;
+	int animationCount = 0;
+	vector<BoundingBox> meshBounds;		//model space bounds of every mesh
+	vector<Model> lodModels;			//simplified levels, their materials are replaced by the users
+	bool lodsGenerated = false;
+};
+
+// Reference counted cache of the GPU resources loaded from files, keyed by the normalized path and
+// the load parameters. Every Acquire has to be paired with a Release of the same resource, the last
+// Release unloads it. Main thread only, like every raylib load.
+class ResourceRegistry
+{
+public:
+	ResourceRegistry();
+	~ResourceRegistry();
+
+	static ResourceRegistry& Instance();
+
+	// The loader is called to fill a new entry when the key is not registered yet,
+	// it returns false if the file could not be loaded and nothing is registered then
+	SharedModel* AcquireModel(const char* path, const char* params, const function<bool(SharedModel&)>& loader);
+	void ReleaseModel(SharedModel* pModel);
+
+	// useCooked loads the .knt next to the image when it is up to date
+	Texture2D AcquireTexture(const char* path, bool useCooked = false);
+	void ReleaseTexture(Texture2D texture);
+
+	// Either path may be null like with LoadShader
+	Shader AcquireShader(const char* vsPath, const char* fsPath);
+	void ReleaseShader(Shader shader);
+
+	bool IsModelLoaded(const char* path, const char* params) const;
+
+	// Resources loaded elsewhere (the AsyncAssetLoader) are registered with one reference. If the same
+	// file was loaded meanwhile, the given one is unloaded and the registered one is returned instead.
+	bool IsTextureLoaded(const char* path, bool useCooked = false) const;
+	Texture2D AddTexture(const char* path, bool useCooked, Texture2D texture);
+	bool IsShaderLoaded(const char* vsPath, const char* fsPath) const;
+	Shader AddShader(const char* vsPath, const char* fsPath, Shader shader);
+
+	// Absolute, '/' separated path without "." and ".." parts, lower case on Windows
+	static string NormalizePath(const char* path);
+
+	// Log the resident resources and how many loads the sharing saved
+	void LogStats() const;
+
+protected:
+	template<typename T>
+	struct Entry
+	{
+		T resource;
+		int refCount;
+	};
+
+	unordered_map<string, Entry<SharedModel*>> _Models;
+	unordered_map<string, Entry<Texture2D>> _Textures;
+	unordered_map<string, Entry<Shader>> _Shaders;
+
+	//handles back to their keys, Release takes the handle
+	unordered_map<const SharedModel*, string> _ModelKeys;
+	unordered_map<unsigned int, string> _TextureKeys;
+	unordered_map<unsigned int, string> _ShaderKeys;
+
+	int _NumRequests = 0;
+	int _NumLoads = 0;
+	double _LoadSeconds = 0.0;
+
+	static string GetModelKey(const char* path, const char* params);
+	static string GetTextureKey(const char* path, bool useCooked);
+	static string GetShaderKey(const char* vsPath, const char* fsPath);
+	static void UnloadSharedModel(SharedModel* pModel);
+};
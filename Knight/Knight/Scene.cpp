@@ -126,6 +126,9 @@ void Scene::DestroySceneObjectByName(const char* Name, bool CaseSensitive)
 
 void Scene::Update(float ElapsedSeconds)
 {
+	_FrameNumber++;
+	_MovedActors.clear();
+
 	if (SceneRoot)
 	{
 		SceneRoot->Update(ElapsedSeconds);
@@ -149,12 +152,29 @@ SceneCamera* Scene::GetMainCameraActor()
 	return _MainCamera;
 }
 
+/// <summary>
+/// ClearRenderQueue - park the active pass's render queue and start an empty one.
+/// </summary>
 void Scene::ClearRenderQueue()
 {
-	_RenderQueue.Background.clear();
-	_RenderQueue.Geometry.clear();
-	_RenderQueue.AlphaBlending.clear();
-	_RenderQueue.Overlay.clear();
+	ActivateRenderQueue(nullptr);
+	_RenderQueue.Clear();
+}
+
+/// <summary>
+/// ActivateRenderQueue - swap the render queue kept for pPass in as _RenderQueue, the queue of the
+/// previous pass is parked. Swapping only moves the containers, nothing is copied.
+/// </summary>
+/// <param name="pPass">The pass about to build or update its queue, nullptr for a scratch queue</param>
+void Scene::ActivateRenderQueue(SceneRenderPass* pPass)
+{
+	if (_RenderQueueOwner == pPass)
+		return;
+
+	//the slot of the active pass holds a spare queue while its own queue is in use
+	std::swap(_RenderQueue, _ParkedRenderQueues[_RenderQueueOwner]);
+	std::swap(_RenderQueue, _ParkedRenderQueues[pPass]);
+	_RenderQueueOwner = pPass;
 }
 
 int Scene::EnabledLights()
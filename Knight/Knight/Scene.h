@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <list>
+#include <unordered_map>
 
 #include "SceneObject.h"
 #include "RenderQueues.h"
@@ -9,6 +10,7 @@
 #define NUM_MAX_LIGHTS  4
 
 class SceneCamera;
+class SceneActor;
 class SceneRenderPass;
 
 typedef struct {
@@ -21,6 +23,14 @@ typedef struct {
 	bool dirty;
 } LightData;
 
+// Point light without shadow for the clustered lighting, there is no limit on their number
+typedef struct {
+	Vector3 position;
+	float radius;		// the light fades out to nothing here
+	Color color;
+	float intensity;
+} PointLightData;
+
 class Scene
 {
 public:
@@ -69,6 +79,19 @@ public:
 
 	void ClearRenderQueue();
 
+	// Render passes keep their queue between frames, the active pass's queue is _RenderQueue and
+	// the others are parked until the pass renders again
+	void ActivateRenderQueue(SceneRenderPass* pPass);
+
+	// Bumped when objects or components are added, removed, activated or deactivated, the passes
+	// collect their render lists again. Call it after changing a component's renderQueue or castShadow.
+	void InvalidateRenderLists() { _RenderListVersion++; }
+	unsigned int GetRenderListVersion() const { return _RenderListVersion; }
+
+	// Counts the Update calls, the actors moved during the last one are re-sorted by the passes
+	unsigned int GetFrameNumber() const { return _FrameNumber; }
+	const vector<SceneActor*>& GetMovedActors() const { return _MovedActors; }
+
 	SceneRenderPass* _CurrentRenderPass;
 
 	LightData Lights[NUM_MAX_LIGHTS] = { 0 };
@@ -76,11 +99,22 @@ public:
 	float SpecularColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f }; //default specular color
 	float DefaultShineness = 16.0f;
 
+	// Any number of point lights, shaded by render passes with clustered lighting like the ForwardRenderPass
+	vector<PointLightData> PointLights;
+
 	int EnabledLights(); // Number of enabled lights in the scene
 
 protected:
 	friend class SceneCamera;
 	friend class SceneObject;
+	friend class SceneActor;
 	SceneCamera* _MainCamera;	
 
+	unsigned int _RenderListVersion = 1;
+	unsigned int _FrameNumber = 0;
+	vector<SceneActor*> _MovedActors;
+
+	SceneRenderPass* _RenderQueueOwner = nullptr;
+	unordered_map<SceneRenderPass*, RenderQueues> _ParkedRenderQueues;
+
 };
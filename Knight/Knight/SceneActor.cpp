@@ -32,6 +32,9 @@ bool SceneActor::Update(float ElapsedSeconds)
 	{
 		return false;
 	}
+
+	Vector3 lastPosition = GetWorldPosition();
+	BoundingBox lastBoundingBox = WorldBoundingBox;
 	
 	_MatTranslation = MatrixTranslate(Position.x, Position.y, Position.z);
 	_MatRotation = MatrixRotateXYZ(Vector3{ DEG2RAD * Rotation.x, DEG2RAD * Rotation.y, DEG2RAD * Rotation.z });
@@ -57,6 +60,14 @@ bool SceneActor::Update(float ElapsedSeconds)
 
 	UpdateCachedWorldBoundingBox();
 
+	//let the render passes re-sort this actor, its distance and visibility may have changed
+	Vector3 position = GetWorldPosition();
+	if (memcmp(&lastPosition, &position, sizeof(Vector3)) != 0 ||
+		memcmp(&lastBoundingBox, &WorldBoundingBox, sizeof(BoundingBox)) != 0)
+	{
+		_Scene->_MovedActors.push_back(this);
+	}
+
 	return true;
 }
 
@@ -6,6 +6,7 @@ SceneObject::SceneObject(Scene* Scene, const char* Name)
 	, IsActive(true)
 	, _Scene(Scene)
 	, Parent(nullptr)
+	, _WasActive(true)
 {
 	if (Name)
 	{
@@ -39,6 +40,8 @@ SceneObject::~SceneObject()
 			_Children[i] = nullptr;
 		}
 	}
+
+	_Scene->InvalidateRenderLists();
 }
 
 void SceneObject::SetName(const char* Name)
@@ -70,6 +73,21 @@ void SceneObject::SetParent(SceneObject* parent)
 	//add into parent's children
 	parent->_Children.push_back(this);
 	Parent = parent;
+	_Scene->InvalidateRenderLists();
+}
+
+/// <summary>
+/// SetActive - activate or deactivate the SceneObject, its components and children
+/// </summary>
+/// <param name="active">false to stop updating and rendering it</param>
+void SceneObject::SetActive(bool active)
+{
+	IsActive = active;
+	if (_WasActive != active)
+	{
+		_WasActive = active;
+		_Scene->InvalidateRenderLists();
+	}
 }
 
 Component* SceneObject::GetComponent(Component::eComponentType ComponentType)
@@ -96,6 +114,7 @@ bool SceneObject::AddComponent(Component* Component)
 	}
 	Component->_SceneObject = this;
 	_Components[Component->Type] = Component;
+	_Scene->InvalidateRenderLists();
 	return true;
 }
 
@@ -106,6 +125,7 @@ Component* SceneObject::RemoveComponent(Component::eComponentType ComponentType,
 	if (component)
 	{
 		_Components.erase(ComponentType);
+		_Scene->InvalidateRenderLists();
 		if (destroy)
 		{
 			delete component;
@@ -124,6 +144,13 @@ Component* SceneObject::RemoveComponent(Component::eComponentType ComponentType,
 /// <remarks>if the SceneObject is not active, its components and children will not be updated</remarks>
 bool SceneObject::Update(float ElapsedSeconds)
 {
+	//catch IsActive written directly instead of through SetActive
+	if (_WasActive != IsActive)
+	{
+		_WasActive = IsActive;
+		_Scene->InvalidateRenderLists();
+	}
+
 	if (IsActive)
 	{
 		map<Component::eComponentType, Component*>::iterator it = _Components.begin();
@@ -18,8 +18,12 @@ public:
 	int ID;
 	void SetName(const char* Name);
 	const char* GetName() const;
+	Scene* GetScene() const { return _Scene; }
 	void SetParent(SceneObject* parent);
 	bool IsActive;
+	// Activates or deactivates the object and tells the render passes right away, a plain write to
+	// IsActive is only noticed at the object's next Update
+	void SetActive(bool active);
 
 	template<class T>
 	T* GetComponent()
@@ -72,6 +76,8 @@ protected:
 	char _Name[MAX_SCENE_OBJECT_NAME];
 	map<Component::eComponentType, Component*> _Components;
 
+	bool _WasActive;	//IsActive as the render passes know it
+
 	friend class SceneRenderPass;
 	friend class ShadowMapRenderPass;
 };
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "raylib.h"
 #include "rlgl.h"
 
+#include <algorithm>
+
 #include "Knight.h"
 #include "SceneRenderPass.h"
 
@@ -26,7 +28,7 @@ void SceneRenderPass::Render()
 	vector<RenderContext>::iterator bk = pScene->_RenderQueue.Background.begin();
 	while (bk != pScene->_RenderQueue.Background.end())
 	{
-		bk->pComponent->Draw(&Hints);
+		DrawComponent(bk->pComponent);
 		++bk;
 	}
 
@@ -34,7 +36,7 @@ void SceneRenderPass::Render()
 	multiset<RenderContext, CompareDistanceAscending>::iterator opaque = pScene->_RenderQueue.Geometry.begin();
 	while (opaque != pScene->_RenderQueue.Geometry.end())
 	{
-		opaque->pComponent->Draw(&Hints);
+		DrawComponent(opaque->pComponent);
 		++opaque;
 	}
 
@@ -44,7 +46,7 @@ void SceneRenderPass::Render()
 	while (alpha != pScene->_RenderQueue.AlphaBlending.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		alpha->pComponent->Draw(&Hints);
+		DrawComponent(alpha->pComponent);
 		EndBlendMode();
 		++alpha;
 	}
@@ -56,7 +58,7 @@ void SceneRenderPass::Render()
 	while (overlay != pScene->_RenderQueue.Overlay.end())
 	{
 		BeginBlendMode(alpha->pComponent->blendingMode);
-		overlay->pComponent->Draw(&Hints);
+		DrawComponent(overlay->pComponent);
 		EndBlendMode();
 		++overlay;
 	}
@@ -64,6 +66,16 @@ void SceneRenderPass::Render()
 	rlEnableDepthMask();
 }
 
+/// <summary>
+/// DrawComponent - Draw a Component with the level of detail it selected, biased by this pass.
+/// </summary>
+/// <param name="pSC">Pointer to Component object</param>
+void SceneRenderPass::DrawComponent(Component* pSC)
+{
+	Hints.levelOfDetail = pSC->levelOfDetail + LevelOfDetailBias;
+	pSC->Draw(&Hints);
+}
+
 /// <summary>
 /// OnAddToRender - this method is called by the SceneRenderPass to add a Component to the render queue.
 /// </summary>
@@ -93,6 +105,18 @@ bool SceneRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 		}
 	}
 
+	AddToRenderQueue(pSC, dist2);
+
+	return true;
+}
+
+/// <summary>
+/// AddToRenderQueue - insert a Component into the render queue it asks for, sorted by dist2.
+/// </summary>
+/// <param name="pSC">Pointer to Component object</param>
+/// <param name="dist2">The sort key, usually the square distance to the active camera</param>
+void SceneRenderPass::AddToRenderQueue(Component* pSC, float dist2)
+{
 	switch (pSC->renderQueue)
 	{
 		case Component::eRenderQueueType::Background:
@@ -109,7 +133,13 @@ bool SceneRenderPass::OnAddToRender(Component* pSC, SceneObject* pSO)
 			break;
 	}
 
-	return true;
+	//remember where it went, so UpdateRenderQueue can take it out again when its actor moves
+	if (_pQueueingEntry != nullptr && _pQueueingEntry->pComponent == pSC)
+	{
+		_pQueueingEntry->queue = pSC->renderQueue;
+		_pQueueingEntry->distance2 = dist2;
+		_pQueueingEntry->queued = true;
+	}
 }
 
 /// <summary>
@@ -147,9 +177,8 @@ void SceneRenderPass::BuildRenderQueue(SceneObject* pRoot)
 	{
 		while (it != pRoot->_Components.end())
 		{
-			if (it->second == nullptr)
-				continue;
-			OnAddToRender(it->second, pRoot);
+			if (it->second != nullptr)
+				OnAddToRender(it->second, pRoot);
 			++it;
 		}
 	}
@@ -159,6 +188,218 @@ void SceneRenderPass::BuildRenderQueue(SceneObject* pRoot)
 
 }
 
+/// <summary>
+/// UpdateRenderQueue - bring the persistent render queue of this pass up to date and make it the scene's queue.
+/// The scene graph is only walked when the scene's render lists were invalidated, a changed view re-queues the
+/// collected Components, otherwise only the actors moved since the last frame are culled and sorted again.
+/// </summary>
+void SceneRenderPass::UpdateRenderQueue()
+{
+	pScene->ActivateRenderQueue(this);
+
+	if (!IncrementalRenderQueue)
+	{
+		_RenderListVersion = 0;
+		pScene->_RenderQueue.Clear();
+		BuildRenderQueue(pScene->SceneRoot);
+		return;
+	}
+
+	unsigned int frame = pScene->GetFrameNumber();
+	if (_RenderListVersion != pScene->GetRenderListVersion())
+	{
+		_RenderList.clear();
+		_ActorEntries.clear();
+		CollectRenderList(pScene->SceneRoot);
+		_RenderListVersion = pScene->GetRenderListVersion();
+		QueueRenderList();
+	}
+	else
+	{
+		RenderView view;
+		GetRenderView(view);
+		bool missedMoves = _RenderQueueFrame != frame && _RenderQueueFrame + 1 != frame;
+		if (_Untracked || _RequeuePending || missedMoves || memcmp(&view, &_RenderView, sizeof(RenderView)) != 0)
+			QueueRenderList();
+		else if (_RenderQueueFrame != frame)
+			UpdateMovedActors();
+	}
+	_RenderQueueFrame = frame;
+	NumComponentsSkipped += _NumCulled;
+}
+
+/// <summary>
+/// CollectRenderList - recursively gather the Components of the active SceneObjects, without culling them.
+/// </summary>
+/// <param name="pRoot">The current SceneObject</param>
+void SceneRenderPass::CollectRenderList(SceneObject* pRoot)
+{
+	if (pRoot == nullptr || pRoot->IsActive == false)
+		return;
+
+	SceneActor* pActor = dynamic_cast<SceneActor*>(pRoot);
+	if (pActor != nullptr && !pRoot->_Components.empty())
+		_ActorEntries[pActor] = _RenderList.size();
+
+	map<Component::eComponentType, Component*>::iterator it = pRoot->_Components.begin();
+	while (it != pRoot->_Components.end())
+	{
+		if (it->second != nullptr)
+		{
+			RenderListEntry entry;
+			entry.pComponent = it->second;
+			entry.pObject = pRoot;
+			entry.pActor = pActor;
+			_RenderList.push_back(entry);
+		}
+		++it;
+	}
+
+	for (int i = 0; i < pRoot->_Children.size(); i++)
+		CollectRenderList(pRoot->_Children[i]);
+}
+
+/// <summary>
+/// QueueRenderList - cull and queue every collected Component for the current view.
+/// </summary>
+void SceneRenderPass::QueueRenderList()
+{
+	pScene->_RenderQueue.Clear();
+	GetRenderView(_RenderView);
+	if (pActiveCamera != nullptr)
+		pActiveCamera->ExtractFrustumPlanes(_FrustumPlanes);
+
+	_NumCulled = 0;
+	_Untracked = false;
+	_RequeuePending = false;
+	for (RenderListEntry& entry : _RenderList)
+		QueueEntry(entry);
+}
+
+/// <summary>
+/// QueueEntry - frustum cull the entry's actor and hand the Component to OnAddToRender.
+/// </summary>
+/// <param name="entry">A Component of the render list, not in the queue</param>
+void SceneRenderPass::QueueEntry(RenderListEntry& entry)
+{
+	entry.queued = false;
+	entry.culled = false;
+
+	//actors with a flat bounding box are never culled, as in BuildRenderQueue
+	SceneActor* pActor = entry.pActor;
+	if (pActiveCamera != nullptr && pActor != nullptr && pActor->WorldBoundingBox.min.z != pActor->WorldBoundingBox.max.z)
+	{
+		if (pActiveCamera->IsBoundingBoxInFrustum(pActor->WorldBoundingBox, _FrustumPlanes) == false)
+		{
+			entry.culled = true;
+			++_NumCulled;
+			return;
+		}
+	}
+
+	size_t numQueued = GetNumQueued();
+	_pQueueingEntry = &entry;
+	OnAddToRender(entry.pComponent, entry.pObject);
+	_pQueueingEntry = nullptr;
+
+	//an override which inserts by itself can't be updated incrementally, the pass re-queues every frame
+	if (!entry.queued && GetNumQueued() != numQueued)
+		_Untracked = true;
+}
+
+template<class T>
+static void EraseRenderContext(T& queue, Component* pSC, float dist2)
+{
+	auto range = queue.equal_range(RenderContext{ nullptr, dist2 });
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->pComponent == pSC)
+		{
+			queue.erase(it);
+			return;
+		}
+	}
+}
+
+static void EraseRenderContext(vector<RenderContext>& queue, Component* pSC)
+{
+	auto it = std::find_if(queue.begin(), queue.end(), [pSC](const RenderContext& rc) { return rc.pComponent == pSC; });
+	if (it != queue.end())
+		queue.erase(it);
+}
+
+/// <summary>
+/// RemoveFromRenderQueue - take a queued Component out, looked up by the sort key it was queued with.
+/// </summary>
+/// <param name="entry">The render list entry of the Component</param>
+void SceneRenderPass::RemoveFromRenderQueue(const RenderListEntry& entry)
+{
+	if (!entry.queued)
+		return;
+
+	switch (entry.queue)
+	{
+		case Component::eRenderQueueType::Background:
+			EraseRenderContext(pScene->_RenderQueue.Background, entry.pComponent);
+			break;
+		case Component::eRenderQueueType::Geometry:
+			EraseRenderContext(pScene->_RenderQueue.Geometry, entry.pComponent, entry.distance2);
+			break;
+		case Component::eRenderQueueType::AlphaBlend:
+			EraseRenderContext(pScene->_RenderQueue.AlphaBlending, entry.pComponent, entry.distance2);
+			break;
+		case Component::eRenderQueueType::Overlay:
+			EraseRenderContext(pScene->_RenderQueue.Overlay, entry.pComponent);
+			break;
+	}
+}
+
+/// <summary>
+/// UpdateMovedActors - re-cull and re-sort the Components of the actors the scene moved in its last Update.
+/// </summary>
+void SceneRenderPass::UpdateMovedActors()
+{
+	const vector<SceneActor*>& movedActors = pScene->GetMovedActors();
+	for (SceneActor* pActor : movedActors)
+	{
+		unordered_map<SceneActor*, size_t>::iterator it = _ActorEntries.find(pActor);
+		if (it == _ActorEntries.end())
+			continue;
+
+		for (size_t i = it->second; i < _RenderList.size() && _RenderList[i].pActor == pActor; i++)
+		{
+			RenderListEntry& entry = _RenderList[i];
+			if (entry.culled)
+				--_NumCulled;
+			RemoveFromRenderQueue(entry);
+			QueueEntry(entry);
+		}
+	}
+}
+
+/// <summary>
+/// GetRenderView - the cameras and projection the queue depends on, the main camera is included because
+/// some passes filter by the distance to it.
+/// </summary>
+/// <param name="view">Receives the view, zero filled so it can be compared with memcmp</param>
+void SceneRenderPass::GetRenderView(RenderView& view)
+{
+	memset(&view, 0, sizeof(RenderView));
+	view.pCamera = pActiveCamera;
+	if (pActiveCamera != nullptr)
+		view.camera = *pActiveCamera->GetCamera3D();
+	SceneCamera* pMainCamera = pScene->GetMainCameraActor();
+	if (pMainCamera != nullptr)
+		view.mainCamera = *pMainCamera->GetCamera3D();
+	view.projection = rlGetMatrixProjection();
+}
+
+size_t SceneRenderPass::GetNumQueued() const
+{
+	const RenderQueues& queue = pScene->_RenderQueue;
+	return queue.Background.size() + queue.Geometry.size() + queue.AlphaBlending.size() + queue.Overlay.size();
+}
+
 /// <summary>
 /// InitLightUniforms - initialize the shader uniform locations for the lights in the scene.
 /// </summary>
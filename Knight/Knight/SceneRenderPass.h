@@ -2,8 +2,10 @@
 
 #include <set>
 #include <vector>
+#include <unordered_map>
 
 #include "Scene.h"
+#include "SceneCamera.h"
 
 typedef struct 
 {
@@ -29,8 +31,24 @@ class SceneRenderPass
 		virtual void BuildRenderQueue(SceneObject *pR);
 		virtual bool OnAddToRender(Component* pSC, SceneObject* pSO);
 
+		// Replaces ClearRenderQueue + BuildRenderQueue in BeginScene: the pass keeps its queue between frames,
+		// walks the scene graph only when objects or components were added, removed, activated or deactivated,
+		// re-queues its components when the view changed and otherwise only re-sorts the actors that moved
+		void UpdateRenderQueue();
+		// Collect the render list again at the next UpdateRenderQueue
+		void InvalidateRenderQueue() { _RenderListVersion = 0; }
+		// Cull and sort the collected render list again at the next UpdateRenderQueue, for passes whose
+		// OnAddToRender changed its mind without the view changing
+		void RequeueRenderList() { _RequeuePending = true; }
+
+		// false rebuilds the queue from the scene graph every frame
+		bool IncrementalRenderQueue = true;
+
 		RenderHints Hints = { 0 };
 
+		// Added to the level of detail of every component, passes like shadow depth can draw coarser meshes
+		unsigned LevelOfDetailBias = 0;
+
 		// _RenderOrder controls the order in which render passes are executed.
 		int _Priority = 0;
 
@@ -53,6 +71,51 @@ class SceneRenderPass
 		virtual void InitLightUniforms(const Shader &);
 		virtual void UpdateLightData(const Shader&);
 
+		void DrawComponent(Component* pSC);
+
+		// Insert a Component into the render queue, OnAddToRender overrides use it so the pass can find
+		// the Component again when its actor moves
+		void AddToRenderQueue(Component* pSC, float dist2);
+
+		struct RenderListEntry
+		{
+			Component* pComponent = nullptr;
+			SceneObject* pObject = nullptr;
+			SceneActor* pActor = nullptr;
+			Component::eRenderQueueType queue = Component::Geometry;
+			float distance2 = 0;	// the sort key it was queued with
+			bool queued = false;
+			bool culled = false;
+		};
+
+		// What the queue was sorted and culled for
+		struct RenderView
+		{
+			SceneCamera* pCamera;
+			Camera3D camera;
+			Camera3D mainCamera;
+			Matrix projection;
+		};
+
+		void CollectRenderList(SceneObject* pRoot);
+		void QueueRenderList();
+		void QueueEntry(RenderListEntry& entry);
+		void RemoveFromRenderQueue(const RenderListEntry& entry);
+		void UpdateMovedActors();
+		void GetRenderView(RenderView& view);
+		size_t GetNumQueued() const;
+
+		vector<RenderListEntry> _RenderList;				// active components in scene graph order
+		unordered_map<SceneActor*, size_t> _ActorEntries;	// the first entry of each actor's components
+		RenderListEntry* _pQueueingEntry = nullptr;
+		RenderView _RenderView = { 0 };
+		FrustumPlane _FrustumPlanes[6] = { 0 };
+		unsigned int _RenderListVersion = 0;
+		unsigned int _RenderQueueFrame = 0;
+		int _NumCulled = 0;
+		bool _Untracked = false;	// an OnAddToRender override queued without AddToRenderQueue
+		bool _RequeuePending = false;
+
 		virtual void EnableAlphaTest(bool enable)
 		{
 			if (Hints.pOverrideShader != nullptr && alphaTestLoc >= 0)
@@ -0,0 +1,156 @@
+#include "StreamingQuadBuffer.h"
+
+#include "rlgl.h"
+#include "raymath.h"
+
+#include <cstddef>
+
+StreamingQuadBuffer::~StreamingQuadBuffer()
+{
+	Release();
+}
+
+/// <summary>
+/// Create - Allocate the CPU side quads and the ring of dynamic vertex buffers. They share one static
+/// index buffer, two triangles per quad.
+/// </summary>
+/// <param name="maxQuads">Quads per draw call, at most STREAMING_QUAD_MAX_QUADS</param>
+/// <returns>false if vertex array objects are not supported</returns>
+bool StreamingQuadBuffer::Create(int maxQuads)
+{
+	Release();
+
+	if (maxQuads <= 0 || maxQuads > STREAMING_QUAD_MAX_QUADS)
+		maxQuads = STREAMING_QUAD_MAX_QUADS;
+
+	vector<unsigned short> indices(maxQuads * 6);
+	for (int q = 0; q < maxQuads; q++)
+	{
+		unsigned short v = (unsigned short)(q * 4);
+		unsigned short* pIndex = &indices[q * 6];
+		pIndex[0] = v;
+		pIndex[1] = v + 1;
+		pIndex[2] = v + 2;
+		pIndex[3] = v;
+		pIndex[4] = v + 2;
+		pIndex[5] = v + 3;
+	}
+
+	int vertexBytes = maxQuads * 4 * (int)sizeof(QuadVertex);
+	for (int i = 0; i < STREAMING_QUAD_NUM_BUFFERS; i++)
+	{
+		_VaoIds[i] = rlLoadVertexArray();
+		if (_VaoIds[i] == 0)
+		{
+			TraceLog(LOG_WARNING, "QUADBUFFER: Vertex array objects are not supported");
+			Release();
+			return false;
+		}
+		rlEnableVertexArray(_VaoIds[i]);
+
+		_VboIds[i] = rlLoadVertexBuffer(nullptr, vertexBytes, true);
+		rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, sizeof(QuadVertex), (int)offsetof(QuadVertex, position));
+		rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+		rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT, false, sizeof(QuadVertex), (int)offsetof(QuadVertex, texcoord));
+		rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+		rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, sizeof(QuadVertex), (int)offsetof(QuadVertex, color));
+		rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+		//the element buffer binding is part of the vertex array state
+		if (i == 0)
+			_EboId = rlLoadVertexBufferElement(indices.data(), (int)(indices.size() * sizeof(unsigned short)), false);
+		else
+			rlEnableVertexBufferElement(_EboId);
+	}
+	rlDisableVertexArray();
+
+	_Vertices.resize(maxQuads * 4);
+	_MaxQuads = maxQuads;
+	_NumQuads = 0;
+	_CurrentBuffer = 0;
+	return true;
+}
+
+void StreamingQuadBuffer::Release()
+{
+	for (int i = 0; i < STREAMING_QUAD_NUM_BUFFERS; i++)
+	{
+		if (_VboIds[i] != 0)
+			rlUnloadVertexBuffer(_VboIds[i]);
+		if (_VaoIds[i] != 0)
+			rlUnloadVertexArray(_VaoIds[i]);
+		_VboIds[i] = 0;
+		_VaoIds[i] = 0;
+	}
+	if (_EboId != 0)
+		rlUnloadVertexBuffer(_EboId);
+	_EboId = 0;
+
+	_Vertices.clear();
+	_Vertices.shrink_to_fit();
+	_MaxQuads = 0;
+	_NumQuads = 0;
+}
+
+QuadVertex* StreamingQuadBuffer::AddQuads(int numQuads)
+{
+	if (_NumQuads + numQuads > _MaxQuads)
+		return nullptr;
+
+	QuadVertex* pQuads = &_Vertices[_NumQuads * 4];
+	_NumQuads += numQuads;
+	return pQuads;
+}
+
+/// <summary>
+/// Draw - Upload the quads into the next buffer of the ring and draw them in one call. raylib's pending
+/// batch is drawn first so the order of the draws is kept.
+/// </summary>
+/// <param name="texture">The texture of every quad</param>
+/// <param name="pShader">Shader to draw with, nullptr for raylib's default shader</param>
+/// <returns>true if a draw call was issued</returns>
+bool StreamingQuadBuffer::Draw(Texture2D texture, const Shader* pShader)
+{
+	if (_NumQuads == 0 || !IsReady())
+		return false;
+
+	rlDrawRenderBatchActive();
+
+	unsigned int vaoId = _VaoIds[_CurrentBuffer];
+	rlUpdateVertexBuffer(_VboIds[_CurrentBuffer], _Vertices.data(), _NumQuads * 4 * (int)sizeof(QuadVertex), 0);
+	_CurrentBuffer = (_CurrentBuffer + 1) % STREAMING_QUAD_NUM_BUFFERS;
+
+	bool customShader = pShader != nullptr && pShader->id != 0;
+	int* pLocs = customShader ? pShader->locs : rlGetShaderLocsDefault();
+	rlEnableShader(customShader ? pShader->id : rlGetShaderIdDefault());
+
+	Matrix matModelView = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+	rlSetUniformMatrix(pLocs[RL_SHADER_LOC_MATRIX_MVP], MatrixMultiply(matModelView, rlGetMatrixProjection()));
+	if (customShader)
+	{
+		//lit shaders transform positions and normals to world space, the quads are there already
+		rlSetUniformMatrix(pLocs[RL_SHADER_LOC_MATRIX_MODEL], rlGetMatrixTransform());
+		rlSetUniformMatrix(pLocs[RL_SHADER_LOC_MATRIX_NORMAL], MatrixIdentity());
+		float up[3] = { 0.0f, 1.0f, 0.0f };
+		rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, up, RL_SHADER_ATTRIB_VEC3, 1);
+	}
+	float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	rlSetUniform(pLocs[RL_SHADER_LOC_COLOR_DIFFUSE], white, RL_SHADER_UNIFORM_VEC4, 1);
+	int slot = 0;
+	rlSetUniform(pLocs[RL_SHADER_LOC_MAP_DIFFUSE], &slot, RL_SHADER_UNIFORM_INT, 1);
+
+	rlActiveTextureSlot(0);
+	rlEnableTexture(texture.id);
+
+	rlEnableVertexArray(vaoId);
+	rlDrawVertexArrayElements(0, _NumQuads * 6, 0);
+	rlDisableVertexArray();
+
+	rlDisableTexture();
+	rlDisableShader();
+
+	_NumQuads = 0;
+	return true;
+}
+
+//End of StreamingQuadBuffer.cpp
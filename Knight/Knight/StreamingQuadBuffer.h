@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+
+using namespace std;
+
+#define STREAMING_QUAD_MAX_QUADS	16384	//16-bit indices address 65536 vertices
+#define STREAMING_QUAD_NUM_BUFFERS	3		//vertex buffers used in turn, so an upload doesn't wait for the draw before
+
+struct QuadVertex
+{
+	Vector3 position;
+	Vector2 texcoord;
+	Color color;
+};
+
+// Dynamic vertex buffer for quads rebuilt every frame (particles, billboards). Quads are written on the
+// CPU, uploaded in one piece and drawn with a single indexed draw call through raylib's default shader.
+// Main thread only, Create needs the GL context.
+class StreamingQuadBuffer
+{
+public:
+	~StreamingQuadBuffer();
+
+	// Returns false if the platform has no vertex array objects, users fall back to raylib's draw calls
+	bool Create(int maxQuads = STREAMING_QUAD_MAX_QUADS);
+	void Release();
+	bool IsReady() const { return _VaoIds[0] != 0; }
+
+	// Room for numQuads more quads, 4 vertices each counter clockwise from the bottom left corner.
+	// nullptr if they don't fit any more, Draw the quads added so far first.
+	QuadVertex* AddQuads(int numQuads);
+
+	// Upload the quads added since the last Draw and draw them with the current matrices, blend mode
+	// and depth state. Returns false if there was nothing to draw.
+	// pShader replaces raylib's default shader, the quads are in world space so its matModel is the identity.
+	bool Draw(Texture2D texture, const Shader* pShader = nullptr);
+
+	int GetNumQuads() const { return _NumQuads; }
+	int GetMaxQuads() const { return _MaxQuads; }
+
+protected:
+	vector<QuadVertex> _Vertices;
+	int _NumQuads = 0;
+	int _MaxQuads = 0;
+
+	unsigned int _VaoIds[STREAMING_QUAD_NUM_BUFFERS] = { 0 };
+	unsigned int _VboIds[STREAMING_QUAD_NUM_BUFFERS] = { 0 };
+	unsigned int _EboId = 0;
+	int _CurrentBuffer = 0;
+};
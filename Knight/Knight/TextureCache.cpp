@@ -0,0 +1,279 @@
+#include "TextureCache.h"
+#include "ResourceRegistry.h"
+#include "AsyncAssetLoader.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+
+TextureCache::TextureCache(size_t budgetBytes, bool asyncLoads)
+	: _BudgetBytes(budgetBytes)
+	, _AsyncLoads(asyncLoads)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	for (auto& it : _Entries)
+	{
+		if (it.second.resident)
+			Unload(it.second);
+	}
+}
+
+/// <summary>
+/// Get - Look a texture up for drawing it this frame. Misses are only counted once, the frames spent
+/// waiting for the load return the placeholder without another miss.
+/// </summary>
+/// <param name="path">The image file, the key as given.</param>
+/// <param name="distance">Priority hint, nearer textures are loaded first and evicted last.</param>
+/// <returns>The texture, or the placeholder if it isn't resident yet or failed to load.</returns>
+Texture2D TextureCache::Get(const char* path, float distance)
+{
+	Entry& entry = GetEntry(path);
+	entry.distance = entry.lastUsedFrame == _Frame ? std::min(entry.distance, distance) : distance;
+	entry.lastUsedFrame = _Frame;
+
+	if (entry.resident)
+	{
+		_Stats.hits++;
+		Touch(entry);
+		return entry.texture;
+	}
+	if (entry.failed || entry.queued || entry.pLoad != nullptr)
+		return GetPlaceholder();
+
+	_Stats.misses++;
+	if (!_AsyncLoads)
+	{
+		MakeResident(entry, ResourceRegistry::Instance().AcquireTexture(path, UseCooked));
+		return entry.resident ? entry.texture : GetPlaceholder();
+	}
+
+	entry.queued = true;
+	_LoadQueue.push_back(&entry);
+	return GetPlaceholder();
+}
+
+/// <summary>
+/// Acquire - Pin a texture, it stays resident until every Acquire is matched by a Release.
+/// </summary>
+/// <param name="path">The image file, the key as given.</param>
+/// <returns>The texture, the placeholder if it could not be loaded.</returns>
+Texture2D TextureCache::Acquire(const char* path)
+{
+	Entry& entry = GetEntry(path);
+	entry.refCount++;
+	entry.lastUsedFrame = _Frame;
+
+	if (entry.resident)
+	{
+		_Stats.hits++;
+		Touch(entry);
+		return entry.texture;
+	}
+	if (entry.failed)
+		return GetPlaceholder();
+
+	//a queued or running background load is overtaken, its result is ignored when it arrives
+	_Stats.misses++;
+	entry.queued = false;
+	MakeResident(entry, ResourceRegistry::Instance().AcquireTexture(path, UseCooked));
+	return entry.resident ? entry.texture : GetPlaceholder();
+}
+
+/// <summary>
+/// Release - Unpin a texture acquired before, it can be evicted again once nothing holds it.
+/// </summary>
+/// <param name="path">The path given to Acquire.</param>
+void TextureCache::Release(const char* path)
+{
+	auto it = _Entries.find(path);
+	if (it == _Entries.end() || it->second.refCount <= 0)
+	{
+		TraceLog(LOG_WARNING, "TEXCACHE: [%s] Released a texture which is not acquired", path);
+		return;
+	}
+	it->second.refCount--;
+}
+
+/// <summary>
+/// Update - Take the finished background loads in, start the queued misses nearest first and evict the
+/// least recently used textures until the resident bytes fit the budget again.
+/// </summary>
+void TextureCache::Update()
+{
+	_Frame++;
+
+	for (size_t i = 0; i < _Loading.size(); )
+	{
+		Entry& entry = *_Loading[i];
+		if (entry.pLoad->IsPending())
+		{
+			i++;
+			continue;
+		}
+
+		if (entry.pLoad->IsReady() && !entry.resident)
+			MakeResident(entry, ResourceRegistry::Instance().AcquireTexture(entry.pPath->c_str(), UseCooked));
+		else if (entry.pLoad->IsFailed() && !entry.resident)
+			MakeResident(entry, Texture2D{ 0 });
+		entry.pLoad.reset();
+		_Loading[i] = _Loading.back();
+		_Loading.pop_back();
+	}
+
+	//misses nobody asked for in the last frame have scrolled out of view, they are not loaded any more
+	unsigned int frame = _Frame;
+	_LoadQueue.erase(std::remove_if(_LoadQueue.begin(), _LoadQueue.end(), [frame](Entry* pEntry) {
+		if (pEntry->queued && pEntry->lastUsedFrame + 1 >= frame)
+			return false;
+		pEntry->queued = false;
+		return true;
+	}), _LoadQueue.end());
+	std::sort(_LoadQueue.begin(), _LoadQueue.end(), [](const Entry* a, const Entry* b) { return a->distance < b->distance; });
+
+	size_t numStarted = 0;
+	while (numStarted < _LoadQueue.size() && _Loading.size() < TEXTURE_CACHE_MAX_LOADS)
+	{
+		Entry& entry = *_LoadQueue[numStarted++];
+		entry.queued = false;
+		entry.pLoad = AsyncAssetLoader::Instance().LoadTextureAsync(entry.pPath->c_str(), UseCooked);
+		_Loading.push_back(&entry);
+	}
+	_LoadQueue.erase(_LoadQueue.begin(), _LoadQueue.begin() + numStarted);
+
+	while (_ResidentBytes > _BudgetBytes)
+	{
+		Entry* pVictim = FindVictim();
+		if (pVictim == nullptr)
+			break;	//everything left is pinned
+		Unload(*pVictim);
+		_Stats.evictions++;
+	}
+}
+
+/// <summary>
+/// Clear - Unload every texture which is not pinned, forget the failed loads and drop the pending ones.
+/// </summary>
+void TextureCache::Clear()
+{
+	_LoadQueue.clear();
+	_Loading.clear();
+	for (auto it = _Entries.begin(); it != _Entries.end(); )
+	{
+		Entry& entry = it->second;
+		entry.queued = false;
+		entry.failed = false;
+		entry.pLoad.reset();
+		if (entry.refCount > 0)
+		{
+			++it;
+			continue;
+		}
+		if (entry.resident)
+			Unload(entry);
+		it = _Entries.erase(it);
+	}
+}
+
+/// <summary>
+/// GetResidentPath - The path of a resident texture by its position in the LRU order.
+/// </summary>
+/// <param name="index">0 is the most recently used texture.</param>
+/// <returns>The path, null if index is out of range.</returns>
+const char* TextureCache::GetResidentPath(int index) const
+{
+	if (index < 0 || index >= (int)_LruList.size())
+		return nullptr;
+	return (*std::next(_LruList.begin(), index))->pPath->c_str();
+}
+
+/// <summary>
+/// LogStats - Log the resident bytes against the budget and the hit rate.
+/// </summary>
+void TextureCache::LogStats() const
+{
+	int lookups = _Stats.hits + _Stats.misses;
+	TraceLog(LOG_INFO, "TEXCACHE: %d textures, %.1f of %.1f MB (peak %.1f MB)", GetNumResident(),
+		_ResidentBytes / (1024.0 * 1024.0), _BudgetBytes / (1024.0 * 1024.0), _Stats.peakBytes / (1024.0 * 1024.0));
+	TraceLog(LOG_INFO, "TEXCACHE: %d hits, %d misses (%.1f%% hit rate), %d evictions, %d failed loads", _Stats.hits, _Stats.misses,
+		lookups > 0 ? 100.0 * _Stats.hits / lookups : 0.0, _Stats.evictions, _Stats.failedLoads);
+}
+
+TextureCache::Entry& TextureCache::GetEntry(const char* path)
+{
+	auto it = _Entries.find(path);
+	if (it == _Entries.end())
+	{
+		it = _Entries.emplace(path, Entry()).first;
+		it->second.pPath = &it->first;	//nodes don't move when the map rehashes
+	}
+	return it->second;
+}
+
+void TextureCache::Touch(Entry& entry)
+{
+	_LruList.splice(_LruList.begin(), _LruList, entry.lruIt);
+}
+
+void TextureCache::MakeResident(Entry& entry, Texture2D texture)
+{
+	if (texture.id == 0)
+	{
+		entry.failed = true;
+		_Stats.failedLoads++;
+		return;
+	}
+
+	entry.texture = texture;
+	entry.bytes = GetTextureBytes(texture);
+	entry.resident = true;
+	_LruList.push_front(&entry);
+	entry.lruIt = _LruList.begin();
+
+	_ResidentBytes += entry.bytes;
+	_Stats.peakBytes = std::max(_Stats.peakBytes, _ResidentBytes);
+}
+
+void TextureCache::Unload(Entry& entry)
+{
+	ResourceRegistry::Instance().ReleaseTexture(entry.texture);
+	_LruList.erase(entry.lruIt);
+	_ResidentBytes -= entry.bytes;
+	entry.texture = Texture2D{ 0 };
+	entry.bytes = 0;
+	entry.resident = false;
+}
+
+// The least recently used texture which is not pinned, the furthest one if several were last used in the same frame
+TextureCache::Entry* TextureCache::FindVictim()
+{
+	Entry* pVictim = nullptr;
+	for (auto it = _LruList.rbegin(); it != _LruList.rend(); ++it)
+	{
+		Entry* pEntry = *it;
+		if (pEntry->refCount > 0)
+			continue;
+		if (pVictim != nullptr && pEntry->lastUsedFrame != pVictim->lastUsedFrame)
+			break;
+		if (pVictim == nullptr || pEntry->distance > pVictim->distance)
+			pVictim = pEntry;
+	}
+	return pVictim;
+}
+
+Texture2D TextureCache::GetPlaceholder() const
+{
+	if (Placeholder.id != 0)
+		return Placeholder;
+	return Texture2D{ rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+}
+
+size_t TextureCache::GetTextureBytes(const Texture2D& texture)
+{
+	size_t bytes = (size_t)GetPixelDataSize(texture.width, texture.height, texture.format);
+	return texture.mipmaps > 1 ? bytes * 4 / 3 : bytes;
+}
+
+//End of TextureCache.cpp
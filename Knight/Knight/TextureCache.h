@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "raylib.h"
+
+using namespace std;
+
+class AsyncTexture;
+
+#define TEXTURE_CACHE_MAX_LOADS	4	//misses loading at the same time, the nearest ones start first
+
+struct TextureCacheStats
+{
+	int hits = 0;
+	int misses = 0;
+	int evictions = 0;
+	int failedLoads = 0;
+	size_t peakBytes = 0;
+};
+
+// Texture cache with a VRAM budget in bytes, for large texture sets (card decks, UI, terrain) which
+// don't all have to be resident at once. Textures are least recently used first evicted, among the
+// ones last used in the same frame the one furthest from the camera goes first. Acquired textures
+// are pinned and never evicted. The textures come from the ResourceRegistry, so the budget counts
+// the references this cache holds; a texture also used elsewhere stays loaded after its eviction.
+// Main thread only.
+class TextureCache
+{
+public:
+	TextureCache(size_t budgetBytes, bool asyncLoads = true);
+	~TextureCache();
+
+	// The texture to draw this frame, valid until the next Update. A miss is loaded in the background
+	// (nearest first) and the placeholder is returned until it is resident, or loaded right away
+	// without asyncLoads. distance is the priority hint, usually the distance to the camera.
+	Texture2D Get(const char* path, float distance = 0.0f);
+
+	// Pin a texture until the matching Release, a miss is loaded right away
+	Texture2D Acquire(const char* path);
+	void Release(const char* path);
+
+	// Once per frame before the textures are used: take finished loads in, start queued ones
+	// and evict down to the budget
+	void Update();
+
+	// Unload every texture which is not pinned
+	void Clear();
+
+	void SetBudget(size_t budgetBytes) { _BudgetBytes = budgetBytes; }
+	size_t GetBudget() const { return _BudgetBytes; }
+	size_t GetResidentBytes() const { return _ResidentBytes; }
+	int GetNumResident() const { return (int)_LruList.size(); }
+	// Resident textures from the most to the least recently used
+	const char* GetResidentPath(int index) const;
+
+	const TextureCacheStats& GetStats() const { return _Stats; }
+	void ResetStats() { _Stats = TextureCacheStats(); }
+	void LogStats() const;
+
+	bool UseCooked = false;			//load the cooked .knt next to the images, as ResourceRegistry::AcquireTexture
+	Texture2D Placeholder = { 0 };	//returned for textures which are not resident, raylib's white texture if id is 0
+
+protected:
+	struct Entry
+	{
+		const string* pPath = nullptr;	// the map key, the LRU list points at entries instead of copying it
+		Texture2D texture = { 0 };
+		size_t bytes = 0;
+		int refCount = 0;
+		float distance = 0.0f;
+		unsigned int lastUsedFrame = 0;
+		bool resident = false;
+		bool queued = false;			// waiting for a free load slot
+		bool failed = false;			// not retried until Clear
+		shared_ptr<AsyncTexture> pLoad;
+		list<Entry*>::iterator lruIt;
+	};
+
+	Entry& GetEntry(const char* path);
+	void Touch(Entry& entry);
+	void MakeResident(Entry& entry, Texture2D texture);
+	void Unload(Entry& entry);
+	Entry* FindVictim();
+	Texture2D GetPlaceholder() const;
+
+	static size_t GetTextureBytes(const Texture2D& texture);
+
+	unordered_map<string, Entry> _Entries;
+	list<Entry*> _LruList;			// resident entries, most recently used first
+	vector<Entry*> _LoadQueue;		// misses waiting for a load slot
+	vector<Entry*> _Loading;		// misses loading in the background
+
+	size_t _BudgetBytes;
+	size_t _ResidentBytes = 0;
+	bool _AsyncLoads;
+	unsigned int _Frame = 1;
+	TextureCacheStats _Stats;
+};
@@ -3,9 +3,9 @@
 #include "rlgl.h"
 
 #include <vector>
-#include <unordered_map>
 #include <config.h>
 #include <algorithm> // Required for std::min and std::max
+#include <cmath>
 
 extern Rectangle& CenterRectangle(Rectangle& r, int width, int height)
 {
@@ -59,242 +59,182 @@ extern BoundingRect Get2DBoundingRectOfCube(const Vector3& cubePosition, float c
     return BoundingRect{ { minX, minY }, { maxX, maxY } };
 }
 
-extern void RecalculateSmoothNormals(const Model& model)
-{
-	for (int midx = 0; midx < model.meshCount; ++midx)
-	{
-		std::map<Vector3, Vector3, Vector3Compare> accumulatedNormals;
-
-		Mesh& mesh = model.meshes[midx];
-
-		// Ensure mesh data is present
-		if (mesh.normals == nullptr)
-		{
-			mesh.normals = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
-			if (mesh.normals == nullptr)
-			{
-				TraceLog(LOG_ERROR, "Failed to allocate memory for mesh normals");
-				return; // Memory allocation failed
-			}
-		}
-
-		memset(mesh.normals, 0, mesh.vertexCount * 3 * sizeof(float));
-
-		if (mesh.indices != nullptr)
-		{
-			// Accumulate normals per vertex
-			for (int i = 0; i < mesh.triangleCount; ++i) {
-				// Retrieve vertex indices
-				unsigned short idx0 = mesh.indices[i * 3];
-				unsigned short idx1 = mesh.indices[i * 3 + 1];
-				unsigned short idx2 = mesh.indices[i * 3 + 2];
-
-				// Retrieve vertex positions
-				Vector3 v0 = {
-					mesh.vertices[idx0 * 3],
-					mesh.vertices[idx0 * 3 + 1],
-					mesh.vertices[idx0 * 3 + 2]
-				};
-				Vector3 v1 = {
-					mesh.vertices[idx1 * 3],
-					mesh.vertices[idx1 * 3 + 1],
-					mesh.vertices[idx1 * 3 + 2]
-				};
-				Vector3 v2 = {
-					mesh.vertices[idx2 * 3],
-					mesh.vertices[idx2 * 3 + 1],
-					mesh.vertices[idx2 * 3 + 2]
-				};
-
-				// Compute face normal
-				Vector3 edge1 = Vector3Subtract(v1, v0);
-				Vector3 edge2 = Vector3Subtract(v2, v0);
-				Vector3 faceNormal = Vector3Normalize(Vector3CrossProduct(edge1, edge2));
-
-				/* Accumulate normals for smoothing
-				for (auto idx : { idx0, idx1, idx2 }) {
-					mesh.normals[idx * 3] += faceNormal.x;
-					mesh.normals[idx * 3 + 1] += faceNormal.y;
-					mesh.normals[idx * 3 + 2] += faceNormal.z;
-				}*/
-
-				accumulatedNormals[v0] = Vector3Add(accumulatedNormals[v0], faceNormal);
-				accumulatedNormals[v1] = Vector3Add(accumulatedNormals[v1], faceNormal);
-				accumulatedNormals[v2] = Vector3Add(accumulatedNormals[v2], faceNormal);
-			}
-		}
-		else
-		{
-			for (int i = 0; i < mesh.vertexCount; i += 3) {
-				Vector3 v0 = { mesh.vertices[i * 3], mesh.vertices[i * 3 + 1], mesh.vertices[i * 3 + 2] };
-				Vector3 v1 = { mesh.vertices[(i + 1) * 3], mesh.vertices[(i + 1) * 3 + 1], mesh.vertices[(i + 1) * 3 + 2] };
-				Vector3 v2 = { mesh.vertices[(i + 2) * 3], mesh.vertices[(i + 2) * 3 + 1], mesh.vertices[(i + 2) * 3 + 2] };
-
-				Vector3 faceNormal = Vector3Normalize(Vector3CrossProduct(
-					Vector3Subtract(v1, v0), Vector3Subtract(v2, v0)));
-
-				accumulatedNormals[v0] = Vector3Add(accumulatedNormals[v0], faceNormal);
-				accumulatedNormals[v1] = Vector3Add(accumulatedNormals[v1], faceNormal);
-				accumulatedNormals[v2] = Vector3Add(accumulatedNormals[v2], faceNormal);
-			}
-		}
-
-		for (int i = 0; i < mesh.vertexCount; ++i)
-		{
-			Vector3 pos = { mesh.vertices[i * 3], mesh.vertices[i * 3 + 1], mesh.vertices[i * 3 + 2] };
-			Vector3 normal = Vector3Normalize(accumulatedNormals[pos]);
-			mesh.normals[i * 3] = normal.x;
-			mesh.normals[i * 3 + 1] = normal.y;
-			mesh.normals[i * 3 + 2] = normal.z;
-		}
-
-		// Update mesh GPU data
-		// in raylib, mesh buffers are updated using rlUpdateVertexBuffer
-		// and normal buffer is usually at index 2
-		UpdateMeshBuffer(mesh, 2, mesh.normals, mesh.vertexCount * 3 * sizeof(float), 0);
-	}
-}
-
-struct Vertex {
-    Vector3 position;
-    Vector3 normal;
-    Vector2 texcoord;
-
-    bool operator==(const Vertex& other) const {
-        return Vector3Equals(position, other.position);
-    }
+struct WeldCell {
+    long long x, y, z;
+    unsigned int id;
 };
 
-struct VertexHash {
-    size_t operator()(const Vertex& v) const {
-        size_t hx = std::hash<float>()(v.position.x);
-        size_t hy = std::hash<float>()(v.position.y);
-        size_t hz = std::hash<float>()(v.position.z);
-        /*size_t nx = std::hash<float>()(v.normal.x);
-        size_t ny = std::hash<float>()(v.normal.y);
-        size_t nz = std::hash<float>()(v.normal.z);
-        size_t tx = std::hash<float>()(v.texcoord.x);
-        size_t ty = std::hash<float>()(v.texcoord.y);*/
-
-        //return hx ^ (hy << 1) ^ (hz << 2) ^ (nx << 3) ^ (ny << 4) ^ (nz << 5) ^ (tx << 6) ^ (ty << 7);
-        return hx ^ (hy << 1) ^ (hz << 2);
+/// <summary>
+/// WeldVertexPositions - give every vertex the id of the first vertex at the same position.
+/// Positions are snapped to a fine grid and looked up in an open addressing hash table,
+/// so this is linear in the vertex count.
+/// </summary>
+/// <param name="vertices">xyz positions</param>
+/// <param name="vertexCount">number of vertices</param>
+/// <param name="weldIds">returns the group id of every vertex</param>
+/// <returns>number of unique positions</returns>
+static unsigned int WeldVertexPositions(const float* vertices, int vertexCount, std::vector<unsigned int>& weldIds)
+{
+    const float invCellSize = 1.0f / 1e-6f;
+
+    size_t capacity = 16;
+    while (capacity < (size_t)vertexCount * 2) capacity <<= 1;
+    std::vector<WeldCell> table(capacity, WeldCell{ 0, 0, 0, 0xffffffffu });
+
+    weldIds.resize(vertexCount);
+    unsigned int numGroups = 0;
+    for (int i = 0; i < vertexCount; i++) {
+        long long x = llroundf(vertices[i * 3] * invCellSize);
+        long long y = llroundf(vertices[i * 3 + 1] * invCellSize);
+        long long z = llroundf(vertices[i * 3 + 2] * invCellSize);
+
+        size_t h = (size_t)((x * 73856093LL) ^ (y * 19349663LL) ^ (z * 83492791LL));
+        size_t slot = (h ^ (h >> 17)) & (capacity - 1);
+        for (;;) {
+            WeldCell& cell = table[slot];
+            if (cell.id == 0xffffffffu) {
+                cell = WeldCell{ x, y, z, numGroups };
+                weldIds[i] = numGroups++;
+                break;
+            }
+            if (cell.x == x && cell.y == y && cell.z == z) {
+                weldIds[i] = cell.id;
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
     }
-};
+    return numGroups;
+}
 
-extern void ConvertMeshToIndexed(Mesh* mesh)
+/// <summary>
+/// RecalculateMeshSmoothNormals - CPU part of RecalculateSmoothNormals for one mesh, does not touch the GPU
+/// </summary>
+/// <param name="mesh">The mesh, indexed or not</param>
+/// <param name="weighting">How face normals are weighted</param>
+static void RecalculateMeshSmoothNormals(Mesh& mesh, eNormalWeighting weighting)
 {
-    std::vector<Vertex> nonIndexedVertices;
-
-    if (mesh->indices != nullptr) {
-        TraceLog(LOG_WARNING, "Mesh is already indexed. No conversion needed. Skip this action.");
-		return;
+    if (mesh.vertices == nullptr || mesh.vertexCount == 0)
+        return;
+
+    // Ensure mesh data is present
+    if (mesh.normals == nullptr)
+    {
+        mesh.normals = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+        if (mesh.normals == nullptr)
+            return; // Memory allocation failed
     }
 
-	TraceLog(LOG_INFO, "Converting mesh to indexed format. Current vertices = %d", mesh->vertexCount);
+    // Vertices sharing a position (uv seams, or every corner of a non-indexed mesh) share one normal
+    std::vector<unsigned int> weldIds;
+    unsigned int numGroups = WeldVertexPositions(mesh.vertices, mesh.vertexCount, weldIds);
+    std::vector<Vector3> groupNormals(numGroups, Vector3{ 0, 0, 0 });
+
+    const int triangleCount = mesh.indices != nullptr ? mesh.triangleCount : mesh.vertexCount / 3;
+    for (int t = 0; t < triangleCount; ++t) {
+        // Retrieve vertex indices, kept as 32-bit values
+        unsigned int idx[3];
+        for (int c = 0; c < 3; c++) {
+            idx[c] = mesh.indices != nullptr ? (unsigned int)mesh.indices[t * 3 + c] : (unsigned int)(t * 3 + c);
+        }
 
-    // Extract existing vertex data
-    for (int i = 0; i < mesh->vertexCount; i++) {
-        Vertex v = {};
-        v.position = {
-            mesh->vertices[i * 3 + 0],
-            mesh->vertices[i * 3 + 1],
-            mesh->vertices[i * 3 + 2]
-        };
-
-        if (mesh->normals) {
-            v.normal = {
-                mesh->normals[i * 3 + 0],
-                mesh->normals[i * 3 + 1],
-                mesh->normals[i * 3 + 2]
-            };
+        Vector3 v[3];
+        for (int c = 0; c < 3; c++) {
+            v[c] = { mesh.vertices[idx[c] * 3], mesh.vertices[idx[c] * 3 + 1], mesh.vertices[idx[c] * 3 + 2] };
         }
 
-        if (mesh->texcoords) {
-            v.texcoord = {
-                mesh->texcoords[i * 2 + 0],
-                mesh->texcoords[i * 2 + 1]
-            };
+        // Unnormalized face normal, its length is twice the triangle area
+        Vector3 faceNormal = Vector3CrossProduct(Vector3Subtract(v[1], v[0]), Vector3Subtract(v[2], v[0]));
+
+        for (int c = 0; c < 3; c++) {
+            Vector3 contribution;
+            switch (weighting) {
+            case NormalWeightArea:
+                contribution = faceNormal;
+                break;
+            case NormalWeightAngle:
+                contribution = Vector3Scale(Vector3Normalize(faceNormal),
+                    Vector3Angle(Vector3Subtract(v[(c + 1) % 3], v[c]), Vector3Subtract(v[(c + 2) % 3], v[c])));
+                break;
+            default:
+                contribution = Vector3Normalize(faceNormal);
+                break;
+            }
+            Vector3& n = groupNormals[weldIds[idx[c]]];
+            n = Vector3Add(n, contribution);
         }
+    }
 
-        nonIndexedVertices.push_back(v);
+    for (int i = 0; i < mesh.vertexCount; ++i)
+    {
+        Vector3 normal = Vector3Normalize(groupNormals[weldIds[i]]);
+        mesh.normals[i * 3] = normal.x;
+        mesh.normals[i * 3 + 1] = normal.y;
+        mesh.normals[i * 3 + 2] = normal.z;
     }
+}
 
-    // Build unique vertices and index buffer
-    std::vector<Vertex> uniqueVertices;
-    std::vector<unsigned int> indices;
-    std::unordered_map<Vertex, unsigned int, VertexHash> vertexToIndex;
+/// <summary>
+/// RecalculateSmoothNormals - recompute smooth vertex normals of every mesh of a model.
+/// Meshes are processed in parallel on the JobSystem, the normal buffers are updated on the calling thread afterwards.
+/// </summary>
+/// <param name="model">The model</param>
+/// <param name="weighting">Uniform (default), area or angle weighted face normals</param>
+extern void RecalculateSmoothNormals(const Model& model, eNormalWeighting weighting)
+{
+    double t = GetTime();
 
-    for (const auto& vertex : nonIndexedVertices) {
-        auto it = vertexToIndex.find(vertex);
-        if (it != vertexToIndex.end()) {
-            indices.push_back(it->second);
+    JobSystem::Instance().ParallelFor(model.meshCount, 1, [&model, weighting](int begin, int end) {
+        for (int midx = begin; midx < end; ++midx) {
+            RecalculateMeshSmoothNormals(model.meshes[midx], weighting);
         }
-        else {
-            unsigned int newIndex = static_cast<unsigned int>(uniqueVertices.size());
-            uniqueVertices.push_back(vertex);
-            vertexToIndex[vertex] = newIndex;
-            indices.push_back(newIndex);
+    });
+
+    int totalVertices = 0;
+    for (int midx = 0; midx < model.meshCount; ++midx)
+    {
+        Mesh& mesh = model.meshes[midx];
+        if (mesh.normals == nullptr)
+        {
+            TraceLog(LOG_ERROR, "Failed to allocate memory for mesh normals");
+            continue;
         }
-    }
-
-    // Free old CPU vertex arrays
-    MemFree(mesh->vertices);
-    if (mesh->normals) MemFree(mesh->normals);
-    if (mesh->texcoords) MemFree(mesh->texcoords);
-    if (mesh->indices) MemFree(mesh->indices);
+        totalVertices += mesh.vertexCount;
 
-    // Allocate new arrays
-    mesh->vertexCount = (int)uniqueVertices.size();
-    mesh->triangleCount = (int)indices.size() / 3;
-
-    mesh->vertices = (float*)MemAlloc(mesh->vertexCount * 3 * sizeof(float));
-    mesh->normals = (float*)MemAlloc(mesh->vertexCount * 3 * sizeof(float));
-    mesh->texcoords = (float*)MemAlloc(mesh->vertexCount * 2 * sizeof(float));
-    mesh->indices = (unsigned short*)MemAlloc((unsigned) indices.size() * sizeof(unsigned short));
-
-    for (int i = 0; i < uniqueVertices.size(); i++) {
-        mesh->vertices[i * 3 + 0] = uniqueVertices[i].position.x;
-        mesh->vertices[i * 3 + 1] = uniqueVertices[i].position.y;
-        mesh->vertices[i * 3 + 2] = uniqueVertices[i].position.z;
-
-        mesh->normals[i * 3 + 0] = uniqueVertices[i].normal.x;
-        mesh->normals[i * 3 + 1] = uniqueVertices[i].normal.y;
-        mesh->normals[i * 3 + 2] = uniqueVertices[i].normal.z;
-
-        mesh->texcoords[i * 2 + 0] = uniqueVertices[i].texcoord.x;
-        mesh->texcoords[i * 2 + 1] = uniqueVertices[i].texcoord.y;
+        // Update mesh GPU data
+        // in raylib, mesh buffers are updated using rlUpdateVertexBuffer
+        // and normal buffer is usually at index 2
+        if (mesh.vboId != nullptr && mesh.vboId[2] != 0)
+            UpdateMeshBuffer(mesh, 2, mesh.normals, mesh.vertexCount * 3 * sizeof(float), 0);
     }
 
-    for (int i = 0; i < indices.size(); i++) {
-        mesh->indices[i] = indices[i];
+    TraceLog(LOG_INFO, "Recalculated smooth normals of %d meshes, %d vertices in %.2f ms", model.meshCount, totalVertices, (GetTime() - t) * 1000);
+}
+
+/// <summary>
+/// ConvertMeshToIndexed - Merge the duplicated vertices of a non-indexed mesh and build its index buffer.
+/// Vertices are merged only if all their attributes match, see MeshOptimizer::DeduplicateVertices.
+/// </summary>
+/// <param name="mesh">The mesh, re-uploaded if it is already on the GPU</param>
+extern void ConvertMeshToIndexed(Mesh* mesh)
+{
+    if (mesh->indices != nullptr) {
+        TraceLog(LOG_WARNING, "Mesh is already indexed. No conversion needed. Skip this action.");
+		return;
     }
 
-    // Update counts
-    mesh->triangleCount = (int)indices.size() / 3;
-
-	//Check if the mesh has been uploaded to GPU
-	//If Yes, we need to unload the mesh buffers and re-upload the mesh with new data
-    if (mesh->vaoId > 0) {
-
-        // Unload rlgl mesh vboId data
-        // raylib will check if this mesh has been uploaded to GPU and skip the upload 
-        // So we just unload the buffers here and then re-upload the mesh
-        // Do not use UnloadMesh() as it will free the mesh structure itself
-        rlUnloadVertexArray(mesh->vaoId);
-        mesh->vaoId = 0;
-        if (mesh->vboId != NULL)
-            for (int i = 0; i < MAX_MESH_VERTEX_BUFFERS; i++)
-            {
-                rlUnloadVertexBuffer(mesh->vboId[i]);
-                mesh->vboId[i] = 0;
-            }
+	TraceLog(LOG_INFO, "Converting mesh to indexed format. Current vertices = %d", mesh->vertexCount);
 
-        TraceLog(LOG_INFO, "Converting mesh to indexed format done. Current vertices = %d, indices=%d", mesh->vertexCount, mesh->triangleCount * 3);
+    // raylib meshes use 16-bit indices, more unique vertices than that can not be addressed
+    if (!MeshOptimizer::DeduplicateVertices(mesh)) {
+        TraceLog(LOG_WARNING, "Mesh has more unique vertices than 16-bit indices can address. Skip this action.");
+        return;
+    }
 
-        // Upload updated mesh to GPU (rebuilds VBOs/VAO)
-        UploadMesh(mesh, true);
+    TraceLog(LOG_INFO, "Converting mesh to indexed format done. Current vertices = %d, indices=%d", mesh->vertexCount, mesh->triangleCount * 3);
 
-    }
+	//If the mesh has been uploaded to GPU, replace its buffers with the new data
+    MeshOptimizer::ReuploadMesh(mesh);
 }
 
 
@@ -457,4 +397,46 @@ extern bool IsBoundingBoxValid(BoundingBox box)
     return true;
 }
 
+/// <summary>
+/// EncodeOctahedralNormal - project a unit vector onto the octahedron |x|+|y|+|z|=1, unfold it into
+/// the [-1,1] square and store both coordinates as 16-bit snorm (x in the low, y in the high 16 bits)
+/// </summary>
+/// <param name="n">Unit vector</param>
+/// <returns>The packed normal</returns>
+extern unsigned int EncodeOctahedralNormal(Vector3 n)
+{
+    float invL1 = 1.0f / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z) + 1e-20f);
+    float u = n.x * invL1;
+    float v = n.z * invL1;
+    if (n.y < 0.0f) {
+        //fold the lower hemisphere over the diagonals
+        float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    short su = (short)roundf(Clamp(u, -1.0f, 1.0f) * 32767.0f);
+    short sv = (short)roundf(Clamp(v, -1.0f, 1.0f) * 32767.0f);
+    return (unsigned int)(unsigned short)su | ((unsigned int)(unsigned short)sv << 16);
+}
+
+/// <summary>
+/// DecodeOctahedralNormal - inverse of EncodeOctahedralNormal
+/// </summary>
+/// <param name="packed">The packed normal</param>
+/// <returns>Unit vector</returns>
+extern Vector3 DecodeOctahedralNormal(unsigned int packed)
+{
+    float u = (short)(packed & 0xffff) * (1.0f / 32767.0f);
+    float v = (short)(packed >> 16) * (1.0f / 32767.0f);
+    Vector3 n = { u, 1.0f - fabsf(u) - fabsf(v), v };
+    if (n.y < 0.0f) {
+        float t = -n.y;
+        n.x += n.x >= 0.0f ? -t : t;
+        n.z += n.z >= 0.0f ? -t : t;
+    }
+    float invLength = 1.0f / sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+    return Vector3{ n.x * invLength, n.y * invLength, n.z * invLength };
+}
+
 //end of Utils.cpp
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "Knight.h"
+#include "KnightCooker.h"
+#include "../BonusGameWorld02/TerrainTileStream.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+
+static const char* AssetTypeNames[COOK_TYPE_COUNT] = { "model", "texture", "heightmap" };
+
+#define FNV_OFFSET_BASIS	14695981039346656037ULL
+#define FNV_PRIME			1099511628211ULL
+
+static unsigned long long HashBytes(const void* pData, size_t size, unsigned long long hash)
+{
+	const unsigned char* pBytes = (const unsigned char*)pData;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= pBytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+//main entry point for the cooker
+int main(int argc, char* argv[])
+{
+	KnightCooker cooker;
+	return cooker.Run(argc, argv);
+}
+
+/// <summary>
+/// Run - Scan, hash, cook what changed and write the manifest. Images are cooked on the workers while
+/// the main thread converts the models, which need the OpenGL context raylib's model loaders upload to.
+/// </summary>
+/// <returns>0 if every asset is up to date or was cooked, 1 otherwise.</returns>
+int KnightCooker::Run(int argc, char* argv[])
+{
+	if (!ParseArguments(argc, argv))
+	{
+		printf("usage: KnightCooker [resource directory] [-f] [-j workers] [-v]\n");
+		printf("  -f  cook everything, ignore the manifest\n");
+		printf("  -j  number of worker threads, default is one less than the hardware threads\n");
+		printf("  -v  show the raylib log\n");
+		return 1;
+	}
+	SetTraceLogLevel(_Verbose ? LOG_INFO : LOG_WARNING);
+
+	if (!DirectoryExists(_Root.c_str()))
+	{
+		printf("KnightCooker: resource directory %s not found\n", _Root.c_str());
+		return 1;
+	}
+
+	//GetTime() needs the window, which is only opened if there are models to cook
+	auto startTime = chrono::steady_clock::now();
+	JobSystem::Instance().Shutdown();
+	JobSystem::Instance().Initialize(_NumWorkers);
+
+	Scan();
+	LoadManifest();
+	HashAssets();
+
+	vector<CookerAsset*> models, images;
+	for (CookerAsset& asset : _Assets)
+	{
+		if (!asset.dirty)
+			continue;
+		if (asset.type == COOK_MODEL)
+			models.push_back(&asset);
+		else
+			images.push_back(&asset);
+	}
+	printf("KnightCooker: %d assets in %s, %d to cook on %d threads\n", (int)_Assets.size(), _Root.c_str(),
+		(int)(models.size() + images.size()), JobSystem::Instance().GetNumThreads());
+
+	//raylib's model loaders upload the meshes, a hidden window provides the context
+	bool hasWindow = false;
+	if (!models.empty())
+	{
+		SetConfigFlags(FLAG_WINDOW_HIDDEN);
+		InitWindow(64, 64, "KnightCooker");
+		hasWindow = IsWindowReady();
+	}
+
+	future<void> imagesDone = JobSystem::Instance().Submit([this, &images]() { CookImages(images); });
+	if (hasWindow)
+		CookModels(models);
+	imagesDone.wait();
+
+	if (hasWindow)
+		CloseWindow();
+
+	int numCooked = 0, numFailed = 0;
+	for (CookerAsset& asset : _Assets)
+	{
+		if (!asset.dirty)
+			continue;
+		if (asset.cooked)
+		{
+			_Manifest[asset.key] = asset.hash;
+			numCooked++;
+		}
+		else
+		{
+			//forget the entry so the asset is retried next time
+			_Manifest.erase(asset.key);
+			numFailed++;
+		}
+	}
+
+	bool manifestSaved = SaveManifest();
+	printf("KnightCooker: %d cooked, %d up to date, %d failed in %.2f s\n", numCooked,
+		(int)_Assets.size() - numCooked - numFailed, numFailed, chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+	if (!manifestSaved)
+		printf("KnightCooker: failed to write the manifest\n");
+
+	JobSystem::Instance().Shutdown();
+	return (numFailed == 0 && manifestSaved) ? 0 : 1;
+}
+
+bool KnightCooker::ParseArguments(int argc, char* argv[])
+{
+	bool hasRoot = false;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "-f")
+			_Force = true;
+		else if (arg == "-v")
+			_Verbose = true;
+		else if (arg == "-j" && i + 1 < argc)
+			_NumWorkers = std::max(1, atoi(argv[++i]) - 1);	//the main thread works too
+		else if (arg[0] != '-' && !hasRoot)
+		{
+			_Root = arg;
+			hasRoot = true;
+		}
+		else
+			return false;
+	}
+
+	while (_Root.size() > 1 && (_Root.back() == '/' || _Root.back() == '\\'))
+		_Root.pop_back();
+	return true;
+}
+
+/// <summary>
+/// Scan - Collect the models and images below the root. Images named heightmap* are cooked twice,
+/// as a texture and as a tiled height file.
+/// </summary>
+void KnightCooker::Scan()
+{
+	_Assets.clear();
+	FilePathList files = LoadDirectoryFilesEx(_Root.c_str(), nullptr, true);
+	for (unsigned int i = 0; i < files.count; i++)
+	{
+		const char* path = files.paths[i];
+		string relativePath = path;
+		if (relativePath.compare(0, _Root.size(), _Root) == 0)
+			relativePath.erase(0, _Root.size() + 1);
+
+		CookerAsset asset;
+		asset.sourcePath = path;
+		if (IsFileExtension(path, COOKER_MODEL_EXTENSIONS))
+		{
+			asset.type = COOK_MODEL;
+			asset.outputPath = KnightAsset::GetBakedPath(path);
+		}
+		else if (IsFileExtension(path, COOKER_IMAGE_EXTENSIONS))
+		{
+			asset.type = COOK_TEXTURE;
+			asset.outputPath = KnightAsset::GetCookedTexturePath(path);
+
+			if (TextFindIndex(TextToLower(GetFileName(path)), COOKER_HEIGHTMAP_PREFIX) == 0)
+			{
+				CookerAsset heightmap = asset;
+				heightmap.type = COOK_HEIGHTMAP;
+				heightmap.outputPath = TextFormat("%s/%s.ktt", GetDirectoryPath(path), GetFileNameWithoutExt(path));
+				heightmap.key = string(AssetTypeNames[COOK_HEIGHTMAP]) + "\t" + relativePath;
+				_Assets.push_back(heightmap);
+			}
+		}
+		else
+			continue;
+
+		asset.key = string(AssetTypeNames[asset.type]) + "\t" + relativePath;
+		_Assets.push_back(asset);
+	}
+	UnloadDirectoryFiles(files);
+}
+
+/// <summary>
+/// HashAssets - Hash the sources in parallel. An asset is dirty if its hash differs from the manifest
+/// entry, or its output is missing.
+/// </summary>
+void KnightCooker::HashAssets()
+{
+	JobSystem::Instance().ParallelFor((int)_Assets.size(), 1, [this](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			_Assets[i].hash = HashFile(_Assets[i].sourcePath.c_str(), GetSettingsSeed(_Assets[i].type));
+	});
+
+	for (CookerAsset& asset : _Assets)
+	{
+		auto entry = _Manifest.find(asset.key);
+		asset.dirty = _Force || asset.hash == 0 || entry == _Manifest.end() || entry->second != asset.hash
+			|| !FileExists(asset.outputPath.c_str());
+	}
+}
+
+/// <summary>
+/// CookImages - Textures and heightmaps don't need the GPU, they are all cooked in parallel.
+/// </summary>
+/// <param name="assets">The dirty image assets.</param>
+void KnightCooker::CookImages(const vector<CookerAsset*>& assets)
+{
+	JobSystem::Instance().ParallelFor((int)assets.size(), 1, [&assets](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			CookerAsset* pAsset = assets[i];
+			if (pAsset->type == COOK_HEIGHTMAP)
+				pAsset->cooked = TerrainTileStream::ConvertFromImage(pAsset->sourcePath.c_str(), pAsset->outputPath.c_str(), COOKER_HEIGHTMAP_TILE_SIZE);
+			else
+				pAsset->cooked = KnightAsset::CookTexture(pAsset->sourcePath.c_str(), pAsset->outputPath.c_str());
+			printf("  %s %s\n", pAsset->cooked ? "cooked" : "failed", pAsset->outputPath.c_str());
+		}
+	});
+}
+
+/// <summary>
+/// CookModels - Convert the models one after the other on the main thread, the mesh processing of each
+/// model runs on all workers inside KnightAsset::Convert.
+/// </summary>
+/// <param name="assets">The dirty model assets.</param>
+void KnightCooker::CookModels(const vector<CookerAsset*>& assets)
+{
+	for (CookerAsset* pAsset : assets)
+	{
+		pAsset->cooked = KnightAsset::Convert(pAsset->sourcePath.c_str(), pAsset->outputPath.c_str(), true);
+		printf("  %s %s\n", pAsset->cooked ? "cooked" : "failed", pAsset->outputPath.c_str());
+	}
+}
+
+/// <summary>
+/// LoadManifest - Read the hashes of the previous run, one "hash type source" line per asset.
+/// </summary>
+void KnightCooker::LoadManifest()
+{
+	_Manifest.clear();
+	string manifestPath = _Root + "/" + COOKER_MANIFEST_NAME;
+	if (!FileExists(manifestPath.c_str()))
+		return;
+
+	char* pText = LoadFileText(manifestPath.c_str());
+	if (pText == nullptr)
+		return;
+
+	string text = pText;
+	UnloadFileText(pText);
+
+	size_t lineStart = 0;
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == string::npos)
+			lineEnd = text.size();
+		string line = text.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t tab = line.find('\t');
+		if (line.empty() || line[0] == '#' || tab == string::npos)
+			continue;
+		_Manifest[line.substr(tab + 1)] = strtoull(line.substr(0, tab).c_str(), nullptr, 16);
+	}
+}
+
+bool KnightCooker::SaveManifest() const
+{
+	string manifestPath = _Root + "/" + COOKER_MANIFEST_NAME;
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, manifestPath.c_str(), "w") != 0 || fp == nullptr)
+		return false;
+
+	fprintf(fp, "# KnightCooker %d, content hash / asset type / source relative to this file\n", COOKER_VERSION);
+	for (const CookerAsset& asset : _Assets)
+	{
+		auto entry = _Manifest.find(asset.key);
+		if (entry != _Manifest.end())
+			fprintf(fp, "%016llx\t%s\n", entry->second, asset.key.c_str());
+	}
+	fclose(fp);
+	return true;
+}
+
+/// <summary>
+/// HashFile - 64-bit FNV-1a of the file contents.
+/// </summary>
+/// <param name="path">The file.</param>
+/// <param name="seed">Start value, GetSettingsSeed() so changed settings invalidate the outputs.</param>
+/// <returns>The hash, 0 if the file can't be read.</returns>
+unsigned long long KnightCooker::HashFile(const char* path, unsigned long long seed)
+{
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, path, "rb") != 0 || fp == nullptr)
+		return 0;
+
+	vector<unsigned char> buffer(64 * 1024);
+	unsigned long long hash = seed;
+	size_t size;
+	while ((size = fread(buffer.data(), 1, buffer.size(), fp)) > 0)
+		hash = HashBytes(buffer.data(), size, hash);
+	fclose(fp);
+	return hash;
+}
+
+unsigned long long KnightCooker::GetSettingsSeed(eCookerAssetType type)
+{
+	int settings[4] = { COOKER_VERSION, (int)type, 0, 0 };
+	switch (type)
+	{
+	case COOK_MODEL:
+		settings[2] = KNIGHT_ASSET_VERSION;
+		settings[3] = 1;	//tangents
+		break;
+	case COOK_TEXTURE:
+		settings[2] = KNIGHT_TEXTURE_VERSION;
+		break;
+	case COOK_HEIGHTMAP:
+		settings[2] = TERRAIN_TILE_FILE_VERSION;
+		settings[3] = COOKER_HEIGHTMAP_TILE_SIZE;
+		break;
+	default:
+		break;
+	}
+	return HashBytes(settings, sizeof(settings), FNV_OFFSET_BASIS);
+}
+
+//End of KnightCooker.cpp
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+#define COOKER_VERSION				1
+#define COOKER_DEFAULT_ROOT			"../../resources"
+#define COOKER_MANIFEST_NAME		"cooked.manifest"
+#define COOKER_HEIGHTMAP_PREFIX		"heightmap"		//images named heightmap* also get a tiled height file
+#define COOKER_HEIGHTMAP_TILE_SIZE	128				//tile size BonusGameWorld02 streams its terrain with
+#define COOKER_MODEL_EXTENSIONS		".obj;.glb;.gltf;.iqm;.m3d;.vox"
+#define COOKER_IMAGE_EXTENSIONS		".png;.jpg;.jpeg;.tga;.bmp"
+
+enum eCookerAssetType
+{
+	COOK_MODEL = 0,		// -> .kna, normals, tangents, indexing and mesh optimization baked in
+	COOK_TEXTURE,		// -> .knt, decoded with its full mip chain
+	COOK_HEIGHTMAP,		// -> .ktt, tiles with min/max table and overview level
+	COOK_TYPE_COUNT
+};
+
+struct CookerAsset
+{
+	eCookerAssetType type = COOK_MODEL;
+	string sourcePath;				// full path
+	string outputPath;				// full path
+	string key;						// type and source path relative to the root, the manifest entry
+	unsigned long long hash = 0;	// content hash of the source and the cooker settings
+	bool dirty = true;
+	bool cooked = false;
+};
+
+// Offline asset cooker: converts everything under the resources directory into the runtime formats
+// the engine loads without any processing, next to the source files. Every source is hashed, assets
+// whose hash matches the manifest of the previous run and whose output exists are skipped.
+class KnightCooker
+{
+public:
+	int Run(int argc, char* argv[]);
+
+protected:
+	bool ParseArguments(int argc, char* argv[]);
+	void Scan();
+	void HashAssets();
+	void LoadManifest();
+	bool SaveManifest() const;
+	void CookImages(const vector<CookerAsset*>& assets);
+	void CookModels(const vector<CookerAsset*>& assets);
+
+	static unsigned long long HashFile(const char* path, unsigned long long seed);
+	static unsigned long long GetSettingsSeed(eCookerAssetType type);
+
+	string _Root = COOKER_DEFAULT_ROOT;
+	bool _Force = false;
+	bool _Verbose = false;
+	int _NumWorkers = 0;
+
+	vector<CookerAsset> _Assets;
+	unordered_map<string, unsigned long long> _Manifest;	// key -> hash of the last successful cook
+};
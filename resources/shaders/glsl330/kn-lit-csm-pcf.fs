@@ -0,0 +1,202 @@
+#version 330
+
+// Lighting of kn-lit-sm-pcf.fs with cascaded shadow maps
+// The cascades are tiles of one shadow map atlas, the fragment picks the first cascade its view depth falls in
+// Any number of point lights without shadow are added through the froxel grid of ClusteredLighting
+
+#define MAX_CASCADES 4
+
+// Input vertex attributes (from vertex shader)
+in vec3 fragPosition;
+in vec2 fragTexCoord;
+//in vec4 fragColor;
+in vec3 fragNormal;
+
+// Input uniform values from raylib
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+// Standard uniforms from Knight
+uniform int alphaTest;
+
+// Output fragment color
+out vec4 finalColor;
+
+// Input lighting values
+uniform vec3 lightDir;
+uniform vec4 lightColor;
+uniform vec4 ambient;
+uniform vec3 viewPos;
+uniform vec3 viewDir;
+
+// Input shadowmapping values
+uniform mat4 cascadeVP[MAX_CASCADES]; // Light view-projection matrix of each cascade
+uniform vec4 cascadeSplits;           // View depth where each cascade ends
+uniform vec4 cascadeTexelSize;        // World units covered by a shadow map texel of each cascade
+uniform int numCascades;
+uniform int cascadeColumns;           // The atlas has cascadeColumns x cascadeColumns tiles
+uniform float fadeRange;              // Share of the last cascade over which the shadows fade out
+uniform float normalOffset;           // Look up the shadow map this many texels along the normal
+uniform sampler2D shadowMap;
+
+uniform int shadowMapResolution;
+
+uniform int receiveShadow;
+
+// Clustered point lights, the view frustum is split into a grid of froxels (screen tiles x depth slices)
+// and each froxel lists the lights reaching into it, see ClusteredLighting
+#define     CLUSTER_TEXTURE_WIDTH   1024
+
+uniform int clusterEnabled;         // 0 = no clustered lights this frame
+uniform sampler2D clusterGrid;      // per froxel: offset into the index list, light count
+uniform sampler2D clusterIndices;   // light indices of all froxels one after the other
+uniform sampler2D clusterLights;    // two texels per light: position and radius, color and intensity
+uniform ivec3 clusterDims;          // tiles across, tiles down, depth slices
+uniform mat4 clusterView;           // view matrix of the camera the grid was built for
+uniform vec2 clusterProjScale;      // view space to normalized device coordinates at depth 1
+uniform vec2 clusterDepthParams;    // slice = log(depth)*x + y
+
+void main()
+{
+    // Texel color fetching from texture sampler
+    vec4 texelColor = texture(texture0, fragTexCoord);
+
+    if (alphaTest > 0 && texelColor.a < 0.51) {
+        discard; // Discard the fragment if alpha is below threshold
+    }
+
+    vec3 lightDot = vec3(0.0);
+    vec3 normal = normalize(fragNormal);
+    vec3 viewD = normalize(viewPos - fragPosition);
+    vec3 specular = vec3(0.0);
+
+    vec3 l = -lightDir;
+
+    float NdotL = max(dot(normal, l), 0.0);
+    lightDot += lightColor.rgb*NdotL;
+
+    float specCo = 0.0;
+    if (NdotL > 0.0) specCo = pow(max(0.0, dot(viewD, reflect(-(l), normal))), 16.0); // 16 refers to shine
+    specular += specCo;
+
+    finalColor = (texelColor*((colDiffuse + vec4(specular, 1.0))*vec4(lightDot, 1.0)));
+
+    // The point lights are not in the shadow of the sun, they are added after it
+    vec3 pointLight = vec3(0.0);
+    vec3 pointSpecular = vec3(0.0);
+    if (clusterEnabled == 1)
+    {
+        // Find the froxel of the fragment the same way the CPU built them
+        vec4 viewP = clusterView*vec4(fragPosition, 1.0);
+        float depth = max(-viewP.z, 0.0001);
+        vec2 ndc = viewP.xy*clusterProjScale/depth;
+        ivec2 tile = clamp(ivec2((ndc*0.5 + 0.5)*vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+        int slice = clamp(int(floor(log(depth)*clusterDepthParams.x + clusterDepthParams.y)), 0, clusterDims.z - 1);
+
+        vec2 range = texelFetch(clusterGrid, ivec2(tile.x + tile.y*clusterDims.x, slice), 0).xy;
+        int first = int(range.x);
+        int count = int(range.y);
+
+        for (int n = 0; n < count; n++)
+        {
+            int index = first + n;
+            int lightIndex = int(texelFetch(clusterIndices, ivec2(index%CLUSTER_TEXTURE_WIDTH, index/CLUSTER_TEXTURE_WIDTH), 0).r);
+            ivec2 lightTexel = ivec2((lightIndex*2)%CLUSTER_TEXTURE_WIDTH, (lightIndex*2)/CLUSTER_TEXTURE_WIDTH);
+            vec4 positionRadius = texelFetch(clusterLights, lightTexel, 0);
+            vec4 colorIntensity = texelFetch(clusterLights, lightTexel + ivec2(1, 0), 0);
+
+            vec3 toLight = positionRadius.xyz - fragPosition;
+            float lightDistance = length(toLight);
+            if (lightDistance >= positionRadius.w)
+                continue;
+
+            // Falls off smoothly to nothing at the light radius
+            float falloff = 1.0 - lightDistance/positionRadius.w;
+            falloff *= falloff;
+
+            vec3 pl = toLight/max(lightDistance, 0.0001);
+            float NdotPL = max(dot(normal, pl), 0.0);
+            pointLight += colorIntensity.rgb*colorIntensity.a*NdotPL*falloff;
+
+            if (NdotPL > 0.0)
+            {
+                vec3 halfVector = normalize(pl + viewD);
+                pointSpecular += pow(max(dot(normal, halfVector), 0.0), 16.0)*falloff;
+            }
+        }
+    }
+    vec4 pointColor = texelColor*vec4(colDiffuse.rgb*pointLight + pointSpecular, 0.0);
+
+    //If this object does not receive shadows, skip shadow calculations
+    if (receiveShadow == 0)
+    {
+        finalColor += pointColor;
+        return;
+    }
+
+    // Pick the cascade
+    float viewDepth = dot(fragPosition - viewPos, viewDir);
+    int cascade = numCascades;
+    for (int i = 0; i < MAX_CASCADES; i++)
+    {
+        if (i < numCascades && viewDepth < cascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    float shadow = 0.0;
+    if (cascade < numCascades)
+    {
+        // Normal offset: moving the lookup off the surface by the texel size of the cascade removes the
+        // "shadow acne" of the large far texels, a small depth bias is enough on top of it
+        vec3 samplePosition = fragPosition + normal * cascadeTexelSize[cascade] * normalOffset;
+        vec4 fragPosLightSpace = cascadeVP[cascade] * vec4(samplePosition, 1);
+        fragPosLightSpace.xyz /= fragPosLightSpace.w; // Perform the perspective division
+        fragPosLightSpace.xyz = (fragPosLightSpace.xyz + 1.0f) / 2.0f; // Transform from [-1, 1] range to [0, 1] range
+        float curDepth = fragPosLightSpace.z;
+        float bias = max(0.0005f * (1.0 - dot(normal, l)), 0.0002f);
+
+        // Place the lookup in the tile of the cascade, the PCF samples are kept inside the tile
+        float tileSize = 1.0f / float(cascadeColumns);
+        vec2 tileOrigin = vec2(float(cascade % cascadeColumns), float(cascade / cascadeColumns)) * tileSize;
+        vec2 texelSize = vec2(1.0f / float(shadowMapResolution));
+        vec2 sampleMin = tileOrigin + texelSize;
+        vec2 sampleMax = tileOrigin + vec2(tileSize) - texelSize;
+        vec2 sampleCoords = tileOrigin + fragPosLightSpace.xy * tileSize;
+
+        int shadowCounter = 0;
+        const int numSamples = 9;
+        if (curDepth < 1.0)
+        {
+            // PCF (percentage-closer filtering) algorithm:
+            // Instead of testing if just one point is closer to the current point,
+            // we test the surrounding points as well.
+            // This blurs shadow edges, hiding aliasing artifacts.
+            for (int x = -1; x <= 1; x++)
+            {
+                for (int y = -1; y <= 1; y++)
+                {
+                    float sampleDepth = texture(shadowMap, clamp(sampleCoords + texelSize * vec2(x, y), sampleMin, sampleMax)).r;
+                    if (curDepth - bias > sampleDepth)
+                    {
+                        shadowCounter++;
+                    }
+                }
+            }
+        }
+        shadow = float(shadowCounter) / float(numSamples);
+
+        // Fade the shadows out towards the end of the last cascade, there is no hard edge where they stop
+        if (cascade == numCascades - 1)
+        {
+            float fadeLength = max(cascadeSplits[cascade] * fadeRange, 0.001);
+            shadow *= clamp((cascadeSplits[cascade] - viewDepth) / fadeLength, 0.0, 1.0);
+        }
+    }
+    finalColor = mix(finalColor, finalColor*ambient, shadow) + pointColor;
+
+    // Gamma correction
+    finalColor = pow(finalColor, vec4(1.0/1.2));
+}
@@ -0,0 +1,127 @@
+// kn-sm-pcf.fs Fragment shader program for rendering object with maximum 4 lightings, texture and shadows
+// The shadow maps of all lights are tiles of one atlas, shadowAtlasRects tells each light where its tile is
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec3 worldPos;
+in vec2 texUV;
+in vec4 vtxColor;
+in vec3 vtxNormal;  //assume the normal is already normalized
+in vec4 fragPositionLightSpace[4];
+
+// These are default uniforms provided by Raylib shader system
+uniform sampler2D texture0;    //texture sampler unit 0
+uniform vec4 colDiffuse;    // color diffuse (base tint color, multiplied by texture color)
+uniform int alphaTest;    // alpha test value (0 = disabled, 1 = enabled)
+
+// Output fragment color
+out vec4 outColor;
+
+#define     MAX_LIGHTS              4
+#define     LIGHT_DIRECTIONAL       0
+#define     LIGHT_POINT             1
+
+struct Light {
+    int enabled;
+    int type;
+    vec3 position;
+    vec3 target;
+    vec4 color;
+};
+
+// Input lighting values
+uniform Light lights[MAX_LIGHTS];
+uniform vec4 ambient;
+uniform vec3 viewPos;
+uniform float materialShininess; // Material shininess factor
+
+// Shadow atlas
+uniform sampler2D shadowAtlas;
+uniform vec4 shadowAtlasRects[MAX_LIGHTS]; // offset and size of each light's tile in texture coordinates, size 0 means no shadow
+uniform int shadowAtlasResolution;
+
+// Share of the 3x3 PCF samples in shadow, 0 outside the light's tile
+float ShadowFactor(vec4 positionLightSpace, vec4 rect, float NdotL)
+{
+    if (rect.z <= 0.0)
+        return 0.0;
+
+    vec3 p = positionLightSpace.xyz / positionLightSpace.w; // Perform the perspective division
+    p = p * 0.5 + 0.5; // Transform from [-1, 1] range to [0, 1] range
+    if (p.x < 0.0 || p.x > 1.0 || p.y < 0.0 || p.y > 1.0 || p.z > 1.0)
+        return 0.0;
+
+    // Keep the samples inside the tile, the neighbours belong to other lights
+    vec2 texelSize = vec2(1.0 / float(shadowAtlasResolution));
+    vec2 sampleMin = rect.xy + texelSize * 0.5;
+    vec2 sampleMax = rect.xy + rect.zw - texelSize * 0.5;
+    vec2 sampleCoords = rect.xy + p.xy * rect.zw;
+
+    // Slope-scale depth bias against "shadow acne"
+    float bias = max(0.002 * (1.0 - NdotL), 0.0005);
+
+    int shadowCounter = 0;
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            float sampleDepth = texture(shadowAtlas, clamp(sampleCoords + texelSize * vec2(x, y), sampleMin, sampleMax)).r;
+            if (p.z - bias > sampleDepth)
+                shadowCounter++;
+        }
+    }
+    return float(shadowCounter) / 9.0;
+}
+
+void main()
+{
+
+    vec4 texel = texture(texture0, texUV) * vtxColor;
+
+    if (alphaTest == 1 && texel.a < 0.5)
+        discard; // Apply alpha test if enabled    
+
+    vec3 viewD = normalize(viewPos - worldPos);
+    vec3 lightSum = vec3(0.0);
+    vec3 specularSum = vec3(0.0);
+
+    //Loop through all enabled lights to calculate lighting
+    for (int i = 0; i < MAX_LIGHTS; i++)
+    {
+        if (lights[i].enabled == 1) // Check if the light is enabled
+        {
+            vec3 light = vec3(0.0);
+
+            if (lights[i].type == LIGHT_DIRECTIONAL)
+            {
+                light = -normalize(lights[i].target - lights[i].position);
+            }
+
+            if (lights[i].type == LIGHT_POINT)
+            {
+                light = normalize(lights[i].position - worldPos);
+            }
+
+            // Calculate diffuse component (Lambertian)
+            float NdotL = max(dot(vtxNormal, light), 0.0);
+
+            // The shadowed part of the light is left to the ambient term
+            float lit = 1.0 - ShadowFactor(fragPositionLightSpace[i], shadowAtlasRects[i], NdotL);
+            lightSum += lights[i].color.rgb * NdotL * lit;
+
+            // Calculate specular component (Blinn-Phong)
+            float specCo = 0.0;
+            if (NdotL > 0.0) // Only calculate specular if diffuse light is present
+            {
+                vec3 halfVector = normalize(light + viewD);
+                float NdotH = max(dot(vtxNormal, halfVector), 0.0);
+                specCo = pow(NdotH, materialShininess);
+            }
+            specularSum += specCo * lit; // Accumulate specular contribution
+        }
+    }
+    
+    outColor = (texel*((colDiffuse + vec4(specularSum, 1.0))*vec4(lightSum, 1.0))) + ambient*colDiffuse;
+    outColor = pow(outColor, vec4(1.0/1.2));      // Gamma correction
+
+}
@@ -0,0 +1,7 @@
+// kn_depth.fs Fragment shader program for rendering shadow casters into a depth-only shadow map
+#version 330
+
+void main()
+{
+    // Nothing to shade, only the depth of the fragment is written
+}
@@ -1,4 +1,4 @@
-// kn_lit.fs Fragment shader program for rendering object with maximum 4 lightings and texture
+// kn_lit.fs Fragment shader program for rendering object with maximum 4 lightings, any number of clustered point lights and texture
 #version 330
 
 // Input vertex attributes (from vertex shader)
@@ -33,6 +33,19 @@ uniform vec4 ambient;
 uniform vec3 viewPos;
 uniform float materialShininess; // Material shininess factor
 
+// Clustered point lights, the view frustum is split into a grid of froxels (screen tiles x depth slices)
+// and each froxel lists the lights reaching into it, see ClusteredLighting
+#define     CLUSTER_TEXTURE_WIDTH   1024
+
+uniform int clusterEnabled;         // 0 = no clustered lights this frame
+uniform sampler2D clusterGrid;      // per froxel: offset into the index list, light count
+uniform sampler2D clusterIndices;   // light indices of all froxels one after the other
+uniform sampler2D clusterLights;    // two texels per light: position and radius, color and intensity
+uniform ivec3 clusterDims;          // tiles across, tiles down, depth slices
+uniform mat4 clusterView;           // view matrix of the camera the grid was built for
+uniform vec2 clusterProjScale;      // view space to normalized device coordinates at depth 1
+uniform vec2 clusterDepthParams;    // slice = log(depth)*x + y
+
 void main()
 {
 
@@ -84,6 +97,49 @@ void main()
             specularSum += specCo; // Accumulate specular contribution
         }
     }
+
+    if (clusterEnabled == 1)
+    {
+        // Find the froxel of the fragment the same way the CPU built them
+        vec4 viewP = clusterView*vec4(worldPos, 1.0);
+        float depth = max(-viewP.z, 0.0001);
+        vec2 ndc = viewP.xy*clusterProjScale/depth;
+        ivec2 tile = clamp(ivec2((ndc*0.5 + 0.5)*vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+        int slice = clamp(int(floor(log(depth)*clusterDepthParams.x + clusterDepthParams.y)), 0, clusterDims.z - 1);
+
+        vec2 range = texelFetch(clusterGrid, ivec2(tile.x + tile.y*clusterDims.x, slice), 0).xy;
+        int first = int(range.x);
+        int count = int(range.y);
+
+        for (int n = 0; n < count; n++)
+        {
+            int index = first + n;
+            int lightIndex = int(texelFetch(clusterIndices, ivec2(index%CLUSTER_TEXTURE_WIDTH, index/CLUSTER_TEXTURE_WIDTH), 0).r);
+            ivec2 lightTexel = ivec2((lightIndex*2)%CLUSTER_TEXTURE_WIDTH, (lightIndex*2)/CLUSTER_TEXTURE_WIDTH);
+            vec4 positionRadius = texelFetch(clusterLights, lightTexel, 0);
+            vec4 colorIntensity = texelFetch(clusterLights, lightTexel + ivec2(1, 0), 0);
+
+            vec3 toLight = positionRadius.xyz - worldPos;
+            float lightDistance = length(toLight);
+            if (lightDistance >= positionRadius.w)
+                continue;
+
+            // Falls off smoothly to nothing at the light radius
+            float falloff = 1.0 - lightDistance/positionRadius.w;
+            falloff *= falloff;
+
+            vec3 light = toLight/max(lightDistance, 0.0001);
+            float NdotL = max(dot(vtxNormal, light), 0.0);
+            lightSum += colorIntensity.rgb*colorIntensity.a*NdotL*falloff;
+
+            if (NdotL > 0.0)
+            {
+                vec3 halfVector = normalize(light + viewD);
+                float NdotH = max(dot(vtxNormal, halfVector), 0.0);
+                specularSum += pow(NdotH, materialShininess)*falloff;
+            }
+        }
+    }
     
     outColor = (texel*((colDiffuse + vec4(specularSum, 1.0))*vec4(lightSum, 1.0))) + ambient*colDiffuse;
     outColor = pow(outColor, vec4(1.0/1.2));      // Gamma correction
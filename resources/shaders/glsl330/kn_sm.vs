@@ -33,7 +33,7 @@ void main()
 
     // NEW: Calculate fragment position in each light's clip space
     for (int i = 0; i < 4; ++i) {
-        fragPositionLightSpace[i] = lightSpaceMatrices[i] * vec4(vertexPosition, 1.0);
+        fragPositionLightSpace[i] = lightSpaceMatrices[i] * vec4(worldPos, 1.0);
     }
 
     // Calculate final vertex position